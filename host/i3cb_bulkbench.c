@@ -0,0 +1,309 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Measures the sustained throughput of the vendor bulk interface.
+ *
+ *   i3cb_bulkbench [-s serial] [-m mode] [-n bytes] [-a addr] [-c cmd] [-d depth] [-t seconds] [-b buses]
+ *
+ * modes:
+ *   echo       USB only, the payload is sent back unchanged (default)
+ *   sdr_write  I3C SDR private writes of n bytes to addr
+ *   sdr_read   I3C SDR private reads of n bytes from addr
+ *   ddr_write  HDR-DDR writes of n/2 words with command cmd to addr
+ *   ddr_read   HDR-DDR reads of n/2 words with command cmd from addr
+ *
+ * depth requests are kept in flight. Payload bytes transferred in each direction are reported in MB/s (10^6 bytes).
+ * With depth 1 the mean round trip time per request is reported as well, e.g. "-m sdr_read -n 1 -d 1" or
+ * "-m ddr_read -n 2 -d 1" show the latency of short transfers incl. the USB round trip.
+ *
+ * With -b the measurement is repeated for 1..buses I3C buses. Every request is preceded by a BUS_SELECT frame, the
+ * requests are distributed round robin over the buses and the aggregate throughput is reported per bus count.
+ * Buses 1..buses-1 have to be set up before, e.g. with the CLI command "i3c_bus 1 2", and need a target at addr.
+ * Buses with even numbers are served by one core, buses with odd numbers by the other, so 3 and 4 buses do not scale
+ * beyond 2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "i3cb_usb.h"
+
+typedef struct
+{
+	const char *name;
+	uint8_t     opcode;
+} bench_mode_t;
+
+static const bench_mode_t bench_modes[] =
+{
+	{ "echo",      BINFRAME_OP_ECHO          },
+	{ "sdr_write", BINFRAME_OP_I3C_SDR_WRITE },
+	{ "sdr_read",  BINFRAME_OP_I3C_SDR_READ  },
+	{ "ddr_write", BINFRAME_OP_I3C_DDR_WRITE },
+	{ "ddr_read",  BINFRAME_OP_I3C_DDR_READ  },
+};
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// builds the request payload, returns its length
+static uint32_t bench_request(uint8_t opcode, uint8_t addr, uint8_t cmd, uint32_t n, uint8_t *preq)
+{
+	uint32_t i, len = 0;
+
+	switch (opcode)
+	{
+		case BINFRAME_OP_ECHO:
+			for (i = 0; i < n; i++)
+				preq[len++] = (uint8_t)i;
+			break;
+		case BINFRAME_OP_I3C_SDR_WRITE:
+			preq[len++] = addr;
+			for (i = 0; i < n; i++)
+				preq[len++] = (uint8_t)i;
+			break;
+		case BINFRAME_OP_I3C_SDR_READ:
+			preq[len++] = addr;
+			preq[len++] = (uint8_t)n;
+			preq[len++] = (uint8_t)(n >> 8);
+			break;
+		case BINFRAME_OP_I3C_DDR_WRITE:
+			preq[len++] = addr;
+			preq[len++] = cmd;
+			for (i = 0; i < n; i++)
+				preq[len++] = (uint8_t)i;
+			break;
+		case BINFRAME_OP_I3C_DDR_READ:
+			preq[len++] = addr;
+			preq[len++] = cmd | 0x80;
+			preq[len++] = (uint8_t)(n / 2);
+			preq[len++] = (uint8_t)((n / 2) >> 8);
+			break;
+	}
+	return len;
+}
+
+typedef struct
+{
+	uint64_t requests;
+	uint64_t errors;
+	uint64_t bytes_out;
+	uint64_t bytes_in;
+	double   seconds;
+} bench_result_t;
+
+// sends a request, preceded by the selection of bus when buses > 0
+static int bench_send(i3cb_usb_t *pdev, uint8_t *pseq, uint32_t buses, uint32_t bus, uint8_t opcode, const uint8_t *preq, uint32_t reqlen)
+{
+	uint8_t sel = (uint8_t)bus;
+	int     ret = 0;
+
+	if (buses > 0)
+		ret = i3cb_usb_send(pdev, ++*pseq, BINFRAME_OP_I3C_BUS_SELECT, &sel, 1);
+	if (ret >= 0)
+		ret = i3cb_usb_send(pdev, ++*pseq, opcode, preq, reqlen);
+	return ret;
+}
+
+// keeps depth requests in flight for the given time, distributed over buses (0: no bus selection). Returns 0 or a
+// negative libusb error code
+static int bench_run(i3cb_usb_t *pdev, uint8_t opcode, const uint8_t *preq, uint32_t reqlen, uint32_t n, uint32_t depth,
+                     uint32_t buses, double seconds, bench_result_t *pres)
+{
+	static uint8_t resp[BINFRAME_MAXLEN];
+	uint8_t        seq = 0, rxseq, rxopcode, status;
+	uint32_t       i, resplen, bus = 0;
+	double         tstart, tend;
+	int            ret = 0;
+
+	memset(pres, 0, sizeof(*pres));
+	tstart = now_s();
+	tend   = tstart;
+	for (i = 0; (i < depth) && (ret >= 0); i++)
+	{
+		ret = bench_send(pdev, &seq, buses, bus, opcode, preq, reqlen);
+		bus = (buses > 0) ? (bus + 1) % buses : 0;
+	}
+	while ( (ret >= 0) && (i > 0) )
+	{
+		ret = i3cb_usb_recv(pdev, &rxseq, &rxopcode, &status, resp, BINFRAME_MAXLEN, &resplen, 1000);
+		if (ret < 0)
+			break;
+		if (rxopcode == BINFRAME_OP_I3C_BUS_SELECT)
+		{ // only counted as error, the transfer following it reports the throughput
+			pres->errors += (status != 0);
+			continue;
+		}
+		i--;
+		pres->requests++;
+		pres->errors    += (status != 0);
+		pres->bytes_out += (opcode == BINFRAME_OP_ECHO) || (opcode == BINFRAME_OP_I3C_SDR_WRITE) || (opcode == BINFRAME_OP_I3C_DDR_WRITE) ? n : 0;
+		pres->bytes_in  += (opcode == BINFRAME_OP_I3C_DDR_WRITE) ? 0 : resplen;
+		tend = now_s();
+		if ((tend - tstart) < seconds)
+		{ // keep the pipeline filled
+			ret = bench_send(pdev, &seq, buses, bus, opcode, preq, reqlen);
+			bus = (buses > 0) ? (bus + 1) % buses : 0;
+			i++;
+		}
+	}
+	pres->seconds = tend - tstart;
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	static uint8_t  req[BINFRAME_MAXLEN];
+	static uint8_t  resp[BINFRAME_MAXLEN];
+	const char     *serial  = NULL;
+	const char     *mode    = "echo";
+	uint32_t        n       = 2048;
+	uint8_t         addr    = 0x08;
+	uint8_t         cmd     = 0x00;
+	uint32_t        depth   = 1;
+	uint32_t        buses   = 0;
+	double          seconds = 5.0;
+	double          base_mbs = 0.0, mbs;
+	uint8_t         opcode  = 0;
+	uint8_t         bus;
+	uint32_t        reqlen, resplen, i, count;
+	bench_result_t  res;
+	i3cb_usb_t     *pdev;
+	int             opt, ret;
+
+	while ( (opt = getopt(argc, argv, "s:m:n:a:c:d:t:b:")) != -1 )
+	{
+		switch (opt)
+		{
+			case 's': serial  = optarg;                              break;
+			case 'm': mode    = optarg;                              break;
+			case 'n': n       = (uint32_t)strtoul(optarg, NULL, 0);  break;
+			case 'a': addr    = (uint8_t)strtoul(optarg, NULL, 0);   break;
+			case 'c': cmd     = (uint8_t)strtoul(optarg, NULL, 0);   break;
+			case 'd': depth   = (uint32_t)strtoul(optarg, NULL, 0);  break;
+			case 't': seconds = strtod(optarg, NULL);                break;
+			case 'b': buses   = (uint32_t)strtoul(optarg, NULL, 0);  break;
+			default:
+				fprintf(stderr, "usage: %s [-s serial] [-m echo|sdr_write|sdr_read|ddr_write|ddr_read] [-n bytes] [-a addr] [-c cmd] [-d depth] [-t seconds] [-b buses]\n", argv[0]);
+				return 1;
+		}
+	}
+	for (i = 0; i < sizeof(bench_modes) / sizeof(bench_modes[0]); i++)
+	{
+		if (strcmp(mode, bench_modes[i].name) == 0)
+			opcode = bench_modes[i].opcode;
+	}
+	if (opcode == 0)
+	{
+		fprintf(stderr, "unknown mode %s\n", mode);
+		return 1;
+	}
+	if ( (n == 0) || (n > 2048) || (depth == 0) || (buses > 4) )
+	{
+		fprintf(stderr, "bytes have to be 1..2048, depth >= 1, buses 0..4\n");
+		return 1;
+	}
+	if ( (opcode == BINFRAME_OP_I3C_DDR_WRITE) || (opcode == BINFRAME_OP_I3C_DDR_READ) )
+		n &= ~1u; // whole words only
+
+	pdev = i3cb_usb_open(serial);
+	if (pdev == NULL)
+	{
+		fprintf(stderr, "no I3C Blaster with vendor bulk interface found\n");
+		return 1;
+	}
+
+	reqlen = bench_request(opcode, addr, cmd, n, req);
+
+	// warm up and check that the mode works at all, on every bus
+	for (bus = 0; bus < ((buses > 0) ? buses : 1); bus++)
+	{
+		if (buses > 0)
+		{
+			ret = i3cb_usb_exec(pdev, BINFRAME_OP_I3C_BUS_SELECT, &bus, 1, resp, sizeof(resp), &resplen);
+			if (ret > 0)
+			{
+				fprintf(stderr, "bus %u is not initialized, status %d\n", bus, ret);
+				i3cb_usb_close(pdev);
+				return 1;
+			}
+		}
+		else
+		{
+			ret = 0;
+		}
+		if (ret >= 0)
+			ret = i3cb_usb_exec(pdev, opcode, req, reqlen, resp, sizeof(resp), &resplen);
+		if (ret < 0)
+		{
+			fprintf(stderr, "transfer failed, libusb error %d\n", ret);
+			i3cb_usb_close(pdev);
+			return 1;
+		}
+		if (ret != 0)
+			fprintf(stderr, "warning: device returned status %d on bus %u, the measurement includes failing transfers\n", ret, bus);
+	}
+
+	for (count = (buses > 0) ? 1 : 0; count <= buses; count++)
+	{
+		ret = bench_run(pdev, opcode, req, reqlen, n, depth, count, seconds, &res);
+		if (ret < 0)
+		{
+			fprintf(stderr, "transfer failed after %llu requests, libusb error %d\n", (unsigned long long)res.requests, ret);
+			i3cb_usb_close(pdev);
+			return 1;
+		}
+		if (count <= 1)
+			printf("mode %s, %u bytes per request, depth %u, %.2f s\n", mode, n, depth, res.seconds);
+		if (count > 0)
+			printf("buses %u:\n", count);
+		printf("requests:  %llu (%llu failed), %.0f requests/s\n", (unsigned long long)res.requests, (unsigned long long)res.errors, (double)res.requests / res.seconds);
+		printf("host->dev: %.3f MB/s\n", (double)res.bytes_out / res.seconds / 1e6);
+		printf("dev->host: %.3f MB/s\n", (double)res.bytes_in / res.seconds / 1e6);
+		if ( (depth == 1) && (res.requests > 0) )
+			printf("latency:   %.1f us per request\n", res.seconds * 1e6 / (double)res.requests);
+		if (count > 0)
+		{
+			mbs = (double)(res.bytes_out + res.bytes_in) / res.seconds / 1e6;
+			if (count == 1)
+				base_mbs = mbs;
+			printf("aggregate: %.3f MB/s, %.2fx of 1 bus\n", mbs, (base_mbs > 0.0) ? mbs / base_mbs : 0.0);
+		}
+	}
+
+	if (buses > 0)
+	{ // leave the vendor interface on bus 0 again
+		bus = 0;
+		i3cb_usb_exec(pdev, BINFRAME_OP_I3C_BUS_SELECT, &bus, 1, resp, sizeof(resp), &resplen);
+	}
+	i3cb_usb_close(pdev);
+	return 0;
+}
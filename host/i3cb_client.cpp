@@ -0,0 +1,586 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "i3cb_client.hpp"
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdexcept>
+#ifdef I3CB_HAVE_LIBUSB
+#include "i3cb_usb.h"
+#endif
+
+namespace i3cb
+{
+
+std::string status_string(uint8_t status)
+{
+	static const char *const texts[] =
+	{
+		"OK", "ERR_IBI_ARBITRATION", "ERR_NAKED_DURING_ARBHDR", "ERR_NAKED", "ERR_INVALID_PARAMETER", "WARN_NO_IBI",
+		"ERR_NAKED_DDR", "WARN_EARLY_TERMINATED", "ERR_DDR_INVALID_PREAMBLE", "ERR_DDR_READ_PARITY_WRONG",
+		"ERR_DDR_READ_CRC_WRONG", "ERR_I2C_FAILED", "ERR_SKIPPED",
+	};
+
+	if (status == status_no_response)
+		return "ERR_NO_RESPONSE";
+	if (status < sizeof(texts) / sizeof(texts[0]))
+		return std::string(texts[status]) + "(" + std::to_string(status) + ")";
+	return "ERR_UNDEFINED(" + std::to_string(status) + ")";
+}
+
+std::vector<uint16_t> response::words(size_t offset) const
+{
+	std::vector<uint16_t> w;
+
+	for (size_t i = offset; i + 1 < data.size(); i += 2)
+		w.push_back((uint16_t)(data[i] | (data[i + 1] << 8)));
+	return w;
+}
+
+static void put_le16(std::vector<uint8_t> &v, uint16_t value)
+{
+	v.push_back((uint8_t)value);
+	v.push_back((uint8_t)(value >> 8));
+}
+
+static void put_le32(std::vector<uint8_t> &v, uint32_t value)
+{
+	put_le16(v, (uint16_t)value);
+	put_le16(v, (uint16_t)(value >> 16));
+}
+
+static void put_words(std::vector<uint8_t> &v, const std::vector<uint16_t> &words)
+{
+	for (uint16_t w : words)
+		put_le16(v, w);
+}
+
+static uint64_t get_le64(const uint8_t *p)
+{
+	uint64_t value = 0;
+
+	for (int i = 7; i >= 0; i--)
+		value = (value << 8) | p[i];
+	return value;
+}
+
+
+serial_transport::serial_transport(const std::string &path)
+{
+	struct termios tio;
+
+	m_fd = open(path.c_str(), O_RDWR | O_NOCTTY);
+	if (m_fd < 0)
+		throw std::runtime_error("can not open " + path + ": " + strerror(errno));
+	if (tcgetattr(m_fd, &tio) == 0)
+	{ // raw bytes, the baudrate has no meaning for USB CDC
+		cfmakeraw(&tio);
+		tcsetattr(m_fd, TCSANOW, &tio);
+	}
+	tcflush(m_fd, TCIOFLUSH);
+}
+
+serial_transport::~serial_transport()
+{
+	close(m_fd);
+}
+
+bool serial_transport::send(uint8_t seq, uint8_t opcode, const uint8_t *ppayload, size_t len)
+{
+	std::vector<uint8_t> buf;
+	size_t               framelen = len + 2;
+	size_t               pos = 0;
+
+	if (framelen > BINFRAME_MAXLEN)
+		return false;
+	buf.reserve(framelen + 3);
+	buf.push_back(BINFRAME_SOF);
+	put_le16(buf, (uint16_t)framelen);
+	buf.push_back(seq);
+	buf.push_back(opcode);
+	buf.insert(buf.end(), ppayload, ppayload + len);
+	while (pos < buf.size())
+	{
+		ssize_t n = write(m_fd, &buf[pos], buf.size() - pos);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		pos += (size_t)n;
+	}
+	return true;
+}
+
+// make sure at least count unprocessed bytes are buffered
+bool serial_transport::fill(size_t count, std::chrono::steady_clock::time_point deadline)
+{
+	while ((m_rx.size() - m_rxhead) < count)
+	{
+		uint8_t       buf[4096];
+		struct pollfd pfd = { m_fd, POLLIN, 0 };
+		auto          remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		ssize_t       n;
+
+		if (remaining.count() <= 0)
+			return false;
+		if (poll(&pfd, 1, (int)remaining.count()) <= 0)
+			continue;
+		n = read(m_fd, buf, sizeof(buf));
+		if (n <= 0)
+			return false;
+		if (m_rxhead > 0)
+		{ // compact
+			m_rx.erase(m_rx.begin(), m_rx.begin() + (ptrdiff_t)m_rxhead);
+			m_rxhead = 0;
+		}
+		m_rx.insert(m_rx.end(), buf, buf + n);
+	}
+	return true;
+}
+
+bool serial_transport::receive(frame &f, int timeout_ms)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+	while (true)
+	{
+		size_t framelen;
+
+		// skip text output of the command line up to the next start of frame
+		do
+		{
+			if (!fill(1, deadline))
+				return false;
+			if (m_rx[m_rxhead] != BINFRAME_SOF)
+				m_rxhead++;
+		} while (m_rx[m_rxhead] != BINFRAME_SOF);
+
+		if (!fill(3, deadline))
+			return false;
+		framelen = m_rx[m_rxhead + 1] | (m_rx[m_rxhead + 2] << 8);
+		if ( (framelen < 3) || (framelen > BINFRAME_MAXLEN) )
+		{ // a SOF character inside of text, resync
+			m_rxhead++;
+			continue;
+		}
+		if (!fill(3 + framelen, deadline))
+			return false;
+
+		const uint8_t *p = &m_rx[m_rxhead];
+		f.seq    = p[3];
+		f.opcode = p[4];
+		f.status = p[5];
+		f.payload.assign(p + 6, p + 3 + framelen);
+		m_rxhead += 3 + framelen;
+		return true;
+	}
+}
+
+
+#ifdef I3CB_HAVE_LIBUSB
+usb_transport::usb_transport(const std::string &serial)
+{
+	m_pdev = i3cb_usb_open(serial.empty() ? NULL : serial.c_str());
+	if (m_pdev == NULL)
+		throw std::runtime_error("no I3C Blaster with vendor bulk interface found");
+}
+
+usb_transport::~usb_transport()
+{
+	i3cb_usb_close(m_pdev);
+}
+
+bool usb_transport::send(uint8_t seq, uint8_t opcode, const uint8_t *ppayload, size_t len)
+{
+	return i3cb_usb_send(m_pdev, seq, opcode, ppayload, (uint32_t)len) == 0;
+}
+
+bool usb_transport::receive(frame &f, int timeout_ms)
+{
+	uint32_t len;
+
+	f.payload.resize(BINFRAME_MAXLEN);
+	if (i3cb_usb_recv(m_pdev, &f.seq, &f.opcode, &f.status, f.payload.data(), BINFRAME_MAXLEN, &len, (unsigned int)timeout_ms) != 0)
+		return false;
+	f.payload.resize(len);
+	return true;
+}
+#endif
+
+
+client::client(std::unique_ptr<transport> ptransport, unsigned window, std::chrono::milliseconds timeout)
+	: m_transport(std::move(ptransport)), m_window(window), m_timeout(timeout)
+{
+	if ( (m_window == 0) || (m_window > 254) )
+		throw std::invalid_argument("window has to be 1..254");
+	m_thread = std::thread(&client::receiver, this);
+}
+
+client::~client()
+{
+	m_stop = true;
+	m_thread.join();
+	for (unsigned seq = 1; seq < m_slots.size(); seq++)
+	{
+		if (m_slots[seq].used)
+			complete((uint8_t)seq, response{ m_slots[seq].opcode, status_no_response, {} });
+	}
+}
+
+std::future<response> client::request(uint8_t opcode, const std::vector<uint8_t> &payload, callback cb)
+{
+	std::lock_guard<std::mutex> sendlock(m_sendmutex);
+	std::future<response>       fut;
+	uint8_t                     seq;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_slotfree.wait(lock, [this] { return m_inflight < m_window; });
+		do
+		{ // seq 0 is used by unsolicited frames
+			m_seq = (uint8_t)((m_seq % 255) + 1);
+		} while (m_slots[m_seq].used);
+		seq = m_seq;
+
+		slot &s    = m_slots[seq];
+		s.used     = true;
+		s.opcode   = opcode;
+		s.deadline = std::chrono::steady_clock::now() + m_timeout;
+		s.promise  = std::promise<response>();
+		s.cb       = std::move(cb);
+		fut        = s.promise.get_future();
+		m_inflight++;
+	}
+
+	if (!m_transport->send(seq, opcode, payload.data(), payload.size()))
+		complete(seq, response{ opcode, status_no_response, {} });
+	return fut;
+}
+
+unsigned client::pending() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_inflight;
+}
+
+void client::on_ibi(std::function<void(const ibi_event &)> handler)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_ibi_handler = std::move(handler);
+}
+
+void client::on_sample(std::function<void(const sample_event &)> handler)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_sample_handler = std::move(handler);
+}
+
+// releases the slot of seq and hands the response over
+void client::complete(uint8_t seq, response &&resp)
+{
+	std::promise<response> promise;
+	callback               cb;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		slot &s = m_slots[seq];
+
+		if (!s.used)
+			return;
+		promise = std::move(s.promise);
+		cb      = std::move(s.cb);
+		s.used  = false;
+		m_inflight--;
+	}
+	m_slotfree.notify_one();
+	if (cb)
+		cb(resp);
+	promise.set_value(std::move(resp));
+}
+
+// IBI and sampler records: dropped count (32 bit), per record: timestamp (64 bit), 2 or 3 header bytes, len, data
+void client::dispatch_event(const frame &f)
+{
+	std::function<void(const ibi_event &)>    ibi_handler;
+	std::function<void(const sample_event &)> sample_handler;
+	const std::vector<uint8_t>               &p = f.payload;
+	size_t                                    pos = 4;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		ibi_handler    = m_ibi_handler;
+		sample_handler = m_sample_handler;
+	}
+
+	if (f.opcode == BINFRAME_OP_I3C_IBI_EVENT)
+	{
+		while (pos + 10 <= p.size())
+		{
+			size_t len = p[pos + 9];
+			if (pos + 10 + len > p.size())
+				break;
+			if ( ibi_handler && (len > 0) )
+				ibi_handler(ibi_event{ get_le64(&p[pos]), p[pos + 8], (uint8_t)(p[pos + 10] >> 1),
+				                       std::vector<uint8_t>(p.begin() + (ptrdiff_t)(pos + 11), p.begin() + (ptrdiff_t)(pos + 10 + len)) });
+			pos += 10 + len;
+		}
+	}
+	else if (f.opcode == BINFRAME_OP_I3C_SAMPLE_EVENT)
+	{
+		while (pos + 11 <= p.size())
+		{
+			size_t len = p[pos + 10];
+			if (pos + 11 + len > p.size())
+				break;
+			if (sample_handler)
+				sample_handler(sample_event{ get_le64(&p[pos]), p[pos + 8], p[pos + 9],
+				                             std::vector<uint8_t>(p.begin() + (ptrdiff_t)(pos + 11), p.begin() + (ptrdiff_t)(pos + 11 + len)) });
+			pos += 11 + len;
+		}
+	}
+}
+
+void client::receiver()
+{
+	frame f;
+
+	while (!m_stop)
+	{
+		if (m_transport->receive(f, 20))
+		{
+			if (f.seq == 0)
+			{
+				dispatch_event(f);
+			}
+			else
+			{
+				bool match;
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					match = m_slots[f.seq].used && (m_slots[f.seq].opcode == f.opcode);
+				}
+				if (match) // otherwise the response of an expired request
+					complete(f.seq, response{ f.opcode, f.status, std::move(f.payload) });
+			}
+		}
+
+		// expire requests without response
+		std::vector<std::pair<uint8_t, uint8_t>> expired; // seq, opcode
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto                        now = std::chrono::steady_clock::now();
+
+			for (unsigned seq = 1; (seq < m_slots.size()) && (m_inflight > 0); seq++)
+			{
+				if (m_slots[seq].used && (m_slots[seq].deadline <= now))
+					expired.emplace_back((uint8_t)seq, m_slots[seq].opcode);
+			}
+		}
+		for (auto &e : expired)
+			complete(e.first, response{ e.second, status_no_response, {} });
+	}
+}
+
+
+std::future<response> client::echo(const std::vector<uint8_t> &data, callback cb)
+{
+	return request(BINFRAME_OP_ECHO, data, std::move(cb));
+}
+
+std::future<response> client::bus_select(uint8_t bus, callback cb)
+{
+	return request(BINFRAME_OP_I3C_BUS_SELECT, { bus }, std::move(cb));
+}
+
+std::future<response> client::bus_init(uint8_t bus, uint8_t gpiobase, uint8_t sm, callback cb)
+{
+	return request(BINFRAME_OP_I3C_BUS_INIT, { bus, gpiobase, sm }, std::move(cb));
+}
+
+std::future<response> client::clk(uint32_t freq_khz, callback cb)
+{
+	std::vector<uint8_t> p;
+	put_le32(p, freq_khz);
+	return request(BINFRAME_OP_I3C_CLK, p, std::move(cb));
+}
+
+std::future<response> client::drivestrength(uint8_t mA, callback cb)
+{
+	return request(BINFRAME_OP_I3C_DRIVESTRENGTH, { mA }, std::move(cb));
+}
+
+std::future<response> client::targetreset(callback cb)
+{
+	return request(BINFRAME_OP_I3C_TARGETRESET, {}, std::move(cb));
+}
+
+std::future<response> client::recover(callback cb)
+{
+	return request(BINFRAME_OP_I3C_RECOVER, {}, std::move(cb));
+}
+
+std::future<response> client::scan(callback cb)
+{
+	return request(BINFRAME_OP_I3C_SCAN, {}, std::move(cb));
+}
+
+std::future<response> client::entdaa(uint8_t addr, callback cb)
+{
+	return request(BINFRAME_OP_I3C_ENTDAA, { addr }, std::move(cb));
+}
+
+std::future<response> client::rstdaa(callback cb)
+{
+	return request(BINFRAME_OP_I3C_RSTDAA, {}, std::move(cb));
+}
+
+std::future<response> client::sdr_write(uint8_t addr, const std::vector<uint8_t> &data, callback cb)
+{
+	std::vector<uint8_t> p{ addr };
+	p.insert(p.end(), data.begin(), data.end());
+	return request(BINFRAME_OP_I3C_SDR_WRITE, p, std::move(cb));
+}
+
+std::future<response> client::sdr_read(uint8_t addr, uint16_t count, callback cb)
+{
+	std::vector<uint8_t> p{ addr };
+	put_le16(p, count);
+	return request(BINFRAME_OP_I3C_SDR_READ, p, std::move(cb));
+}
+
+std::future<response> client::sdr_writeread(uint8_t addr, const std::vector<uint8_t> &data, uint16_t count, callback cb)
+{
+	std::vector<uint8_t> p{ addr };
+	put_le16(p, count);
+	p.insert(p.end(), data.begin(), data.end());
+	return request(BINFRAME_OP_I3C_SDR_WRITEREAD, p, std::move(cb));
+}
+
+std::future<response> client::ccc_broadcast_write(const std::vector<uint8_t> &data, callback cb)
+{
+	return request(BINFRAME_OP_I3C_CCC_BC_WRITE, data, std::move(cb));
+}
+
+std::future<response> client::ccc_direct_write(uint8_t addr, const std::vector<uint8_t> &bc_data, const std::vector<uint8_t> &direct_data, callback cb)
+{
+	std::vector<uint8_t> p{ addr, (uint8_t)bc_data.size() };
+	p.insert(p.end(), bc_data.begin(), bc_data.end());
+	p.insert(p.end(), direct_data.begin(), direct_data.end());
+	return request(BINFRAME_OP_I3C_CCC_DIRECT_WRITE, p, std::move(cb));
+}
+
+std::future<response> client::ccc_direct_read(uint8_t addr, const std::vector<uint8_t> &bc_data, uint16_t count, callback cb)
+{
+	std::vector<uint8_t> p{ addr };
+	put_le16(p, count);
+	p.insert(p.end(), bc_data.begin(), bc_data.end());
+	return request(BINFRAME_OP_I3C_CCC_DIRECT_READ, p, std::move(cb));
+}
+
+std::future<response> client::poll(callback cb)
+{
+	return request(BINFRAME_OP_I3C_POLL, {}, std::move(cb));
+}
+
+std::future<response> client::ibi_config(bool enable, callback cb)
+{
+	return request(BINFRAME_OP_I3C_IBI_CONFIG, { (uint8_t)enable }, std::move(cb));
+}
+
+std::future<response> client::ibi_read(uint16_t maxcount, callback cb)
+{
+	std::vector<uint8_t> p;
+	put_le16(p, maxcount);
+	return request(BINFRAME_OP_I3C_IBI_READ, p, std::move(cb));
+}
+
+std::future<response> client::ibi_stream(bool enable, callback cb)
+{
+	return request(BINFRAME_OP_I3C_IBI_STREAM, { (uint8_t)enable }, std::move(cb));
+}
+
+std::future<response> client::ddr_config(bool crc_word_indicator, bool enable_early_write_term, bool write_ack_enable, callback cb)
+{
+	return request(BINFRAME_OP_I3C_DDR_CONFIG, { (uint8_t)crc_word_indicator, (uint8_t)enable_early_write_term, (uint8_t)write_ack_enable }, std::move(cb));
+}
+
+std::future<response> client::ddr_write(uint8_t addr, uint8_t cmd, const std::vector<uint16_t> &words, callback cb)
+{
+	std::vector<uint8_t> p{ addr, cmd };
+	put_words(p, words);
+	return request(BINFRAME_OP_I3C_DDR_WRITE, p, std::move(cb));
+}
+
+std::future<response> client::ddr_read(uint8_t addr, uint8_t cmd, uint16_t count, callback cb)
+{
+	std::vector<uint8_t> p{ addr, cmd };
+	put_le16(p, count);
+	return request(BINFRAME_OP_I3C_DDR_READ, p, std::move(cb));
+}
+
+std::future<response> client::ddr_writeread(uint8_t addr, uint8_t wrcmd, uint8_t rdcmd, const std::vector<uint16_t> &words, uint16_t count, callback cb)
+{
+	std::vector<uint8_t> p{ addr, wrcmd, rdcmd };
+	put_le16(p, count);
+	put_words(p, words);
+	return request(BINFRAME_OP_I3C_DDR_WRITEREAD, p, std::move(cb));
+}
+
+std::future<response> client::i2c_clk(uint32_t freq_khz, callback cb)
+{
+	std::vector<uint8_t> p;
+	put_le32(p, freq_khz);
+	return request(BINFRAME_OP_I2C_CLK, p, std::move(cb));
+}
+
+std::future<response> client::i2c_write(uint8_t addr, const std::vector<uint8_t> &data, callback cb)
+{
+	std::vector<uint8_t> p{ addr };
+	p.insert(p.end(), data.begin(), data.end());
+	return request(BINFRAME_OP_I2C_WRITE, p, std::move(cb));
+}
+
+std::future<response> client::i2c_read(uint8_t addr, uint16_t count, callback cb)
+{
+	std::vector<uint8_t> p{ addr };
+	put_le16(p, count);
+	return request(BINFRAME_OP_I2C_READ, p, std::move(cb));
+}
+
+std::future<response> client::i2c_writeread(uint8_t addr, const std::vector<uint8_t> &data, uint16_t count, callback cb)
+{
+	std::vector<uint8_t> p{ addr };
+	put_le16(p, count);
+	p.insert(p.end(), data.begin(), data.end());
+	return request(BINFRAME_OP_I2C_WRITEREAD, p, std::move(cb));
+}
+
+} // namespace i3cb
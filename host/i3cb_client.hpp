@@ -0,0 +1,233 @@
+#ifndef _I3CB_CLIENT_HPP
+#define _I3CB_CLIENT_HPP
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "binframe.h"
+
+/*
+ * Pipelined C++ access to the I3C Blaster using the binary frames of src/binframe.h.
+ *
+ * A client keeps up to window requests in flight. Every request gets its own sequence number, a receiver thread
+ * matches the responses and completes the request: the returned future gets the response and the optional callback is
+ * called (from the receiver thread) before. Requests which are not answered within the timeout, or are still pending
+ * when the client is destroyed, complete with status_no_response.
+ * The transfer functions are thread safe. Requests are executed by the device in the order they were sent.
+ *
+ * Transports:
+ *   serial_transport  the CDC serial port (e.g. /dev/ttyACM0). Frames are embedded into the command line stream, so
+ *                     text output of the device in between is skipped. Also used for the pty of i3cb::loopback
+ *   usb_transport     the vendor bulk interface (only when built with libusb)
+ */
+
+#ifdef I3CB_HAVE_LIBUSB
+struct i3cb_usb; // see i3cb_usb.h
+#endif
+
+namespace i3cb
+{
+
+// i3c_hl_status_t of the firmware, plus the status of requests without response
+enum : uint8_t
+{
+	status_ok                    = 0,
+	status_ibi                   = 1,
+	status_nak_during_arbhdr     = 2,
+	status_nak_during_sdraddr    = 3,
+	status_param_outofrange      = 4,
+	status_no_ibi                = 5,
+	status_nak_ddr               = 6,
+	status_ddr_early_termination = 7,
+	status_ddr_invalid_preamble  = 8,
+	status_ddr_parity_wrong      = 9,
+	status_ddr_crc_wrong         = 10,
+	status_i2c_xfererror         = 11,
+	status_batch_skipped         = 12,
+	status_no_response           = 0xff,
+};
+
+// same texts as returned by the text commands, e.g. "ERR_NAKED(3)"
+std::string status_string(uint8_t status);
+
+struct frame
+{
+	uint8_t              seq;
+	uint8_t              opcode;
+	uint8_t              status;   // responses only
+	std::vector<uint8_t> payload;
+};
+
+struct response
+{
+	uint8_t              opcode = 0;
+	uint8_t              status = status_no_response;
+	std::vector<uint8_t> data;
+
+	bool ok() const { return status == status_ok; }
+
+	// data as little endian 16-bit words starting at byte offset, e.g. HDR-DDR read data
+	std::vector<uint16_t> words(size_t offset = 0) const;
+};
+
+struct ibi_event
+{
+	uint64_t             timestamp_us;
+	uint8_t              bus;
+	uint8_t              addr;
+	std::vector<uint8_t> payload;  // MDB and following bytes
+};
+
+struct sample_event
+{
+	uint64_t             timestamp_us;
+	uint8_t              job;
+	uint8_t              status;
+	std::vector<uint8_t> data;
+};
+
+using callback = std::function<void(const response &)>;
+
+class transport
+{
+public:
+	virtual ~transport() = default;
+
+	// sends a request frame, returns false on failure
+	virtual bool send(uint8_t seq, uint8_t opcode, const uint8_t *ppayload, size_t len) = 0;
+
+	// receives the next response or event frame. Returns false when nothing was received within timeout_ms
+	virtual bool receive(frame &f, int timeout_ms) = 0;
+};
+
+class serial_transport : public transport
+{
+public:
+	// opens the serial port or pty at path, throws std::runtime_error on failure
+	explicit serial_transport(const std::string &path);
+	~serial_transport() override;
+
+	bool send(uint8_t seq, uint8_t opcode, const uint8_t *ppayload, size_t len) override;
+	bool receive(frame &f, int timeout_ms) override;
+
+private:
+	bool fill(size_t count, std::chrono::steady_clock::time_point deadline);
+
+	int                  m_fd;
+	std::vector<uint8_t> m_rx;
+	size_t               m_rxhead = 0;
+};
+
+#ifdef I3CB_HAVE_LIBUSB
+class usb_transport : public transport
+{
+public:
+	// opens the device with the given serial number (empty: the first one), throws std::runtime_error on failure
+	explicit usb_transport(const std::string &serial = "");
+	~usb_transport() override;
+
+	bool send(uint8_t seq, uint8_t opcode, const uint8_t *ppayload, size_t len) override;
+	bool receive(frame &f, int timeout_ms) override;
+
+private:
+	::i3cb_usb *m_pdev;
+};
+#endif
+
+class client
+{
+public:
+	explicit client(std::unique_ptr<transport> ptransport, unsigned window = 8,
+	                std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+	~client();
+
+	client(const client &) = delete;
+	client &operator=(const client &) = delete;
+
+	// any request. Blocks while window requests are in flight
+	std::future<response> request(uint8_t opcode, const std::vector<uint8_t> &payload, callback cb = nullptr);
+
+	// count of requests in flight
+	unsigned pending() const;
+
+	// called from the receiver thread for streamed IBIs / sampler results (BINFRAME_OP_I3C_IBI_STREAM / SAMPLE_STREAM)
+	void on_ibi(std::function<void(const ibi_event &)> handler);
+	void on_sample(std::function<void(const sample_event &)> handler);
+
+	// bus and controller setup
+	std::future<response> echo(const std::vector<uint8_t> &data, callback cb = nullptr);
+	std::future<response> bus_select(uint8_t bus, callback cb = nullptr);
+	std::future<response> bus_init(uint8_t bus, uint8_t gpiobase, uint8_t sm, callback cb = nullptr);
+	std::future<response> clk(uint32_t freq_khz, callback cb = nullptr);
+	std::future<response> drivestrength(uint8_t mA, callback cb = nullptr);
+	std::future<response> targetreset(callback cb = nullptr);
+	std::future<response> recover(callback cb = nullptr);
+
+	// I3C SDR, see i3c_hl.h. Read data is returned in response::data
+	std::future<response> scan(callback cb = nullptr);
+	std::future<response> entdaa(uint8_t addr, callback cb = nullptr);
+	std::future<response> rstdaa(callback cb = nullptr);
+	std::future<response> sdr_write(uint8_t addr, const std::vector<uint8_t> &data, callback cb = nullptr);
+	std::future<response> sdr_read(uint8_t addr, uint16_t count, callback cb = nullptr);
+	std::future<response> sdr_writeread(uint8_t addr, const std::vector<uint8_t> &data, uint16_t count, callback cb = nullptr);
+	std::future<response> ccc_broadcast_write(const std::vector<uint8_t> &data, callback cb = nullptr);
+	std::future<response> ccc_direct_write(uint8_t addr, const std::vector<uint8_t> &bc_data, const std::vector<uint8_t> &direct_data, callback cb = nullptr);
+	std::future<response> ccc_direct_read(uint8_t addr, const std::vector<uint8_t> &bc_data, uint16_t count, callback cb = nullptr);
+	std::future<response> poll(callback cb = nullptr);
+	std::future<response> ibi_config(bool enable, callback cb = nullptr);
+	std::future<response> ibi_read(uint16_t maxcount, callback cb = nullptr);
+	std::future<response> ibi_stream(bool enable, callback cb = nullptr);
+
+	// I3C HDR-DDR. Write responses carry the count of written words (16 bit), read data is returned as words
+	std::future<response> ddr_config(bool crc_word_indicator, bool enable_early_write_term, bool write_ack_enable, callback cb = nullptr);
+	std::future<response> ddr_write(uint8_t addr, uint8_t cmd, const std::vector<uint16_t> &words, callback cb = nullptr);
+	std::future<response> ddr_read(uint8_t addr, uint8_t cmd, uint16_t count, callback cb = nullptr);
+	std::future<response> ddr_writeread(uint8_t addr, uint8_t wrcmd, uint8_t rdcmd, const std::vector<uint16_t> &words, uint16_t count, callback cb = nullptr);
+
+	// I2C on the I3C pins
+	std::future<response> i2c_clk(uint32_t freq_khz, callback cb = nullptr);
+	std::future<response> i2c_write(uint8_t addr, const std::vector<uint8_t> &data, callback cb = nullptr);
+	std::future<response> i2c_read(uint8_t addr, uint16_t count, callback cb = nullptr);
+	std::future<response> i2c_writeread(uint8_t addr, const std::vector<uint8_t> &data, uint16_t count, callback cb = nullptr);
+
+private:
+	struct slot
+	{
+		bool                                  used = false;
+		uint8_t                               opcode = 0;
+		std::chrono::steady_clock::time_point deadline;
+		std::promise<response>                promise;
+		callback                              cb;
+	};
+
+	void receiver();
+	void complete(uint8_t seq, response &&resp);
+	void dispatch_event(const frame &f);
+
+	std::unique_ptr<transport>                m_transport;
+	unsigned                                  m_window;
+	std::chrono::milliseconds                 m_timeout;
+	mutable std::mutex                        m_mutex;      // slots, m_inflight, m_seq and handlers
+	std::mutex                                m_sendmutex;  // serializes requesters, requests go out in sequence order
+	std::condition_variable                   m_slotfree;
+	std::array<slot, 256>                     m_slots;
+	unsigned                                  m_inflight = 0;
+	uint8_t                                   m_seq = 0;
+	std::function<void(const ibi_event &)>    m_ibi_handler;
+	std::function<void(const sample_event &)> m_sample_handler;
+	std::atomic<bool>                         m_stop{false};
+	std::thread                               m_thread;
+};
+
+} // namespace i3cb
+
+#endif
@@ -0,0 +1,580 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "i3cb_loopback.hpp"
+#include "i3cb_client.hpp"
+#include "binframe.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <stdexcept>
+
+namespace i3cb
+{
+
+// i3c_hl_status_t values used by the emulation
+enum : uint8_t
+{
+	lb_ok                 = 0,
+	lb_nak_during_sdraddr = 3,
+	lb_param_outofrange   = 4,
+	lb_no_ibi             = 5,
+	lb_nak_ddr            = 6,
+	lb_i2c_xfererror      = 11,
+};
+
+static uint16_t get_le16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+loopback::loopback(std::chrono::microseconds latency)
+	: m_latency(latency)
+{
+	struct termios tio;
+
+	m_master = posix_openpt(O_RDWR | O_NOCTTY);
+	if ( (m_master < 0) || (grantpt(m_master) != 0) || (unlockpt(m_master) != 0) || (ptsname(m_master) == NULL) )
+	{
+		if (m_master >= 0)
+			close(m_master);
+		throw std::runtime_error("no pseudo terminal available");
+	}
+	m_path  = ptsname(m_master);
+	m_slave = open(m_path.c_str(), O_RDWR | O_NOCTTY);
+	if ( (m_slave >= 0) && (tcgetattr(m_slave, &tio) == 0) )
+	{ // binary frames must pass unchanged
+		cfmakeraw(&tio);
+		tcsetattr(m_slave, TCSANOW, &tio);
+	}
+	m_thread = std::thread(&loopback::serve, this);
+}
+
+loopback::~loopback()
+{
+	m_stop = true;
+	m_thread.join();
+	if (m_slave >= 0)
+		close(m_slave);
+	close(m_master);
+}
+
+void loopback::add_target(uint8_t addr)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_targets[addr & 0x7f];
+}
+
+void loopback::raise_ibi(uint8_t addr, const std::vector<uint8_t> &payload)
+{
+	std::vector<uint8_t> ibi{ (uint8_t)((addr << 1) | 1) };
+	bool                 stream;
+
+	ibi.insert(ibi.end(), payload.begin(), payload.end());
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		stream = m_ibi_stream;
+		if (!stream)
+			m_ibis.push_back(ibi);
+	}
+	if (stream)
+	{ // same record as the firmware: dropped count, timestamp, bus, len, data
+		std::vector<uint8_t> rec(4 + 10, 0);
+		uint64_t             ts = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+		                              std::chrono::steady_clock::now().time_since_epoch()).count();
+
+		for (int i = 0; i < 8; i++)
+			rec[4 + i] = (uint8_t)(ts >> (8 * i));
+		rec[13] = (uint8_t)ibi.size();
+		rec.insert(rec.end(), ibi.begin(), ibi.end());
+		respond(0, BINFRAME_OP_I3C_IBI_EVENT, lb_ok, rec);
+	}
+}
+
+loopback::target *loopback::find(uint8_t addr)
+{
+	auto it = m_targets.find(addr & 0x7f);
+	return (it == m_targets.end()) ? nullptr : &it->second;
+}
+
+void loopback::transfer_delay(std::chrono::microseconds bustime)
+{
+	auto delay = m_latency + bustime;
+
+	if (delay.count() > 0)
+		std::this_thread::sleep_for(delay);
+}
+
+void loopback::respond(uint8_t seq, uint8_t opcode, uint8_t status, const std::vector<uint8_t> &payload)
+{
+	std::vector<uint8_t> buf;
+	size_t               framelen = payload.size() + 3;
+	size_t               pos = 0;
+
+	buf.push_back(BINFRAME_SOF);
+	buf.push_back((uint8_t)framelen);
+	buf.push_back((uint8_t)(framelen >> 8));
+	buf.push_back(seq);
+	buf.push_back(opcode);
+	buf.push_back(status);
+	buf.insert(buf.end(), payload.begin(), payload.end());
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	while (pos < buf.size())
+	{
+		ssize_t n = write(m_master, &buf[pos], buf.size() - pos);
+		if (n <= 0)
+			break;
+		pos += (size_t)n;
+	}
+}
+
+// executes one request like binframe_command of the firmware, request and response payloads as in binframe.h
+uint8_t loopback::execute(uint8_t opcode, const std::vector<uint8_t> &p, std::vector<uint8_t> &resp)
+{
+	uint8_t  status = lb_ok;
+	size_t   len = p.size();
+	bool     xfer = true;  // takes bus time
+	uint32_t clocks = 0;   // SCL cycles of the transfer besides the bytes/words
+	target  *pt;
+
+	m_requests++;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	pt = (len > 0) ? find(p[0]) : nullptr;
+	switch (opcode)
+	{
+		case BINFRAME_OP_ECHO:
+			resp = p;
+			xfer = false;
+			break;
+		case BINFRAME_OP_GPIO_READ:
+			resp.assign(4, 0);
+			xfer = false;
+			break;
+		case BINFRAME_OP_I3C_BUS_SELECT:
+		case BINFRAME_OP_I3C_BUS_INIT:
+			status = ( (len >= 1) && (p[0] < 4) ) ? lb_ok : lb_param_outofrange;
+			xfer = false;
+			break;
+		case BINFRAME_OP_I3C_CLK:
+			if ( (len >= 4) && (get_le32(&p[0]) >= 49) && (get_le32(&p[0]) <= 12500) )
+				m_i3c_khz = get_le32(&p[0]);
+			else
+				status = lb_param_outofrange;
+			xfer = false;
+			break;
+		case BINFRAME_OP_I2C_CLK:
+			if ( (len >= 4) && (get_le32(&p[0]) >= 1) && (get_le32(&p[0]) <= 2000) )
+				m_i2c_khz = get_le32(&p[0]);
+			else
+				status = lb_param_outofrange;
+			xfer = false;
+			break;
+		case BINFRAME_OP_GPIO_WRITE:
+		case BINFRAME_OP_I3C_DRIVESTRENGTH:
+		case BINFRAME_OP_I3C_RECOVER:
+		case BINFRAME_OP_I3C_IBI_CONFIG:
+		case BINFRAME_OP_I3C_DDR_CONFIG:
+		case BINFRAME_OP_I2C_TIMEOUT:
+			xfer = false;
+			break;
+		case BINFRAME_OP_I3C_TARGETRESET:
+		case BINFRAME_OP_I3C_RSTDAA:
+		case BINFRAME_OP_I3C_CCC_BC_WRITE:
+			break;
+		case BINFRAME_OP_I3C_SCAN:
+		case BINFRAME_OP_I2C_SCAN:
+			for (auto &t : m_targets)
+				resp.push_back(t.first);
+			clocks = 120 * 20; // arbitration header and address of every address
+			break;
+		case BINFRAME_OP_I3C_ENTDAA: // all targets have a dynamic address already
+			status = lb_nak_during_sdraddr;
+			break;
+		case BINFRAME_OP_I3C_SDR_WRITE:
+		case BINFRAME_OP_I2C_WRITE:
+			status = (pt == nullptr) ? lb_nak_during_sdraddr : lb_ok;
+			if (pt && (len > 1))
+			{
+				pt->regptr = p[1];
+				for (size_t i = 2; i < len; i++)
+					pt->regs[pt->regptr++] = p[i];
+			}
+			break;
+		case BINFRAME_OP_I3C_SDR_READ:
+		case BINFRAME_OP_I3C_SDR_WRITEREAD:
+		case BINFRAME_OP_I2C_READ:
+		case BINFRAME_OP_I2C_WRITEREAD:
+		case BINFRAME_OP_I3C_CCC_DIRECT_READ:
+			if (len < 3)
+			{
+				status = lb_param_outofrange;
+				break;
+			}
+			status = (pt == nullptr) ? lb_nak_during_sdraddr : lb_ok;
+			if ( pt && (len > 3) && (opcode != BINFRAME_OP_I3C_CCC_DIRECT_READ) )
+			{
+				pt->regptr = p[3];
+				for (size_t i = 4; i < len; i++)
+					pt->regs[pt->regptr++] = p[i];
+			}
+			for (uint16_t i = 0; pt && (i < get_le16(&p[1])); i++)
+				resp.push_back((opcode == BINFRAME_OP_I3C_CCC_DIRECT_READ) ? 0 : pt->regs[pt->regptr++]);
+			break;
+		case BINFRAME_OP_I3C_CCC_DIRECT_WRITE:
+			status = (pt == nullptr) ? lb_nak_during_sdraddr : lb_ok;
+			break;
+		case BINFRAME_OP_I3C_DDR_WRITE:
+		case BINFRAME_OP_I3C_DDR_WRITEREAD:
+		{
+			size_t                hdrlen = (opcode == BINFRAME_OP_I3C_DDR_WRITE) ? 2 : 5;
+			std::vector<uint16_t> words;
+
+			if (len < hdrlen)
+			{
+				status = lb_param_outofrange;
+				break;
+			}
+			for (size_t i = hdrlen; i + 1 < len; i += 2)
+				words.push_back(get_le16(&p[i]));
+			status = (pt == nullptr) ? lb_nak_ddr : lb_ok;
+			if (pt)
+				pt->ddr[p[1] & 0x7f] = words;
+			resp.push_back(pt ? (uint8_t)words.size() : 0);
+			resp.push_back(pt ? (uint8_t)(words.size() >> 8) : 0);
+			if ( pt && (opcode == BINFRAME_OP_I3C_DDR_WRITEREAD) )
+			{
+				const std::vector<uint16_t> &rd = pt->ddr[p[2] & 0x7f];
+				for (size_t i = 0; (i < rd.size()) && (i < get_le16(&p[3])); i++)
+				{
+					resp.push_back((uint8_t)rd[i]);
+					resp.push_back((uint8_t)(rd[i] >> 8));
+				}
+			}
+			break;
+		}
+		case BINFRAME_OP_I3C_DDR_READ:
+			if (len < 4)
+			{
+				status = lb_param_outofrange;
+				break;
+			}
+			status = (pt == nullptr) ? lb_nak_ddr : lb_ok;
+			if (pt)
+			{ // the target terminates the read early when it has less words
+				const std::vector<uint16_t> &rd = pt->ddr[p[1] & 0x7f];
+				for (size_t i = 0; (i < rd.size()) && (i < get_le16(&p[2])); i++)
+				{
+					resp.push_back((uint8_t)rd[i]);
+					resp.push_back((uint8_t)(rd[i] >> 8));
+				}
+			}
+			break;
+		case BINFRAME_OP_I3C_POLL:
+			if (m_ibis.empty())
+				status = lb_no_ibi;
+			else
+			{
+				resp = m_ibis.front();
+				m_ibis.pop_front();
+			}
+			break;
+		case BINFRAME_OP_I3C_IBI_READ:
+		{
+			uint16_t maxcount = (len >= 2) ? get_le16(&p[0]) : 0;
+
+			xfer = false;
+			resp.assign(4, 0);
+			while ( (maxcount-- > 0) && !m_ibis.empty() )
+			{
+				std::vector<uint8_t> &ibi = m_ibis.front();
+				resp.insert(resp.end(), 9, 0); // timestamp, bus 0
+				resp.push_back((uint8_t)ibi.size());
+				resp.insert(resp.end(), ibi.begin(), ibi.end());
+				m_ibis.pop_front();
+			}
+			break;
+		}
+		case BINFRAME_OP_I3C_IBI_STREAM:
+			m_ibi_stream = (len >= 1) && (p[0] != 0);
+			xfer = false;
+			break;
+		default:
+			status = lb_param_outofrange;
+			xfer = false;
+			break;
+	}
+	if (xfer)
+	{ // bus time: SDR and I2C transfer 9 clocks per byte, HDR-DDR 10 clocks per word after an ENTHDR CCC of 18 clocks
+		bool     i2c = (opcode >= BINFRAME_OP_I2C_CLK);
+		bool     ddr = (opcode >= BINFRAME_OP_I3C_DDR_CONFIG) && !i2c;
+		uint32_t khz = i2c ? m_i2c_khz : m_i3c_khz;
+
+		if (ddr)
+			clocks += 18 + 10 * (uint32_t)(2 + ((len > 2) ? (len - 2) / 2 : 0) + resp.size() / 2);
+		else
+			clocks += 9 * (uint32_t)(2 + ((len > 1) ? len - 1 : 0) + resp.size());
+		lock.unlock();
+		transfer_delay(std::chrono::microseconds((clocks * 1000ull) / khz));
+	}
+	else
+		lock.unlock();
+
+	if ( (opcode >= BINFRAME_OP_I2C_CLK) && (status == lb_nak_during_sdraddr) )
+		status = lb_i2c_xfererror;
+	// read data is dropped on errors, the written word count of HDR-DDR writes is kept
+	if ( (status != lb_ok) && (opcode != BINFRAME_OP_I3C_DDR_WRITE) && (opcode != BINFRAME_OP_I3C_DDR_WRITEREAD) )
+		resp.clear();
+	return status;
+}
+
+void loopback::process(uint8_t seq, uint8_t opcode, const std::vector<uint8_t> &p)
+{
+	std::vector<uint8_t> resp;
+	uint8_t              status = execute(opcode, p, resp);
+
+	respond(seq, opcode, status, resp);
+}
+
+// text commands with a binary frame counterpart. args lists the request payload fields in frame order, each one as index
+// of the text argument and type: a = byte, n = 16 bit, k = 32 bit, b = byte list, l = byte list preceded by its length,
+// w = word list. Lists may be missing. output formats the response payload: b = bytes, w = words, c = count and words,
+// s = address list
+struct text_command
+{
+	const char *name;
+	uint8_t     opcode;
+	const char *args;
+	char        output;
+};
+
+static const text_command s_text_commands[] =
+{
+	{ "i3c_clk",                  BINFRAME_OP_I3C_CLK,              "0k",         0  },
+	{ "i3c_drivestrength",        BINFRAME_OP_I3C_DRIVESTRENGTH,    "0a",         0  },
+	{ "i3c_targetreset",          BINFRAME_OP_I3C_TARGETRESET,      "",           0  },
+	{ "i3c_recover",              BINFRAME_OP_I3C_RECOVER,          "",           0  },
+	{ "i3c_rstdaa",               BINFRAME_OP_I3C_RSTDAA,           "",           0  },
+	{ "i3c_scan",                 BINFRAME_OP_I3C_SCAN,             "",           's' },
+	{ "i3c_poll",                 BINFRAME_OP_I3C_POLL,             "",           'b' },
+	{ "i3c_sdr_write",            BINFRAME_OP_I3C_SDR_WRITE,        "0a1b",       0  },
+	{ "i3c_sdr_read",             BINFRAME_OP_I3C_SDR_READ,         "0a1n",       'b' },
+	{ "i3c_sdr_writeread",        BINFRAME_OP_I3C_SDR_WRITEREAD,    "0a2n1b",     'b' },
+	{ "i3c_sdr_ccc_bc_write",     BINFRAME_OP_I3C_CCC_BC_WRITE,     "0b",         0  },
+	{ "i3c_sdr_ccc_direct_write", BINFRAME_OP_I3C_CCC_DIRECT_WRITE, "0a1l2b",     0  },
+	{ "i3c_sdr_ccc_direct_read",  BINFRAME_OP_I3C_CCC_DIRECT_READ,  "0a2n1b",     'b' },
+	{ "i3c_ddr_config",           BINFRAME_OP_I3C_DDR_CONFIG,       "0a1a2a",     0  },
+	{ "i3c_ddr_write",            BINFRAME_OP_I3C_DDR_WRITE,        "0a1a2w",     'c' },
+	{ "i3c_ddr_read",             BINFRAME_OP_I3C_DDR_READ,         "0a1a2n",     'w' },
+	{ "i3c_ddr_writeread",        BINFRAME_OP_I3C_DDR_WRITEREAD,    "0a1a2a4n3w", 'c' },
+	{ "i2c_clk",                  BINFRAME_OP_I2C_CLK,              "0k",         0  },
+	{ "i2c_timeout",              BINFRAME_OP_I2C_TIMEOUT,          "0k",         0  },
+	{ "i2c_scan",                 BINFRAME_OP_I2C_SCAN,             "",           's' },
+	{ "i2c_write",                BINFRAME_OP_I2C_WRITE,            "0a1b",       0  },
+	{ "i2c_read",                 BINFRAME_OP_I2C_READ,             "0a1n",       'b' },
+	{ "i2c_writeread",            BINFRAME_OP_I2C_WRITEREAD,        "0a2n1b",     'b' },
+};
+
+// answers a command line like the command line interface of the firmware. The echo is never sent
+void loopback::process_text(const std::string &line)
+{
+	std::vector<std::string> tokens;
+	std::vector<uint8_t>     p, resp;
+	const text_command      *pcmd = nullptr;
+	std::string              out;
+	size_t                   start = 0;
+	char                     buf[16];
+	uint8_t                  status;
+
+	while (start < line.size())
+	{
+		size_t end = line.find(' ', start);
+		if (end == std::string::npos)
+			end = line.size();
+		if (end > start)
+			tokens.push_back(line.substr(start, end - start));
+		start = end + 1;
+	}
+	if (tokens.empty())
+		return;
+	for (const text_command &c : s_text_commands)
+		if (tokens[0] == c.name)
+			pcmd = &c;
+	if (pcmd == nullptr)
+	{
+		write_text("\x1b[30;41mERROR: Command not found (" + tokens[0] + ")\x1b[0m\r\n");
+		return;
+	}
+
+	for (const char *pa = pcmd->args; pa[0] && pa[1]; pa += 2)
+	{
+		size_t               index = 1 + (size_t)(pa[0] - '0');
+		std::vector<uint8_t> list;
+
+		if ( (index >= tokens.size()) && (strchr("ank", pa[1]) != nullptr) )
+		{
+			write_text("\x1b[30;41mERROR: Too few arguments\x1b[0m\r\n");
+			return;
+		}
+		if (strchr("ank", pa[1]) != nullptr)
+		{
+			uint32_t value = (uint32_t)strtoul(tokens[index].c_str(), nullptr, 0);
+
+			for (int i = 0; i < ((pa[1] == 'a') ? 1 : (pa[1] == 'n') ? 2 : 4); i++)
+				p.push_back((uint8_t)(value >> (8 * i)));
+			continue;
+		}
+		for (size_t pos = 0; index < tokens.size() && pos < tokens[index].size(); )
+		{
+			size_t   end = tokens[index].find(',', pos);
+			uint32_t value;
+
+			if (end == std::string::npos)
+				end = tokens[index].size();
+			value = (uint32_t)strtoul(tokens[index].substr(pos, end - pos).c_str(), nullptr, 0);
+			list.push_back((uint8_t)value);
+			if (pa[1] == 'w')
+				list.push_back((uint8_t)(value >> 8));
+			pos = end + 1;
+		}
+		if (pa[1] == 'l')
+			p.push_back((uint8_t)list.size());
+		p.insert(p.end(), list.begin(), list.end());
+	}
+
+	status = execute(pcmd->opcode, p, resp);
+	out = status_string(status);
+	if (pcmd->output == 's')
+	{ // the scan commands always succeed and separate the list with a comma, even when empty
+		out += ",";
+		for (size_t i = 0; i < resp.size(); i++)
+		{
+			snprintf(buf, sizeof(buf), (i > 0) ? ",0x%02x" : "0x%02x", resp[i]);
+			out += buf;
+		}
+	}
+	else if ( (pcmd->output == 'c') && (resp.size() >= 2) )
+	{
+		snprintf(buf, sizeof(buf), ",%d", get_le16(&resp[0]));
+		out += buf;
+	}
+	if ( (status == lb_ok) && ( (pcmd->output == 'w') || (pcmd->output == 'c') ) )
+	{
+		for (size_t i = (pcmd->output == 'c') ? 2 : 0; i + 1 < resp.size(); i += 2)
+		{
+			snprintf(buf, sizeof(buf), ",0x%04x", get_le16(&resp[i]));
+			out += buf;
+		}
+	}
+	else if ( (status == lb_ok) && (pcmd->output == 'b') )
+	{
+		for (uint8_t b : resp)
+		{
+			snprintf(buf, sizeof(buf), ",0x%02x", b);
+			out += buf;
+		}
+	}
+	write_text(out + "\r\n");
+}
+
+void loopback::write_text(const std::string &text)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t                      pos = 0;
+
+	while (pos < text.size())
+	{
+		ssize_t n = write(m_master, text.data() + pos, text.size() - pos);
+		if (n <= 0)
+			break;
+		pos += (size_t)n;
+	}
+}
+
+void loopback::serve()
+{
+	std::vector<uint8_t> rx;
+	std::string          line;
+
+	while (!m_stop)
+	{
+		struct pollfd pfd = { m_master, POLLIN, 0 };
+		uint8_t       buf[4096];
+		ssize_t       n;
+		size_t        pos = 0;
+
+		if (poll(&pfd, 1, 20) <= 0)
+			continue;
+		n = read(m_master, buf, sizeof(buf));
+		if (n <= 0)
+		{ // no client connected to the pty
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+		rx.insert(rx.end(), buf, buf + n);
+
+		// frames: SOF as first character of a line, len (16 bit), seq, opcode, payload
+		while (pos < rx.size())
+		{
+			size_t framelen;
+
+			if ( (rx[pos] != BINFRAME_SOF) || !line.empty() )
+			{ // command line, @ turns off the echo which is never sent anyway
+				if ( (rx[pos] == '\r') || (rx[pos] == '\n') )
+				{
+					process_text(line);
+					line.clear();
+				}
+				else if ( (rx[pos] != '@') || !line.empty() )
+					line += (char)rx[pos];
+				pos++;
+				continue;
+			}
+			if (rx.size() - pos < 3)
+				break;
+			framelen = get_le16(&rx[pos + 1]);
+			if ( (framelen < 2) || (framelen > BINFRAME_MAXLEN) )
+			{
+				pos++;
+				continue;
+			}
+			if (rx.size() - pos < 3 + framelen)
+				break;
+			process(rx[pos + 3], rx[pos + 4], std::vector<uint8_t>(rx.begin() + (ptrdiff_t)(pos + 5), rx.begin() + (ptrdiff_t)(pos + 3 + framelen)));
+			pos += 3 + framelen;
+		}
+		rx.erase(rx.begin(), rx.begin() + (ptrdiff_t)pos);
+	}
+}
+
+} // namespace i3cb
@@ -0,0 +1,86 @@
+#ifndef _I3CB_LOOPBACK_HPP
+#define _I3CB_LOOPBACK_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Test double of the I3C Blaster: answers binary frames (src/binframe.h) on a pseudo terminal, so host code like
+ * i3cb::client or the Python module can be exercised without hardware. Open path() like the CDC serial port.
+ *
+ * The emulated bus has targets with 256 byte register spaces: SDR and I2C writes set the register pointer with the first
+ * byte and write the following bytes, reads continue at the register pointer. HDR-DDR reads return the words of the
+ * last write with the same command code (bit 7 ignored). Transfers to other addresses are NAKed. IBIs raised with
+ * raise_ibi are streamed when BINFRAME_OP_I3C_IBI_STREAM is enabled, otherwise queued for POLL and IBI_READ.
+ * The text commands of the same transfers are answered as well (without echo), other commands are unknown.
+ * A transfer takes latency plus its bus time at the clock set with I3C_CLK / I2C_CLK (12.5 MHz / 100 kHz after start).
+ */
+
+namespace i3cb
+{
+
+class loopback
+{
+public:
+	// creates the pty and starts answering. Every I3C/I2C transfer takes latency in addition to its bus time.
+	// Throws std::runtime_error when no pty is available
+	explicit loopback(std::chrono::microseconds latency = std::chrono::microseconds(0));
+	~loopback();
+
+	loopback(const loopback &) = delete;
+	loopback &operator=(const loopback &) = delete;
+
+	// device side of the pty for serial_transport
+	const std::string &path() const { return m_path; }
+
+	// adds a target acknowledging the 7-bit address addr
+	void add_target(uint8_t addr);
+
+	// raises a IBI of target addr with MDB and payload
+	void raise_ibi(uint8_t addr, const std::vector<uint8_t> &payload);
+
+	// count of answered requests
+	uint64_t requests() const { return m_requests; }
+
+private:
+	struct target
+	{
+		uint8_t                                  regs[256] = { 0 };
+		uint8_t                                  regptr = 0;
+		std::map<uint8_t, std::vector<uint16_t>> ddr;    // last written words per command code
+	};
+
+	void    serve();
+	uint8_t execute(uint8_t opcode, const std::vector<uint8_t> &p, std::vector<uint8_t> &resp);
+	void    process(uint8_t seq, uint8_t opcode, const std::vector<uint8_t> &p);
+	void    process_text(const std::string &line);
+	void    respond(uint8_t seq, uint8_t opcode, uint8_t status, const std::vector<uint8_t> &payload);
+	void    write_text(const std::string &text);
+	target *find(uint8_t addr);
+	void    transfer_delay(std::chrono::microseconds bustime);
+
+	int                              m_master = -1;
+	int                              m_slave = -1;    // kept open, so the pty survives reconnects of the client
+	std::string                      m_path;
+	std::chrono::microseconds        m_latency;
+	std::mutex                       m_mutex;         // targets, IBIs and writes to the pty
+	std::map<uint8_t, target>        m_targets;
+	std::deque<std::vector<uint8_t>> m_ibis;          // IBI address byte, MDB, payload
+	bool                             m_ibi_stream = false;
+	uint32_t                         m_i3c_khz = 12500;
+	uint32_t                         m_i2c_khz = 100;
+	std::atomic<uint64_t>            m_requests{0};
+	std::atomic<bool>                m_stop{false};
+	std::thread                      m_thread;
+};
+
+} // namespace i3cb
+
+#endif
@@ -0,0 +1,79 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Runs the I3C Blaster test double (see i3cb_loopback.hpp) until Ctrl-C, e.g. for the Python module:
+ *
+ *   i3cb_loopback [-l latency_us] [-t addr]...
+ *
+ * Prints the pty to connect to. Without -t the targets 0x08 and 0x30 are emulated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <vector>
+#include "i3cb_loopback.hpp"
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void on_signal(int)
+{
+	s_stop = 1;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<uint8_t> targets;
+	long                 latency_us = 0;
+	int                  opt;
+
+	while ( (opt = getopt(argc, argv, "l:t:")) != -1 )
+	{
+		switch (opt)
+		{
+			case 'l': latency_us = strtol(optarg, NULL, 0);                    break;
+			case 't': targets.push_back((uint8_t)strtoul(optarg, NULL, 0));   break;
+			default:
+				fprintf(stderr, "usage: %s [-l latency_us] [-t addr]...\n", argv[0]);
+				return 1;
+		}
+	}
+	if (targets.empty())
+		targets = { 0x08, 0x30 };
+
+	i3cb::loopback lb{ std::chrono::microseconds(latency_us) };
+	for (uint8_t addr : targets)
+		lb.add_target(addr);
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	printf("%s\n", lb.path().c_str());
+	fflush(stdout);
+	while (!s_stop)
+		pause();
+	fprintf(stderr, "%llu requests answered\n", (unsigned long long)lb.requests());
+	return 0;
+}
@@ -0,0 +1,229 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Exercises the pipelined client library (i3cb_client.hpp) against a device or the built-in test double.
+ *
+ *   i3cb_pipeline [-p port | -u serial] [-m mode] [-a addr] [-n bytes] [-d depth] [-c count] [-l latency_us]
+ *
+ * Without -p (serial port, e.g. /dev/ttyACM0) or -u (vendor bulk interface, "-" for the first device) an
+ * i3cb::loopback on a pty is used, whose transfers take latency_us (default 50) plus their bus time.
+ *
+ * modes:
+ *   check      checks the responses of all transfer types against the loopback target model, then runs echo (default)
+ *   echo       count requests of n bytes
+ *   sdr_write  count I3C SDR private writes of n bytes to addr
+ *   sdr_read   count I3C SDR private reads of n bytes from addr
+ *
+ * Every run is done with depth 1 and with depth requests in flight, the request rates show what pipelining gains.
+ * Returns 0 when all responses were as expected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "i3cb_client.hpp"
+#include "i3cb_loopback.hpp"
+
+static int s_failures = 0;
+
+static void expect(bool cond, const char *what)
+{
+	if (!cond)
+	{
+		fprintf(stderr, "FAIL: %s\n", what);
+		s_failures++;
+	}
+}
+
+// functional checks, the expected values follow the target model of i3cb::loopback
+static void check(i3cb::client &c, uint8_t addr)
+{
+	std::vector<uint8_t> pattern = { 0x10, 0xa5, 0x5a, 0x01, 0x02 };
+	std::atomic<int>     callbacks{0};
+
+	auto echo = c.echo({ 1, 2, 3 }, [&](const i3cb::response &r) { callbacks += r.ok(); });
+	auto wr   = c.sdr_write(addr, pattern);
+	auto rd   = c.sdr_writeread(addr, { 0x10 }, 4);
+	auto nak  = c.sdr_read((uint8_t)(addr ^ 0x40), 1);
+	auto dw   = c.ddr_write(addr, 0x05, { 0x1234, 0xabcd });
+	auto dr   = c.ddr_read(addr, 0x85, 2);
+	auto dwr  = c.ddr_writeread(addr, 0x06, 0x86, { 0x0001, 0x0002, 0x0003 }, 3);
+	auto scan = c.scan();
+	auto bus  = c.bus_select(7);
+
+	i3cb::response r = echo.get();
+	expect(r.ok() && (r.data == std::vector<uint8_t>{ 1, 2, 3 }), "echo");
+	expect(callbacks == 1, "callback before the future");
+	expect(wr.get().ok(), "sdr_write");
+	r = rd.get();
+	expect(r.ok() && (r.data == std::vector<uint8_t>{ 0xa5, 0x5a, 0x01, 0x02 }), "sdr_writeread reads back sdr_write");
+	expect(nak.get().status == i3cb::status_nak_during_sdraddr, "sdr_read of a missing target is NAKed");
+	r = dw.get();
+	expect(r.ok() && (r.words() == std::vector<uint16_t>{ 2 }), "ddr_write returns the written word count");
+	r = dr.get();
+	expect(r.ok() && (r.words() == std::vector<uint16_t>{ 0x1234, 0xabcd }), "ddr_read reads back ddr_write");
+	r = dwr.get();
+	expect(r.ok() && (r.words() == std::vector<uint16_t>{ 3, 0x0001, 0x0002, 0x0003 }), "ddr_writeread");
+	r = scan.get();
+	expect(r.ok() && !r.data.empty(), "scan");
+	expect(bus.get().status == i3cb::status_param_outofrange, "bus_select of an invalid bus");
+}
+
+static void check_ibi(i3cb::client &c, i3cb::loopback &lb, uint8_t addr)
+{
+	std::atomic<int> ibis{0};
+
+	lb.raise_ibi(addr, { 0x42 });
+	i3cb::response r = c.poll().get();
+	expect(r.ok() && (r.data == std::vector<uint8_t>{ (uint8_t)((addr << 1) | 1), 0x42 }), "poll returns the queued IBI");
+	expect(c.poll().get().status == i3cb::status_no_ibi, "poll without IBI");
+
+	c.on_ibi([&](const i3cb::ibi_event &e) { ibis += (e.addr == addr) && (e.payload == std::vector<uint8_t>{ 0x43 }); });
+	expect(c.ibi_stream(true).get().ok(), "ibi_stream");
+	lb.raise_ibi(addr, { 0x43 });
+	c.echo({}).get(); // the event frame is sent before this response
+	expect(ibis == 1, "streamed IBI");
+	c.ibi_stream(false).get();
+}
+
+// count requests with depth in flight, returns requests/s
+static double run(i3cb::client &c, const std::string &mode, uint8_t addr, uint32_t n, uint32_t count)
+{
+	std::vector<uint8_t> data(n);
+	std::atomic<uint32_t> errors{0};
+	auto                 done = [&](const i3cb::response &r) { errors += !r.ok(); };
+	auto                 tstart = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < n; i++)
+		data[i] = (uint8_t)i;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (mode == "sdr_write")
+			c.sdr_write(addr, data, done);
+		else if (mode == "sdr_read")
+			c.sdr_read(addr, (uint16_t)n, done);
+		else
+			c.echo(data, done);
+	}
+	while (c.pending() > 0)
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tstart).count();
+	if (errors > 0)
+	{
+		fprintf(stderr, "%u of %u requests failed\n", errors.load(), count);
+		s_failures++;
+	}
+	return count / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string                      port, serial;
+	std::string                      mode = "check";
+	uint8_t                          addr = 0x08;
+	uint32_t                         n = 16;
+	uint32_t                         depth = 8;
+	uint32_t                         count = 2000;
+	long                             latency_us = 50;
+	std::unique_ptr<i3cb::loopback>  plb;
+	int                              opt;
+
+	while ( (opt = getopt(argc, argv, "p:u:m:a:n:d:c:l:")) != -1 )
+	{
+		switch (opt)
+		{
+			case 'p': port       = optarg;                                break;
+			case 'u': serial     = optarg;                                break;
+			case 'm': mode       = optarg;                                break;
+			case 'a': addr       = (uint8_t)strtoul(optarg, NULL, 0);     break;
+			case 'n': n          = (uint32_t)strtoul(optarg, NULL, 0);    break;
+			case 'd': depth      = (uint32_t)strtoul(optarg, NULL, 0);    break;
+			case 'c': count      = (uint32_t)strtoul(optarg, NULL, 0);    break;
+			case 'l': latency_us = strtol(optarg, NULL, 0);               break;
+			default:
+				fprintf(stderr, "usage: %s [-p port | -u serial] [-m check|echo|sdr_write|sdr_read] [-a addr] [-n bytes] [-d depth] [-c count] [-l latency_us]\n", argv[0]);
+				return 1;
+		}
+	}
+	if ( (n == 0) || (n > 1024) || (depth == 0) || (depth > 254) )
+	{
+		fprintf(stderr, "bytes have to be 1..1024, depth 1..254\n");
+		return 1;
+	}
+
+	try
+	{
+		auto connect = [&](unsigned window) -> std::unique_ptr<i3cb::client>
+		{
+			std::unique_ptr<i3cb::transport> pt;
+#ifdef I3CB_HAVE_LIBUSB
+			if (!serial.empty())
+				pt.reset(new i3cb::usb_transport((serial == "-") ? "" : serial));
+			else
+#endif
+			if (!serial.empty())
+				throw std::runtime_error("built without libusb, use -p");
+			else
+				pt.reset(new i3cb::serial_transport(plb ? plb->path() : port));
+			return std::unique_ptr<i3cb::client>(new i3cb::client(std::move(pt), window));
+		};
+
+		if (port.empty() && serial.empty())
+		{
+			plb.reset(new i3cb::loopback(std::chrono::microseconds(latency_us)));
+			plb->add_target(addr);
+			printf("loopback on %s, %ld us latency per transfer plus bus time\n", plb->path().c_str(), latency_us);
+		}
+
+		if (mode == "check")
+		{
+			auto pc = connect(depth);
+			check(*pc, addr);
+			if (plb)
+				check_ibi(*pc, *plb, addr);
+			printf("check: %s\n", (s_failures == 0) ? "passed" : "FAILED");
+			mode = "echo";
+		}
+
+		double single = run(*connect(1), mode, addr, n, count);
+		double piped  = run(*connect(depth), mode, addr, n, count);
+		printf("mode %s, %u bytes, %u requests\n", mode.c_str(), n, count);
+		printf("depth 1:  %.0f requests/s\n", single);
+		printf("depth %u: %.0f requests/s, %.2fx\n", depth, piped, piped / single);
+	}
+	catch (const std::exception &e)
+	{
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return (s_failures == 0) ? 0 : 1;
+}
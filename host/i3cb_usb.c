@@ -0,0 +1,226 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "i3cb_usb.h"
+#include <stdlib.h>
+#include <string.h>
+#include <libusb.h>
+
+#define I3CB_USB_TIMEOUT_MS  (1000)
+#define I3CB_USB_RXBUFSIZE   (4 * BINFRAME_MAXLEN)
+
+struct i3cb_usb
+{
+	libusb_context       *pctx;
+	libusb_device_handle *phandle;
+	uint8_t               seq;
+	uint8_t               txbuf[3 + BINFRAME_MAXLEN];
+	uint8_t               rxbuf[I3CB_USB_RXBUFSIZE];
+	uint32_t              rxhead;                      // first unprocessed byte
+	uint32_t              rxtail;                      // end of received data
+};
+
+static libusb_device_handle *i3cb_usb_find(libusb_context *pctx, const char *serial)
+{
+	libusb_device        **plist;
+	libusb_device_handle  *phandle = NULL;
+	ssize_t                count, i;
+
+	count = libusb_get_device_list(pctx, &plist);
+	for (i = 0; (i < count) && (phandle == NULL); i++)
+	{
+		struct libusb_device_descriptor desc;
+		unsigned char                   str[64];
+
+		if ( (libusb_get_device_descriptor(plist[i], &desc) != 0) ||
+		     (desc.idVendor != I3CB_USB_VID) || (desc.idProduct != I3CB_USB_PID) )
+			continue;
+		if (libusb_open(plist[i], &phandle) != 0)
+		{
+			phandle = NULL;
+			continue;
+		}
+		if (serial != NULL)
+		{
+			if ( (libusb_get_string_descriptor_ascii(phandle, desc.iSerialNumber, str, sizeof(str)) < 0) ||
+			     (strcmp((const char *)str, serial) != 0) )
+			{
+				libusb_close(phandle);
+				phandle = NULL;
+			}
+		}
+	}
+	if (count >= 0)
+		libusb_free_device_list(plist, 1);
+	return phandle;
+}
+
+i3cb_usb_t *i3cb_usb_open(const char *serial)
+{
+	i3cb_usb_t *pdev = calloc(1, sizeof(i3cb_usb_t));
+
+	if (pdev == NULL)
+		return NULL;
+	if (libusb_init(&pdev->pctx) != 0)
+	{
+		free(pdev);
+		return NULL;
+	}
+	pdev->phandle = i3cb_usb_find(pdev->pctx, serial);
+	if ( (pdev->phandle == NULL) || (libusb_claim_interface(pdev->phandle, I3CB_USB_INTERFACE) != 0) )
+	{
+		i3cb_usb_close(pdev);
+		return NULL;
+	}
+	return pdev;
+}
+
+void i3cb_usb_close(i3cb_usb_t *pdev)
+{
+	if (pdev == NULL)
+		return;
+	if (pdev->phandle != NULL)
+	{
+		libusb_release_interface(pdev->phandle, I3CB_USB_INTERFACE);
+		libusb_close(pdev->phandle);
+	}
+	libusb_exit(pdev->pctx);
+	free(pdev);
+}
+
+int i3cb_usb_send(i3cb_usb_t *pdev, uint8_t seq, uint8_t opcode, const void *ppayload, uint32_t len)
+{
+	uint32_t framelen = len + 2;
+	int      transferred;
+	int      ret;
+
+	if (framelen > BINFRAME_MAXLEN)
+		return LIBUSB_ERROR_INVALID_PARAM;
+
+	pdev->txbuf[0] = BINFRAME_SOF;
+	pdev->txbuf[1] = (uint8_t)framelen;
+	pdev->txbuf[2] = (uint8_t)(framelen >> 8);
+	pdev->txbuf[3] = seq;
+	pdev->txbuf[4] = opcode;
+	if (len > 0)
+		memcpy(&pdev->txbuf[5], ppayload, len);
+
+	ret = libusb_bulk_transfer(pdev->phandle, I3CB_USB_EP_OUT, pdev->txbuf, (int)(framelen + 3), &transferred, I3CB_USB_TIMEOUT_MS);
+	if ( (ret == 0) && (transferred != (int)(framelen + 3)) )
+		ret = LIBUSB_ERROR_IO;
+	return ret;
+}
+
+// make sure at least count bytes are in the receive buffer
+static int i3cb_usb_fill(i3cb_usb_t *pdev, uint32_t count, unsigned int timeout_ms)
+{
+	while ( (pdev->rxtail - pdev->rxhead) < count )
+	{
+		uint32_t request;
+		int      transferred;
+		int      ret;
+
+		if (pdev->rxhead > 0)
+		{ // compact
+			memmove(pdev->rxbuf, &pdev->rxbuf[pdev->rxhead], pdev->rxtail - pdev->rxhead);
+			pdev->rxtail -= pdev->rxhead;
+			pdev->rxhead  = 0;
+		}
+
+		// request whole packets only, otherwise a packet carrying the start of the next frame would overflow.
+		// The device sends at least the missing bytes, so the transfer ends either full or with a short packet.
+		request = count - pdev->rxtail;
+		request = (request + I3CB_USB_PACKETSIZE - 1) & ~(uint32_t)(I3CB_USB_PACKETSIZE - 1);
+		if (request > sizeof(pdev->rxbuf) - pdev->rxtail)
+			return LIBUSB_ERROR_OVERFLOW;
+
+		ret = libusb_bulk_transfer(pdev->phandle, I3CB_USB_EP_IN, &pdev->rxbuf[pdev->rxtail], (int)request, &transferred, timeout_ms);
+		if (transferred > 0)
+			pdev->rxtail += (uint32_t)transferred;
+		if ( (ret != 0) && !((ret == LIBUSB_ERROR_TIMEOUT) && (transferred > 0)) )
+			return ret;
+	}
+	return 0;
+}
+
+int i3cb_usb_recv(i3cb_usb_t *pdev, uint8_t *pseq, uint8_t *popcode, uint8_t *pstatus,
+                  void *ppayload, uint32_t maxlen, uint32_t *plen, unsigned int timeout_ms)
+{
+	uint8_t  *p;
+	uint32_t  framelen, len;
+	int       ret;
+
+	// resync to the next start of frame
+	do
+	{
+		if ( (ret = i3cb_usb_fill(pdev, 1, timeout_ms)) != 0 )
+			return ret;
+		if (pdev->rxbuf[pdev->rxhead] != BINFRAME_SOF)
+			pdev->rxhead++;
+	} while (pdev->rxbuf[pdev->rxhead] != BINFRAME_SOF);
+
+	if ( (ret = i3cb_usb_fill(pdev, 3, timeout_ms)) != 0 )
+		return ret;
+	p = &pdev->rxbuf[pdev->rxhead];
+	framelen = (uint32_t)p[1] | ((uint32_t)p[2] << 8);
+	if ( (framelen < 3) || (framelen > BINFRAME_MAXLEN) )
+	{ // not a valid frame, skip the SOF
+		pdev->rxhead++;
+		return LIBUSB_ERROR_IO;
+	}
+	if ( (ret = i3cb_usb_fill(pdev, 3 + framelen, timeout_ms)) != 0 )
+		return ret;
+
+	p = &pdev->rxbuf[pdev->rxhead];
+	len = framelen - 3;
+	if (pseq)
+		*pseq = p[3];
+	if (popcode)
+		*popcode = p[4];
+	if (pstatus)
+		*pstatus = p[5];
+	if (plen)
+		*plen = len;
+	if (ppayload)
+		memcpy(ppayload, &p[6], (len < maxlen) ? len : maxlen);
+	pdev->rxhead += 3 + framelen;
+	return 0;
+}
+
+int i3cb_usb_exec(i3cb_usb_t *pdev, uint8_t opcode, const void *ppayload, uint32_t len,
+                  void *presp, uint32_t maxlen, uint32_t *presplen)
+{
+	uint8_t seq, rxseq, rxopcode, status;
+	int     ret;
+
+	seq = ++pdev->seq;
+	if ( (ret = i3cb_usb_send(pdev, seq, opcode, ppayload, len)) != 0 )
+		return ret;
+	do
+	{ // skip responses of earlier, abandoned requests
+		if ( (ret = i3cb_usb_recv(pdev, &rxseq, &rxopcode, &status, presp, maxlen, presplen, I3CB_USB_TIMEOUT_MS)) != 0 )
+			return ret;
+	} while ( (rxseq != seq) || (rxopcode != opcode) );
+	return status;
+}
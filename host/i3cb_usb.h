@@ -0,0 +1,42 @@
+#ifndef _I3CB_USB_H
+#define _I3CB_USB_H
+
+#include <stdint.h>
+#include "binframe.h"
+
+/*
+ * Host access to the I3C Blaster vendor bulk interface using libusb.
+ *
+ * The interface carries the same binary frames as the CDC escape (see src/binframe.h), but without the stdio
+ * character handling in between. Requests may be pipelined: several requests can be sent before the responses
+ * are collected, as long as the outstanding data fits into the device fifos (4 KiB each direction).
+ */
+
+#define I3CB_USB_VID          (0x2E8A)
+#define I3CB_USB_PID          (0x000A)
+#define I3CB_USB_INTERFACE    (2)
+#define I3CB_USB_EP_OUT       (0x03)
+#define I3CB_USB_EP_IN        (0x83)
+#define I3CB_USB_PACKETSIZE   (64)
+
+typedef struct i3cb_usb i3cb_usb_t;
+
+// open the device with the given serial number, or the first one found if serial is NULL. Returns NULL on failure
+i3cb_usb_t *i3cb_usb_open(const char *serial);
+
+void i3cb_usb_close(i3cb_usb_t *pdev);
+
+// send a request frame. Returns 0 on success, a negative libusb error code otherwise
+int i3cb_usb_send(i3cb_usb_t *pdev, uint8_t seq, uint8_t opcode, const void *ppayload, uint32_t len);
+
+// receive a response frame. Payload exceeding maxlen is dropped, *plen returns the full payload length.
+// Returns 0 on success, a negative libusb error code otherwise
+int i3cb_usb_recv(i3cb_usb_t *pdev, uint8_t *pseq, uint8_t *popcode, uint8_t *pstatus,
+                  void *ppayload, uint32_t maxlen, uint32_t *plen, unsigned int timeout_ms);
+
+// send a request and wait for its response. Returns the status byte of the response (i3c_hl_status_t) or a negative
+// libusb error code
+int i3cb_usb_exec(i3cb_usb_t *pdev, uint8_t opcode, const void *ppayload, uint32_t len,
+                  void *presp, uint32_t maxlen, uint32_t *presplen);
+
+#endif
@@ -0,0 +1,667 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i3c_hal_host.h"
+
+/*
+ * pico-sdk subset of i3c_hl on the PIO simulator, see i3c_hal_host.h
+ */
+
+pio_hw_t         i3c_hal_host_pio[NUM_PIOS];
+io_bank0_hw_t    i3c_hal_host_io_bank0;
+dma_channel_hw_t i3c_hal_host_dma[NUM_DMA_CHANNELS];
+
+typedef struct
+{
+	volatile uint8_t *read, *write; // host pointers, shadow FIFOs or memory
+	uint32_t          count;        // remaining transfers, kept by an abort like TRANS_COUNT
+	uint32_t          ctrl;
+	bool              active;
+	bool              claimed;
+} hal_dma_t;
+
+typedef struct
+{
+	hardware_alarm_callback_t callback;
+	uint64_t                  target;   // cycle the alarm fires at, UINT64_MAX: not armed
+	bool                      claimed;
+} hal_alarm_t;
+
+static piosim_t    s_sim;
+static hal_dma_t   s_dma[NUM_DMA_CHANNELS];
+static hal_alarm_t s_alarm[NUM_ALARMS];
+static uint64_t    s_alarm_next = UINT64_MAX; // earliest target of all alarms
+static bool        s_irq_disabled;
+static bool        s_irq_active;              // an alarm callback runs
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// addresses
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// simulator address of a shadow PIO or IO_BANK0 register, 0: none
+static uint32_t hal_simaddr(const volatile void *p)
+{
+	uintptr_t a = (uintptr_t)p, base;
+
+	for (unsigned i = 0; i < NUM_PIOS; i++)
+	{
+		base = (uintptr_t)&i3c_hal_host_pio[i];
+		if ((a >= base) && (a < base + sizeof(pio_hw_t)))
+			return (i ? PIOSIM_PIO1_BASE : PIOSIM_PIO0_BASE) + (uint32_t)(a - base);
+	}
+	base = (uintptr_t)&i3c_hal_host_io_bank0;
+	if ((a >= base) && (a < base + sizeof(io_bank0_hw_t)))
+		return PIOSIM_IO_BANK0_BASE + (uint32_t)(a - base);
+	return 0;
+}
+
+// DMA channel of a shadow DMA register, -1: none. *poffset = register offset within the channel
+static int hal_dmareg(const volatile void *p, uint32_t *poffset)
+{
+	uintptr_t a = (uintptr_t)p, base = (uintptr_t)&i3c_hal_host_dma[0];
+
+	if ((a < base) || (a >= base + sizeof(i3c_hal_host_dma)))
+		return -1;
+	*poffset = (uint32_t)(a - base) % sizeof(dma_channel_hw_t);
+	return (int)((a - base) / sizeof(dma_channel_hw_t));
+}
+
+static void hal_fatal(const char *pmsg)
+{
+	fprintf(stderr, "i3c_hal_host: %s\n", pmsg);
+	abort();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// interrupts
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static void hal_alarm_update_next(void)
+{
+	s_alarm_next = UINT64_MAX;
+	for (unsigned i = 0; i < NUM_ALARMS; i++)
+	{
+		if (s_alarm[i].target < s_alarm_next)
+			s_alarm_next = s_alarm[i].target;
+	}
+}
+
+// interrupt entry: the callbacks of all alarms which are due, unless interrupts are disabled or a callback runs already
+static void hal_alarm_service(void)
+{
+	if ( (s_sim.cycle < s_alarm_next) || s_irq_disabled || s_irq_active )
+		return;
+	s_irq_active = true;
+	for (unsigned i = 0; i < NUM_ALARMS; i++)
+	{
+		if (s_alarm[i].target <= s_sim.cycle)
+		{
+			s_alarm[i].target = UINT64_MAX;
+			hal_alarm_update_next();
+			if (s_alarm[i].callback)
+				s_alarm[i].callback(i);
+		}
+	}
+	s_irq_active = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// dma
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t hal_dma_load(volatile uint8_t *p, unsigned size)
+{
+	uint32_t addr = hal_simaddr(p);
+
+	if (addr)
+		return piosim_read32(&s_sim, addr);
+	switch (size)
+	{
+		case 1:  return *p;
+		case 2:  return *(volatile uint16_t *)p;
+		default: return *(volatile uint32_t *)p;
+	}
+}
+
+static void hal_dma_store(volatile uint8_t *p, unsigned size, uint32_t value)
+{
+	uint32_t addr = hal_simaddr(p);
+
+	if (addr)
+	{ // the bus replicates narrow data over the 32 bit FIFO register
+		if (size == 1)
+			value = (value & 0xffu) * 0x01010101u;
+		else if (size == 2)
+			value = (value & 0xffffu) * 0x00010001u;
+		piosim_write32(&s_sim, addr, value);
+		return;
+	}
+	switch (size)
+	{
+		case 1:  *p = (uint8_t)value; break;
+		case 2:  *(volatile uint16_t *)p = (uint16_t)value; break;
+		default: *(volatile uint32_t *)p = value; break;
+	}
+}
+
+// address after a transfer: incremented when enabled, wrapped at the ring boundary when the ring applies
+static volatile uint8_t *hal_dma_next(volatile uint8_t *p, uint32_t ctrl, bool write)
+{
+	uintptr_t a = (uintptr_t)p, mask;
+	unsigned  size = 1u << ((ctrl >> DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB) & 3u);
+	unsigned  ring = (ctrl >> DMA_CH0_CTRL_TRIG_RING_SIZE_LSB) & 0xfu;
+
+	if (!(ctrl & (write ? DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS : DMA_CH0_CTRL_TRIG_INCR_READ_BITS)))
+		return p;
+	if (ring && (((ctrl & DMA_CH0_CTRL_TRIG_RING_SEL_BITS) != 0) == write))
+	{
+		mask = ((uintptr_t)1 << ring) - 1u;
+		return (volatile uint8_t *)((a & ~mask) | ((a + size) & mask));
+	}
+	return p + size;
+}
+
+// all transfers the DREQs allow at the current cycle. FIFO accesses advance the simulation like CPU accesses
+static void hal_dma_service(void)
+{
+	for (unsigned ch = 0; ch < NUM_DMA_CHANNELS; ch++)
+	{
+		hal_dma_t *pd = &s_dma[ch];
+		unsigned   treq = (pd->ctrl >> DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB) & 0x3fu;
+		unsigned   size = 1u << ((pd->ctrl >> DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB) & 3u);
+
+		while (pd->active && ((treq == DREQ_FORCE) || piosim_dreq(&s_sim, treq)))
+		{
+			hal_dma_store(pd->write, size, hal_dma_load(pd->read, size));
+			pd->read = hal_dma_next(pd->read, pd->ctrl, false);
+			pd->write = hal_dma_next(pd->write, pd->ctrl, true);
+			if (--pd->count == 0)
+				pd->active = false;
+		}
+	}
+}
+
+static bool hal_dma_active(void)
+{
+	for (unsigned ch = 0; ch < NUM_DMA_CHANNELS; ch++)
+	{
+		if (s_dma[ch].active)
+			return true;
+	}
+	return false;
+}
+
+static void hal_dma_trigger(uint channel)
+{
+	hal_dma_t *pd = &s_dma[channel];
+
+	pd->active = (pd->ctrl & DMA_CH0_CTRL_TRIG_EN_BITS) && (pd->count != 0);
+	hal_dma_service();
+}
+
+// everything which happens between two accesses of the CPU
+static void hal_service(void)
+{
+	hal_dma_service();
+	hal_alarm_service();
+}
+
+// bus access of the CPU to a register outside the simulator
+static void hal_access(void)
+{
+	hal_service();
+	piosim_step(&s_sim, s_sim.access_cycles);
+}
+
+static uint32_t hal_dma_read(uint channel, uint32_t offset)
+{
+	hal_dma_t *pd = &s_dma[channel];
+
+	switch (offset)
+	{
+		case offsetof(dma_channel_hw_t, read_addr):
+		case offsetof(dma_channel_hw_t, al1_read_addr):
+		case offsetof(dma_channel_hw_t, al2_read_addr):
+		case offsetof(dma_channel_hw_t, al3_read_addr_trig):
+			return (uint32_t)(uintptr_t)pd->read;
+		case offsetof(dma_channel_hw_t, write_addr):
+		case offsetof(dma_channel_hw_t, al1_write_addr):
+		case offsetof(dma_channel_hw_t, al2_write_addr_trig):
+		case offsetof(dma_channel_hw_t, al3_write_addr):
+			return (uint32_t)(uintptr_t)pd->write;
+		case offsetof(dma_channel_hw_t, transfer_count):
+		case offsetof(dma_channel_hw_t, al1_transfer_count_trig):
+		case offsetof(dma_channel_hw_t, al2_transfer_count):
+		case offsetof(dma_channel_hw_t, al3_transfer_count):
+			return pd->count;
+		default:
+			return pd->ctrl | (pd->active ? DMA_CH0_CTRL_TRIG_BUSY_BITS : 0u);
+	}
+}
+
+static void hal_dma_write(uint channel, uint32_t offset, uint32_t value)
+{
+	hal_dma_t *pd = &s_dma[channel];
+
+	switch (offset)
+	{
+		case offsetof(dma_channel_hw_t, transfer_count):
+		case offsetof(dma_channel_hw_t, al2_transfer_count):
+		case offsetof(dma_channel_hw_t, al3_transfer_count):
+			pd->count = value;
+			break;
+		case offsetof(dma_channel_hw_t, al1_transfer_count_trig):
+			pd->count = value;
+			hal_dma_trigger(channel);
+			break;
+		case offsetof(dma_channel_hw_t, ctrl_trig):
+			pd->ctrl = value & ~DMA_CH0_CTRL_TRIG_BUSY_BITS;
+			hal_dma_trigger(channel);
+			break;
+		case offsetof(dma_channel_hw_t, al1_ctrl):
+		case offsetof(dma_channel_hw_t, al2_ctrl):
+		case offsetof(dma_channel_hw_t, al3_ctrl):
+			pd->ctrl = value & ~DMA_CH0_CTRL_TRIG_BUSY_BITS;
+			break;
+		default: // 32 bit addresses cannot hold host pointers
+			hal_fatal("DMA addresses are host pointers, set them with the dma_channel_* functions or i3c_hal_dma_set_write_addr");
+	}
+}
+
+int dma_claim_unused_channel(bool required)
+{
+	for (unsigned ch = 0; ch < NUM_DMA_CHANNELS; ch++)
+	{
+		if (!s_dma[ch].claimed)
+		{
+			s_dma[ch].claimed = true;
+			return (int)ch;
+		}
+	}
+	if (required)
+		hal_fatal("no free DMA channel");
+	return -1;
+}
+
+dma_channel_config dma_get_channel_config(uint channel)
+{
+	dma_channel_config c;
+
+	c.ctrl = s_dma[channel].ctrl;
+	return c;
+}
+
+void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger)
+{
+	hal_access();
+	s_dma[channel].ctrl = config->ctrl;
+	if (trigger)
+		hal_dma_trigger(channel);
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr, const volatile void *read_addr,
+                           uint transfer_count, bool trigger)
+{
+	hal_access();
+	s_dma[channel].write = (volatile uint8_t *)write_addr;
+	s_dma[channel].read = (volatile uint8_t *)read_addr;
+	s_dma[channel].count = transfer_count;
+	dma_channel_set_config(channel, config, trigger);
+}
+
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count)
+{
+	hal_access();
+	s_dma[channel].read = (volatile uint8_t *)read_addr;
+	s_dma[channel].count = transfer_count;
+	hal_dma_trigger(channel);
+}
+
+void dma_channel_transfer_to_buffer_now(uint channel, volatile void *write_addr, uint32_t transfer_count)
+{
+	hal_access();
+	s_dma[channel].write = (volatile uint8_t *)write_addr;
+	s_dma[channel].count = transfer_count;
+	hal_dma_trigger(channel);
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+	hal_access();
+	hal_dma_service();
+	return s_dma[channel].active;
+}
+
+void dma_channel_abort(uint channel)
+{
+	hal_access();
+	s_dma[channel].active = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// registers
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t i3c_hal_read32(const volatile uint32_t *preg)
+{
+	uint32_t addr = hal_simaddr(preg), offset;
+	int      ch;
+
+	hal_service();
+	if (addr)
+		return piosim_read32(&s_sim, addr);
+	ch = hal_dmareg(preg, &offset);
+	if (ch >= 0)
+	{
+		hal_access();
+		return hal_dma_read((uint)ch, offset);
+	}
+	return *preg;
+}
+
+void i3c_hal_write32(volatile uint32_t *preg, uint32_t value)
+{
+	uint32_t addr = hal_simaddr(preg), offset;
+	int      ch;
+
+	hal_service();
+	if (addr)
+	{
+		piosim_write32(&s_sim, addr, value);
+		return;
+	}
+	ch = hal_dmareg(preg, &offset);
+	if (ch >= 0)
+	{
+		hal_access();
+		hal_dma_write((uint)ch, offset, value);
+		return;
+	}
+	*preg = value;
+}
+
+volatile void *i3c_hal_dma_get_write_addr(uint channel)
+{
+	hal_access();
+	return s_dma[channel].write;
+}
+
+void i3c_hal_dma_set_write_addr(uint channel, volatile void *paddr)
+{
+	hal_access();
+	s_dma[channel].write = (volatile uint8_t *)paddr;
+}
+
+void hw_set_bits(io_rw_32 *preg, uint32_t mask)
+{
+	uint32_t addr = hal_simaddr(preg);
+
+	hal_service();
+	if (addr)
+		piosim_write32(&s_sim, addr | PIOSIM_ALIAS_SET, mask);
+	else
+		i3c_hal_write32(preg, i3c_hal_read32(preg) | mask);
+}
+
+void hw_clear_bits(io_rw_32 *preg, uint32_t mask)
+{
+	uint32_t addr = hal_simaddr(preg);
+
+	hal_service();
+	if (addr)
+		piosim_write32(&s_sim, addr | PIOSIM_ALIAS_CLR, mask);
+	else
+		i3c_hal_write32(preg, i3c_hal_read32(preg) & ~mask);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// gpio, irq, sync
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+	i3c_hal_write32(&io_bank0_hw->io[gpio].ctrl, (uint32_t)fn << IO_BANK0_GPIO0_CTRL_FUNCSEL_LSB);
+}
+
+void gpio_set_drive_strength(uint gpio, enum gpio_drive_strength drive)
+{
+	(void)gpio;
+	(void)drive;
+}
+
+void gpio_set_slew_rate(uint gpio, enum gpio_slew_rate slew)
+{
+	(void)gpio;
+	(void)slew;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled)
+{
+	(void)gpio;
+	(void)events;
+	(void)enabled;
+}
+
+void gpio_acknowledge_irq(uint gpio, uint32_t events)
+{
+	(void)gpio;
+	(void)events;
+}
+
+uint32_t gpio_get_irq_event_mask(uint gpio)
+{
+	(void)gpio;
+	return 0;
+}
+
+void gpio_add_raw_irq_handler_masked(uint32_t gpio_mask, irq_handler_t handler)
+{
+	(void)gpio_mask;
+	(void)handler;
+}
+
+void irq_set_enabled(uint num, bool enabled)
+{
+	(void)num;
+	(void)enabled;
+}
+
+uint32_t save_and_disable_interrupts(void)
+{
+	uint32_t status = s_irq_disabled ? 0u : 1u; // like PRIMASK inverted: 1 = enabled
+
+	s_irq_disabled = true;
+	return status;
+}
+
+void restore_interrupts(uint32_t status)
+{
+	s_irq_disabled = (status == 0);
+}
+
+spin_lock_t *spin_lock_instance(uint lock_num)
+{
+	static spin_lock_t locks[32];
+
+	return &locks[lock_num & 31u];
+}
+
+int spin_lock_claim_unused(bool required)
+{
+	static unsigned next = 16; // 0..15 are reserved for the pico-sdk
+
+	if (next < 32)
+		return (int)next++;
+	if (required)
+		hal_fatal("no free spin lock");
+	return -1;
+}
+
+uint32_t spin_lock_blocking(spin_lock_t *lock)
+{
+	(void)lock;
+	return save_and_disable_interrupts();
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq)
+{
+	(void)lock;
+	restore_interrupts(saved_irq);
+}
+
+uint get_core_num(void)
+{
+	return 0;
+}
+
+void __wfe(void)
+{
+	busy_wait_us_32(1);
+}
+
+void __sev(void)
+{
+}
+
+void tight_loop_contents(void)
+{
+	hal_access();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// time
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t time_us_64(void)
+{
+	hal_access();
+	return piosim_time_ns(&s_sim) / 1000u;
+}
+
+uint32_t time_us_32(void)
+{
+	return (uint32_t)time_us_64();
+}
+
+void sleep_us(uint64_t us)
+{
+	uint64_t end = s_sim.cycle + us * s_sim.sysclk_khz / 1000u;
+
+	// in steps of the access time while a DMA transfer runs, so it keeps up with the FIFOs. Otherwise at once up to the
+	// next alarm
+	while (s_sim.cycle < end)
+	{
+		if (hal_dma_active())
+			hal_access();
+		else
+		{
+			uint64_t stop = (s_alarm_next < end) ? s_alarm_next : end;
+
+			piosim_step(&s_sim, (stop > s_sim.cycle) ? (stop - s_sim.cycle) : 1u);
+			hal_alarm_service();
+		}
+	}
+}
+
+void sleep_ms(uint32_t ms)
+{
+	sleep_us((uint64_t)ms * 1000u);
+}
+
+void busy_wait_us_32(uint32_t us)
+{
+	sleep_us(us);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// timer alarms
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+int hardware_alarm_claim_unused(bool required)
+{
+	for (unsigned i = 0; i < NUM_ALARMS; i++)
+	{
+		if (!s_alarm[i].claimed)
+		{
+			s_alarm[i].claimed = true;
+			return (int)i;
+		}
+	}
+	if (required)
+		hal_fatal("no free hardware alarm");
+	return -1;
+}
+
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback)
+{
+	s_alarm[alarm_num].callback = callback;
+}
+
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t)
+{
+	// first cycle at which time_us_64 returns t
+	uint64_t target = (to_us_since_boot(t) * s_sim.sysclk_khz + 999u) / 1000u;
+
+	hal_access();
+	if (target <= s_sim.cycle)
+		return true;
+	s_alarm[alarm_num].target = target;
+	hal_alarm_update_next();
+	return false;
+}
+
+void hardware_alarm_cancel(uint alarm_num)
+{
+	s_alarm[alarm_num].target = UINT64_MAX;
+	hal_alarm_update_next();
+}
+
+void hardware_alarm_force_irq(uint alarm_num)
+{
+	s_alarm[alarm_num].target = s_sim.cycle;
+	hal_alarm_update_next();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// simulation
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+piosim_t *i3c_hal_host_sim(void)
+{
+	return &s_sim;
+}
+
+void i3c_hal_host_init(uint32_t sysclk_khz)
+{
+	piosim_init(&s_sim, sysclk_khz);
+	memset(s_dma, 0, sizeof(s_dma));
+	memset(s_alarm, 0, sizeof(s_alarm));
+	for (unsigned i = 0; i < NUM_ALARMS; i++)
+		s_alarm[i].target = UINT64_MAX;
+	s_alarm_next   = UINT64_MAX;
+	s_irq_disabled = false;
+}
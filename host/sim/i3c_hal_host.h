@@ -0,0 +1,297 @@
+#ifndef _I3C_HAL_HOST_H
+#define _I3C_HAL_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/pio.h"
+#include "piosim.h"
+
+/*
+ * Host side of src/i3c_hal.h: the part of the pico-sdk i3c_hl uses, implemented on the PIO simulator (piosim.h).
+ *
+ * pio0, pio1, io_bank0_hw and the DMA channels are shadow structures with the layout of the RP2040. They only give the
+ * registers their addresses: i3c_hal_read32 / i3c_hal_write32 and hw_set_bits / hw_clear_bits translate them into
+ * accesses of the simulator, which advances by its access time with every access like a CPU polling a register.
+ *
+ * The DMA channels are modeled with the pico-sdk channel configuration (DATA_SIZE, INCR_READ/WRITE, RING, TREQ_SEL),
+ * paced by the DREQs of the PIO FIFOs. Read and write addresses are host pointers: into the shadow FIFOs for the PIO,
+ * memory otherwise. Transfers are done whenever the simulation advances through this layer, i.e. while the CPU polls.
+ *
+ * Time (time_us_32, sleep_us, busy_wait_us_32) is the simulated time, so timeouts and the transfer statistics of
+ * i3c_hl show bus time. The only interrupts are the hardware alarms of the timer: their callbacks run from the next
+ * register access or time query once the simulated time reached the target, unless interrupts are disabled
+ * (save_and_disable_interrupts). The GPIO IRQ never fires and __wfe just lets 1 us pass. There is a single core, spin
+ * locks only disable the interrupts.
+ */
+
+#define __not_in_flash_func(func)   func
+#define __not_in_flash(group)
+#define count_of(a)                 (sizeof(a) / sizeof((a)[0]))
+
+#define NUM_CORES                   (2u)
+#define NUM_BANK0_GPIOS             (30u)
+#define NUM_DMA_CHANNELS            (12u)
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// hardware/structs
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+	io_ro_32 status;
+	io_rw_32 ctrl;
+} io_status_ctrl_hw_t;
+
+typedef struct
+{
+	io_status_ctrl_hw_t io[NUM_BANK0_GPIOS];
+} io_bank0_hw_t;
+
+typedef struct
+{
+	io_rw_32 read_addr;
+	io_rw_32 write_addr;
+	io_rw_32 transfer_count;
+	io_rw_32 ctrl_trig;
+	io_rw_32 al1_ctrl;
+	io_rw_32 al1_read_addr;
+	io_rw_32 al1_write_addr;
+	io_rw_32 al1_transfer_count_trig;
+	io_rw_32 al2_ctrl;
+	io_rw_32 al2_transfer_count;
+	io_rw_32 al2_read_addr;
+	io_rw_32 al2_write_addr_trig;
+	io_rw_32 al3_ctrl;
+	io_rw_32 al3_write_addr;
+	io_rw_32 al3_transfer_count;
+	io_rw_32 al3_read_addr_trig;
+} dma_channel_hw_t;
+
+extern pio_hw_t         i3c_hal_host_pio[NUM_PIOS];
+extern io_bank0_hw_t    i3c_hal_host_io_bank0;
+extern dma_channel_hw_t i3c_hal_host_dma[NUM_DMA_CHANNELS];
+
+#define pio0            (&i3c_hal_host_pio[0])
+#define pio1            (&i3c_hal_host_pio[1])
+#define io_bank0_hw     (&i3c_hal_host_io_bank0)
+
+#define IO_BANK0_GPIO0_CTRL_FUNCSEL_LSB         (0u)
+#define IO_BANK0_GPIO0_STATUS_OUTTOPAD_BITS     (1u << 9)
+#define IO_BANK0_GPIO0_STATUS_OETOPAD_BITS      (1u << 13)
+#define IO_BANK0_GPIO0_STATUS_INFROMPAD_LSB     (17u)
+#define IO_BANK0_GPIO0_STATUS_INFROMPAD_BITS    (1u << 17)
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// registers, see src/i3c_hal.h
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t i3c_hal_read32(const volatile uint32_t *preg);
+void     i3c_hal_write32(volatile uint32_t *preg, uint32_t value);
+volatile void *i3c_hal_dma_get_write_addr(uint channel);
+void     i3c_hal_dma_set_write_addr(uint channel, volatile void *paddr);
+
+void     hw_set_bits(io_rw_32 *preg, uint32_t mask);
+void     hw_clear_bits(io_rw_32 *preg, uint32_t mask);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// gpio, irq, sync, time
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+enum gpio_function
+{
+	GPIO_FUNC_SPI  = 1,
+	GPIO_FUNC_UART = 2,
+	GPIO_FUNC_I2C  = 3,
+	GPIO_FUNC_PWM  = 4,
+	GPIO_FUNC_SIO  = 5,
+	GPIO_FUNC_PIO0 = 6,
+	GPIO_FUNC_PIO1 = 7,
+	GPIO_FUNC_NULL = 0x1f,
+};
+
+enum gpio_drive_strength
+{
+	GPIO_DRIVE_STRENGTH_2MA  = 0,
+	GPIO_DRIVE_STRENGTH_4MA  = 1,
+	GPIO_DRIVE_STRENGTH_8MA  = 2,
+	GPIO_DRIVE_STRENGTH_12MA = 3,
+};
+
+enum gpio_slew_rate
+{
+	GPIO_SLEW_RATE_SLOW = 0,
+	GPIO_SLEW_RATE_FAST = 1,
+};
+
+enum gpio_irq_level
+{
+	GPIO_IRQ_LEVEL_LOW  = 1u,
+	GPIO_IRQ_LEVEL_HIGH = 2u,
+	GPIO_IRQ_EDGE_FALL  = 4u,
+	GPIO_IRQ_EDGE_RISE  = 8u,
+};
+
+#define IO_IRQ_BANK0    (13u)
+
+typedef void (*irq_handler_t)(void);
+
+void     gpio_set_function(uint gpio, enum gpio_function fn);
+void     gpio_set_drive_strength(uint gpio, enum gpio_drive_strength drive);
+void     gpio_set_slew_rate(uint gpio, enum gpio_slew_rate slew);
+void     gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled);
+void     gpio_acknowledge_irq(uint gpio, uint32_t events);
+uint32_t gpio_get_irq_event_mask(uint gpio);
+void     gpio_add_raw_irq_handler_masked(uint32_t gpio_mask, irq_handler_t handler);
+void     irq_set_enabled(uint num, bool enabled);
+
+uint32_t save_and_disable_interrupts(void);
+void     restore_interrupts(uint32_t status);
+uint     get_core_num(void);
+void     __wfe(void);
+void     __sev(void);
+void     tight_loop_contents(void);
+
+static inline void __dmb(void)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+typedef volatile uint32_t spin_lock_t;
+
+spin_lock_t *spin_lock_instance(uint lock_num);
+int      spin_lock_claim_unused(bool required);
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+void     spin_unlock(spin_lock_t *lock, uint32_t saved_irq);
+
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+void     sleep_us(uint64_t us);
+void     sleep_ms(uint32_t ms);
+void     busy_wait_us_32(uint32_t us);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// timer alarms
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#define NUM_GENERIC_TIMERS  (1u)
+#define NUM_ALARMS          (4u)
+
+typedef uint64_t absolute_time_t;
+typedef void (*hardware_alarm_callback_t)(uint alarm_num);
+
+static inline absolute_time_t from_us_since_boot(uint64_t us)
+{
+	return us;
+}
+
+static inline uint64_t to_us_since_boot(absolute_time_t t)
+{
+	return t;
+}
+
+int  hardware_alarm_claim_unused(bool required);
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback);
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t); // true: t has already passed, the alarm is not set
+void hardware_alarm_cancel(uint alarm_num);
+void hardware_alarm_force_irq(uint alarm_num);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// dma
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+enum dma_channel_transfer_size
+{
+	DMA_SIZE_8  = 0,
+	DMA_SIZE_16 = 1,
+	DMA_SIZE_32 = 2,
+};
+
+#define DREQ_FORCE                          (0x3fu)
+
+#define DMA_CH0_CTRL_TRIG_EN_BITS           (1u << 0)
+#define DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB     (2u)
+#define DMA_CH0_CTRL_TRIG_INCR_READ_BITS    (1u << 4)
+#define DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS   (1u << 5)
+#define DMA_CH0_CTRL_TRIG_RING_SIZE_LSB     (6u)
+#define DMA_CH0_CTRL_TRIG_RING_SEL_BITS     (1u << 10)
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB      (11u)
+#define DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB      (15u)
+#define DMA_CH0_CTRL_TRIG_BUSY_BITS         (1u << 24)
+
+typedef struct
+{
+	uint32_t ctrl;
+} dma_channel_config;
+
+static inline dma_channel_hw_t *dma_channel_hw_addr(uint channel)
+{
+	return &i3c_hal_host_dma[channel];
+}
+
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+	c->ctrl = incr ? (c->ctrl | DMA_CH0_CTRL_TRIG_INCR_READ_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_INCR_READ_BITS);
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+	c->ctrl = incr ? (c->ctrl | DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS);
+}
+
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+	c->ctrl = (c->ctrl & ~(0x3fu << DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB)) | ((dreq & 0x3fu) << DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB);
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size)
+{
+	c->ctrl = (c->ctrl & ~(3u << DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB)) | ((uint32_t)size << DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB);
+}
+
+static inline void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits)
+{
+	c->ctrl = (c->ctrl & ~((0xfu << DMA_CH0_CTRL_TRIG_RING_SIZE_LSB) | DMA_CH0_CTRL_TRIG_RING_SEL_BITS)) |
+	          ((size_bits & 0xfu) << DMA_CH0_CTRL_TRIG_RING_SIZE_LSB) | (write ? DMA_CH0_CTRL_TRIG_RING_SEL_BITS : 0u);
+}
+
+static inline uint32_t channel_config_get_ctrl_value(const dma_channel_config *c)
+{
+	return c->ctrl;
+}
+
+// read increment, no write increment, 32 bit, unpaced, chained to itself (= no chaining), enabled
+static inline dma_channel_config dma_channel_get_default_config(uint channel)
+{
+	dma_channel_config c;
+
+	c.ctrl = DMA_CH0_CTRL_TRIG_EN_BITS | DMA_CH0_CTRL_TRIG_INCR_READ_BITS | ((uint32_t)DMA_SIZE_32 << DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB) |
+	         ((channel & 0xfu) << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB) | (DREQ_FORCE << DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB);
+	return c;
+}
+
+static inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx)
+{
+	return ((pio == pio1) ? 8u : 0u) + (is_tx ? 0u : 4u) + sm;
+}
+
+int  dma_claim_unused_channel(bool required);
+dma_channel_config dma_get_channel_config(uint channel);
+void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr, const volatile void *read_addr,
+                           uint transfer_count, bool trigger);
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count);
+void dma_channel_transfer_to_buffer_now(uint channel, volatile void *write_addr, uint32_t transfer_count);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_abort(uint channel);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// simulation
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// the simulated RP2040. i3c_hal_host_init resets it to power up with the given system clock (125000 kHz on the RP2040),
+// afterwards target models can be attached to the pins of a bus
+piosim_t *i3c_hal_host_sim(void);
+void      i3c_hal_host_init(uint32_t sysclk_khz);
+
+#endif
@@ -0,0 +1,560 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "i3cb_fw_host.h"
+
+/*
+ * pico-sdk and TinyUSB of the firmware beyond i3c_hl on the PIO simulator, see i3cb_fw_host.h
+ */
+
+#define GPIO_VBUS_SENSE     (24u)       // Pico: VBUS through a divider, Xiao: not connected
+#define IDLE_AFTER_NS       (10000000u) // host time without CDC traffic before getchar_timeout_us waits for input
+#define IDLE_WAIT_MS        (1)
+#define IDLE_CATCHUP_MAX_US (100000u)   // simulated time following the host time per wait at most
+
+uart_inst_t i3cb_fw_host_uart[1];
+i2c_inst_t  i3cb_fw_host_i2c[2];
+adc_hw_t    i3cb_fw_host_adc;
+
+static bool            s_xiao;
+static piosim_device_t s_board;         // SIO outputs and the pins held low by the board
+static uint32_t        s_sio_oe, s_sio_out;
+
+static int             s_master = -1;   // pty
+static int             s_notify = -1;   // inotify watch of the pty, counts the clients
+static char            s_path[64];
+static int             s_clients;
+static uint8_t         s_rx[CFG_TUD_CDC_RX_BUFSIZE];
+static uint32_t        s_rxpos, s_rxlen;
+static bool            s_prevcr;        // CR/LF translation: last character written was a CR
+static uint64_t        s_lastio_ns;
+static volatile sig_atomic_t s_stop;
+
+uint8_t *i3cb_fw_host_flash;
+
+static uint64_t host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// CDC on the pty
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// output is dropped while no client has the pty open, like stdio_usb does without DTR
+static void pty_write(const char *p, size_t len)
+{
+	while ( (len > 0) && (s_clients > 0) )
+	{
+		ssize_t n = write(s_master, p, len);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		p   += n;
+		len -= (size_t)n;
+	}
+	s_lastio_ns = host_ns();
+}
+
+// pico-sdk stdio CR/LF translation: a LF not preceded by a CR gets one
+static void pty_write_crlf(const char *p, size_t len)
+{
+	char   buf[512];
+	size_t n = 0;
+
+	for (size_t i=0; i<len; i++)
+	{
+		if (n + 2 > sizeof(buf))
+		{
+			pty_write(buf, n);
+			n = 0;
+		}
+		if ( (p[i] == '\n') && !s_prevcr )
+			buf[n++] = '\r';
+		buf[n++] = p[i];
+		s_prevcr = p[i] == '\r';
+	}
+	pty_write(buf, n);
+}
+
+static ssize_t stdout_write(void *cookie, const char *p, size_t len)
+{
+	(void)cookie;
+	pty_write_crlf(p, len);
+	return (ssize_t)len;
+}
+
+// opens and closes of the pty by clients
+static void pty_notify(void)
+{
+	char buf[sizeof(struct inotify_event) * 16];
+	ssize_t len;
+
+	while ( (len = read(s_notify, buf, sizeof(buf))) > 0 )
+	{
+		for (char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len)
+		{
+			uint32_t mask = ((struct inotify_event *)p)->mask;
+			if (mask & IN_OPEN)
+				s_clients++;
+			if ( (mask & (IN_CLOSE_WRITE | IN_CLOSE_NOWRITE)) && (s_clients > 0) )
+				s_clients--;
+		}
+	}
+}
+
+// waits up to timeout_ms for input from the pty. Returns false when the CDC input has to wait for the next call,
+// because a client connected: the firmware first sees it connected (tud_cdc_connected) and greets it
+static bool pty_poll(int timeout_ms)
+{
+	struct pollfd fds[2] = { { s_notify, POLLIN, 0 }, { s_master, POLLIN, 0 } };
+	int           clients = s_clients;
+	ssize_t       n;
+
+	if (s_stop)
+		exit(0);
+	if (poll(fds, (s_clients > 0) ? 2 : 1, timeout_ms) <= 0)
+		return true;
+	pty_notify();
+	if ( (s_clients > 0) && (fds[1].revents & POLLIN) )
+	{
+		n = read(s_master, s_rx, sizeof(s_rx));
+		if (n > 0)
+		{
+			s_rxpos = 0;
+			s_rxlen = (uint32_t)n;
+			s_lastio_ns = host_ns();
+		}
+	}
+	return (clients > 0) || (s_clients == 0);
+}
+
+static bool pty_open(void)
+{
+	struct termios tio;
+	int            slave;
+
+	s_master = posix_openpt(O_RDWR | O_NOCTTY);
+	if ( (s_master < 0) || (grantpt(s_master) != 0) || (unlockpt(s_master) != 0) || (ptsname(s_master) == NULL) )
+		return false;
+	snprintf(s_path, sizeof(s_path), "%s", ptsname(s_master));
+
+	// raw, binary frames must pass unchanged. The setting stays after the close
+	slave = open(s_path, O_RDWR | O_NOCTTY);
+	if (slave < 0)
+		return false;
+	if (tcgetattr(slave, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tcsetattr(slave, TCSANOW, &tio);
+	}
+	close(slave);
+
+	s_notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if ( (s_notify < 0) || (inotify_add_watch(s_notify, s_path, IN_OPEN | IN_CLOSE) < 0) )
+		return false;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// stdio, TinyUSB
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+bool stdio_init_all(void)
+{
+	return true;
+}
+
+int getchar_timeout_us(uint32_t timeout_us)
+{
+	(void)timeout_us;
+	if (s_rxpos == s_rxlen)
+	{
+		uint64_t start = host_ns();
+		bool     idle = (start - s_lastio_ns) > IDLE_AFTER_NS;
+		bool     ready;
+
+		fflush(stdout); // the output of the last command
+		ready = pty_poll(idle ? IDLE_WAIT_MS : 0);
+		if (idle)
+		{ // the simulated time keeps pace with the host while waiting
+			uint64_t us = (host_ns() - start) / 1000u;
+			sleep_us((us < IDLE_CATCHUP_MAX_US) ? us : IDLE_CATCHUP_MAX_US);
+		}
+		if ( !ready || (s_rxpos == s_rxlen) )
+			return PICO_ERROR_TIMEOUT;
+	}
+	return s_rx[s_rxpos++];
+}
+
+void stdio_put_string(const char *s, int len, bool newline, bool cr_translation)
+{
+	fflush(stdout); // keeps the order with printf
+	if (cr_translation)
+		pty_write_crlf(s, (size_t)len);
+	else
+		pty_write(s, (size_t)len);
+	if (newline)
+		pty_write_crlf("\n", 1);
+}
+
+bool tusb_init(void)
+{
+	return true;
+}
+
+void tud_task(void)
+{
+}
+
+bool tud_cdc_connected(void)
+{
+	return s_clients > 0;
+}
+
+bool tud_vendor_mounted(void)
+{
+	return false;
+}
+
+uint32_t tud_vendor_available(void)
+{
+	return 0;
+}
+
+uint32_t tud_vendor_read(void *buffer, uint32_t bufsize)
+{
+	(void)buffer;
+	(void)bufsize;
+	return 0;
+}
+
+uint32_t tud_vendor_write(const void *buffer, uint32_t bufsize)
+{
+	(void)buffer;
+	(void)bufsize;
+	return 0;
+}
+
+uint32_t tud_vendor_write_flush(void)
+{
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// gpio, clocks
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static void board_update(piosim_t *ps, piosim_device_t *pdev, uint32_t levels, uint32_t changed)
+{
+	(void)ps;
+	(void)pdev;
+	(void)levels;
+	(void)changed;
+}
+
+// SIO outputs driving low, only on pins whose function is SIO
+static void sio_update(void)
+{
+	piosim_t *ps = i3c_hal_host_sim();
+	uint32_t  low = s_xiao ? (1u << GPIO_VBUS_SENSE) : 0u;
+
+	for (unsigned i=0; i<NUM_BANK0_GPIOS; i++)
+	{
+		if ( (ps->funcsel[i] == GPIO_FUNC_SIO) && (s_sio_oe & ~s_sio_out & (1u << i)) )
+			low |= 1u << i;
+	}
+	piosim_pull(ps, &s_board, ~low, false);
+	piosim_pull(ps, &s_board, low, true);
+}
+
+void gpio_init(uint gpio)
+{
+	s_sio_oe  &= ~(1u << gpio);
+	s_sio_out &= ~(1u << gpio);
+	gpio_set_function(gpio, GPIO_FUNC_SIO);
+	sio_update();
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+	s_sio_oe = out ? (s_sio_oe | (1u << gpio)) : (s_sio_oe & ~(1u << gpio));
+	sio_update();
+}
+
+void gpio_put(uint gpio, bool value)
+{
+	s_sio_out = value ? (s_sio_out | (1u << gpio)) : (s_sio_out & ~(1u << gpio));
+	sio_update();
+}
+
+void gpio_xor_mask(uint32_t mask)
+{
+	s_sio_out ^= mask;
+	sio_update();
+}
+
+bool gpio_get(uint gpio)
+{
+	sio_update();
+	return (i3c_hal_read32(&io_bank0_hw->io[gpio].status) & IO_BANK0_GPIO0_STATUS_INFROMPAD_BITS) != 0;
+}
+
+void gpio_set_pulls(uint gpio, bool up, bool down)
+{
+	(void)gpio;
+	(void)up;
+	(void)down;
+}
+
+uint32_t frequency_count_khz(uint src)
+{
+	switch (src)
+	{
+		case CLOCKS_FC0_SRC_VALUE_PLL_SYS_CLKSRC_PRIMARY:
+		case CLOCKS_FC0_SRC_VALUE_CLK_SYS:
+		case CLOCKS_FC0_SRC_VALUE_CLK_PERI:
+			return i3c_hal_host_sim()->sysclk_khz;
+		case CLOCKS_FC0_SRC_VALUE_PLL_USB_CLKSRC_PRIMARY:
+		case CLOCKS_FC0_SRC_VALUE_CLK_USB:
+		case CLOCKS_FC0_SRC_VALUE_CLK_ADC:
+			return 48000;
+		case CLOCKS_FC0_SRC_VALUE_ROSC_CLKSRC:
+			return 6500;
+		case CLOCKS_FC0_SRC_VALUE_CLK_RTC:
+			return 47;
+		default:
+			return 0;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// uart, adc, i2c
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+uint uart_init(uart_inst_t *uart, uint baudrate)
+{
+	uart->baudrate = baudrate;
+	return baudrate;
+}
+
+void uart_set_format(uart_inst_t *uart, uint data_bits, uint stop_bits, uart_parity_t parity)
+{
+	(void)uart;
+	(void)data_bits;
+	(void)stop_bits;
+	(void)parity;
+}
+
+void uart_putc(uart_inst_t *uart, char c)
+{
+	(void)uart;
+	(void)c;
+}
+
+void adc_init(void)
+{
+}
+
+void adc_gpio_init(uint gpio)
+{
+	(void)gpio;
+}
+
+void adc_select_input(uint input)
+{
+	(void)input;
+}
+
+void adc_run(bool run)
+{
+	(void)run;
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate)
+{
+	return i2c_set_baudrate(i2c, baudrate);
+}
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate)
+{
+	i2c->baudrate = baudrate;
+	return baudrate;
+}
+
+// START, address byte without ACK and STOP
+static int i2c_nak(i2c_inst_t *i2c)
+{
+	sleep_us(11u * 1000000u / (i2c->baudrate ? i2c->baudrate : 100000u));
+	return PICO_ERROR_GENERIC;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us)
+{
+	(void)addr;
+	(void)src;
+	(void)len;
+	(void)nostop;
+	(void)timeout_us;
+	return i2c_nak(i2c);
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us)
+{
+	(void)addr;
+	(void)dst;
+	(void)len;
+	(void)nostop;
+	(void)timeout_us;
+	return i2c_nak(i2c);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// flash
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// like NOR flash, programming can only clear bits
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+	if ( ((flash_offs | count) % FLASH_SECTOR_SIZE) || (flash_offs + count > PICO_FLASH_SIZE_BYTES) )
+	{
+		fprintf(stderr, "flash_range_erase: invalid range 0x%x+0x%zx\n", (unsigned)flash_offs, count);
+		abort();
+	}
+	memset(i3cb_fw_host_flash + flash_offs, 0xff, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+	if ( ((flash_offs | count) % FLASH_PAGE_SIZE) || (flash_offs + count > PICO_FLASH_SIZE_BYTES) )
+	{
+		fprintf(stderr, "flash_range_program: invalid range 0x%x+0x%zx\n", (unsigned)flash_offs, count);
+		abort();
+	}
+	for (size_t i=0; i<count; i++)
+		i3cb_fw_host_flash[flash_offs + i] &= data[i];
+}
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms)
+{
+	(void)enter_exit_timeout_ms;
+	func(param); // a single core, nothing else runs from flash
+	return PICO_OK;
+}
+
+bool flash_safe_execute_core_init(void)
+{
+	return true;
+}
+
+bool i3cb_fw_host_flash_open(const char *path)
+{
+	struct stat st;
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	bool created;
+	void *p;
+
+	if ( (fd < 0) || (fstat(fd, &st) != 0) )
+		return false;
+	created = (st.st_size == 0);
+	if ( (ftruncate(fd, PICO_FLASH_SIZE_BYTES) != 0) ||
+	     ((p = mmap(NULL, PICO_FLASH_SIZE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) )
+	{
+		close(fd);
+		return false;
+	}
+	close(fd);
+	i3cb_fw_host_flash = p;
+	if (created)
+		memset(i3cb_fw_host_flash, 0xff, PICO_FLASH_SIZE_BYTES);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// board
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+const char *i3cb_fw_host_open(bool xiao)
+{
+	s_xiao = xiao;
+	piosim_attach(i3c_hal_host_sim(), &s_board, board_update, NULL);
+	sio_update();
+	*(uint32_t *)&i3cb_fw_host_adc.result = 2048; // VIO = 3.3 V, the ADC input has a divider by 2
+	if (!pty_open())
+		return NULL;
+	return s_path;
+}
+
+unsigned i3cb_fw_host_gpiobase(bool xiao)
+{
+	return xiao ? 6u : 16u;
+}
+
+int i3cb_fw_host_run(void)
+{
+	FILE *pstdout;
+
+	if (i3cb_fw_host_flash == NULL)
+	{ // erased flash without file
+		i3cb_fw_host_flash = malloc(PICO_FLASH_SIZE_BYTES);
+		if (i3cb_fw_host_flash == NULL)
+			return 1;
+		memset(i3cb_fw_host_flash, 0xff, PICO_FLASH_SIZE_BYTES);
+	}
+
+	// printf of the firmware goes to the pty
+	pstdout = fopencookie(NULL, "w", (cookie_io_functions_t){ .write = stdout_write });
+	if (pstdout == NULL)
+		return 1;
+	setvbuf(pstdout, NULL, _IOFBF, 4096);
+	fflush(stdout);
+	stdout = pstdout;
+	return i3cb_firmware_main();
+}
+
+void i3cb_fw_host_stop(void)
+{
+	s_stop = 1;
+}
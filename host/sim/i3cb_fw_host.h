@@ -0,0 +1,177 @@
+#ifndef _I3CB_FW_HOST_H
+#define _I3CB_FW_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "i3c_hal_host.h"
+#include "tusb_config.h"
+
+/*
+ * Host build of the firmware (src/main.c with busengine, sampler, binframe and the NeoPixel driver): the part of the
+ * pico-sdk and TinyUSB it uses beyond i3c_hal_host.h, on the PIO simulator. The pico-sdk headers included by the
+ * firmware are replaced by the ones in host/sim/include, which all include this header.
+ *
+ * The board is a Raspberry Pi Pico (I3C on GPIO16/17) or a Xiao RP2040 (GPIO6/7), told apart by the firmware through
+ * GPIO24 like on the hardware:
+ *  - USB CDC: a pseudo terminal. stdio (printf, getchar_timeout_us) is its data with the same CR/LF translation as
+ *    pico-sdk stdio, tud_cdc_connected is true while a client has the pty open. The vendor bulk interface is never
+ *    mounted, binary frames work embedded in the CDC stream
+ *  - SIO GPIOs: outputs driving low pull the pin low in the simulator, gpio_get returns the pin level
+ *  - I2C: no I2C devices on the bus, every transfer fails like without ACK
+ *  - ADC: VIO reads 3.3 V, the NeoPixel UART output goes nowhere
+ *  - flash: 2 MB of memory, or a file (i3cb_fw_host_flash_open). Only the configuration store lives in it, the firmware
+ *    itself does not
+ *
+ * While the pty is busy the firmware runs as fast as the simulation allows. When nothing was received or sent for a
+ * while, getchar_timeout_us waits for input up to 1 ms and lets the simulated time catch up with the host time, so the
+ * process sleeps and periodic sampler jobs keep running at their rate when idle.
+ */
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// pico/stdlib.h, hardware/gpio.h, hardware/clocks.h
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#define PICO_ERROR_NONE     (0)
+#define PICO_ERROR_TIMEOUT  (-1)
+#define PICO_ERROR_GENERIC  (-2)
+
+#define GPIO_OUT            (1)
+#define GPIO_IN             (0)
+
+bool stdio_init_all(void);
+int  getchar_timeout_us(uint32_t timeout_us);
+void stdio_put_string(const char *s, int len, bool newline, bool cr_translation);
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_xor_mask(uint32_t mask);
+void gpio_set_pulls(uint gpio, bool up, bool down);
+
+#define CLOCKS_FC0_SRC_VALUE_PLL_SYS_CLKSRC_PRIMARY (0x1u)
+#define CLOCKS_FC0_SRC_VALUE_PLL_USB_CLKSRC_PRIMARY (0x2u)
+#define CLOCKS_FC0_SRC_VALUE_ROSC_CLKSRC            (0x3u)
+#define CLOCKS_FC0_SRC_VALUE_CLK_SYS                (0x9u)
+#define CLOCKS_FC0_SRC_VALUE_CLK_PERI               (0xau)
+#define CLOCKS_FC0_SRC_VALUE_CLK_USB                (0xbu)
+#define CLOCKS_FC0_SRC_VALUE_CLK_ADC                (0xcu)
+#define CLOCKS_FC0_SRC_VALUE_CLK_RTC                (0xdu)
+
+uint32_t frequency_count_khz(uint src);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// hardware/uart.h, hardware/adc.h, hardware/i2c.h
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef enum
+{
+	UART_PARITY_NONE,
+	UART_PARITY_EVEN,
+	UART_PARITY_ODD,
+} uart_parity_t;
+
+typedef struct
+{
+	uint baudrate;
+} uart_inst_t;
+
+extern uart_inst_t i3cb_fw_host_uart[1];
+#define uart0   (&i3cb_fw_host_uart[0])
+
+uint uart_init(uart_inst_t *uart, uint baudrate);
+void uart_set_format(uart_inst_t *uart, uint data_bits, uint stop_bits, uart_parity_t parity);
+void uart_putc(uart_inst_t *uart, char c);
+
+typedef struct
+{
+	io_rw_32 cs;
+	io_ro_32 result;
+	io_rw_32 fcs;
+	io_ro_32 fifo;
+	io_rw_32 div;
+	io_ro_32 intr;
+	io_rw_32 inte;
+	io_rw_32 intf;
+	io_ro_32 ints;
+} adc_hw_t;
+
+extern adc_hw_t i3cb_fw_host_adc;
+#define adc_hw  (&i3cb_fw_host_adc)
+
+void adc_init(void);
+void adc_gpio_init(uint gpio);
+void adc_select_input(uint input);
+void adc_run(bool run);
+
+typedef struct
+{
+	uint baudrate;
+} i2c_inst_t;
+
+extern i2c_inst_t i3cb_fw_host_i2c[2];
+#define i2c0    (&i3cb_fw_host_i2c[0])
+#define i2c1    (&i3cb_fw_host_i2c[1])
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+int  i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us);
+int  i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// hardware/flash.h, pico/flash.h
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#define PICO_OK                (0)
+#define PICO_FLASH_SIZE_BYTES  (2u * 1024u * 1024u)
+#define FLASH_SECTOR_SIZE      (4096u)
+#define FLASH_PAGE_SIZE        (256u)
+
+// the flash is memory of the process, see i3cb_fw_host_flash_open
+extern uint8_t *i3cb_fw_host_flash;
+#define XIP_BASE ((uintptr_t)i3cb_fw_host_flash)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+int  flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms);
+bool flash_safe_execute_core_init(void);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// tusb.h
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+bool     tusb_init(void);
+void     tud_task(void);
+bool     tud_cdc_connected(void);
+bool     tud_vendor_mounted(void);
+uint32_t tud_vendor_available(void);
+uint32_t tud_vendor_read(void *buffer, uint32_t bufsize);
+uint32_t tud_vendor_write(const void *buffer, uint32_t bufsize);
+uint32_t tud_vendor_write_flush(void);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// board
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// the firmware's main, renamed by the build
+int i3cb_firmware_main(void);
+
+// sets up the board on the simulator (after i3c_hal_host_init) and creates the pty. Returns the path of the pty,
+// NULL on errors
+const char *i3cb_fw_host_open(bool xiao);
+
+// runs the firmware, stdout is the pty from now on. Returns after i3cb_fw_host_stop only through exit()
+int i3cb_fw_host_run(void);
+
+// maps the flash to the file path, so the configuration store (src/cfgstore.h) persists across runs. The file is created
+// erased when it does not exist. Without it, the flash is erased at every start. Call it before i3cb_fw_host_run
+bool i3cb_fw_host_flash_open(const char *path);
+
+// SDA of I3C bus 0 as set up by the firmware on the board
+unsigned i3cb_fw_host_gpiobase(bool xiao);
+
+// lets the firmware exit at its next poll of the CDC input. Can be called from a signal handler
+void i3cb_fw_host_stop(void);
+
+#endif
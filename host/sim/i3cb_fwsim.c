@@ -0,0 +1,144 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * The firmware (src/main.c with its CLI, the bus engine, the sampler and binary frames) built for the host against the
+ * PIO simulator and target models, its USB CDC interface is a pseudo terminal (see sim/i3cb_fw_host.h):
+ *
+ *   i3cb_fwsim [-s sysclk_khz] [-x] [-o trace.vcd] [-f flash.bin] [-t target]...
+ *
+ * The path of the pty is printed as the first line on stdout, connect to it like to the serial port of the hardware,
+ * e.g. with i3cblaster.init(port=path) of python/i3cblaster.py. The firmware sees a Raspberry Pi Pico, with -x a Xiao
+ * RP2040. The CLI, the binary frames and the bus timing are the ones of the firmware, only the host sets the pace: the
+ * simulation runs as fast as it can while commands come in and catches up with the host time when idle.
+ *
+ * -t attaches a target model (i3ctarget.h) to I3C bus 0, up to 4: "ADDR[,key=value]...", ADDR is the dynamic address
+ * (0: none, to be assigned by ENTDAA). Keys: pid, bcr, dcr, ddr (0: none, 10: V1.0, 11: V1.1), ack, limit, crc, mrl, mwl,
+ * see i3cb_piosim. Without -t there are targets at 0x08 and at 0x30.
+ *
+ * -f keeps the flash in a file, so the configuration saved by config_save is applied at the next start like on the
+ * hardware. Without it, every start sees an erased flash.
+ *
+ * Ends on SIGINT / SIGTERM and prints per target its address and the errors it detected to stderr. The VCD trace (-o)
+ * contains SDA and SCL incl. the output enables, it grows with the simulated time, also while idle.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include "i3cb_fw_host.h"
+#include "i3ctarget.h"
+
+#define MAX_TARGETS  (4)
+
+static i3ctarget_t        s_targets[MAX_TARGETS];
+static i3ctarget_config_t s_targetcfg[MAX_TARGETS];
+static unsigned           s_targetcount;
+
+static void print_targets(void)
+{
+	piosim_vcd_close(i3c_hal_host_sim());
+	i3ctarget_print_stats(stderr, s_targets, s_targetcount);
+}
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	i3cb_fw_host_stop();
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t    sysclk_khz = 125000;
+	bool        xiao = false;
+	const char *vcdfile = NULL, *flashfile = NULL, *path;
+	unsigned    gpio;
+	piosim_t   *ps;
+	int         opt;
+
+	while ( (opt = getopt(argc, argv, "s:xo:f:t:")) != -1 )
+	{
+		switch (opt)
+		{
+			case 's': sysclk_khz = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'x': xiao       = true;                               break;
+			case 'o': vcdfile    = optarg;                             break;
+			case 'f': flashfile  = optarg;                             break;
+			case 't':
+				if (!i3ctarget_config_add(s_targetcfg, MAX_TARGETS, &s_targetcount, optarg))
+				{
+					fprintf(stderr, "invalid target: %s\n", optarg);
+					return 1;
+				}
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-s sysclk_khz] [-x] [-o trace.vcd] [-f flash.bin] [-t target]...\n", argv[0]);
+				return 1;
+		}
+	}
+	if ( (sysclk_khz == 0) || (optind < argc) )
+	{
+		fprintf(stderr, "parameter out of range\n");
+		return 1;
+	}
+	if (s_targetcount == 0)
+	{
+		i3ctarget_config_add(s_targetcfg, MAX_TARGETS, &s_targetcount, "0x08");
+		i3ctarget_config_add(s_targetcfg, MAX_TARGETS, &s_targetcount, "0x30,pid=0x0123456789ac");
+	}
+
+	i3c_hal_host_init(sysclk_khz);
+	ps = i3c_hal_host_sim();
+	gpio = i3cb_fw_host_gpiobase(xiao);
+	for (unsigned i=0; i<s_targetcount; i++)
+		i3ctarget_attach(&s_targets[i], ps, gpio, &s_targetcfg[i]);
+	piosim_vcd_pin(ps, gpio, "SDA");
+	piosim_vcd_pin(ps, gpio + 1u, "SCL");
+	if ( vcdfile && !piosim_vcd_open(ps, vcdfile) )
+	{
+		fprintf(stderr, "cannot create %s\n", vcdfile);
+		return 1;
+	}
+	if ( flashfile && !i3cb_fw_host_flash_open(flashfile) )
+	{
+		fprintf(stderr, "cannot open %s\n", flashfile);
+		return 1;
+	}
+	path = i3cb_fw_host_open(xiao);
+	if (path == NULL)
+	{
+		perror("pty");
+		return 1;
+	}
+	printf("%s\n", path);
+	fflush(stdout);
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	atexit(print_targets);
+	return i3cb_fw_host_run();
+}
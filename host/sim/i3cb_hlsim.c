@@ -0,0 +1,461 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Runs the i3c_hl API of the firmware natively against target models (i3ctarget.h) on the PIO simulator, through the
+ * host HAL (i3c_hal_host.h). It checks changes of i3c_hl end-to-end without hardware and makes the CPU side of the
+ * transfers (encoding, FIFO polling, DMA handling, parity and CRC) accessible to perf, valgrind and gdb:
+ *
+ *   i3cb_hlsim [-f i3c_khz] [-s sysclk_khz] [-g gpiobase] [-m sm] [-n loops] [-o trace.vcd] [-t target]... [op]...
+ *
+ * -t attaches a target model like in i3cb_piosim: "ADDR[,key=value]...", ADDR is the dynamic address (0: none, to be
+ * assigned by ENTDAA). Keys: pid, bcr, dcr, ddr (0: none, 10: V1.0, 11: V1.1), ack, limit, crc, mrl, mwl.
+ *
+ * The ops are i3c_hl calls, run in the given order:
+ *   rstdaa                    i3c_hl_rstdaa
+ *   entdaa=A                  i3c_hl_entdaa assigning address A
+ *   daa[=FIRST,LAST]          i3c_hl_daa assigning addresses of the pool FIRST..LAST (default 0x08..0x7d) to all targets
+ *   scan                      i3c_hl_scan, prints the ACKing addresses
+ *   scan_checkack             the same scan with i3c_hl_checkack per address, the way i3c_scan worked before
+ *   write=A,B,...             i3c_hl_sdr_privwrite
+ *   read=A,N                  i3c_hl_sdr_privread of up to N bytes
+ *   ccc=C,B,...               i3c_hl_sdr_ccc_broadcast_write of CCC C with payload
+ *   cccw=A,C,B,...            i3c_hl_sdr_ccc_direct_write of CCC C to A with payload
+ *   cccr=A,C,N                i3c_hl_sdr_ccc_direct_read of up to N bytes
+ *   ddr_config=ACK,ET,CRC,RS  flags of the following HDR-DDR transfers: ACK of the first written word, early write
+ *                             termination, CRC word after early terminations, finalize with HDR restart. Default: all 0
+ *   ddr_write=A,CMD,W,...     i3c_hl_ddr_write
+ *   ddr_read=A,CMD,N          i3c_hl_ddr_read of up to N words
+ *   hdrexit                   i3c_hl_hdrexit
+ *   poll=N                    i3c_hl_poll of up to N bytes
+ *   ibi=T,MDB[,B,...]         target T (index of -t) raises an IBI with MDB and payload
+ *   hotjoin=T                 target T raises a Hot-Join request
+ *   fault_parity=T,N          target T sends read word N (1 = first) of its next HDR-DDR read with wrong parity
+ *   fault_crc=T               target T sends its next HDR-DDR CRC word with a wrong CRC
+ *   dma=SDR,DDR               i3c_hl_sdr_write_dma_enable / i3c_hl_ddr_write_dma_enable
+ *   idle=US                   sleep_us
+ * Without ops a private write of 0x00 0x55 to 0x08 runs.
+ *
+ * The ops are repeated -n times (default 1). The first pass prints start, duration (simulated time), status and data
+ * per op. At the end follow the simulated and the host time of all passes, the transfer statistics of i3c_hl and per
+ * target its address and the errors it detected.
+ *
+ * example, ENTDAA, SDR and HDR-DDR write and read back with a V1.1 target, 1000 times for perf:
+ *   i3cb_hlsim -n 1000 -t 0,pid=0x0123456789ab rstdaa entdaa=0x08 write=0x08,0x10,1,2,3 write=0x08,0x10 read=0x08,3
+ *              ddr_config=1,0,0,0 ddr_write=0x08,0x05,0x1234,0x5678 ddr_read=0x08,0x85,8
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "i3c_hl.h"
+#include "i3c_hal.h"
+#include "i3ctarget.h"
+
+#define MAX_TARGETS   (4)
+#define MAX_ARGS      (512)
+#define RESULT_LEN    (8192)  // printed result of an op
+
+static i3c_hl_bus_t      *s_pbus;
+static bool               s_ddr_ack, s_ddr_earlyterm, s_ddr_crc, s_ddr_restart; // ddr_config
+static bool               s_verbose;   // print the ops, first pass only
+static i3ctarget_t        s_targets[MAX_TARGETS];
+static i3ctarget_config_t s_targetcfg[MAX_TARGETS];
+static unsigned           s_targetcount;
+
+// console output of ucli
+void ucli_print(const char *str)
+{
+	fputs(str, stdout);
+}
+
+static int print_bytes(char *result, const uint8_t *pdat, uint32_t count)
+{
+	int len = 0;
+
+	for (uint32_t i=0; (i<count) && (len < RESULT_LEN - 16); i++)
+		len += sprintf(result + len, "%s0x%02x", i ? "," : "", pdat[i]);
+	return len;
+}
+
+static int print_words(char *result, const uint16_t *pdat, uint32_t count)
+{
+	int len = 0;
+
+	for (uint32_t i=0; (i<count) && (len < RESULT_LEN - 16); i++)
+		len += sprintf(result + len, "%s0x%04x", i ? "," : "", pdat[i]);
+	return len;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// ops
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static i3c_hl_status_t op_entdaa(uint8_t addr, char *result)
+{
+	uint8_t         pid[8];
+	i3c_hl_status_t status = i3c_hl_entdaa(s_pbus, addr, pid);
+
+	if (status == i3c_hl_status_ok)
+		print_bytes(result, pid, 8);
+	return status;
+}
+
+static i3c_hl_status_t op_daa(const uint32_t *pargs, unsigned argc, char *result)
+{
+	i3c_hl_daa_entry_t entries[MAX_TARGETS];
+	uint32_t        count;
+	size_t          len = 0;
+	i3c_hl_status_t status = i3c_hl_daa(s_pbus, (argc >= 1) ? (uint8_t)pargs[0] : 0x08u, (argc >= 2) ? (uint8_t)pargs[1] : 0x7du,
+	                                    NULL, entries, MAX_TARGETS, &count);
+
+	for (uint32_t i=0; i<count; i++)
+	{
+		const i3c_hl_daa_entry_t *pe = &entries[i];
+
+		len += (size_t)snprintf(result + len, RESULT_LEN - len, "%s0x%02x%02x%02x%02x%02x%02x,0x%02x,0x%02x->0x%02x", i ? " " : "",
+		                        pe->pid[0], pe->pid[1], pe->pid[2], pe->pid[3], pe->pid[4], pe->pid[5], pe->bcr, pe->dcr, pe->addr);
+	}
+	return status;
+}
+
+static void print_present(char *result, const uint32_t *ppresent)
+{
+	size_t len = 0;
+
+	result[0] = '\0';
+	for (unsigned addr=0; addr<0x80; addr++)
+	{
+		if (ppresent[addr >> 5] & (1ul << (addr & 31u)))
+			len += (size_t)snprintf(result + len, RESULT_LEN - len, "%s0x%02x", len ? " " : "", addr);
+	}
+}
+
+static i3c_hl_status_t op_scan(char *result)
+{
+	uint32_t        present[4];
+	i3c_hl_status_t status = i3c_hl_scan(s_pbus, present);
+
+	print_present(result, present);
+	return status;
+}
+
+// the address scan of i3c_scan before i3c_hl_scan: one frame per address, for comparison
+static i3c_hl_status_t op_scan_checkack(char *result)
+{
+	uint32_t present[4] = { 0 };
+
+	for (unsigned addr=0; addr<0x80; addr++)
+	{
+		if ( (addr != 0x7F) && (addr != 0x7C) && (addr != 0x7A) && (addr != 0x76) && (addr != 0x6E) && (addr != 0x5E) && (addr != 0x3E) )
+		{
+			if (i3c_hl_checkack(s_pbus, (uint8_t)addr) == i3c_hl_status_ok)
+				present[addr >> 5] |= 1ul << (addr & 31u);
+			sleep_us(10);
+		}
+	}
+	i3c_hl_arbhdronly(s_pbus);
+	print_present(result, present);
+	return i3c_hl_status_ok;
+}
+
+static i3c_hl_status_t op_write(const uint32_t *pargs, unsigned argc)
+{
+	uint8_t dat[MAX_ARGS];
+
+	for (unsigned i=1; i<argc; i++)
+		dat[i-1] = (uint8_t)pargs[i];
+	return i3c_hl_sdr_privwrite(s_pbus, (uint8_t)pargs[0], dat, argc - 1);
+}
+
+static i3c_hl_status_t op_read(const uint32_t *pargs, char *result)
+{
+	uint8_t         dat[1024];
+	uint32_t        len = (pargs[1] < sizeof(dat)) ? pargs[1] : sizeof(dat);
+	i3c_hl_status_t status = i3c_hl_sdr_privread(s_pbus, (uint8_t)pargs[0], dat, &len);
+
+	if (status == i3c_hl_status_ok)
+		print_bytes(result, dat, len);
+	return status;
+}
+
+static i3c_hl_status_t op_ccc(const uint32_t *pargs, unsigned argc)
+{
+	uint8_t dat[MAX_ARGS];
+
+	for (unsigned i=0; i<argc; i++)
+		dat[i] = (uint8_t)pargs[i];
+	return i3c_hl_sdr_ccc_broadcast_write(s_pbus, dat, argc);
+}
+
+static i3c_hl_status_t op_cccw(const uint32_t *pargs, unsigned argc)
+{
+	uint8_t ccc = (uint8_t)pargs[1], dat[MAX_ARGS];
+
+	for (unsigned i=2; i<argc; i++)
+		dat[i-2] = (uint8_t)pargs[i];
+	return i3c_hl_sdr_ccc_direct_write(s_pbus, &ccc, 1, (uint8_t)pargs[0], dat, argc - 2);
+}
+
+static i3c_hl_status_t op_cccr(const uint32_t *pargs, char *result)
+{
+	uint8_t         ccc = (uint8_t)pargs[1], dat[256];
+	uint32_t        len = (pargs[2] < sizeof(dat)) ? pargs[2] : sizeof(dat);
+	i3c_hl_status_t status = i3c_hl_sdr_ccc_direct_read(s_pbus, &ccc, 1, (uint8_t)pargs[0], dat, &len);
+
+	if (status == i3c_hl_status_ok)
+		print_bytes(result, dat, len);
+	return status;
+}
+
+static i3c_hl_status_t op_ddr_write(const uint32_t *pargs, unsigned argc, char *result)
+{
+	uint16_t        dat[MAX_ARGS];
+	uint32_t        count = argc - 2;
+	i3c_hl_status_t status;
+
+	for (unsigned i=2; i<argc; i++)
+		dat[i-2] = (uint16_t)pargs[i];
+	status = i3c_hl_ddr_write(s_pbus, (uint8_t)pargs[0], (uint8_t)pargs[1], dat, &count, s_ddr_restart, s_ddr_ack, s_ddr_earlyterm, s_ddr_crc);
+	sprintf(result, "%u words", (unsigned)count);
+	return status;
+}
+
+static i3c_hl_status_t op_ddr_read(const uint32_t *pargs, char *result)
+{
+	uint16_t        dat[1024];
+	uint32_t        count = (pargs[2] < 1024u) ? pargs[2] : 1024u;
+	i3c_hl_status_t status = i3c_hl_ddr_read(s_pbus, (uint8_t)pargs[0], (uint8_t)pargs[1], dat, &count, s_ddr_restart, s_ddr_crc);
+
+	if ( (status == i3c_hl_status_ok) || (status == i3c_hl_status_ddr_crc_wrong) || (status == i3c_hl_status_ddr_parity_wrong) )
+		print_words(result, dat, count);
+	return status;
+}
+
+static i3c_hl_status_t op_poll(uint32_t maxlen, char *result)
+{
+	uint8_t         dat[256];
+	uint32_t        len = (maxlen < sizeof(dat)) ? maxlen : sizeof(dat);
+	i3c_hl_status_t status = i3c_hl_poll(s_pbus, dat, &len);
+
+	if (status == i3c_hl_status_ok)
+		print_bytes(result, dat, len);
+	return status;
+}
+
+static i3c_hl_status_t op_ibi(const uint32_t *pargs, unsigned argc)
+{
+	uint8_t payload[I3CTARGET_IBI_PAYLOAD];
+	uint8_t len = 0;
+
+	for (unsigned i=2; (i<argc) && (len < sizeof(payload) - 1u); i++)
+		payload[len++] = (uint8_t)pargs[i];
+	return i3ctarget_ibi(&s_targets[pargs[0]], (uint8_t)pargs[1], payload, len) ? i3c_hl_status_ok : i3c_hl_status_param_outofrange;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// main
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// runs op "name[=v,v,...]", returns false on unknown ops or missing arguments
+static bool run_op(const char *op)
+{
+	char     name[32], result[RESULT_LEN];
+	uint32_t args[MAX_ARGS];
+	unsigned argc = 0;
+	const char *p = strchr(op, '=');
+	size_t   namelen = p ? (size_t)(p - op) : strlen(op);
+	uint64_t tstart;
+	i3c_hl_status_t status = i3c_hl_status_ok;
+
+	if (namelen >= sizeof(name))
+		return false;
+	memcpy(name, op, namelen);
+	name[namelen] = 0;
+	while ( p && (argc < MAX_ARGS) )
+	{
+		char *end;
+		args[argc++] = (uint32_t)strtoul(p + 1, &end, 0);
+		p = (*end == ',') ? end : NULL;
+	}
+
+	tstart = time_us_64();
+	result[0] = 0;
+	if      (strcmp(name, "rstdaa") == 0)                        status = i3c_hl_rstdaa(s_pbus);
+	else if ( (strcmp(name, "entdaa") == 0) && (argc >= 1) )     status = op_entdaa((uint8_t)args[0], result);
+	else if (strcmp(name, "daa") == 0)                           status = op_daa(args, argc, result);
+	else if (strcmp(name, "scan") == 0)                          status = op_scan(result);
+	else if (strcmp(name, "scan_checkack") == 0)                 status = op_scan_checkack(result);
+	else if ( (strcmp(name, "write") == 0) && (argc >= 1) )      status = op_write(args, argc);
+	else if ( (strcmp(name, "read") == 0) && (argc >= 2) )       status = op_read(args, result);
+	else if ( (strcmp(name, "ccc") == 0) && (argc >= 1) )        status = op_ccc(args, argc);
+	else if ( (strcmp(name, "cccw") == 0) && (argc >= 2) )       status = op_cccw(args, argc);
+	else if ( (strcmp(name, "cccr") == 0) && (argc >= 3) )       status = op_cccr(args, result);
+	else if ( (strcmp(name, "ddr_config") == 0) && (argc >= 1) )
+	{
+		s_ddr_ack       = args[0] != 0;
+		s_ddr_earlyterm = (argc >= 2) && (args[1] != 0);
+		s_ddr_crc       = (argc >= 3) && (args[2] != 0);
+		s_ddr_restart   = (argc >= 4) && (args[3] != 0);
+	}
+	else if ( (strcmp(name, "ddr_write") == 0) && (argc >= 2) )  status = op_ddr_write(args, argc, result);
+	else if ( (strcmp(name, "ddr_read") == 0) && (argc >= 3) )   status = op_ddr_read(args, result);
+	else if (strcmp(name, "hdrexit") == 0)                       status = i3c_hl_hdrexit(s_pbus);
+	else if ( (strcmp(name, "poll") == 0) && (argc >= 1) )       status = op_poll(args[0], result);
+	else if ( (strcmp(name, "ibi") == 0) && (argc >= 2) && (args[0] < s_targetcount) ) status = op_ibi(args, argc);
+	else if ( (strcmp(name, "hotjoin") == 0) && (argc >= 1) && (args[0] < s_targetcount) )
+		status = i3ctarget_hotjoin(&s_targets[args[0]]) ? i3c_hl_status_ok : i3c_hl_status_param_outofrange;
+	else if ( (strcmp(name, "fault_parity") == 0) && (argc >= 2) && (args[0] < s_targetcount) )
+		s_targets[args[0]].faults.ddr_parity_word = args[1];
+	else if ( (strcmp(name, "fault_crc") == 0) && (argc >= 1) && (args[0] < s_targetcount) )
+		s_targets[args[0]].faults.ddr_crc = true;
+	else if ( (strcmp(name, "dma") == 0) && (argc >= 2) )
+	{
+		i3c_hl_sdr_write_dma_enable(s_pbus, args[0] != 0);
+		i3c_hl_ddr_write_dma_enable(s_pbus, args[1] != 0);
+	}
+	else if ( (strcmp(name, "idle") == 0) && (argc >= 1) )       sleep_us(args[0]);
+	else
+		return false;
+	if (s_verbose)
+	{
+		printf("%-12s %10llu %8llu  %-28s %s\n", name, (unsigned long long)tstart, (unsigned long long)(time_us_64() - tstart),
+		       i3c_hl_get_errorstring(status), result);
+	}
+	return true;
+}
+
+static void print_stats(void)
+{
+	for (unsigned type=0; type<I3C_HL_STATS_TYPES; type++)
+	{
+		i3c_hl_stats_t stats;
+
+		i3c_hl_stats_get(s_pbus, (i3c_hl_stats_type_t)type, &stats);
+		if (stats.count == 0)
+			continue;
+		printf("%-18s %8u transfers, data %u, NAK %u, IBI %u, parity/CRC %u, early terminated %u, max %u us, busy %llu us\n",
+		       i3c_hl_stats_typename((i3c_hl_stats_type_t)type), (unsigned)stats.count, (unsigned)stats.data, (unsigned)stats.nak,
+		       (unsigned)stats.ibi, (unsigned)stats.parity_crc, (unsigned)stats.early_term, (unsigned)stats.max_us,
+		       (unsigned long long)stats.busy_us);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *defaultops[] = { "write=0x08,0x00,0x55" };
+	const char    **ops = defaultops;
+	int             opcount = (int)(sizeof(defaultops)/sizeof(defaultops[0]));
+	uint32_t        freq_khz = 12500, sysclk_khz = 125000, loops = 1;
+	unsigned        gpio = 0, sm = 0;
+	const char     *vcdfile = NULL;
+	piosim_t       *ps;
+	struct timespec t0, t1;
+	uint64_t        simstart_ns;
+	double          host_us;
+	int             opt;
+
+	while ( (opt = getopt(argc, argv, "f:s:g:m:n:o:t:")) != -1 )
+	{
+		switch (opt)
+		{
+			case 'f': freq_khz   = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 's': sysclk_khz = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'g': gpio       = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'm': sm         = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'n': loops      = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'o': vcdfile    = optarg;                             break;
+			case 't':
+				if (!i3ctarget_config_add(s_targetcfg, MAX_TARGETS, &s_targetcount, optarg))
+				{
+					fprintf(stderr, "invalid target: %s\n", optarg);
+					return 1;
+				}
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-f i3c_khz] [-s sysclk_khz] [-g gpiobase] [-m sm] [-n loops] [-o trace.vcd] [-t target]... [op]...\n", argv[0]);
+				return 1;
+		}
+	}
+	if ( (freq_khz == 0) || (freq_khz > 12500u) || (sysclk_khz == 0) || (gpio + 1u >= NUM_BANK0_GPIOS) || (sm >= NUM_PIO_STATE_MACHINES) || (loops == 0) )
+	{
+		fprintf(stderr, "parameter out of range\n");
+		return 1;
+	}
+	if (optind < argc)
+	{
+		ops = (const char **)&argv[optind];
+		opcount = argc - optind;
+	}
+
+	i3c_hal_host_init(sysclk_khz);
+	ps = i3c_hal_host_sim();
+	for (unsigned i=0; i<s_targetcount; i++)
+		i3ctarget_attach(&s_targets[i], ps, gpio, &s_targetcfg[i]);
+	piosim_vcd_pin(ps, gpio, "SDA");
+	piosim_vcd_pin(ps, gpio + 1u, "SCL");
+	piosim_vcd_sm(ps, 0, sm);
+	piosim_vcd_sm(ps, 1, sm);
+	if ( vcdfile && !piosim_vcd_open(ps, vcdfile) )
+	{
+		fprintf(stderr, "cannot create %s\n", vcdfile);
+		return 1;
+	}
+	s_pbus = i3c_hl_bus(0);
+	if ( (i3c_init(s_pbus, (uint8_t)sm, (uint8_t)gpio) != i3c_hl_status_ok) ||
+	     (i3c_hl_set_clkrate(s_pbus, freq_khz) != i3c_hl_status_ok) )
+	{
+		fprintf(stderr, "i3c_init failed\n");
+		return 1;
+	}
+
+	printf("%-12s %10s %8s  %-28s %s\n", "op", "start_us", "time_us", "status", "result");
+	simstart_ns = piosim_time_ns(ps);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (uint32_t loop=0; loop<loops; loop++)
+	{
+		s_verbose = (loop == 0);
+		for (int i=0; i<opcount; i++)
+		{
+			if (!run_op(ops[i]))
+			{
+				fprintf(stderr, "unknown op or missing arguments: %s\n", ops[i]);
+				return 1;
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	host_us = (double)(t1.tv_sec - t0.tv_sec) * 1e6 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e3;
+
+	printf("%u passes: simulated %.1f us, host %.1f us (%.1f us simulated per host ms)\n", (unsigned)loops,
+	       (double)(piosim_time_ns(ps) - simstart_ns) / 1e3, host_us, (double)(piosim_time_ns(ps) - simstart_ns) / host_us);
+	print_stats();
+	i3ctarget_print_stats(stdout, s_targets, s_targetcount);
+	piosim_vcd_close(ps);
+	return 0;
+}
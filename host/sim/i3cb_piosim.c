@@ -0,0 +1,982 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Runs the instruction words i3c_hl feeds into the state machines against the programs of src/i3c.pio in the PIO
+ * simulator (piosim.h), to check changes of the programs and to measure the bus timing without hardware:
+ *
+ *   i3cb_piosim [-f i3c_khz] [-s sysclk_khz] [-g gpiobase] [-m sm] [-o trace.vcd] [-t target]... [step]...
+ *
+ * -t attaches a target model (i3ctarget.h), up to 4: "ADDR[,key=value]...", ADDR is the dynamic address (0: none, to
+ * be assigned by ENTDAA). Keys: pid, bcr, dcr, ddr (0: none, 10: V1.0, 11: V1.1), ack (V1.1 ACK of written words),
+ * limit (V1.1 early termination request after this many written words), crc (V1.1 CRC word after an early
+ * termination), mrl, mwl.
+ *
+ * The steps run in the given order, each until the state machine waits for its next instruction word again:
+ *   start, restart, stop      START / RESTART / STOP condition
+ *   arbhdr                    open drain 0x7E/W incl. ACK, or the address of an IBI winning the arbitration
+ *   addr=A[,R]                push pull address A with RnW bit R incl. ACK
+ *   write=B,...               SDR data bytes streamed back to back like the DMA write engine (joined TX FIFO)
+ *   writecpu=B,...            SDR data bytes one by one like the per byte mode
+ *   read=N                    SDR read of up to N bytes
+ *   entdaa=A                  ENTDAA assigning address A to the target winning the arbitration, like i3c_hl_entdaa
+ *   poll=N                    read an IBI or Hot-Join request of up to N bytes like i3c_hl_poll
+ *   ddr_config=ACK,ET,CRC     HDR-DDR framing like the i3c_ddr_config command: ACK of the first written word, early
+ *                             write termination requests, CRC word after early terminations. Default: all 0 (V1.0)
+ *   ddr_write=A,CMD,W,...     HDR-DDR command, data and CRC words. Send ENTHDR0 before
+ *   ddr_read=A,CMD,N          HDR-DDR command and up to N data words incl. CRC or early termination
+ *   hdrrestart                HDR restart pattern between two HDR-DDR transfers. After a NAK the bus needs hdrexit
+ *   hdrexit                   HDR exit pattern, back to the SDR state machine
+ *   idle=NS                   keep the bus idle
+ *   ibi=T,MDB[,B,...]         target T (index of -t) raises an IBI with MDB and payload
+ *   hotjoin=T                 target T raises a Hot-Join request
+ *   fault_parity=T,N          target T sends read word N (1 = first) of its next HDR-DDR read with wrong parity
+ *   fault_crc=T               target T sends its next HDR-DDR CRC word with a wrong CRC
+ * Without steps a private write of 0x00 0x55 to 0x08 runs.
+ *
+ * Printed are start, duration, SCL clocks and result per step, at the end the measured bus timing: SCL period, high
+ * and low times and the minimum times between SDA changes and SCL edges (setup: SDA change -> next SCL edge, hold:
+ * SCL edge -> next SDA change). Both SCL edges count, as HDR-DDR transfers data on both. Then per target its address
+ * and the errors it detected.
+ * Without target everything gets NAKed and reads return 1s. The VCD trace (-o) contains SDA and SCL incl. the output
+ * enables and the PCs of both state machines of the bus.
+ *
+ * example, ENTDAA, IBI and a HDR-DDR write and read back with a V1.1 target:
+ *   i3cb_piosim -t 0,pid=0x0123456789ab entdaa=0x08 ibi=0,0xa5,1,2 idle=2000 poll=8 start arbhdr writecpu=0x20
+ *               ddr_config=1,0,0 ddr_write=0x08,0x05,0x1234,0x5678 hdrrestart ddr_read=0x08,0x05,8 hdrexit
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include "piosim.h"
+#include "i3ctarget.h"
+#include "i3c.pio.h"
+
+#define FSTAT_RXEMPTY(sm)    (1u << (8u + (sm)))
+#define FSTAT_TXFULL(sm)     (1u << (16u + (sm)))
+#define FSTAT_TXEMPTY(sm)    (1u << (24u + (sm)))
+#define SHIFTCTRL_AUTOPUSH   (1u << 16)
+#define SHIFTCTRL_OUT_RIGHT  (1u << 19)
+#define SHIFTCTRL_PUSH_LSB   (20u)
+#define SHIFTCTRL_FJOIN_TX   (1u << 30)
+#define SHIFTCTRL_FJOIN_RX   (1u << 31)
+#define GPIO_STATUS_OUTTOPAD (1u << 9)
+#define GPIO_STATUS_OETOPAD  (1u << 13)
+#define GPIO_STATUS_INFROMPAD (1u << 17)
+#define POLL_LIMIT           (1u << 22)  // register polls before a wait is reported as hang
+#define MAX_TARGETS          (4)
+
+// bus timing collected by a passive device on SDA and SCL
+typedef struct
+{
+	uint32_t sda, scl;          // pin masks
+	uint64_t scl_edges;         // rising SCL edges
+	uint64_t last_rise, last_fall, last_scl, last_sda;
+	bool     sda_since_scl;     // SDA changed since the last SCL edge
+	bool     scl_since_sda;     // SCL toggled since the last SDA change
+	uint64_t period_min, high_min, low_min, setup_min, hold_min;
+	uint64_t setup_at, hold_at; // cycle of the minimum setup / hold time
+} monitor_t;
+
+static piosim_t        s_sim;
+static piosim_device_t s_mondev;
+static monitor_t       s_mon;
+static unsigned        s_sm;
+static unsigned        s_gpio;
+static bool            s_ddr;       // pins at the HDR-DDR state machine
+static uint32_t        s_pinctrl;   // PINCTRL of both state machines
+static uint32_t        s_shiftctrl; // SHIFTCTRL of the SDR state machine without push threshold
+static uint8_t         s_arbcode = 0xfc;       // address of an IBI won the arbitration in arbhdr, 0xfc: none
+static bool            s_ddr_ack, s_ddr_earlyterm, s_ddr_crc; // ddr_config
+static i3ctarget_t     s_targets[MAX_TARGETS];
+static i3ctarget_config_t s_targetcfg[MAX_TARGETS];
+static unsigned        s_targetcount;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// register access like i3c_hl
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t pio_reg(bool ddr, uint32_t offset)
+{
+	return (ddr ? PIOSIM_PIO1_BASE : PIOSIM_PIO0_BASE) + offset;
+}
+
+static uint32_t sm_reg(bool ddr, uint32_t sm0offset)
+{
+	return pio_reg(ddr, sm0offset + s_sm*PIOSIM_SM_STRIDE);
+}
+
+static uint32_t rd(uint32_t addr)
+{
+	return piosim_read32(&s_sim, addr);
+}
+
+static void wr(uint32_t addr, uint32_t value)
+{
+	piosim_write32(&s_sim, addr, value);
+}
+
+static void poll_check(uint32_t *ppolls, const char *what)
+{
+	if (++(*ppolls) > POLL_LIMIT)
+	{
+		fprintf(stderr, "state machine hangs while waiting for %s (pio%u sm%u pc %u)\n", what, s_ddr ? 1u : 0u, s_sm,
+		        (unsigned)rd(sm_reg(s_ddr, PIOSIM_SM0_ADDR)));
+		exit(1);
+	}
+}
+
+static void put32(uint32_t data)
+{
+	uint32_t polls = 0;
+
+	while (rd(pio_reg(s_ddr, PIOSIM_FSTAT)) & FSTAT_TXFULL(s_sm))
+		poll_check(&polls, "TX FIFO space");
+	wr(pio_reg(s_ddr, PIOSIM_TXF0 + 4u*s_sm), data);
+}
+
+static uint32_t get32(void)
+{
+	uint32_t polls = 0;
+
+	while (rd(pio_reg(s_ddr, PIOSIM_FSTAT)) & FSTAT_RXEMPTY(s_sm))
+		poll_check(&polls, "RX FIFO data");
+	return rd(pio_reg(s_ddr, PIOSIM_RXF0 + 4u*s_sm));
+}
+
+static void wait_tx_empty(void)
+{
+	uint32_t polls = 0;
+
+	while ((rd(pio_reg(s_ddr, PIOSIM_FSTAT)) & FSTAT_TXEMPTY(s_sm)) == 0)
+		poll_check(&polls, "an empty TX FIFO");
+}
+
+static void wait_idle(void)
+{
+	uint32_t polls = 0;
+
+	while (rd(sm_reg(s_ddr, PIOSIM_SM0_ADDR)) != 0)
+		poll_check(&polls, "the first PULL");
+}
+
+static void set_autopush(uint8_t bitcount)
+{
+	wr(sm_reg(s_ddr, PIOSIM_SM0_SHIFTCTRL), s_shiftctrl | ((uint32_t)(bitcount & 0x1fu) << SHIFTCTRL_PUSH_LSB));
+}
+
+static void set_autopush_bitrev(uint8_t bitcount)
+{
+	wr(sm_reg(s_ddr, PIOSIM_SM0_SHIFTCTRL), (s_shiftctrl | ((uint32_t)(bitcount & 0x1fu) << SHIFTCTRL_PUSH_LSB)) & ~SHIFTCTRL_OUT_RIGHT);
+}
+
+// hand the pins over between the state machines, see i3c_pio_select
+static void pio_select(bool ddr)
+{
+	uint32_t pins = 0, pindirs = 0;
+
+	if (s_ddr == ddr)
+		return;
+	wait_tx_empty();
+	wait_idle();
+	for (unsigned i=0; i<2; i++)
+	{
+		uint32_t status = rd(PIOSIM_IO_BANK0_BASE + PIOSIM_GPIO_STATUS(s_gpio + i));
+		pins    |= ((status & GPIO_STATUS_OUTTOPAD) ? 1u : 0u) << i;
+		pindirs |= ((status & GPIO_STATUS_OETOPAD)  ? 1u : 0u) << i;
+	}
+	uint32_t clkdiv = rd(sm_reg(ddr, PIOSIM_SM0_CLKDIV));
+	wr(sm_reg(ddr, PIOSIM_SM0_CLKDIV), 1u << 16);
+	wr(sm_reg(ddr, PIOSIM_SM0_PINCTRL), (2u << 26) | (s_gpio << 5));
+	wr(sm_reg(ddr, PIOSIM_SM0_INSTR), pio_encode_set(pio_pins, pins));
+	wr(sm_reg(ddr, PIOSIM_SM0_INSTR), pio_encode_set(pio_pindirs, pindirs));
+	wr(sm_reg(ddr, PIOSIM_SM0_PINCTRL), s_pinctrl);
+	wr(sm_reg(ddr, PIOSIM_SM0_CLKDIV), clkdiv);
+	wr(PIOSIM_IO_BANK0_BASE + PIOSIM_GPIO_CTRL(s_gpio),     ddr ? PIOSIM_FUNCSEL_PIO1 : PIOSIM_FUNCSEL_PIO0);
+	wr(PIOSIM_IO_BANK0_BASE + PIOSIM_GPIO_CTRL(s_gpio + 1), ddr ? PIOSIM_FUNCSEL_PIO1 : PIOSIM_FUNCSEL_PIO0);
+	s_ddr = ddr;
+}
+
+// load both programs and set up the state machines of the bus, see i3c_init and i3c_hl_set_clkrate
+static void bus_init(uint32_t freq_khz)
+{
+	uint32_t clkdiv = (uint32_t)(((uint64_t)s_sim.sysclk_khz * 65536u) / (10u * freq_khz)); // an SDR bit takes 10 PIO cycles
+	uint32_t clkdiv1 = 1u << 16;
+
+	for (unsigned i=0; i<sizeof(i3c_program_instructions)/sizeof(i3c_program_instructions[0]); i++)
+		wr(pio_reg(false, PIOSIM_INSTR_MEM0 + 4u*i), i3c_program_instructions[i]);
+	for (unsigned i=0; i<sizeof(i3c_ddr_program_instructions)/sizeof(i3c_ddr_program_instructions[0]); i++)
+		wr(pio_reg(true, PIOSIM_INSTR_MEM0 + 4u*i), i3c_ddr_program_instructions[i]);
+
+	s_pinctrl = (1u << 26) | (s_gpio << 5) | (1u << 20) | (s_gpio << 0) | (s_gpio << 15) | (2u << 29) | ((s_gpio + 1u) << 10);
+	s_shiftctrl = SHIFTCTRL_OUT_RIGHT | SHIFTCTRL_AUTOPUSH;
+
+	wr(sm_reg(true, PIOSIM_SM0_CLKDIV), clkdiv1);
+	wr(sm_reg(true, PIOSIM_SM0_PINCTRL), s_pinctrl);
+	wr(sm_reg(true, PIOSIM_SM0_EXECCTRL), (i3c_ddr_wrap << 12) | (i3c_ddr_wrap_target << 7) | (1u << 30) | (s_gpio << 24));
+	wr(sm_reg(true, PIOSIM_SM0_SHIFTCTRL), SHIFTCTRL_AUTOPUSH);
+	wr(sm_reg(true, PIOSIM_SM0_INSTR), pio_encode_jmp(0));
+	wr(pio_reg(true, PIOSIM_CTRL + PIOSIM_ALIAS_SET), 1u << s_sm);
+	wr(pio_reg(true, PIOSIM_INPUT_SYNC_BYPASS + PIOSIM_ALIAS_SET), 3u << s_gpio);
+
+	wr(sm_reg(false, PIOSIM_SM0_INSTR), pio_encode_jmp(0));
+	wr(sm_reg(false, PIOSIM_SM0_CLKDIV), clkdiv1);
+	wr(sm_reg(false, PIOSIM_SM0_PINCTRL), (1u << 26) | ((s_gpio + 1u) << 5) | (2u << 20) | (s_gpio << 0) | (s_gpio << 15) |
+	                                      (2u << 29) | ((s_gpio + 1u) << 10));
+	wr(PIOSIM_IO_BANK0_BASE + PIOSIM_GPIO_CTRL(s_gpio),     PIOSIM_FUNCSEL_PIO0);
+	wr(PIOSIM_IO_BANK0_BASE + PIOSIM_GPIO_CTRL(s_gpio + 1), PIOSIM_FUNCSEL_PIO0);
+	wr(sm_reg(false, PIOSIM_SM0_EXECCTRL), (i3c_wrap << 12) | (i3c_wrap_target << 7) | (1u << 30) | (s_gpio << 24));
+	wr(sm_reg(false, PIOSIM_SM0_SHIFTCTRL), s_shiftctrl);
+	wr(pio_reg(false, PIOSIM_CTRL + PIOSIM_ALIAS_SET), 1u << s_sm);
+	wr(pio_reg(false, PIOSIM_INPUT_SYNC_BYPASS + PIOSIM_ALIAS_SET), 3u << s_gpio);
+	put32(I3CPIO_OPCODE_SETDIR_SCLSDA_SCLHIGH(1, 0));
+	// the OUT PINDIRS of SCL has to run before OUT_COUNT gets reduced to SDA, like in i3c_init
+	wait_tx_empty();
+	wait_idle();
+	wr(sm_reg(false, PIOSIM_SM0_PINCTRL), s_pinctrl);
+	s_ddr = false;
+
+	wr(sm_reg(false, PIOSIM_SM0_CLKDIV), clkdiv);
+	wr(sm_reg(true, PIOSIM_SM0_CLKDIV), clkdiv);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// bus timing monitor
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static void min_update(uint64_t *pmin, uint64_t value)
+{
+	if (value < *pmin)
+		*pmin = value;
+}
+
+static void monitor_update(piosim_t *ps, piosim_device_t *pdev, uint32_t levels, uint32_t changed)
+{
+	monitor_t *pm = (monitor_t *)pdev->ctx;
+	uint64_t   now = ps->cycle;
+
+	if (changed & pm->scl)
+	{
+		if (levels & pm->scl)
+		{
+			if (pm->last_rise != UINT64_MAX)
+				min_update(&pm->period_min, now - pm->last_rise);
+			if (pm->last_fall != UINT64_MAX)
+				min_update(&pm->low_min, now - pm->last_fall);
+			pm->last_rise = now;
+			pm->scl_edges++;
+		}
+		else
+		{
+			if (pm->last_rise != UINT64_MAX)
+				min_update(&pm->high_min, now - pm->last_rise);
+			pm->last_fall = now;
+		}
+		if ( pm->sda_since_scl && (now - pm->last_sda < pm->setup_min) )
+		{
+			pm->setup_min = now - pm->last_sda;
+			pm->setup_at  = now;
+		}
+		pm->last_scl = now;
+		pm->sda_since_scl = false;
+		pm->scl_since_sda = true;
+	}
+	if (changed & pm->sda)
+	{
+		if ( pm->scl_since_sda && (now - pm->last_scl < pm->hold_min) )
+		{
+			pm->hold_min = now - pm->last_scl;
+			pm->hold_at  = now;
+		}
+		pm->last_sda = now;
+		pm->sda_since_scl = true;
+		pm->scl_since_sda = false;
+	}
+}
+
+static void monitor_attach(void)
+{
+	memset(&s_mon, 0, sizeof(s_mon));
+	s_mon.sda = 1u << s_gpio;
+	s_mon.scl = 1u << (s_gpio + 1u);
+	s_mon.last_rise = s_mon.last_fall = UINT64_MAX;
+	s_mon.period_min = s_mon.high_min = s_mon.low_min = s_mon.setup_min = s_mon.hold_min = UINT64_MAX;
+	piosim_attach(&s_sim, &s_mondev, monitor_update, &s_mon);
+}
+
+static void print_ns(const char *name, uint64_t cycles)
+{
+	if (cycles == UINT64_MAX)
+		printf("%s -", name);
+	else
+		printf("%s %llu ns", name, (unsigned long long)piosim_cycles_to_ns(&s_sim, cycles));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// steps, same instruction words as i3c_hl
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// CRC5 of I3C HDR-DDR (x^5 + x^2 + 1, MSB first) over a 16 bit word
+static uint8_t crc5(uint8_t crc, uint16_t data)
+{
+	for (int bit=15; bit>=0; bit--)
+	{
+		uint8_t feedback = (uint8_t)(((crc >> 4) ^ (data >> bit)) & 1u);
+		crc = (uint8_t)((crc << 1) & 0x1fu);
+		if (feedback)
+			crc ^= 0x05u;
+	}
+	return crc;
+}
+
+static uint32_t ddr_parity(uint16_t data)
+{
+	return ((uint32_t)__builtin_parity(data & 0xaaaau) << 1) | ((uint32_t)__builtin_parity(data & 0x5555u) ^ 1u);
+}
+
+static void step_start(char *result)
+{
+	pio_select(false);
+	put32(I3CPIO_OPCODE_START);
+	result[0] = 0;
+}
+
+static void step_restart(char *result)
+{
+	put32(I3CPIO_OPCODE_SCL0_SDA1);
+	put32(I3CPIO_OPCODE_SDADRIVE_WAIT4);
+	put32(I3CPIO_OPCODE_SCL1_WAIT4);
+	put32(I3CPIO_OPCODE_SDA0_WAIT4);
+	put32(I3CPIO_OPCODE_SCL0);
+	result[0] = 0;
+}
+
+static void step_stop(char *result)
+{
+	put32(I3CPIO_OPCODE_SCL0_SDA0);
+	put32(I3CPIO_OPCODE_SDADRIVE_WAIT4);
+	put32(I3CPIO_OPCODE_SCL1_WAIT2);
+	put32(I3CPIO_OPCODE_SDARELEASE);
+	result[0] = 0;
+}
+
+static void step_arbhdr(char *result)
+{
+	uint32_t data0, data1;
+
+	wait_tx_empty();
+	set_autopush(6);
+	put32(I3CPIO_OPCODE_XFER(6, OD_WBIT(1), OD_WBIT(1), OD_WBIT(1), OD_WBIT(1), OD_WBIT(1), OD_WBIT(1)));
+	put32(I3CPIO_OPCODE_SCL0);
+	data0 = get32();
+	set_autopush(3);
+	if (data0 == 0x3fu)
+	{
+		put32(I3CPIO_OPCODE_XFER(3, OD_WBIT(0), OD_WBIT(0), OD_RACKBIT, 0, 0, 0));
+		put32(I3CPIO_OPCODE_SCL0);
+		data1 = get32();
+		strcpy(result, (data1 & 1u) ? "NAK" : "ACK");
+	}
+	else
+	{
+		put32(I3CPIO_OPCODE_XFER(3, OD_WBIT(1), OD_WBIT(1), OD_WBIT(0), 0, 0, 0));
+		put32(I3CPIO_OPCODE_SCL0);
+		data1 = get32();
+		s_arbcode = (uint8_t)((data0 << 2) | (data1 >> 1));
+		sprintf(result, "IBI arbitration 0x%02x", (unsigned)s_arbcode);
+	}
+}
+
+// push pull address byte incl. RnW, returns true on ACK
+static bool sdr_write_addr(uint8_t value)
+{
+	wait_tx_empty();
+	set_autopush(9);
+	put32(I3CPIO_OPCODE_XFER(6, SDR_WBIT((value>>7)&1), SDR_WBIT((value>>6)&1), SDR_WBIT((value>>5)&1), SDR_WBIT((value>>4)&1), SDR_WBIT((value>>3)&1), SDR_WBIT((value>>2)&1)));
+	put32(I3CPIO_OPCODE_XFER(3, SDR_WBIT((value>>1)&1), SDR_WBIT((value>>0)&1), OD_RACKBIT, 0, 0, 0));
+	put32(I3CPIO_OPCODE_SCL0);
+	return (get32() & 1u) == 0;
+}
+
+static void step_addr(const uint32_t *pargs, unsigned argc, char *result)
+{
+	uint8_t value = (uint8_t)(((pargs[0] & 0x7fu) << 1) | ((argc > 1) ? (pargs[1] & 1u) : 0u));
+
+	strcpy(result, sdr_write_addr(value) ? "ACK" : "NAK");
+}
+
+static uint32_t wdata_word(uint8_t value, unsigned index)
+{
+	uint8_t tbit = (uint8_t)(__builtin_parity(value) ^ 1);
+
+	if (index == 0)
+		return I3CPIO_OPCODE_XFER(6, SDR_WBIT((value>>7)&1), SDR_WBIT((value>>6)&1), SDR_WBIT((value>>5)&1), SDR_WBIT((value>>4)&1), SDR_WBIT((value>>3)&1), SDR_WBIT((value>>2)&1));
+	return I3CPIO_OPCODE_XFER(3, SDR_WBIT((value>>1)&1), SDR_WBIT((value>>0)&1), SDR_WBIT(tbit), 0, 0, 0);
+}
+
+// the DMA writes a word as soon as the joined TX FIFO has space, like put32
+static void step_write(const uint32_t *pargs, unsigned argc, char *result)
+{
+	wait_tx_empty();
+	wait_idle();
+	wr(sm_reg(false, PIOSIM_SM0_SHIFTCTRL), s_shiftctrl | SHIFTCTRL_FJOIN_TX);
+	for (unsigned i=0; i<argc; i++)
+	{
+		put32(wdata_word((uint8_t)pargs[i], 0));
+		put32(wdata_word((uint8_t)pargs[i], 1));
+	}
+	put32(I3CPIO_OPCODE_SCL0);
+	wait_tx_empty();
+	wait_idle();
+	set_autopush(9);
+	wr(sm_reg(false, PIOSIM_SM0_INSTR), pio_encode_mov(pio_isr, pio_null));
+	sprintf(result, "%u bytes", argc);
+}
+
+static void step_writecpu(const uint32_t *pargs, unsigned argc, char *result)
+{
+	for (unsigned i=0; i<argc; i++)
+	{
+		wait_tx_empty();
+		set_autopush(9);
+		put32(wdata_word((uint8_t)pargs[i], 0));
+		put32(wdata_word((uint8_t)pargs[i], 1));
+		put32(I3CPIO_OPCODE_SCL0);
+		get32();
+	}
+	sprintf(result, "%u bytes", argc);
+}
+
+// SDR read until the T-bit ends the data or maxlen bytes are read, returns the count of bytes
+static uint32_t sdr_read_bytes(uint8_t *pdat, uint32_t maxlen)
+{
+	uint32_t count = 0;
+	bool     done = (maxlen == 0);
+
+	if (done)
+		return 0;
+	wait_tx_empty();
+	set_autopush(9);
+	put32(I3CPIO_OPCODE_READ_BYTES(maxlen));
+	while (!done)
+	{
+		uint32_t value = get32();
+		pdat[count++] = (uint8_t)(value >> 1);
+		done = ((value & 1u) == 0) || (count == maxlen);
+	}
+	return count;
+}
+
+static int print_bytes(char *result, const uint8_t *pdat, uint32_t count)
+{
+	int len = 0;
+
+	for (uint32_t i=0; (i<count) && (i<16); i++)
+		len += sprintf(result + len, " %02x", pdat[i]);
+	if (count > 16)
+		len += sprintf(result + len, " ... (%u bytes)", (unsigned)count);
+	return len;
+}
+
+static void step_read(uint32_t maxlen, char *result)
+{
+	static uint8_t data[65536];
+	uint32_t count;
+
+	if (maxlen > sizeof(data))
+		maxlen = sizeof(data);
+	count = sdr_read_bytes(data, maxlen);
+	print_bytes(result + sprintf(result, "data"), data, count);
+}
+
+// 8 open drain read bits and the ACK bit driven by the controller (ack) or not
+static uint8_t od_read(bool ack)
+{
+	wait_tx_empty();
+	set_autopush(9);
+	put32(I3CPIO_OPCODE_XFER(6, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT));
+	put32(I3CPIO_OPCODE_XFER(3, OD_RBIT, OD_RBIT, OD_WBIT(ack ? 0 : 1), 0, 0, 0));
+	put32(I3CPIO_OPCODE_SCL0);
+	return (uint8_t)(get32() >> 1);
+}
+
+// 8 open drain read bits without ACK, used for PID, BCR and DCR during ENTDAA
+static uint8_t od_read8(void)
+{
+	wait_tx_empty();
+	set_autopush(8);
+	put32(I3CPIO_OPCODE_XFER(6, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT));
+	put32(I3CPIO_OPCODE_XFER(2, OD_RBIT, OD_RBIT, 0, 0, 0, 0));
+	put32(I3CPIO_OPCODE_SCL0);
+	return (uint8_t)get32();
+}
+
+static bool sda_low(void)
+{
+	return (rd(PIOSIM_IO_BANK0_BASE + PIOSIM_GPIO_STATUS(s_gpio)) & GPIO_STATUS_INFROMPAD) == 0;
+}
+
+static void step_entdaa(uint8_t addr, char *result)
+{
+	char    scratch[256];
+	uint8_t id[8];
+
+	if (sda_low())
+	{
+		strcpy(result, "IBI pending");
+		return;
+	}
+	step_start(scratch);
+	step_arbhdr(result);
+	if (strcmp(result, "ACK") != 0)
+	{
+		if (s_arbcode == 0xfc) // an IBI is left for poll
+			step_stop(scratch);
+		return;
+	}
+	step_writecpu((const uint32_t[]){ 0x07 }, 1, scratch);
+	step_restart(scratch);
+	if (!sdr_write_addr((0x7eu << 1) | 1u))
+	{
+		strcpy(result, "no target without address");
+	}
+	else
+	{
+		for (unsigned i=0; i<8; i++)
+			id[i] = od_read8();
+		addr = (uint8_t)(addr << 1);
+		addr |= (uint8_t)(__builtin_parity(addr) ^ 1);
+		sprintf(result, "PID %02x%02x%02x%02x%02x%02x BCR %02x DCR %02x -> 0x%02x %s", id[0], id[1], id[2], id[3], id[4],
+		        id[5], id[6], id[7], addr >> 1, sdr_write_addr(addr) ? "ACK" : "NAK");
+	}
+	step_stop(scratch);
+}
+
+// IBI of an arbitration lost in arbhdr, or signalled by a target pulling SDA low
+static void step_poll(uint32_t maxlen, char *result)
+{
+	static uint8_t data[65536];
+	uint32_t count = 0;
+
+	if (maxlen > sizeof(data))
+		maxlen = sizeof(data);
+	if (s_arbcode != 0xfc)
+	{
+		if (maxlen > 0)
+		{
+			data[count++] = s_arbcode;
+			maxlen--;
+		}
+		count += sdr_read_bytes(&data[count], maxlen);
+		s_arbcode = 0xfc;
+	}
+	else if (sda_low())
+	{
+		uint8_t ibiword = od_read(true);
+
+		if (maxlen > 0)
+		{
+			data[count++] = ibiword;
+			maxlen--;
+		}
+		if (ibiword != 0x04) // Hot-Join has no data
+			count += sdr_read_bytes(&data[count], maxlen);
+	}
+	else
+	{
+		strcpy(result, "no IBI");
+		return;
+	}
+	step_stop(result);
+	print_bytes(result + sprintf(result, "IBI"), data, count);
+}
+
+static uint16_t ddr_command(uint8_t addr, uint8_t command, uint32_t *pparity)
+{
+	uint16_t dat = (uint16_t)(((uint16_t)addr << 1) | ((uint16_t)command << 8));
+
+	*pparity = ddr_parity(dat);
+	if ((*pparity & 1u) == 0) // PA0 forced to 1 for a faster turnaround
+	{
+		*pparity |= 1u;
+		dat ^= 1u;
+	}
+	return dat;
+}
+
+// word by word like i3c_hl_ddr_write, the preambles of the data words follow ddr_config
+static void step_ddr_write(const uint32_t *pargs, unsigned argc, char *result)
+{
+	uint32_t parity, words = 0;
+	uint16_t dat = ddr_command((uint8_t)pargs[0], (uint8_t)(pargs[1] & 0x7fu), &parity);
+	uint8_t  crc = crc5(0x1f, dat), prevcrc;
+	bool     nak = false, terminated = false;
+	int      len;
+
+	pio_select(true);
+	set_autopush_bitrev(19);
+	put32(DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits));
+	put32(DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, ((uint32_t)dat << 2) | parity));
+	get32();
+	for (unsigned i=2; (i<argc) && !nak && !terminated; i++)
+	{
+		uint32_t preamble;
+
+		if ( (i == 2) && s_ddr_ack )
+			preamble = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 0, 0, 18, i3c_ddr_offset_target_nacked, i3c_ddr_offset_cmd_write_bits);
+		else if ( (i > 2) && s_ddr_earlyterm )
+			preamble = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 0, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_target_nacked);
+		else
+			preamble = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 1, 1, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
+		dat = (uint16_t)pargs[i];
+		put32(preamble);
+		put32(DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, ((uint32_t)dat << 2) | ddr_parity(dat)));
+		prevcrc = crc;
+		crc = crc5(crc, dat);
+		if (get32() & 1u)
+		{
+			nak = (i == 2);
+			terminated = !nak;
+			crc = prevcrc;
+		}
+		else
+			words++;
+	}
+	if (nak)
+	{
+		strcpy(result, "NAK");
+		return;
+	}
+	len = sprintf(result, "%u words", (unsigned)words);
+	if (terminated)
+		len += sprintf(result + len, ", early termination");
+	if ( !terminated || s_ddr_crc )
+	{
+		set_autopush_bitrev(11);
+		put32(DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 10, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits));
+		put32(DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 10, (((0xcu << 5) | crc) << 1) | 1u));
+		get32();
+		sprintf(result + len, ", CRC 0x%02x", crc);
+	}
+}
+
+// reads the CRC word, returns the 13 bit result: preamble in bit 12..11, CRC in bit 6..2
+static uint32_t ddr_read_crc_word(void)
+{
+	set_autopush_bitrev(13);
+	put32(DDR_OPCODE_SET_X(5));
+	put32(DDR_HDR_OPCODE_READ_NEXTBIT);
+	return get32();
+}
+
+// first data word with ACK in the preamble, the following words streamed with cmd_read_word like i3c_ddr_read_dma
+static void step_ddr_read(const uint32_t *pargs, unsigned argc, char *result)
+{
+	uint32_t parity, pioretval, maxwords = (argc > 2) ? pargs[2] : 1u;
+	uint32_t words = 0, queued = 0;
+	uint16_t dat = ddr_command((uint8_t)pargs[0], (uint8_t)(pargs[1] | 0x80u), &parity);
+	uint8_t  crc = crc5(0x1f, dat);
+	bool     halted = false, crc_received = false;
+	int      len;
+
+	pio_select(true);
+	set_autopush_bitrev(19);
+	put32(DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits));
+	put32(DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, ((uint32_t)dat << 2) | parity));
+	get32();
+	put32(DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 0, 0, 18, i3c_ddr_offset_target_nacked, i3c_ddr_offset_cmd_write_bits));
+	put32(DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(0, 18, 0));
+	pioretval = get32();
+	if (pioretval & 1u)
+	{
+		strcpy(result, "NAK");
+		return;
+	}
+	dat = (uint16_t)(pioretval >> 3);
+	crc = crc5(crc, dat);
+	len = sprintf(result, "data %04x", dat);
+	if (((pioretval >> 1) & 3u) != ddr_parity(dat))
+		len += sprintf(result + len, " (parity error)");
+	words = 1;
+
+	set_autopush_bitrev(21);
+	while ( (words < maxwords) && !halted )
+	{
+		uint32_t fstat = rd(pio_reg(true, PIOSIM_FSTAT));
+
+		if ( ((fstat & FSTAT_TXFULL(s_sm)) == 0) && (words + queued < maxwords) )
+		{
+			wr(pio_reg(true, PIOSIM_TXF0 + 4u*s_sm), DDR_HDR_OPCODE_READ_WORD);
+			queued++;
+		}
+		else if ((fstat & FSTAT_RXEMPTY(s_sm)) == 0)
+		{
+			pioretval = rd(pio_reg(true, PIOSIM_RXF0 + 4u*s_sm));
+			queued--;
+			dat = (uint16_t)(pioretval >> 3);
+			crc = crc5(crc, dat);
+			words++;
+			if (words <= 8)
+				len += sprintf(result + len, " %04x", dat);
+			if (((pioretval >> 1) & 3u) != ddr_parity(dat))
+				len += sprintf(result + len, " (parity error)");
+			if ((pioretval >> 19) != 3u)
+				len += sprintf(result + len, " (invalid preamble)");
+		}
+		else
+		{
+			halted = rd(sm_reg(true, PIOSIM_SM0_ADDR)) == i3c_ddr_offset_target_nacked_halt;
+		}
+	}
+	if (words > 8)
+		len += sprintf(result + len, " ... (%u words)", (unsigned)words);
+
+	// flush queued instruction words, release a halted state machine and read the CRC word
+	wr(sm_reg(true, PIOSIM_SM0_SHIFTCTRL) | PIOSIM_ALIAS_XOR, SHIFTCTRL_FJOIN_RX);
+	wr(sm_reg(true, PIOSIM_SM0_SHIFTCTRL) | PIOSIM_ALIAS_XOR, SHIFTCTRL_FJOIN_RX);
+	set_autopush_bitrev(19);
+	if (halted)
+	{
+		wr(pio_reg(true, PIOSIM_IRQ_FORCE), 1u << s_sm);
+		put32(DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(0, 18, 0));
+		get32();
+		pioretval = ddr_read_crc_word();
+		crc_received = (pioretval >> 11) == 1u;
+		len += sprintf(result + len, crc_received ? ", CRC 0x%02x (%s)" : ", invalid CRC preamble",
+		               (unsigned)((pioretval >> 2) & 0x1fu), (((pioretval >> 2) & 0x1fu) == crc) ? "ok" : "wrong");
+	}
+	if (!crc_received)
+	{ // early termination by the controller
+		put32(DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 1, 0, 18, i3c_ddr_offset_target_nacked, i3c_ddr_offset_target_nacked));
+		put32(0);
+		get32();
+		len += sprintf(result + len, ", early terminated");
+		if (s_ddr_crc)
+		{ // the termination preamble leaves SDA driven low, release it for the CRC word of the target
+			put32(DDR_OPCODE_SDA_DIR(0));
+			pioretval = ddr_read_crc_word();
+			sprintf(result + len, ", CRC 0x%02x (%s)", (unsigned)((pioretval >> 2) & 0x1fu), (((pioretval >> 2) & 0x1fu) == crc) ? "ok" : "wrong");
+		}
+	}
+}
+
+static void step_ddr_config(const uint32_t *pargs, unsigned argc, char *result)
+{
+	s_ddr_ack       = pargs[0] != 0;
+	s_ddr_earlyterm = (argc > 1) && (pargs[1] != 0);
+	s_ddr_crc       = (argc > 2) && (pargs[2] != 0);
+	result[0] = 0;
+}
+
+// HDR restart like the finalize_with_restart of i3c_hl_ddr_write/read, the pins stay at the HDR-DDR state machine
+static void step_hdrrestart(char *result)
+{
+	if (s_ddr)
+	{
+		put32(DDR_OPCODE_SDA_DIR(1));
+		put32(DDR_OPCODE_SDA_PATTERN(5, 0x15));
+		put32(DDR_OPCODE_SCL1);
+		put32(DDR_OPCODE_SCL0);
+		put32(DDR_OPCODE_SDA_DIR(0));
+	}
+	result[0] = 0;
+}
+
+static void step_hdrexit(char *result)
+{
+	if (s_ddr)
+	{
+		put32(DDR_OPCODE_SDA_DIR(1));
+		put32(DDR_OPCODE_SDA_PATTERN(8, 0xaa));
+		put32(DDR_OPCODE_SCL0_WAIT7);
+		put32(DDR_OPCODE_SCL1_WAIT7);
+		put32(DDR_OPCODE_SDA_DIR(0));
+		pio_select(false);
+	}
+	result[0] = 0;
+}
+
+static void step_ibi(const uint32_t *pargs, unsigned argc, char *result)
+{
+	uint8_t payload[I3CTARGET_IBI_PAYLOAD];
+	uint8_t len = 0;
+
+	for (unsigned i=2; (i<argc) && (len < sizeof(payload)); i++)
+		payload[len++] = (uint8_t)pargs[i];
+	strcpy(result, i3ctarget_ibi(&s_targets[pargs[0]], (uint8_t)pargs[1], payload, len) ? "raised" : "refused");
+}
+
+static void step_hotjoin(unsigned target, char *result)
+{
+	strcpy(result, i3ctarget_hotjoin(&s_targets[target]) ? "raised" : "refused");
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// main
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// runs step "name[=v,v,...]", returns false on unknown steps or missing arguments
+static bool run_step(const char *step)
+{
+	char     name[32], result[256];
+	uint32_t args[512];
+	unsigned argc = 0;
+	const char *p = strchr(step, '=');
+	size_t   namelen = p ? (size_t)(p - step) : strlen(step);
+	uint64_t tstart, edges;
+
+	if (namelen >= sizeof(name))
+		return false;
+	memcpy(name, step, namelen);
+	name[namelen] = 0;
+	while ( p && (argc < sizeof(args)/sizeof(args[0])) )
+	{
+		char *end;
+		args[argc++] = (uint32_t)strtoul(p + 1, &end, 0);
+		p = (*end == ',') ? end : NULL;
+	}
+
+	tstart = s_sim.cycle;
+	edges  = s_mon.scl_edges;
+	result[0] = 0;
+	if      (strcmp(name, "start") == 0)                       step_start(result);
+	else if (strcmp(name, "restart") == 0)                     step_restart(result);
+	else if (strcmp(name, "stop") == 0)                        step_stop(result);
+	else if (strcmp(name, "arbhdr") == 0)                      step_arbhdr(result);
+	else if ( (strcmp(name, "addr") == 0) && (argc >= 1) )     step_addr(args, argc, result);
+	else if ( (strcmp(name, "write") == 0) && (argc >= 1) )    step_write(args, argc, result);
+	else if ( (strcmp(name, "writecpu") == 0) && (argc >= 1) ) step_writecpu(args, argc, result);
+	else if ( (strcmp(name, "read") == 0) && (argc >= 1) )     step_read(args[0], result);
+	else if ( (strcmp(name, "ddr_write") == 0) && (argc >= 2) ) step_ddr_write(args, argc, result);
+	else if ( (strcmp(name, "ddr_read") == 0) && (argc >= 2) ) step_ddr_read(args, argc, result);
+	else if ( (strcmp(name, "entdaa") == 0) && (argc >= 1) )   step_entdaa((uint8_t)args[0], result);
+	else if ( (strcmp(name, "poll") == 0) && (argc >= 1) )     step_poll(args[0], result);
+	else if ( (strcmp(name, "ddr_config") == 0) && (argc >= 1) ) step_ddr_config(args, argc, result);
+	else if (strcmp(name, "hdrrestart") == 0)                  step_hdrrestart(result);
+	else if (strcmp(name, "hdrexit") == 0)                     step_hdrexit(result);
+	else if ( (strcmp(name, "ibi") == 0) && (argc >= 2) && (args[0] < s_targetcount) ) step_ibi(args, argc, result);
+	else if ( (strcmp(name, "hotjoin") == 0) && (argc >= 1) && (args[0] < s_targetcount) ) step_hotjoin(args[0], result);
+	else if ( (strcmp(name, "fault_parity") == 0) && (argc >= 2) && (args[0] < s_targetcount) )
+		s_targets[args[0]].faults.ddr_parity_word = args[1];
+	else if ( (strcmp(name, "fault_crc") == 0) && (argc >= 1) && (args[0] < s_targetcount) )
+		s_targets[args[0]].faults.ddr_crc = true;
+	else if ( (strcmp(name, "idle") == 0) && (argc >= 1) )     piosim_step(&s_sim, ((uint64_t)args[0] * s_sim.sysclk_khz) / 1000000u);
+	else
+		return false;
+	if (!piosim_run_until_stalled(&s_sim, s_ddr ? 1u : 0u, 100000000u))
+	{
+		fprintf(stderr, "%s: state machine does not get idle\n", step);
+		exit(1);
+	}
+	printf("%-12s %10llu %10llu %6llu  %s\n", name, (unsigned long long)piosim_cycles_to_ns(&s_sim, tstart),
+	       (unsigned long long)piosim_cycles_to_ns(&s_sim, s_sim.cycle - tstart), (unsigned long long)(s_mon.scl_edges - edges), result);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *defaultsteps[] = { "start", "arbhdr", "restart", "addr=0x08", "write=0x00,0x55", "stop" };
+	uint32_t    freq_khz = 12500, sysclk_khz = 125000;
+	const char *vcdfile = NULL;
+	int         opt;
+
+	while ( (opt = getopt(argc, argv, "f:s:g:m:o:t:")) != -1 )
+	{
+		switch (opt)
+		{
+			case 'f': freq_khz   = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 's': sysclk_khz = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'g': s_gpio     = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'm': s_sm       = (unsigned)strtoul(optarg, NULL, 0); break;
+			case 'o': vcdfile    = optarg;                             break;
+			case 't':
+				if (!i3ctarget_config_add(s_targetcfg, MAX_TARGETS, &s_targetcount, optarg))
+				{
+					fprintf(stderr, "invalid target: %s\n", optarg);
+					return 1;
+				}
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-f i3c_khz] [-s sysclk_khz] [-g gpiobase] [-m sm] [-o trace.vcd] [-t target]... [step]...\n", argv[0]);
+				return 1;
+		}
+	}
+	if ( (freq_khz == 0) || (freq_khz > 12500u) || (sysclk_khz == 0) || (s_gpio + 1u >= PIOSIM_NUM_GPIOS) || (s_sm >= PIOSIM_NUM_SMS) )
+	{
+		fprintf(stderr, "parameter out of range\n");
+		return 1;
+	}
+
+	piosim_init(&s_sim, sysclk_khz);
+	monitor_attach();
+	for (unsigned i=0; i<s_targetcount; i++)
+		i3ctarget_attach(&s_targets[i], &s_sim, s_gpio, &s_targetcfg[i]);
+	piosim_vcd_pin(&s_sim, s_gpio, "SDA");
+	piosim_vcd_pin(&s_sim, s_gpio + 1u, "SCL");
+	piosim_vcd_sm(&s_sim, 0, s_sm);
+	piosim_vcd_sm(&s_sim, 1, s_sm);
+	if ( vcdfile && !piosim_vcd_open(&s_sim, vcdfile) )
+	{
+		fprintf(stderr, "cannot create %s\n", vcdfile);
+		return 1;
+	}
+	bus_init(freq_khz);
+
+	printf("%-12s %10s %10s %6s  %s\n", "step", "start_ns", "time_ns", "clocks", "result");
+	if (optind < argc)
+	{
+		for (int i=optind; i<argc; i++)
+		{
+			if (!run_step(argv[i]))
+			{
+				fprintf(stderr, "unknown step or missing arguments: %s\n", argv[i]);
+				return 1;
+			}
+		}
+	}
+	else
+	{
+		for (unsigned i=0; i<sizeof(defaultsteps)/sizeof(defaultsteps[0]); i++)
+			run_step(defaultsteps[i]);
+	}
+	piosim_step(&s_sim, 16); // let the last edges settle in the trace
+
+	print_ns("SCL: period min", s_mon.period_min);
+	if (s_mon.period_min != UINT64_MAX)
+		printf(" (%.1f kHz)", 1e6 / (double)piosim_cycles_to_ns(&s_sim, s_mon.period_min));
+	print_ns(", high min", s_mon.high_min);
+	print_ns(", low min", s_mon.low_min);
+	print_ns("\nSDA: setup min", s_mon.setup_min);
+	print_ns(" at", s_mon.setup_at);
+	print_ns(", hold min", s_mon.hold_min);
+	print_ns(" at", s_mon.hold_at);
+	printf("\ncontention: %llu cycles\n", (unsigned long long)s_sim.contention);
+	i3ctarget_print_stats(stdout, s_targets, s_targetcount);
+	piosim_vcd_close(&s_sim);
+	return 0;
+}
@@ -0,0 +1,909 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "i3ctarget.h"
+
+#define ADDR_HOTJOIN        (0x02u)
+#define ADDR_BROADCAST      (0x7eu)
+
+#define CCC_ENEC            (0x00)
+#define CCC_DISEC           (0x01)
+#define CCC_RSTDAA          (0x06)
+#define CCC_ENTDAA          (0x07)
+#define CCC_SETMWL          (0x09)
+#define CCC_SETMRL          (0x0a)
+#define CCC_ENTHDR0         (0x20)
+#define CCC_DIRECT          (0x80)
+#define CCC_SETNEWDA        (0x88)
+#define CCC_GETMWL          (0x8b)
+#define CCC_GETMRL          (0x8c)
+#define CCC_GETPID          (0x8d)
+#define CCC_GETBCR          (0x8e)
+#define CCC_GETDCR          (0x8f)
+#define CCC_GETSTATUS       (0x90)
+#define CCC_GETMXDS         (0x94)
+#define CCC_GETCAPS         (0x95)
+
+#define BCR_IBI_PAYLOAD     (1u << 2)
+#define BCR_HDR_CAPABLE     (1u << 5)
+#define EVENT_IBI           (1u << 0)
+#define EVENT_CR            (1u << 1)
+#define EVENT_HJ            (1u << 3)
+#define STATUS_PROTOCOL_ERR (1u << 5)
+
+// SDR frames. Each is 9 bits (8 bits and ACK or T-bit) except the 64 bits of PID, BCR and DCR during ENTDAA
+enum
+{
+	st_idle,        // bus free, waiting for START
+	st_ignore,      // not addressed, waiting for a repeated START or STOP
+	st_header,      // address after START / repeated START, arbitrating with a pending request
+	st_write,       // bytes from the controller: CCC code, CCC data or private write
+	st_read,        // private read from the register space
+	st_getccc,      // response of a direct GET CCC
+	st_ibi,         // MDB and payload of an ACKed IBI
+	st_daa_id,      // ENTDAA: PID, BCR, DCR with arbitration
+	st_daa_addr,    // ENTDAA: assigned address with parity, ACK
+};
+
+// HDR-DDR words
+enum
+{
+	ddr_ignore,     // not addressed or no HDR-DDR support, waiting for restart or exit
+	ddr_command,
+	ddr_write,
+	ddr_crc_in,     // CRC word of a write
+	ddr_read,
+	ddr_crc_out,    // CRC word of a read
+	ddr_done,       // CRC word done, waiting for restart or exit
+};
+
+// CRC5 of I3C HDR-DDR (x^5 + x^2 + 1, MSB first) over a 16 bit word
+static uint8_t crc5(uint8_t crc, uint16_t data)
+{
+	for (int bit=15; bit>=0; bit--)
+	{
+		uint8_t feedback = (uint8_t)(((crc >> 4) ^ (data >> bit)) & 1u);
+		crc = (uint8_t)((crc << 1) & 0x1fu);
+		if (feedback)
+			crc ^= 0x05u;
+	}
+	return crc;
+}
+
+static uint32_t ddr_parity(uint16_t data)
+{
+	return ((uint32_t)__builtin_parity(data & 0xaaaau) << 1) | ((uint32_t)__builtin_parity(data & 0x5555u) ^ 1u);
+}
+
+static void drive(i3ctarget_t *pt, bool low)
+{
+	piosim_pull(pt->ps, &pt->dev, pt->sda, low);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// IBI and Hot-Join requests
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool request_pending(const i3ctarget_t *pt)
+{
+	return ( pt->ibi_pending && (pt->dynaddr != 0) && (pt->events & EVENT_IBI) ) ||
+	       ( pt->hj_pending  && (pt->dynaddr == 0) && (pt->events & EVENT_HJ) );
+}
+
+// address header of the pending request: own address with R, or the Hot-Join address with W
+static uint8_t request_header(const i3ctarget_t *pt)
+{
+	return (pt->dynaddr != 0) ? (uint8_t)((pt->dynaddr << 1) | 1u) : (uint8_t)(ADDR_HOTJOIN << 1);
+}
+
+// signal a pending request on the idle bus once it is available
+static void request_schedule(i3ctarget_t *pt)
+{
+	uint64_t cycle = pt->stop_cycle + ((uint64_t)pt->cfg.taval_ns * pt->ps->sysclk_khz + 999999u) / 1000000u;
+
+	if ( !pt->busy && !pt->ddr_mode && request_pending(pt) )
+		piosim_wakeup(pt->ps, &pt->dev, (cycle > pt->ps->cycle) ? cycle : pt->ps->cycle + 1u);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// SDR
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t daa_id(const i3ctarget_t *pt)
+{
+	return ((pt->cfg.pid & 0xffffffffffffull) << 16) | ((uint64_t)pt->cfg.bcr << 8) | pt->cfg.dcr;
+}
+
+// load the next byte to send and its T-bit, 0 ends the data
+static void read_next(i3ctarget_t *pt)
+{
+	bool last;
+
+	switch (pt->state)
+	{
+		case st_read:
+			pt->shift = pt->regs[pt->regptr];
+			last = (pt->cfg.mrl != 0) && (pt->count + 1u >= pt->cfg.mrl);
+			break;
+		case st_getccc:
+			pt->shift = pt->rdata[pt->count];
+			last = pt->count + 1u >= pt->rlen;
+			break;
+		default: // st_ibi
+			pt->shift = pt->ibi_data[pt->count];
+			last = pt->count + 1u >= pt->ibi_len;
+			break;
+	}
+	pt->tbit = !last;
+	pt->count++;
+}
+
+static void enter(i3ctarget_t *pt, uint8_t state)
+{
+	pt->state = state;
+	pt->bit = 0;
+	pt->shift = 0;
+	pt->count = 0;
+	pt->arbitrating = (state == st_daa_id);
+	if ( (state == st_read) || (state == st_getccc) || (state == st_ibi) )
+		read_next(pt);
+}
+
+static void ddr_enter(i3ctarget_t *pt)
+{
+	pt->ddr_mode = true;
+	pt->ddr_state = (pt->cfg.ddr != i3ctarget_ddr_none) ? ddr_command : ddr_ignore;
+	pt->wait_start = true; // the falling edge after the T-bit of ENTHDR0 is no data
+	pt->sda_falls = 0;
+	pt->state = st_ignore;
+}
+
+static bool ccc_direct_set(int16_t ccc)
+{
+	return (ccc == (CCC_DIRECT | CCC_ENEC)) || (ccc == (CCC_DIRECT | CCC_DISEC)) || (ccc == CCC_SETNEWDA) ||
+	       (ccc == (CCC_DIRECT | CCC_SETMWL)) || (ccc == (CCC_DIRECT | CCC_SETMRL));
+}
+
+// prepares the response of a direct GET CCC, returns false for unsupported ones
+static bool ccc_response(i3ctarget_t *pt)
+{
+	uint8_t *p = pt->rdata;
+
+	switch (pt->ccc)
+	{
+		case CCC_GETMWL:
+			*p++ = (uint8_t)(pt->cfg.mwl >> 8);
+			*p++ = (uint8_t)pt->cfg.mwl;
+			break;
+		case CCC_GETMRL:
+			*p++ = (uint8_t)(pt->cfg.mrl >> 8);
+			*p++ = (uint8_t)pt->cfg.mrl;
+			if (pt->cfg.bcr & BCR_IBI_PAYLOAD)
+				*p++ = pt->cfg.ibi_payload;
+			break;
+		case CCC_GETPID:
+			for (int i=5; i>=0; i--)
+				*p++ = (uint8_t)(pt->cfg.pid >> (8*i));
+			break;
+		case CCC_GETBCR:
+			*p++ = pt->cfg.bcr;
+			break;
+		case CCC_GETDCR:
+			*p++ = pt->cfg.dcr;
+			break;
+		case CCC_GETSTATUS:
+			*p++ = 0;
+			*p++ = (uint8_t)((pt->protocol_error ? STATUS_PROTOCOL_ERR : 0u) | (pt->ibi_pending ? 1u : 0u));
+			pt->protocol_error = false;
+			break;
+		case CCC_GETMXDS:
+			*p++ = pt->cfg.maxwr;
+			*p++ = pt->cfg.maxrd;
+			break;
+		case CCC_GETCAPS: // GETHDRCAP of V1.0: HDR modes only. V1.1 adds GETCAP2 with the version (1 = V1.1)
+			*p++ = (pt->cfg.ddr != i3ctarget_ddr_none) ? 0x01u : 0x00u;
+			if (pt->cfg.ddr == i3ctarget_ddr_v11)
+				*p++ = 0x01u;
+			break;
+		default:
+			return false;
+	}
+	pt->rlen = (uint8_t)(p - pt->rdata);
+	return true;
+}
+
+// data byte of a broadcast CCC or a direct SET CCC, count is its index
+static void ccc_data(i3ctarget_t *pt, uint8_t data)
+{
+	switch (pt->ccc)
+	{
+		case CCC_ENEC:
+		case CCC_DIRECT | CCC_ENEC:
+			if (pt->count == 0)
+				pt->events |= data;
+			break;
+		case CCC_DISEC:
+		case CCC_DIRECT | CCC_DISEC:
+			if (pt->count == 0)
+				pt->events &= (uint8_t)~data;
+			break;
+		case CCC_SETMWL:
+		case CCC_DIRECT | CCC_SETMWL:
+			if (pt->count < 2)
+				pt->cfg.mwl = (pt->count == 0) ? (uint16_t)((pt->cfg.mwl & 0x00ffu) | (data << 8)) : (uint16_t)((pt->cfg.mwl & 0xff00u) | data);
+			break;
+		case CCC_SETMRL:
+		case CCC_DIRECT | CCC_SETMRL:
+			if (pt->count < 2)
+				pt->cfg.mrl = (pt->count == 0) ? (uint16_t)((pt->cfg.mrl & 0x00ffu) | (data << 8)) : (uint16_t)((pt->cfg.mrl & 0xff00u) | data);
+			else if (pt->count == 2)
+				pt->cfg.ibi_payload = data;
+			break;
+		case CCC_SETNEWDA:
+			if (pt->count == 0)
+				pt->dynaddr = data >> 1;
+			break;
+		default:
+			break;
+	}
+}
+
+static void write_byte(i3ctarget_t *pt, uint8_t data, bool tbit)
+{
+	if ((bool)(__builtin_parity(data) ^ 1) != tbit)
+	{
+		pt->stats.sdr_parity_errors++;
+		pt->protocol_error = true;
+		return;
+	}
+	if (pt->ccc_expected)
+	{
+		pt->ccc_expected = false;
+		pt->ccc = data;
+		pt->count = 0;
+		if (data == CCC_RSTDAA)
+			pt->dynaddr = 0;
+		else if (data == CCC_ENTHDR0)
+			ddr_enter(pt);
+		return;
+	}
+	if (pt->ccc >= 0)
+		ccc_data(pt, data);
+	else if (pt->count == 0)
+		pt->regptr = data;
+	else
+		pt->regs[pt->regptr++] = data;
+	pt->count++;
+}
+
+// address byte complete (7 bits + RnW in shift): decide on the ACK and the following frame
+static void header(i3ctarget_t *pt)
+{
+	uint8_t addr = pt->shift >> 1;
+	bool    rnw  = (pt->shift & 1u) != 0;
+
+	pt->ack = false;
+	if (pt->arbitrating)
+		return; // the own request won, the controller ACKs or NAKs it
+	if (addr == ADDR_BROADCAST)
+	{
+		if (!rnw)
+		{ // a CCC code follows
+			pt->ack = true;
+			pt->nextstate = st_write;
+			pt->ccc = -1;
+			pt->ccc_expected = true;
+		}
+		else if ( (pt->ccc == CCC_ENTDAA) && (pt->dynaddr == 0) )
+		{
+			pt->ack = true;
+			pt->nextstate = st_daa_id;
+		}
+		return;
+	}
+	if (pt->ccc < CCC_DIRECT) // a broadcast CCC ends with the repeated START, a direct one continues with the next address
+		pt->ccc = -1;
+	pt->ccc_expected = false;
+	if ( (pt->dynaddr == 0) || (addr != pt->dynaddr) )
+		return;
+	if (pt->ccc >= 0)
+	{
+		pt->ack = rnw ? ccc_response(pt) : ccc_direct_set(pt->ccc);
+		pt->nextstate = rnw ? st_getccc : st_write;
+	}
+	else
+	{
+		pt->ack = true;
+		pt->nextstate = rnw ? st_read : st_write;
+	}
+}
+
+// ACK bit of the controller after the own request won the arbitration
+static void request_acked(i3ctarget_t *pt, bool acked)
+{
+	bool hotjoin = pt->hdrbyte == (ADDR_HOTJOIN << 1);
+
+	pt->arbitrating = false;
+	pt->state = st_ignore;
+	if (!acked)
+	{ // stays pending, signalled again after the STOP
+		pt->stats.ibi_naks++;
+		return;
+	}
+	pt->stats.ibis++;
+	if (hotjoin)
+	{ // ENTDAA follows
+		pt->hj_pending = false;
+	}
+	else
+	{
+		pt->ibi_pending = false;
+		if (pt->cfg.bcr & BCR_IBI_PAYLOAD)
+			enter(pt, st_ibi);
+	}
+}
+
+static void sdr_start(i3ctarget_t *pt)
+{
+	bool repeated = pt->busy;
+
+	pt->busy = true;
+	enter(pt, st_header);
+	pt->ack = false;
+	pt->arbitrating = !repeated && request_pending(pt); // requests arbitrate after a START only
+	pt->hdrbyte = request_header(pt);
+	if (!pt->self_start)
+		drive(pt, false);
+	pt->self_start = false;
+	piosim_wakeup(pt->ps, &pt->dev, UINT64_MAX);
+}
+
+static void sdr_stop(i3ctarget_t *pt)
+{
+	pt->busy = false;
+	pt->state = st_idle;
+	pt->ccc = -1;
+	pt->ccc_expected = false;
+	pt->arbitrating = false;
+	drive(pt, false);
+	pt->stop_cycle = pt->ps->cycle;
+	request_schedule(pt);
+}
+
+// drive the next bit of the frame
+static void sdr_scl_fall(i3ctarget_t *pt)
+{
+	bool low = false;
+
+	switch (pt->state)
+	{
+		case st_header:
+			if (pt->bit < 8)
+				low = pt->arbitrating && !((pt->hdrbyte >> (7 - pt->bit)) & 1u);
+			else
+				low = pt->ack;
+			break;
+		case st_read:
+		case st_getccc:
+		case st_ibi:
+			low = (pt->bit < 8) ? !((pt->shift >> (7 - pt->bit)) & 1u) : !pt->tbit;
+			break;
+		case st_daa_id:
+			low = pt->arbitrating && !((daa_id(pt) >> (63 - pt->bit)) & 1u);
+			break;
+		case st_daa_addr:
+			low = (pt->bit == 8) && pt->ack;
+			break;
+		default:
+			break;
+	}
+	drive(pt, low);
+}
+
+// sample the bit of the frame
+static void sdr_scl_rise(i3ctarget_t *pt, bool sda)
+{
+	switch (pt->state)
+	{
+		case st_header:
+			if (pt->bit < 8)
+			{
+				if ( pt->arbitrating && ((pt->hdrbyte >> (7 - pt->bit)) & 1u) && !sda )
+				{
+					pt->arbitrating = false;
+					pt->stats.arbitration_lost++;
+				}
+				pt->shift = (uint8_t)((pt->shift << 1) | (sda ? 1u : 0u));
+				if (pt->bit == 7)
+					header(pt);
+				pt->bit++;
+			}
+			else if (pt->arbitrating)
+				request_acked(pt, !sda);
+			else if (pt->ack)
+				enter(pt, pt->nextstate);
+			else
+				pt->state = st_ignore;
+			break;
+		case st_write:
+			if (pt->bit < 8)
+			{
+				pt->shift = (uint8_t)((pt->shift << 1) | (sda ? 1u : 0u));
+				pt->bit++;
+			}
+			else
+			{
+				uint8_t data = pt->shift;
+
+				pt->bit = 0;
+				pt->shift = 0;
+				write_byte(pt, data, sda);
+			}
+			break;
+		case st_read:
+		case st_getccc:
+		case st_ibi:
+			if (pt->bit < 8)
+				pt->bit++;
+			else
+			{
+				if (pt->state == st_read)
+					pt->regptr++;
+				if (pt->tbit)
+				{ // more data, unless the controller aborts with a repeated START now
+					pt->bit = 0;
+					read_next(pt);
+				}
+				else
+					pt->state = st_ignore;
+			}
+			break;
+		case st_daa_id:
+			if ( pt->arbitrating && ((daa_id(pt) >> (63 - pt->bit)) & 1u) && !sda )
+			{
+				pt->arbitrating = false;
+				pt->stats.arbitration_lost++;
+			}
+			if (++pt->bit == 64)
+			{
+				if (pt->arbitrating)
+					enter(pt, st_daa_addr);
+				else
+					pt->state = st_ignore;
+			}
+			break;
+		case st_daa_addr:
+			if (pt->bit < 8)
+			{
+				pt->shift = (uint8_t)((pt->shift << 1) | (sda ? 1u : 0u));
+				if (pt->bit == 7) // 7 bit address and odd parity
+					pt->ack = (__builtin_parity(pt->shift) == 1) && ((pt->shift >> 1) != 0);
+				pt->bit++;
+			}
+			else
+			{
+				if (pt->ack)
+				{
+					pt->dynaddr = pt->shift >> 1;
+					pt->hj_pending = false;
+				}
+				pt->state = st_ignore;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// HDR-DDR
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t ddr_read_words(const i3ctarget_t *pt)
+{
+	if (pt->ddr_len[pt->command])
+		return pt->ddr_len[pt->command];
+	return (pt->cfg.mrl >= 2) ? pt->cfg.mrl / 2u : 1u;
+}
+
+// preamble, data and parity of the next read word: PRE1 = 1, PRE0 = 0 (ACK) for the first word, passive otherwise
+static void ddr_read_load(i3ctarget_t *pt)
+{
+	uint16_t dat = pt->ddr_len[pt->command] ? pt->ddr_data[pt->command][pt->rpos] : (uint16_t)pt->rpos;
+	uint32_t parity = ddr_parity(dat);
+
+	if (pt->faults.ddr_parity_word == pt->rpos + 1u)
+	{
+		parity ^= 1u;
+		pt->faults.ddr_parity_word = 0;
+	}
+	pt->rbits = ((pt->first ? 2u : 3u) << 18) | ((uint32_t)dat << 2) | parity;
+}
+
+// CRC word of a read: preamble 01, token 1100, CRC5, 1. PRE1 is driven before the first edge
+static void ddr_crc_start(i3ctarget_t *pt)
+{
+	uint8_t crc = pt->crc;
+
+	if (pt->faults.ddr_crc)
+	{
+		crc ^= 1u;
+		pt->faults.ddr_crc = false;
+	}
+	pt->rbits = (1u << 10) | (0xcu << 6) | ((uint32_t)crc << 1) | 1u;
+	pt->ddr_state = ddr_crc_out;
+	pt->wait_start = true;
+	drive(pt, true);
+}
+
+static void ddr_commit(i3ctarget_t *pt)
+{
+	uint32_t words = (pt->wlen < I3CTARGET_DDR_WORDS) ? pt->wlen : I3CTARGET_DDR_WORDS;
+
+	memcpy(pt->ddr_data[pt->command], pt->wbuf, words * sizeof(pt->wbuf[0]));
+	pt->ddr_len[pt->command] = (uint16_t)words;
+}
+
+// end of a transfer by restart or exit. A write without CRC word (early terminated) is stored
+static void ddr_finish(i3ctarget_t *pt)
+{
+	if ( (pt->ddr_state == ddr_write) && (pt->wlen > 0) )
+		ddr_commit(pt);
+	drive(pt, false);
+}
+
+static void ddr_command_edge(i3ctarget_t *pt)
+{
+	uint16_t dat = (uint16_t)(pt->word >> 2);
+
+	if (pt->edge < 19)
+		return;
+	pt->wait_start = true;
+	pt->ddr_state = ddr_ignore;
+	if ((pt->word >> 18) != 1u)
+	{
+		pt->stats.ddr_preamble_errors++;
+		return;
+	}
+	if ((pt->word & 3u) != ddr_parity(dat))
+	{
+		pt->stats.ddr_parity_errors++;
+		pt->protocol_error = true;
+		return;
+	}
+	if ( (pt->dynaddr == 0) || (((dat >> 1) & 0x7fu) != pt->dynaddr) )
+		return;
+	pt->command = (uint8_t)((dat >> 8) & 0x7fu);
+	pt->crc = crc5(0x1f, dat);
+	pt->first = true;
+	pt->terminate = false;
+	if (dat & 0x8000u)
+	{
+		pt->ddr_state = ddr_read;
+		pt->rpos = 0;
+		ddr_read_load(pt);
+	}
+	else
+	{
+		pt->ddr_state = ddr_write;
+		pt->wlen = 0;
+	}
+}
+
+static void ddr_write_edge(i3ctarget_t *pt)
+{
+	bool v11 = pt->cfg.ddr == i3ctarget_ddr_v11;
+
+	if (pt->edge == 0)
+	{
+		if ((pt->word & 1u) == 0)
+		{ // PRE1 = 0: CRC word
+			pt->ddr_state = ddr_crc_in;
+			return;
+		}
+		pt->terminate = v11 && !pt->first && (pt->cfg.ddr_write_limit != 0) && (pt->wlen >= pt->cfg.ddr_write_limit);
+		if ( (v11 && pt->first && pt->cfg.ddr_write_ack) || pt->terminate )
+			drive(pt, true); // PRE0 = 0: ACK of the first word, early termination request of the following ones
+	}
+	else if (pt->edge == 1)
+	{
+		drive(pt, false);
+		if (pt->terminate) // the CRC word or restart / exit follow
+			pt->wait_start = true;
+	}
+	else if (pt->edge == 19)
+	{
+		uint16_t dat = (uint16_t)(pt->word >> 2);
+
+		if ((pt->word & 3u) != ddr_parity(dat))
+		{
+			pt->stats.ddr_parity_errors++;
+			pt->protocol_error = true;
+		}
+		if (pt->wlen < I3CTARGET_DDR_WORDS)
+			pt->wbuf[pt->wlen] = dat;
+		pt->wlen++;
+		pt->crc = crc5(pt->crc, dat);
+		pt->stats.ddr_words_written++;
+		pt->first = false;
+		pt->wait_start = true;
+	}
+}
+
+static void ddr_crc_in_edge(i3ctarget_t *pt)
+{
+	if (pt->edge != 10)
+		return;
+	// 11 bits: preamble 01, token 1100, CRC5. The trailing 1 is not needed
+	if ((pt->word >> 9) != 1u)
+		pt->stats.ddr_preamble_errors++;
+	if ( (((pt->word >> 5) & 0xfu) != 0xcu) || ((pt->word & 0x1fu) != pt->crc) )
+	{
+		pt->stats.ddr_crc_errors++;
+		pt->protocol_error = true;
+	}
+	else
+		ddr_commit(pt);
+	pt->ddr_state = ddr_done;
+}
+
+static void ddr_read_edge(i3ctarget_t *pt, bool sda)
+{
+	if ( (pt->edge == 1) && !pt->first && !sda )
+	{ // PRE0 driven low by the controller: early termination
+		drive(pt, false);
+		if ( (pt->cfg.ddr == i3ctarget_ddr_v11) && pt->cfg.ddr_crc_on_termination )
+			ddr_crc_start(pt);
+		else
+			pt->ddr_state = ddr_done;
+		return;
+	}
+	if (pt->edge < 19)
+	{
+		drive(pt, !((pt->rbits >> (18 - pt->edge)) & 1u));
+		return;
+	}
+	pt->crc = crc5(pt->crc, (uint16_t)(pt->rbits >> 2));
+	pt->stats.ddr_words_read++;
+	pt->rpos++;
+	pt->first = false;
+	if (pt->rpos < ddr_read_words(pt))
+	{ // PRE1 = 1: another data word
+		ddr_read_load(pt);
+		drive(pt, false);
+		pt->wait_start = true;
+	}
+	else
+		ddr_crc_start(pt);
+}
+
+static void ddr_crc_out_edge(i3ctarget_t *pt)
+{
+	if (pt->edge < 11)
+		drive(pt, !((pt->rbits >> (10 - pt->edge)) & 1u));
+	else
+	{
+		drive(pt, false);
+		pt->ddr_state = ddr_done;
+	}
+}
+
+static void ddr_scl_edge(i3ctarget_t *pt, bool rising, bool sda)
+{
+	uint8_t falls = pt->sda_falls;
+
+	pt->sda_falls = 0;
+	if (rising && (falls >= 2))
+	{ // HDR restart, the next command word starts with the next rising edge
+		ddr_finish(pt);
+		pt->ddr_state = (pt->cfg.ddr != i3ctarget_ddr_none) ? ddr_command : ddr_ignore;
+		pt->wait_start = true;
+		return;
+	}
+	if (pt->wait_start)
+	{
+		if (!rising)
+			return;
+		pt->wait_start = false;
+		pt->edge = 0;
+		pt->word = 0;
+	}
+	pt->word = (pt->word << 1) | (sda ? 1u : 0u);
+	switch (pt->ddr_state)
+	{
+		case ddr_command: ddr_command_edge(pt);     break;
+		case ddr_write:   ddr_write_edge(pt);       break;
+		case ddr_crc_in:  ddr_crc_in_edge(pt);      break;
+		case ddr_read:    ddr_read_edge(pt, sda);   break;
+		case ddr_crc_out: ddr_crc_out_edge(pt);     break;
+		default:                                    break;
+	}
+	pt->edge++;
+}
+
+static void ddr_exit(i3ctarget_t *pt)
+{
+	ddr_finish(pt);
+	pt->ddr_mode = false;
+	pt->sda_falls = 0;
+	pt->state = st_ignore; // a STOP follows
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// device
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static void i3ctarget_update(piosim_t *ps, piosim_device_t *pdev, uint32_t levels, uint32_t changed)
+{
+	i3ctarget_t *pt = (i3ctarget_t *)pdev->ctx;
+	bool scl = (levels & pt->scl) != 0, sda = (levels & pt->sda) != 0;
+	bool sclchanged = (changed & pt->scl) != 0, sdachanged = (changed & pt->sda) != 0;
+
+	(void)ps;
+	if (changed == 0)
+	{ // bus available: signal the request by pulling SDA low, this is the START
+		if ( !pt->busy && !pt->ddr_mode && (pt->state == st_idle) && scl && sda && request_pending(pt) )
+		{
+			pt->self_start = true;
+			drive(pt, true);
+		}
+		return;
+	}
+	if (sclchanged && !scl)
+	{
+		if (pt->ddr_mode)
+			ddr_scl_edge(pt, false, sda);
+		else
+			sdr_scl_fall(pt);
+	}
+	if (sdachanged)
+	{
+		if (pt->ddr_mode)
+		{
+			if ( !sda && (!scl || sclchanged) && (++pt->sda_falls == 4) )
+				ddr_exit(pt);
+		}
+		else if (scl && !sclchanged)
+		{
+			if (sda)
+				sdr_stop(pt);
+			else
+				sdr_start(pt);
+		}
+	}
+	if (sclchanged && scl)
+	{
+		if (pt->ddr_mode)
+			ddr_scl_edge(pt, true, sda);
+		else
+			sdr_scl_rise(pt, sda);
+	}
+}
+
+void i3ctarget_config_default(i3ctarget_config_t *pcfg)
+{
+	memset(pcfg, 0, sizeof(*pcfg));
+	pcfg->pid            = 0x0123456789abull;
+	pcfg->bcr            = BCR_HDR_CAPABLE | BCR_IBI_PAYLOAD | (1u << 1); // IBI request capable
+	pcfg->ddr            = i3ctarget_ddr_v11;
+	pcfg->ddr_write_ack  = true;
+	pcfg->mwl            = 256;
+	pcfg->mrl            = 256;
+	pcfg->ibi_payload    = I3CTARGET_IBI_PAYLOAD;
+	pcfg->taval_ns       = 1000;
+}
+
+bool i3ctarget_config_parse(i3ctarget_config_t *pcfg, const char *spec)
+{
+	char *end;
+
+	i3ctarget_config_default(pcfg);
+	pcfg->dynaddr = (uint8_t)strtoul(spec, &end, 0);
+	while (*end == ',')
+	{
+		const char *key = end + 1, *eq = strchr(key, '=');
+		unsigned long long value;
+
+		if (!eq)
+			return false;
+		value = strtoull(eq + 1, &end, 0);
+		if      (strncmp(key, "pid=", 4) == 0)   pcfg->pid = value & 0xffffffffffffull;
+		else if (strncmp(key, "bcr=", 4) == 0)   pcfg->bcr = (uint8_t)value;
+		else if (strncmp(key, "dcr=", 4) == 0)   pcfg->dcr = (uint8_t)value;
+		else if (strncmp(key, "ddr=", 4) == 0)   pcfg->ddr = (value == 11) ? i3ctarget_ddr_v11 : ((value == 10) ? i3ctarget_ddr_v10 : i3ctarget_ddr_none);
+		else if (strncmp(key, "ack=", 4) == 0)   pcfg->ddr_write_ack = value != 0;
+		else if (strncmp(key, "limit=", 6) == 0) pcfg->ddr_write_limit = (uint32_t)value;
+		else if (strncmp(key, "crc=", 4) == 0)   pcfg->ddr_crc_on_termination = value != 0;
+		else if (strncmp(key, "mrl=", 4) == 0)   pcfg->mrl = (uint16_t)value;
+		else if (strncmp(key, "mwl=", 4) == 0)   pcfg->mwl = (uint16_t)value;
+		else
+			return false;
+	}
+	return (*end == 0) && (pcfg->dynaddr <= 0x7f);
+}
+
+bool i3ctarget_config_add(i3ctarget_config_t *pcfgs, unsigned maxcount, unsigned *pcount, const char *spec)
+{
+	if ( (*pcount >= maxcount) || !i3ctarget_config_parse(&pcfgs[*pcount], spec) )
+		return false;
+	(*pcount)++;
+	return true;
+}
+
+void i3ctarget_attach(i3ctarget_t *pt, piosim_t *ps, unsigned gpiosda, const i3ctarget_config_t *pcfg)
+{
+	memset(pt, 0, sizeof(*pt));
+	pt->ps      = ps;
+	pt->sda     = 1u << gpiosda;
+	pt->scl     = 1u << (gpiosda + 1u);
+	pt->cfg     = *pcfg;
+	pt->dynaddr = pcfg->dynaddr;
+	pt->events  = EVENT_IBI | EVENT_CR | EVENT_HJ;
+	pt->ccc     = -1;
+	pt->state   = st_idle;
+	piosim_attach(ps, &pt->dev, i3ctarget_update, pt);
+}
+
+void i3ctarget_detach(i3ctarget_t *pt)
+{
+	piosim_detach(pt->ps, &pt->dev);
+}
+
+bool i3ctarget_ibi(i3ctarget_t *pt, uint8_t mdb, const uint8_t *ppayload, uint8_t len)
+{
+	if ( (pt->dynaddr == 0) || !(pt->events & EVENT_IBI) || (len >= I3CTARGET_IBI_PAYLOAD) )
+		return false;
+	pt->ibi_data[0] = mdb;
+	if (len > 0)
+		memcpy(&pt->ibi_data[1], ppayload, len);
+	pt->ibi_len = (uint8_t)(len + 1u);
+	pt->ibi_pending = true;
+	request_schedule(pt);
+	return true;
+}
+
+bool i3ctarget_hotjoin(i3ctarget_t *pt)
+{
+	if ( (pt->dynaddr != 0) || !(pt->events & EVENT_HJ) )
+		return false;
+	pt->hj_pending = true;
+	request_schedule(pt);
+	return true;
+}
+
+void i3ctarget_print_stats(FILE *f, const i3ctarget_t *pt, unsigned count)
+{
+	for (unsigned i=0; i<count; i++, pt++)
+	{
+		fprintf(f, "target %u: address 0x%02x, IBIs %llu (NAKed %llu), arbitration lost %llu, DDR words written %llu read %llu, "
+		        "errors: T-bit %llu, DDR parity %llu, CRC %llu, preamble %llu\n", i, pt->dynaddr,
+		        (unsigned long long)pt->stats.ibis, (unsigned long long)pt->stats.ibi_naks,
+		        (unsigned long long)pt->stats.arbitration_lost, (unsigned long long)pt->stats.ddr_words_written,
+		        (unsigned long long)pt->stats.ddr_words_read, (unsigned long long)pt->stats.sdr_parity_errors,
+		        (unsigned long long)pt->stats.ddr_parity_errors, (unsigned long long)pt->stats.ddr_crc_errors,
+		        (unsigned long long)pt->stats.ddr_preamble_errors);
+	}
+}
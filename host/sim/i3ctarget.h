@@ -0,0 +1,178 @@
+#ifndef _I3CTARGET_H
+#define _I3CTARGET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "piosim.h"
+
+/*
+ * Behavioral model of an I3C target on SDA/SCL of the PIO simulator (piosim.h), attached as device. Several targets
+ * can share a bus, everything they drive is open drain (wired AND), which also gives the arbitration of ENTDAA and IBIs.
+ *
+ * The model follows the bus edge by edge like a target does: data is sampled at the rising SCL edge, driven right after
+ * the falling one (at the falling edge itself, the controller samples before its edges). START and STOP are SDA edges
+ * while SCL stays high, SDA changes in the same cycle as an SCL edge count as changes while SCL is low.
+ *
+ * SDR:
+ *  - ACK of the own dynamic address and of 0x7E (broadcast, and 0x7E/R during ENTDAA as long as no address is
+ *    assigned), everything else is NAKed
+ *  - private write: the first byte sets the pointer into a 256 byte register space, the following bytes are written
+ *    there. Private read returns the register space from the pointer on, at most MRL bytes, the T-bit of the last
+ *    byte ends the data. The controller can abort earlier with a repeated START at the T-bit
+ *  - CCCs: ENEC, DISEC, RSTDAA, ENTDAA (PID, BCR, DCR arbitration), SETMWL, SETMRL, ENTHDR0 broadcast and ENEC, DISEC,
+ *    SETNEWDA, SETMWL, SETMRL, GETMWL, GETMRL, GETPID, GETBCR, GETDCR, GETSTATUS, GETMXDS, GETCAPS direct. Other
+ *    direct CCCs are NAKed
+ *  - IBI with MDB and payload (BCR bit 2) and Hot-Join (address 0x02). A raised request is signalled by pulling SDA low
+ *    once the bus is available (tAVAL after STOP), and it arbitrates in the address header after every START
+ *  - the T-bit parity of written bytes is checked
+ *
+ * HDR-DDR (after ENTHDR0, until the HDR exit pattern):
+ *  - command words with the own address are ACKed, words of the other addresses are ignored
+ *  - write: data words and the CRC word are checked, the words are stored per command code (bit 7 = read ignored)
+ *    unless the CRC is wrong. V1.1 targets ACK the first data word in its preamble and can request the early
+ *    termination after a configured count of words
+ *  - read: returns the words of the last write with the same command code, a code never written returns an
+ *    incrementing pattern of MRL/2 words. The end of data is the CRC word. The controller can terminate earlier, V1.1
+ *    targets send their CRC word then
+ *  - HDR restart (2 SDA falling edges while SCL is low, then SCL rises, the next command word starts with the
+ *    following rising edge) and exit (4 SDA falling edges) patterns. Targets without HDR-DDR only watch for them
+ *
+ * Faults injected on request: wrong parity of a DDR read word and a wrong CRC of a DDR read. Errors of the controller
+ * (T-bit parity, DDR parity, CRC, preambles) are counted.
+ */
+
+#define I3CTARGET_REGS          (256)
+#define I3CTARGET_DDR_WORDS     (256)   // stored words per DDR command code
+#define I3CTARGET_IBI_PAYLOAD   (16)
+
+// HDR-DDR support
+typedef enum
+{
+	i3ctarget_ddr_none = 0,
+	i3ctarget_ddr_v10,      // I3C V1.0: no ACK of written words, no early termination, no CRC after a terminated read
+	i3ctarget_ddr_v11,      // I3C V1.1: ENDXFER options ddr_write_ack, ddr_write_limit, ddr_crc_on_termination
+} i3ctarget_ddr_t;
+
+typedef struct
+{
+	uint8_t         dynaddr;        // dynamic address at start, 0: none (assigned by ENTDAA)
+	uint64_t        pid;            // 48 bit provisioned ID
+	uint8_t         bcr, dcr;
+	i3ctarget_ddr_t ddr;
+	uint16_t        mwl, mrl;       // max write / read length, the reads end at mrl bytes (SDR) or mrl/2 words (DDR)
+	uint8_t         ibi_payload;    // max IBI payload incl. MDB, reported by GETMRL
+	uint8_t         maxwr, maxrd;   // GETMXDS
+	bool            ddr_write_ack;  // V1.1: ACK the first written word. The controller has to expect it (ack_nack_enable)
+	uint32_t        ddr_write_limit;// V1.1: request the early termination of writes after this many words, 0: never. The
+	                                // controller has to evaluate it (early_write_termination_enabled)
+	bool            ddr_crc_on_termination; // V1.1: send the CRC word after the controller terminated a read, expect
+	                                // it after an early terminated write. Has to match read_crc_on_early_termination
+	uint32_t        taval_ns;       // bus available time before an IBI or Hot-Join is signalled on an idle bus
+} i3ctarget_config_t;
+
+typedef struct
+{
+	uint64_t sdr_parity_errors;     // written bytes with a wrong T-bit
+	uint64_t ddr_parity_errors;     // command and data words with wrong parity
+	uint64_t ddr_crc_errors;        // written CRC words with a wrong token or CRC
+	uint64_t ddr_preamble_errors;   // unexpected preambles
+	uint64_t ibis;                  // IBIs and Hot-Joins ACKed by the controller
+	uint64_t ibi_naks;              // IBIs and Hot-Joins NAKed by the controller
+	uint64_t arbitration_lost;      // ENTDAA and IBI arbitration lost against another target
+	uint64_t ddr_words_written;
+	uint64_t ddr_words_read;
+} i3ctarget_stats_t;
+
+typedef struct
+{
+	uint32_t ddr_parity_word;       // wrong parity in read word number (1 = first word) of the next DDR read, 0: none
+	bool     ddr_crc;               // wrong CRC in the next CRC word sent
+} i3ctarget_faults_t;
+
+typedef struct
+{
+	piosim_device_t    dev;
+	piosim_t          *ps;
+	uint32_t           sda, scl;    // pin masks
+	i3ctarget_config_t cfg;
+	i3ctarget_stats_t  stats;
+	i3ctarget_faults_t faults;
+
+	// state visible to the host
+	uint8_t            dynaddr;     // 0: none
+	uint8_t            events;      // enabled events (ENEC/DISEC): bit 0 IBI, bit 1 controller role request, bit 3 Hot-Join
+	bool               ddr_mode;
+	bool               protocol_error;
+	uint8_t            regs[I3CTARGET_REGS];
+	uint8_t            regptr;
+	uint16_t           ddr_data[128][I3CTARGET_DDR_WORDS];
+	uint16_t           ddr_len[128];
+
+	// pending IBI / Hot-Join
+	bool               ibi_pending, hj_pending;
+	uint8_t            ibi_data[I3CTARGET_IBI_PAYLOAD];
+	uint8_t            ibi_len;
+
+	// SDR state
+	uint8_t            state;
+	uint8_t            bit;         // bit within the current frame
+	uint8_t            shift;
+	bool               busy;        // between START and STOP
+	bool               self_start;  // SDA pulled low to signal an IBI / Hot-Join
+	bool               arbitrating; // driving the own address in the header
+	uint8_t            hdrbyte;     // address header driven during arbitration
+	bool               ack;         // ACK of the current address
+	bool               tbit;        // T-bit of the byte being read
+	uint8_t            nextstate;   // state after the ACK
+	int16_t            ccc;         // current CCC, -1: none
+	bool               ccc_expected;// next written byte is a CCC code (after 0x7E/W)
+	uint16_t           count;       // bytes of the current frame sequence
+	uint8_t            rdata[8];    // response of a direct GET CCC
+	uint8_t            rlen;
+	uint64_t           stop_cycle;
+
+	// HDR-DDR state
+	uint8_t            ddr_state;
+	uint8_t            edge;        // edge within the current word
+	bool               wait_start;  // the next rising SCL edge starts a word
+	uint32_t           word;        // sampled bits
+	bool               first;       // first data word of the transfer
+	bool               terminate;   // early termination requested by the target
+	uint8_t            command;
+	uint8_t            crc;
+	uint8_t            sda_falls;   // SDA falling edges while SCL is low, HDR exit and restart detection
+	uint16_t           wbuf[I3CTARGET_DDR_WORDS];
+	uint16_t           wlen;
+	uint32_t           rpos;
+	uint32_t           rbits;       // word being sent: preamble, data and parity, MSB first
+} i3ctarget_t;
+
+// default configuration: no dynamic address, HDR-DDR V1.1 with write ACK, without write limit and CRC on termination,
+// MWL/MRL 256
+void i3ctarget_config_default(i3ctarget_config_t *pcfg);
+
+// configuration from a string "ADDR[,key=value]...", as used by the -t option of the simulator tools. ADDR is the
+// dynamic address at start (0: none), keys: pid, bcr, dcr, ddr (0: none, 10: V1.0, 11: V1.1), ack, limit, crc, mrl,
+// mwl. Everything else is the default configuration. Returns false on syntax errors
+bool i3ctarget_config_parse(i3ctarget_config_t *pcfg, const char *spec);
+
+// parse spec into pcfgs[*pcount] and count it, for the -t options. Returns false on syntax errors or when all maxcount
+// configurations are used
+bool i3ctarget_config_add(i3ctarget_config_t *pcfgs, unsigned maxcount, unsigned *pcount, const char *spec);
+
+// reset the target to its power up state with configuration pcfg and attach it to SDA = gpiosda, SCL = gpiosda + 1
+void i3ctarget_attach(i3ctarget_t *pt, piosim_t *ps, unsigned gpiosda, const i3ctarget_config_t *pcfg);
+void i3ctarget_detach(i3ctarget_t *pt);
+
+// raise an IBI with MDB and up to I3CTARGET_IBI_PAYLOAD-1 payload bytes. Fails without dynamic address or when the
+// IBI is disabled
+bool i3ctarget_ibi(i3ctarget_t *pt, uint8_t mdb, const uint8_t *ppayload, uint8_t len);
+
+// raise a Hot-Join request. Fails with dynamic address or when Hot-Join is disabled
+bool i3ctarget_hotjoin(i3ctarget_t *pt);
+
+// one line per target of pt[0..count-1] with its address, the IBI and DDR counters and the errors seen
+void i3ctarget_print_stats(FILE *f, const i3ctarget_t *pt, unsigned count);
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef _HARDWARE_GPIO_H
+#define _HARDWARE_GPIO_H
+
+// host build of the firmware: replaced by i3cb_fw_host.h
+#include "i3cb_fw_host.h"
+
+#endif
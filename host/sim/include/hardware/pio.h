@@ -0,0 +1,181 @@
+#ifndef _HARDWARE_PIO_H
+#define _HARDWARE_PIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Host replacement of the pico-sdk header hardware/pio.h for the PIO simulator (see piosim.h). Provides what the
+ * pioasm generated i3c.pio.h needs (struct pio_program, pio_sm_config and its default config helpers), the
+ * instruction encoders and the register layout incl. the register bits used by i3c_hl, with the same names and
+ * encodings as the pico-sdk. The instances pio0 and pio1 come from i3c_hal_host.h.
+ */
+
+typedef unsigned int uint;
+
+typedef volatile uint32_t io_rw_32;
+typedef const volatile uint32_t io_ro_32;
+typedef volatile uint32_t io_wo_32;
+
+#define NUM_PIOS                (2u)
+#define NUM_PIO_STATE_MACHINES  (4u)
+
+typedef struct
+{
+	io_rw_32 clkdiv;
+	io_rw_32 execctrl;
+	io_rw_32 shiftctrl;
+	io_ro_32 addr;
+	io_rw_32 instr;
+	io_rw_32 pinctrl;
+} pio_sm_hw_t;
+
+typedef struct
+{
+	io_rw_32    ctrl;
+	io_ro_32    fstat;
+	io_rw_32    fdebug;
+	io_ro_32    flevel;
+	io_wo_32    txf[NUM_PIO_STATE_MACHINES];
+	io_ro_32    rxf[NUM_PIO_STATE_MACHINES];
+	io_rw_32    irq;
+	io_wo_32    irq_force;
+	io_rw_32    input_sync_bypass;
+	io_ro_32    dbg_padout;
+	io_ro_32    dbg_padoe;
+	io_ro_32    dbg_cfginfo;
+	io_wo_32    instr_mem[32];
+	pio_sm_hw_t sm[NUM_PIO_STATE_MACHINES];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+
+#define PIO_CTRL_SM_ENABLE_LSB              (0u)
+#define PIO_CTRL_SM_RESTART_LSB             (4u)
+#define PIO_CTRL_CLKDIV_RESTART_LSB         (8u)
+#define PIO_FSTAT_RXFULL_LSB                (0u)
+#define PIO_FSTAT_RXEMPTY_LSB               (8u)
+#define PIO_FSTAT_TXFULL_LSB                (16u)
+#define PIO_FSTAT_TXEMPTY_LSB               (24u)
+#define PIO_FDEBUG_RXSTALL_LSB              (0u)
+#define PIO_FDEBUG_TXSTALL_LSB              (24u)
+#define PIO_SM0_CLKDIV_FRAC_LSB             (8u)
+#define PIO_SM0_CLKDIV_INT_LSB              (16u)
+#define PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB    (7u)
+#define PIO_SM0_EXECCTRL_WRAP_TOP_LSB       (12u)
+#define PIO_SM0_EXECCTRL_JMP_PIN_LSB        (24u)
+#define PIO_SM0_EXECCTRL_SIDE_PINDIR_LSB    (29u)
+#define PIO_SM0_EXECCTRL_SIDE_EN_LSB        (30u)
+#define PIO_SM0_SHIFTCTRL_AUTOPUSH_LSB      (16u)
+#define PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS     (1u << 16)
+#define PIO_SM0_SHIFTCTRL_AUTOPULL_LSB      (17u)
+#define PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_LSB   (18u)
+#define PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_LSB  (19u)
+#define PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB   (20u)
+#define PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB   (25u)
+#define PIO_SM0_SHIFTCTRL_FJOIN_TX_BITS     (1u << 30)
+#define PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS     (1u << 31)
+#define PIO_SM0_PINCTRL_OUT_BASE_LSB        (0u)
+#define PIO_SM0_PINCTRL_SET_BASE_LSB        (5u)
+#define PIO_SM0_PINCTRL_SIDESET_BASE_LSB    (10u)
+#define PIO_SM0_PINCTRL_IN_BASE_LSB         (15u)
+#define PIO_SM0_PINCTRL_OUT_COUNT_LSB       (20u)
+#define PIO_SM0_PINCTRL_SET_COUNT_LSB       (26u)
+#define PIO_SM0_PINCTRL_SIDESET_COUNT_LSB   (29u)
+
+typedef struct pio_program
+{
+	const uint16_t *instructions;
+	uint8_t         length;
+	int8_t          origin;           // required instruction memory origin or -1
+	uint8_t         pio_version;      // emitted by pioasm of pico-sdk 2.x
+	uint32_t        used_gpio_ranges;
+} pio_program_t;
+
+typedef struct
+{
+	uint32_t clkdiv;
+	uint32_t execctrl;
+	uint32_t shiftctrl;
+	uint32_t pinctrl;
+} pio_sm_config;
+
+static inline pio_sm_config pio_get_default_sm_config(void)
+{
+	pio_sm_config c;
+
+	c.clkdiv    = 1u << 16;
+	c.execctrl  = 31u << 12;              // wrap top 31, bottom 0
+	c.shiftctrl = (1u << 18) | (1u << 19); // shift right in both directions
+	c.pinctrl   = 0;
+	return c;
+}
+
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap)
+{
+	c->execctrl = (c->execctrl & ~((0x1fu << 12) | (0x1fu << 7))) | ((wrap & 0x1fu) << 12) | ((wrap_target & 0x1fu) << 7);
+}
+
+static inline void sm_config_set_sideset(pio_sm_config *c, uint bit_count, bool optional, bool pindirs)
+{
+	c->pinctrl  = (c->pinctrl & ~(7u << 29)) | ((bit_count & 7u) << 29);
+	c->execctrl = (c->execctrl & ~((1u << 30) | (1u << 29))) | ((optional ? 1u : 0u) << 30) | ((pindirs ? 1u : 0u) << 29);
+}
+
+// sources and destinations of IN/OUT/MOV/SET. Bits 2..0 are the encoding, the upper bits only keep the values unique
+enum pio_src_dest
+{
+	pio_pins     = 0u,
+	pio_x        = 1u,
+	pio_y        = 2u,
+	pio_null     = 3u | 0x20u | 0x80u,
+	pio_pindirs  = 4u | 0x08u | 0x40u | 0x80u,
+	pio_exec_mov = 4u | 0x08u | 0x10u | 0x20u | 0x40u,
+	pio_status   = 5u | 0x08u | 0x10u | 0x20u | 0x80u,
+	pio_pc       = 5u | 0x08u | 0x20u | 0x40u,
+	pio_isr      = 6u | 0x20u,
+	pio_osr      = 7u | 0x10u | 0x20u,
+	pio_exec_out = 7u | 0x08u | 0x20u | 0x40u | 0x80u,
+};
+
+static inline uint pio_encode_jmp(uint addr)
+{
+	return 0x0000u | (addr & 0x1fu);
+}
+
+static inline uint pio_encode_in(enum pio_src_dest src, uint count)
+{
+	return 0x4000u | (((uint)src & 7u) << 5) | (count & 0x1fu);
+}
+
+static inline uint pio_encode_out(enum pio_src_dest dest, uint count)
+{
+	return 0x6000u | (((uint)dest & 7u) << 5) | (count & 0x1fu);
+}
+
+static inline uint pio_encode_push(bool if_full, bool block)
+{
+	return 0x8000u | ((if_full ? 1u : 0u) << 6) | ((block ? 1u : 0u) << 5);
+}
+
+static inline uint pio_encode_pull(bool if_empty, bool block)
+{
+	return 0x8080u | ((if_empty ? 1u : 0u) << 6) | ((block ? 1u : 0u) << 5);
+}
+
+static inline uint pio_encode_mov(enum pio_src_dest dest, enum pio_src_dest src)
+{
+	return 0xa000u | (((uint)dest & 7u) << 5) | ((uint)src & 7u);
+}
+
+static inline uint pio_encode_set(enum pio_src_dest dest, uint value)
+{
+	return 0xe000u | (((uint)dest & 7u) << 5) | (value & 0x1fu);
+}
+
+static inline uint pio_encode_nop(void)
+{
+	return pio_encode_mov(pio_y, pio_y);
+}
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef _PICO_FLASH_H
+#define _PICO_FLASH_H
+
+// host build of the firmware: replaced by i3cb_fw_host.h
+#include "i3cb_fw_host.h"
+
+#endif
@@ -0,0 +1,1098 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "piosim.h"
+
+#include <string.h>
+
+#define PIOSIM_PINMASK ((1u << PIOSIM_NUM_GPIOS) - 1u)
+#define PIOSIM_QUIET_MIN (64u)  // piosim_step skips quiet phases of at least this many cycles
+
+// register fields, same layout as the RP2040
+#define EXECCTRL_EXEC_STALLED  (1u << 31)
+#define EXECCTRL_SIDE_EN       (1u << 30)
+#define EXECCTRL_SIDE_PINDIR   (1u << 29)
+#define EXECCTRL_JMP_PIN(v)    (((v) >> 24) & 0x1fu)
+#define EXECCTRL_WRAP_TOP(v)   (((v) >> 12) & 0x1fu)
+#define EXECCTRL_WRAP_BOTTOM(v) (((v) >> 7) & 0x1fu)
+#define EXECCTRL_STATUS_SEL    (1u << 4)
+#define EXECCTRL_STATUS_N(v)   ((v) & 0xfu)
+#define SHIFTCTRL_FJOIN_RX     (1u << 31)
+#define SHIFTCTRL_FJOIN_TX     (1u << 30)
+#define SHIFTCTRL_PULL_THRESH(v) ((((v) >> 25) & 0x1fu) ? (((v) >> 25) & 0x1fu) : 32u)
+#define SHIFTCTRL_PUSH_THRESH(v) ((((v) >> 20) & 0x1fu) ? (((v) >> 20) & 0x1fu) : 32u)
+#define SHIFTCTRL_OUT_SHIFTDIR (1u << 19)  // 1: right
+#define SHIFTCTRL_IN_SHIFTDIR  (1u << 18)  // 1: right
+#define SHIFTCTRL_AUTOPULL     (1u << 17)
+#define SHIFTCTRL_AUTOPUSH     (1u << 16)
+#define PINCTRL_SIDESET_COUNT(v) (((v) >> 29) & 0x7u)
+#define PINCTRL_SET_COUNT(v)   (((v) >> 26) & 0x7u)
+#define PINCTRL_OUT_COUNT(v)   (((v) >> 20) & 0x3fu)
+#define PINCTRL_IN_BASE(v)     (((v) >> 15) & 0x1fu)
+#define PINCTRL_SIDESET_BASE(v) (((v) >> 10) & 0x1fu)
+#define PINCTRL_SET_BASE(v)    (((v) >> 5) & 0x1fu)
+#define PINCTRL_OUT_BASE(v)    ((v) & 0x1fu)
+#define FDEBUG_RXSTALL(sm)     (1u << (0 + (sm)))
+#define FDEBUG_RXUNDER(sm)     (1u << (8 + (sm)))
+#define FDEBUG_TXOVER(sm)      (1u << (16 + (sm)))
+#define FDEBUG_TXSTALL(sm)     (1u << (24 + (sm)))
+
+static const uint32_t piosim_pio_base[PIOSIM_NUM_PIOS] = { PIOSIM_PIO0_BASE, PIOSIM_PIO1_BASE };
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// FIFOs
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t piosim_tx_capacity(const piosim_sm_t *psm)
+{
+	if (psm->shiftctrl & SHIFTCTRL_FJOIN_TX)
+		return 2*PIOSIM_FIFO_DEPTH;
+	return (psm->shiftctrl & SHIFTCTRL_FJOIN_RX) ? 0 : PIOSIM_FIFO_DEPTH;
+}
+
+static uint32_t piosim_rx_capacity(const piosim_sm_t *psm)
+{
+	if (psm->shiftctrl & SHIFTCTRL_FJOIN_RX)
+		return 2*PIOSIM_FIFO_DEPTH;
+	return (psm->shiftctrl & SHIFTCTRL_FJOIN_TX) ? 0 : PIOSIM_FIFO_DEPTH;
+}
+
+static void piosim_fifo_push(piosim_fifo_t *pf, uint32_t value)
+{
+	pf->buf[(pf->head + pf->count) % (2*PIOSIM_FIFO_DEPTH)] = value;
+	pf->count++;
+}
+
+static uint32_t piosim_fifo_pop(piosim_fifo_t *pf)
+{
+	uint32_t value = pf->buf[pf->head];
+	pf->head = (pf->head + 1) % (2*PIOSIM_FIFO_DEPTH);
+	pf->count--;
+	return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// state machine
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static void piosim_sm_restart(piosim_sm_t *psm)
+{
+	psm->isr = 0;
+	psm->isr_count = 0;
+	psm->osr_count = 32;
+	psm->delay = 0;
+	psm->stalled = false;
+	psm->irq_waiting = false;
+	psm->exec_pending = false;
+}
+
+static void piosim_sm_reset(piosim_sm_t *psm)
+{
+	memset(psm, 0, sizeof(*psm));
+	psm->clkdiv    = 1u << 16;
+	psm->execctrl  = 0x1fu << 12;
+	psm->shiftctrl = SHIFTCTRL_OUT_SHIFTDIR | SHIFTCTRL_IN_SHIFTDIR;
+	psm->pinctrl   = 5u << 26;
+	piosim_sm_restart(psm);
+}
+
+// write count pins starting at base (wrapping at 32) with the bits of value, to the outputs or output enables
+static void piosim_write_pins(uint32_t *preg, uint32_t base, uint32_t count, uint32_t value)
+{
+	for (uint32_t i=0; i<count; i++)
+	{
+		uint32_t pin = (base + i) & 0x1fu;
+		if ((value >> i) & 1u)
+			*preg |= 1u << pin;
+		else
+			*preg &= ~(1u << pin);
+	}
+}
+
+static uint32_t piosim_rotate_in(uint32_t in, uint32_t base)
+{
+	return base ? ((in >> base) | (in << (32u - base))) : in;
+}
+
+static uint32_t piosim_irq_index(uint32_t index, unsigned sm)
+{
+	if (index & 0x10u) // relative
+		return (index & 0x4u) | ((index + sm) & 0x3u);
+	return index & 0x7u;
+}
+
+static uint32_t piosim_bitrev(uint32_t v)
+{
+	uint32_t r = 0;
+	for (int i=0; i<32; i++)
+	{
+		r = (r << 1) | (v & 1u);
+		v >>= 1;
+	}
+	return r;
+}
+
+// one instruction cycle of a state machine. in are the synchronized input levels
+static void piosim_sm_cycle(piosim_pio_t *pio, unsigned smidx, uint32_t in)
+{
+	piosim_sm_t *psm = &pio->sm[smidx];
+	uint16_t instr;
+	bool     exec;
+	bool     stall = false;
+	bool     jump = false;
+	uint32_t delay, sidecount, sidebits, side = 0;
+	bool     side_active;
+	uint32_t pull_thresh = SHIFTCTRL_PULL_THRESH(psm->shiftctrl);
+	uint32_t push_thresh = SHIFTCTRL_PUSH_THRESH(psm->shiftctrl);
+	uint32_t op, arg1, arg2, index;
+
+	if ( (psm->delay > 0) && !psm->exec_pending )
+	{
+		psm->delay--;
+		return;
+	}
+	psm->delay = 0;
+	exec  = psm->exec_pending;
+	instr = exec ? psm->exec_instr : pio->instr_mem[psm->pc];
+	psm->instructions++;
+
+	// decode delay and side-set. With SIDE_EN the msb of the side-set field enables it
+	sidecount   = PINCTRL_SIDESET_COUNT(psm->pinctrl);
+	delay       = (instr >> 8) & (0x1fu >> sidecount);
+	sidebits    = sidecount;
+	side_active = sidecount > 0;
+	if (sidecount > 0)
+	{
+		side = ((instr >> 8) & 0x1fu) >> (5u - sidecount);
+		if (psm->execctrl & EXECCTRL_SIDE_EN)
+		{
+			sidebits--;
+			side_active = (side >> sidebits) & 1u;
+			side &= (1u << sidebits) - 1u;
+		}
+	}
+
+	op    = instr >> 13;
+	arg1  = (instr >> 5) & 0x7u;
+	arg2  = instr & 0x1fu;
+	index = arg2 ? arg2 : 32u; // bit count of IN/OUT
+	switch (op)
+	{
+		case 0: // JMP
+		{
+			bool cond = false;
+			switch (arg1)
+			{
+				case 0: cond = true; break;
+				case 1: cond = (psm->x == 0); break;
+				case 2: cond = (psm->x != 0); psm->x--; break;
+				case 3: cond = (psm->y == 0); break;
+				case 4: cond = (psm->y != 0); psm->y--; break;
+				case 5: cond = (psm->x != psm->y); break;
+				case 6: cond = (in >> EXECCTRL_JMP_PIN(psm->execctrl)) & 1u; break;
+				case 7: cond = (psm->osr_count < pull_thresh); break;
+			}
+			if (cond)
+			{
+				psm->pc = arg2;
+				jump = true;
+			}
+			break;
+		}
+		case 1: // WAIT
+		{
+			uint32_t polarity = (instr >> 7) & 1u;
+			uint32_t source = (instr >> 5) & 3u;
+			uint32_t value = 0;
+			if (source == 0)
+				value = (in >> arg2) & 1u;
+			else if (source == 1)
+				value = (piosim_rotate_in(in, PINCTRL_IN_BASE(psm->pinctrl)) >> arg2) & 1u;
+			else if (source == 2)
+				value = (pio->irq >> piosim_irq_index(arg2, smidx)) & 1u;
+			if (value != polarity)
+				stall = true;
+			else if ( (source == 2) && polarity )
+				pio->irq &= ~(1u << piosim_irq_index(arg2, smidx));
+			break;
+		}
+		case 2: // IN
+		{
+			uint32_t data = 0;
+			uint32_t count;
+			switch (arg1)
+			{
+				case 0: data = piosim_rotate_in(in, PINCTRL_IN_BASE(psm->pinctrl)); break;
+				case 1: data = psm->x; break;
+				case 2: data = psm->y; break;
+				case 6: data = psm->isr; break;
+				case 7: data = psm->osr; break;
+				default: break;
+			}
+			if (index < 32)
+				data &= (1u << index) - 1u;
+			count = psm->isr_count + index;
+			if (count > 32)
+				count = 32;
+			if ( (psm->shiftctrl & SHIFTCTRL_AUTOPUSH) && (count >= push_thresh) && (psm->rx.count >= piosim_rx_capacity(psm)) )
+			{
+				stall = true;
+				break;
+			}
+			if (index == 32)
+				psm->isr = data;
+			else if (psm->shiftctrl & SHIFTCTRL_IN_SHIFTDIR)
+				psm->isr = (psm->isr >> index) | (data << (32u - index));
+			else
+				psm->isr = (psm->isr << index) | data;
+			psm->isr_count = count;
+			if ( (psm->shiftctrl & SHIFTCTRL_AUTOPUSH) && (count >= push_thresh) )
+			{
+				piosim_fifo_push(&psm->rx, psm->isr);
+				psm->isr = 0;
+				psm->isr_count = 0;
+			}
+			break;
+		}
+		case 3: // OUT
+		{
+			uint32_t data;
+			if ( (psm->shiftctrl & SHIFTCTRL_AUTOPULL) && (psm->osr_count >= pull_thresh) )
+			{
+				if (psm->tx.count == 0)
+				{
+					pio->fdebug |= FDEBUG_TXSTALL(smidx);
+					stall = true;
+					break;
+				}
+				psm->osr = piosim_fifo_pop(&psm->tx);
+				psm->osr_count = 0;
+			}
+			if (index == 32)
+			{
+				data = psm->osr;
+				psm->osr = 0;
+			}
+			else if (psm->shiftctrl & SHIFTCTRL_OUT_SHIFTDIR)
+			{
+				data = psm->osr & ((1u << index) - 1u);
+				psm->osr >>= index;
+			}
+			else
+			{
+				data = psm->osr >> (32u - index);
+				psm->osr <<= index;
+			}
+			psm->osr_count = (psm->osr_count + index > 32u) ? 32u : psm->osr_count + index;
+			switch (arg1)
+			{
+				case 0: piosim_write_pins(&pio->pad_out, PINCTRL_OUT_BASE(psm->pinctrl), PINCTRL_OUT_COUNT(psm->pinctrl), data); break;
+				case 1: psm->x = data; break;
+				case 2: psm->y = data; break;
+				case 3: break;
+				case 4: piosim_write_pins(&pio->pad_oe, PINCTRL_OUT_BASE(psm->pinctrl), PINCTRL_OUT_COUNT(psm->pinctrl), data); break;
+				case 5: psm->pc = data & 0x1fu; jump = true; break;
+				case 6: psm->isr = data; psm->isr_count = index; break;
+				case 7: // executed in the next cycle, the delay of the OUT is ignored
+					psm->exec_instr = (uint16_t)data;
+					delay = 0;
+					break;
+			}
+			break;
+		}
+		case 4: // PUSH / PULL
+		{
+			bool ifcond = (instr >> 6) & 1u;
+			bool block  = (instr >> 5) & 1u;
+			if ((instr & 0x80u) == 0)
+			{ // PUSH
+				if (ifcond && (psm->isr_count < push_thresh))
+					break;
+				if (psm->rx.count >= piosim_rx_capacity(psm))
+				{
+					if (block)
+					{
+						stall = true;
+						break;
+					}
+					pio->fdebug |= FDEBUG_RXSTALL(smidx);
+				}
+				else
+				{
+					piosim_fifo_push(&psm->rx, psm->isr);
+				}
+				psm->isr = 0;
+				psm->isr_count = 0;
+			}
+			else
+			{ // PULL
+				if (ifcond && (psm->osr_count < pull_thresh))
+					break;
+				if (psm->tx.count == 0)
+				{
+					if (block)
+					{
+						pio->fdebug |= FDEBUG_TXSTALL(smidx);
+						stall = true;
+						break;
+					}
+					psm->osr = psm->x;
+				}
+				else
+				{
+					psm->osr = piosim_fifo_pop(&psm->tx);
+				}
+				psm->osr_count = 0;
+			}
+			break;
+		}
+		case 5: // MOV
+		{
+			uint32_t data = 0;
+			switch (instr & 0x7u)
+			{
+				case 0: data = piosim_rotate_in(in, PINCTRL_IN_BASE(psm->pinctrl)); break;
+				case 1: data = psm->x; break;
+				case 2: data = psm->y; break;
+				case 5:
+				{
+					uint32_t level = (psm->execctrl & EXECCTRL_STATUS_SEL) ? psm->rx.count : psm->tx.count;
+					data = (level < EXECCTRL_STATUS_N(psm->execctrl)) ? 0xffffffffu : 0;
+					break;
+				}
+				case 6: data = psm->isr; break;
+				case 7: data = psm->osr; break;
+				default: break;
+			}
+			if (((instr >> 3) & 3u) == 1)
+				data = ~data;
+			else if (((instr >> 3) & 3u) == 2)
+				data = piosim_bitrev(data);
+			switch (arg1)
+			{
+				case 0: piosim_write_pins(&pio->pad_out, PINCTRL_OUT_BASE(psm->pinctrl), PINCTRL_OUT_COUNT(psm->pinctrl), data); break;
+				case 1: psm->x = data; break;
+				case 2: psm->y = data; break;
+				case 4: psm->exec_instr = (uint16_t)data; delay = 0; break;
+				case 5: psm->pc = data & 0x1fu; jump = true; break;
+				case 6: psm->isr = data; psm->isr_count = 0; break;
+				case 7: psm->osr = data; psm->osr_count = 0; break;
+				default: break;
+			}
+			break;
+		}
+		case 6: // IRQ
+		{
+			uint32_t bit = 1u << piosim_irq_index(arg2, smidx);
+			if (instr & 0x40u)
+			{
+				pio->irq &= ~bit;
+			}
+			else if (!psm->irq_waiting)
+			{
+				pio->irq |= bit;
+				if (instr & 0x20u)
+				{
+					psm->irq_waiting = true;
+					stall = true;
+				}
+			}
+			else if (pio->irq & bit)
+			{
+				stall = true;
+			}
+			else
+			{
+				psm->irq_waiting = false;
+			}
+			break;
+		}
+		case 7: // SET
+		{
+			switch (arg1)
+			{
+				case 0: piosim_write_pins(&pio->pad_out, PINCTRL_SET_BASE(psm->pinctrl), PINCTRL_SET_COUNT(psm->pinctrl), arg2); break;
+				case 1: psm->x = arg2; break;
+				case 2: psm->y = arg2; break;
+				case 4: piosim_write_pins(&pio->pad_oe, PINCTRL_SET_BASE(psm->pinctrl), PINCTRL_SET_COUNT(psm->pinctrl), arg2); break;
+				default: break;
+			}
+			break;
+		}
+	}
+
+	// side-set is asserted from the first cycle of an instruction, also when it stalls, and wins over OUT/SET
+	if (side_active && (sidebits > 0))
+	{
+		uint32_t *preg = (psm->execctrl & EXECCTRL_SIDE_PINDIR) ? &pio->pad_oe : &pio->pad_out;
+		piosim_write_pins(preg, PINCTRL_SIDESET_BASE(psm->pinctrl), sidebits, side);
+	}
+
+	psm->stalled = stall;
+	if (stall)
+		return;
+
+	psm->exec_pending = false;
+	if ( ((op == 3) && (arg1 == 7)) || ((op == 5) && (arg1 == 4)) )
+		psm->exec_pending = true; // OUT/MOV EXEC
+	if (!jump && !exec)
+	{
+		if (psm->pc == EXECCTRL_WRAP_TOP(psm->execctrl))
+			psm->pc = EXECCTRL_WRAP_BOTTOM(psm->execctrl);
+		else
+			psm->pc = (psm->pc + 1u) & 0x1fu;
+	}
+	psm->delay = delay;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// pins and VCD trace
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static void piosim_pads(const piosim_t *ps, uint32_t *pout, uint32_t *poe)
+{
+	uint32_t out = 0, oe = 0;
+	for (unsigned i=0; i<PIOSIM_NUM_GPIOS; i++)
+	{
+		const piosim_pio_t *pio;
+		if (ps->funcsel[i] == PIOSIM_FUNCSEL_PIO0)
+			pio = &ps->pio[0];
+		else if (ps->funcsel[i] == PIOSIM_FUNCSEL_PIO1)
+			pio = &ps->pio[1];
+		else
+			continue;
+		out |= pio->pad_out & (1u << i);
+		oe  |= pio->pad_oe  & (1u << i);
+	}
+	*pout = out;
+	*poe  = oe;
+}
+
+static uint32_t piosim_pulled_low(const piosim_t *ps)
+{
+	uint32_t pulled = 0;
+	for (const piosim_device_t *pdev = ps->devices; pdev; pdev = pdev->next)
+		pulled |= pdev->pull_low;
+	return pulled;
+}
+
+// identifier code of a traced signal: one or two printable characters
+static const char *piosim_vcd_id(unsigned index, char *pid)
+{
+	pid[0] = (char)('!' + index % 94u);
+	pid[1] = (index >= 94u) ? (char)('!' + index / 94u) : 0;
+	pid[2] = 0;
+	return pid;
+}
+
+static void piosim_vcd_time(piosim_t *ps)
+{
+	fprintf(ps->vcd, "#%llu\n", (unsigned long long)(ps->cycle * 1000000000ull / ps->sysclk_khz));
+}
+
+static void piosim_vcd_dump(piosim_t *ps, bool force)
+{
+	uint32_t out, oe, pulled;
+	bool     stamped = false;
+
+	if (!ps->vcd)
+		return;
+	piosim_pads(ps, &out, &oe);
+	pulled = piosim_pulled_low(ps);
+	for (unsigned i=0; i<PIOSIM_NUM_GPIOS; i++)
+	{
+		uint32_t bit = 1u << i;
+		if ((ps->vcd_pins & bit) == 0)
+			continue;
+		if ( force || ((ps->levels ^ ps->vcd_levels) & bit) || ((oe ^ ps->vcd_oe) & bit) || ((pulled ^ ps->vcd_pulled) & bit) )
+		{
+			if (!stamped)
+				piosim_vcd_time(ps);
+			stamped = true;
+			char id[3];
+			fprintf(ps->vcd, "%u%s\n", (ps->levels >> i) & 1u, piosim_vcd_id(3*i, id));
+			fprintf(ps->vcd, "%u%s\n", (oe >> i) & 1u, piosim_vcd_id(3*i+1, id));
+			fprintf(ps->vcd, "%u%s\n", (pulled >> i) & 1u, piosim_vcd_id(3*i+2, id));
+		}
+	}
+	for (unsigned p=0; p<PIOSIM_NUM_PIOS; p++)
+	{
+		for (unsigned sm=0; sm<PIOSIM_NUM_SMS; sm++)
+		{
+			uint8_t pc = ps->pio[p].sm[sm].pc;
+			if ( (ps->vcd_sms & (1u << (p*PIOSIM_NUM_SMS + sm))) == 0 )
+				continue;
+			if ( force || (pc != ps->vcd_pc[p][sm]) )
+			{
+				if (!stamped)
+					piosim_vcd_time(ps);
+				stamped = true;
+				fprintf(ps->vcd, "b");
+				for (int b=4; b>=0; b--)
+					fputc('0' + ((pc >> b) & 1), ps->vcd);
+				char id[3];
+				fprintf(ps->vcd, " %s\n", piosim_vcd_id(3*PIOSIM_NUM_GPIOS + p*PIOSIM_NUM_SMS + sm, id));
+				ps->vcd_pc[p][sm] = pc;
+			}
+		}
+	}
+	ps->vcd_levels = ps->levels;
+	ps->vcd_oe     = oe;
+	ps->vcd_pulled = pulled;
+}
+
+// resolve the pin levels from the PIO outputs, the devices and the pull-ups. Devices react on changes immediately,
+// so this repeats until the levels are stable
+static void piosim_resolve(piosim_t *ps)
+{
+	uint32_t out, oe, pulled, levels;
+
+	for (int iteration=0; iteration<16; iteration++)
+	{
+		uint32_t changed;
+
+		piosim_pads(ps, &out, &oe);
+		pulled = piosim_pulled_low(ps);
+		levels = ~((oe & ~out) | pulled) & ((oe & out) | ps->pullup | (ps->levels & ~ps->pullup)) & PIOSIM_PINMASK;
+		changed = levels ^ ps->levels;
+		if (changed == 0)
+			break;
+		ps->levels = levels;
+		for (piosim_device_t *pdev = ps->devices; pdev; pdev = pdev->next)
+			pdev->update(ps, pdev, levels, changed);
+	}
+	if (oe & out & pulled)
+		ps->contention++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// simulation
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static void piosim_cycle(piosim_t *ps)
+{
+	for (unsigned p=0; p<PIOSIM_NUM_PIOS; p++)
+	{
+		piosim_pio_t *pio = &ps->pio[p];
+		uint32_t in = (ps->levels & pio->input_sync_bypass) | (ps->sync[1] & ~pio->input_sync_bypass);
+
+		for (unsigned sm=0; sm<PIOSIM_NUM_SMS; sm++)
+		{
+			piosim_sm_t *psm = &pio->sm[sm];
+			uint32_t div;
+
+			if ((pio->ctrl & (1u << sm)) == 0)
+			{ // instructions written to SMx_INSTR execute on a disabled state machine as well
+				if (psm->exec_pending)
+					piosim_sm_cycle(pio, sm, in);
+				continue;
+			}
+			div = psm->clkdiv >> 8;
+			if ((div >> 8) == 0)
+				div += 65536u << 8; // INT = 0 divides by 65536
+			psm->divacc += 256u;
+			if (psm->divacc < div)
+				continue;
+			psm->divacc -= div;
+			piosim_sm_cycle(pio, sm, in);
+		}
+	}
+	ps->sync[1] = ps->sync[0];
+	ps->sync[0] = ps->levels;
+	ps->cycle++;
+	piosim_resolve(ps);
+
+	for (piosim_device_t *pdev = ps->devices; pdev; pdev = pdev->next)
+	{
+		if (pdev->wakeup <= ps->cycle)
+		{
+			pdev->wakeup = UINT64_MAX;
+			pdev->update(ps, pdev, ps->levels, 0);
+			piosim_resolve(ps);
+		}
+	}
+	piosim_vcd_dump(ps, false);
+}
+
+void piosim_init(piosim_t *ps, uint32_t sysclk_khz)
+{
+	memset(ps, 0, sizeof(*ps));
+	ps->sysclk_khz    = sysclk_khz;
+	ps->access_cycles = 1;
+	ps->pullup        = PIOSIM_PINMASK;
+	ps->levels        = PIOSIM_PINMASK;
+	ps->sync[0]       = PIOSIM_PINMASK;
+	ps->sync[1]       = PIOSIM_PINMASK;
+	for (unsigned i=0; i<PIOSIM_NUM_GPIOS; i++)
+		ps->funcsel[i] = PIOSIM_FUNCSEL_NULL;
+	for (unsigned p=0; p<PIOSIM_NUM_PIOS; p++)
+		for (unsigned sm=0; sm<PIOSIM_NUM_SMS; sm++)
+			piosim_sm_reset(&ps->pio[p].sm[sm]);
+}
+
+// count of the following cycles in which nothing but the clock dividers changes: every enabled state machine stalls in a
+// blocking PULL on an empty TX FIFO, the input synchronizers settled and no device asked for a call. At most maxcycles
+static uint64_t piosim_quiet_cycles(const piosim_t *ps, uint64_t maxcycles)
+{
+	if ( (ps->sync[0] != ps->levels) || (ps->sync[1] != ps->levels) )
+		return 0;
+	for (unsigned p=0; p<PIOSIM_NUM_PIOS; p++)
+	{
+		const piosim_pio_t *pio = &ps->pio[p];
+
+		for (unsigned sm=0; sm<PIOSIM_NUM_SMS; sm++)
+		{
+			const piosim_sm_t *psm = &pio->sm[sm];
+
+			if (psm->exec_pending)
+				return 0;
+			if ((pio->ctrl & (1u << sm)) == 0)
+				continue;
+			if ( !psm->stalled || (psm->delay > 0) || (psm->tx.count != 0) || ((pio->instr_mem[psm->pc] & 0xe0a0u) != 0x80a0u) )
+				return 0;
+		}
+	}
+	for (const piosim_device_t *pdev = ps->devices; pdev; pdev = pdev->next)
+	{
+		if (pdev->wakeup <= ps->cycle + maxcycles)
+			maxcycles = (pdev->wakeup > ps->cycle) ? (pdev->wakeup - ps->cycle - 1u) : 0;
+	}
+	return maxcycles;
+}
+
+// advance by quiet cycles at once, with the same result as cycle by cycle
+static void piosim_skip(piosim_t *ps, uint64_t cycles)
+{
+	uint32_t out, oe;
+
+	for (unsigned p=0; p<PIOSIM_NUM_PIOS; p++)
+	{
+		piosim_pio_t *pio = &ps->pio[p];
+
+		for (unsigned sm=0; sm<PIOSIM_NUM_SMS; sm++)
+		{
+			piosim_sm_t *psm = &pio->sm[sm];
+			uint64_t     acc, div;
+
+			if ((pio->ctrl & (1u << sm)) == 0)
+				continue;
+			div = psm->clkdiv >> 8;
+			if ((div >> 8) == 0)
+				div += 65536u << 8;
+			acc = psm->divacc + 256u * cycles;
+			psm->divacc = (uint32_t)(acc % div);
+			if (acc >= div)
+			{ // the stalled PULL executes again with every clock enable
+				psm->instructions += acc / div;
+				pio->fdebug |= FDEBUG_TXSTALL(sm);
+			}
+		}
+	}
+	piosim_pads(ps, &out, &oe);
+	if (oe & out & piosim_pulled_low(ps))
+		ps->contention += cycles;
+	ps->cycle += cycles;
+}
+
+void piosim_step(piosim_t *ps, uint64_t cycles)
+{
+	while (cycles > 0)
+	{
+		uint64_t n;
+
+		// cycle by cycle first, this also resolves changes from outside (register writes, device pulls)
+		for (n = (cycles < PIOSIM_QUIET_MIN) ? cycles : PIOSIM_QUIET_MIN; n > 0; n--)
+		{
+			piosim_cycle(ps);
+			cycles--;
+		}
+		n = (cycles >= PIOSIM_QUIET_MIN) ? piosim_quiet_cycles(ps, cycles) : 0;
+		if (n >= PIOSIM_QUIET_MIN)
+		{ // e.g. sleep_us on an idle bus
+			piosim_skip(ps, n);
+			cycles -= n;
+		}
+	}
+}
+
+bool piosim_run_until_stalled(piosim_t *ps, unsigned pio, uint64_t maxcycles)
+{
+	piosim_pio_t *ppio = &ps->pio[pio];
+
+	for (uint64_t i=0; i<=maxcycles; i++)
+	{
+		bool idle = true;
+		for (unsigned sm=0; sm<PIOSIM_NUM_SMS; sm++)
+		{
+			const piosim_sm_t *psm = &ppio->sm[sm];
+			uint16_t instr = psm->exec_pending ? psm->exec_instr : ppio->instr_mem[psm->pc];
+			if ((ppio->ctrl & (1u << sm)) == 0)
+				continue;
+			if ( (psm->tx.count != 0) || !psm->stalled || ((instr & 0xe080u) != 0x8080u) )
+				idle = false;
+		}
+		if (idle)
+			return true;
+		if (i < maxcycles)
+			piosim_cycle(ps);
+	}
+	return false;
+}
+
+bool piosim_dreq(const piosim_t *ps, unsigned dreq)
+{
+	const piosim_sm_t *psm;
+
+	if (dreq >= 4*PIOSIM_NUM_SMS)
+		return false;
+	psm = &ps->pio[dreq / (2*PIOSIM_NUM_SMS)].sm[dreq % PIOSIM_NUM_SMS];
+	if ((dreq % (2*PIOSIM_NUM_SMS)) < PIOSIM_NUM_SMS)
+		return psm->tx.count < piosim_tx_capacity(psm);
+	return psm->rx.count != 0;
+}
+
+uint64_t piosim_cycles_to_ns(const piosim_t *ps, uint64_t cycles)
+{
+	return (cycles * 1000000ull) / ps->sysclk_khz;
+}
+
+uint64_t piosim_time_ns(const piosim_t *ps)
+{
+	return piosim_cycles_to_ns(ps, ps->cycle);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// registers
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t piosim_pio_read(piosim_t *ps, piosim_pio_t *pio, uint32_t offset, bool sideeffects)
+{
+	uint32_t value = 0;
+
+	if (offset == PIOSIM_CTRL)
+		return pio->ctrl;
+	if (offset == PIOSIM_FSTAT)
+	{
+		for (unsigned sm=0; sm<PIOSIM_NUM_SMS; sm++)
+		{
+			const piosim_sm_t *psm = &pio->sm[sm];
+			value |= (psm->rx.count >= piosim_rx_capacity(psm)) ? (1u << (0 + sm)) : 0;
+			value |= (psm->rx.count == 0) ? (1u << (8 + sm)) : 0;
+			value |= (psm->tx.count >= piosim_tx_capacity(psm)) ? (1u << (16 + sm)) : 0;
+			value |= (psm->tx.count == 0) ? (1u << (24 + sm)) : 0;
+		}
+		return value;
+	}
+	if (offset == PIOSIM_FDEBUG)
+		return pio->fdebug;
+	if (offset == PIOSIM_FLEVEL)
+	{
+		for (unsigned sm=0; sm<PIOSIM_NUM_SMS; sm++)
+			value |= ((pio->sm[sm].tx.count & 0xfu) | ((pio->sm[sm].rx.count & 0xfu) << 4)) << (8*sm);
+		return value;
+	}
+	if ( (offset >= PIOSIM_RXF0) && (offset < PIOSIM_RXF0 + 4*PIOSIM_NUM_SMS) )
+	{
+		unsigned sm = (offset - PIOSIM_RXF0) / 4;
+		piosim_sm_t *psm = &pio->sm[sm];
+		if (!sideeffects)
+			return psm->rx.count ? psm->rx.buf[psm->rx.head] : 0;
+		if (psm->rx.count == 0)
+		{
+			pio->fdebug |= FDEBUG_RXUNDER(sm);
+			return 0;
+		}
+		return piosim_fifo_pop(&psm->rx);
+	}
+	if (offset == PIOSIM_IRQ)
+		return pio->irq;
+	if (offset == PIOSIM_INPUT_SYNC_BYPASS)
+		return pio->input_sync_bypass;
+	if (offset == PIOSIM_DBG_PADOUT)
+		return pio->pad_out;
+	if (offset == PIOSIM_DBG_PADOE)
+		return pio->pad_oe;
+	if ( (offset >= PIOSIM_SM0_CLKDIV) && (offset < PIOSIM_SM0_CLKDIV + PIOSIM_NUM_SMS*PIOSIM_SM_STRIDE) )
+	{
+		piosim_sm_t *psm = &pio->sm[(offset - PIOSIM_SM0_CLKDIV) / PIOSIM_SM_STRIDE];
+		switch ((offset - PIOSIM_SM0_CLKDIV) % PIOSIM_SM_STRIDE + PIOSIM_SM0_CLKDIV)
+		{
+			case PIOSIM_SM0_CLKDIV:    return psm->clkdiv;
+			case PIOSIM_SM0_EXECCTRL:  return psm->execctrl | ((psm->exec_pending && psm->stalled) ? EXECCTRL_EXEC_STALLED : 0);
+			case PIOSIM_SM0_SHIFTCTRL: return psm->shiftctrl;
+			case PIOSIM_SM0_ADDR:      return psm->pc;
+			case PIOSIM_SM0_INSTR:     return psm->exec_pending ? psm->exec_instr : pio->instr_mem[psm->pc];
+			case PIOSIM_SM0_PINCTRL:   return psm->pinctrl;
+		}
+	}
+	(void)ps;
+	return 0;
+}
+
+static void piosim_pio_write(piosim_t *ps, piosim_pio_t *pio, uint32_t offset, uint32_t value)
+{
+	if (offset == PIOSIM_CTRL)
+	{
+		pio->ctrl = value & 0xfu;
+		for (unsigned sm=0; sm<PIOSIM_NUM_SMS; sm++)
+		{
+			if (value & (1u << (4 + sm)))
+				piosim_sm_restart(&pio->sm[sm]);
+			if (value & (1u << (8 + sm)))
+				pio->sm[sm].divacc = 0;
+		}
+	}
+	else if (offset == PIOSIM_FDEBUG)
+	{
+		pio->fdebug &= ~value;
+	}
+	else if ( (offset >= PIOSIM_TXF0) && (offset < PIOSIM_TXF0 + 4*PIOSIM_NUM_SMS) )
+	{
+		unsigned sm = (offset - PIOSIM_TXF0) / 4;
+		piosim_sm_t *psm = &pio->sm[sm];
+		if (psm->tx.count >= piosim_tx_capacity(psm))
+			pio->fdebug |= FDEBUG_TXOVER(sm);
+		else
+			piosim_fifo_push(&psm->tx, value);
+	}
+	else if (offset == PIOSIM_IRQ)
+	{
+		pio->irq &= ~value;
+	}
+	else if (offset == PIOSIM_IRQ_FORCE)
+	{
+		pio->irq |= value & 0xffu;
+	}
+	else if (offset == PIOSIM_INPUT_SYNC_BYPASS)
+	{
+		pio->input_sync_bypass = value;
+	}
+	else if ( (offset >= PIOSIM_INSTR_MEM0) && (offset < PIOSIM_INSTR_MEM0 + 4*32) )
+	{
+		pio->instr_mem[(offset - PIOSIM_INSTR_MEM0) / 4] = (uint16_t)value;
+	}
+	else if ( (offset >= PIOSIM_SM0_CLKDIV) && (offset < PIOSIM_SM0_CLKDIV + PIOSIM_NUM_SMS*PIOSIM_SM_STRIDE) )
+	{
+		piosim_sm_t *psm = &pio->sm[(offset - PIOSIM_SM0_CLKDIV) / PIOSIM_SM_STRIDE];
+		switch ((offset - PIOSIM_SM0_CLKDIV) % PIOSIM_SM_STRIDE + PIOSIM_SM0_CLKDIV)
+		{
+			case PIOSIM_SM0_CLKDIV:
+				psm->clkdiv = value & 0xffffff00u;
+				break;
+			case PIOSIM_SM0_EXECCTRL:
+				psm->execctrl = value & ~EXECCTRL_EXEC_STALLED;
+				break;
+			case PIOSIM_SM0_SHIFTCTRL:
+				if ((value ^ psm->shiftctrl) & (SHIFTCTRL_FJOIN_RX | SHIFTCTRL_FJOIN_TX))
+				{ // changing the FIFO join flushes both FIFOs
+					psm->tx.count = 0;
+					psm->rx.count = 0;
+				}
+				psm->shiftctrl = value;
+				break;
+			case PIOSIM_SM0_INSTR:
+				psm->exec_pending = true;
+				psm->exec_instr = (uint16_t)value;
+				psm->stalled = false;
+				break;
+			case PIOSIM_SM0_PINCTRL:
+				psm->pinctrl = value;
+				break;
+		}
+	}
+	(void)ps;
+}
+
+static uint32_t piosim_io_read(piosim_t *ps, uint32_t offset)
+{
+	uint32_t out, oe, gpio = offset / 8;
+
+	if (gpio >= PIOSIM_NUM_GPIOS)
+		return 0;
+	if (offset & 4u)
+		return ps->funcsel[gpio];
+	piosim_pads(ps, &out, &oe);
+	return (((out >> gpio) & 1u) << 8) | (((out >> gpio) & 1u) << 9) | (((oe >> gpio) & 1u) << 12) | (((oe >> gpio) & 1u) << 13) |
+	       (((ps->levels >> gpio) & 1u) << 17) | (((ps->levels >> gpio) & 1u) << 19);
+}
+
+static void piosim_io_write(piosim_t *ps, uint32_t offset, uint32_t value)
+{
+	uint32_t gpio = offset / 8;
+
+	if ( (gpio < PIOSIM_NUM_GPIOS) && (offset & 4u) )
+	{
+		ps->funcsel[gpio] = value & 0x1fu;
+		piosim_resolve(ps);
+	}
+}
+
+static piosim_pio_t *piosim_pio_at(piosim_t *ps, uint32_t base)
+{
+	for (unsigned p=0; p<PIOSIM_NUM_PIOS; p++)
+		if (base == piosim_pio_base[p])
+			return &ps->pio[p];
+	return NULL;
+}
+
+uint32_t piosim_read32(piosim_t *ps, uint32_t addr)
+{
+	uint32_t      base = addr & ~0x3fffu;
+	uint32_t      offset = addr & 0xfffu;
+	piosim_pio_t *pio = piosim_pio_at(ps, base);
+
+	piosim_step(ps, ps->access_cycles);
+	if (pio)
+		return piosim_pio_read(ps, pio, offset, true);
+	if (base == PIOSIM_IO_BANK0_BASE)
+		return piosim_io_read(ps, offset);
+	return 0;
+}
+
+void piosim_write32(piosim_t *ps, uint32_t addr, uint32_t value)
+{
+	uint32_t      base = addr & ~0x3fffu;
+	uint32_t      offset = addr & 0xfffu;
+	uint32_t      alias = addr & 0x3000u;
+	piosim_pio_t *pio = piosim_pio_at(ps, base);
+
+	piosim_step(ps, ps->access_cycles);
+	if (pio)
+	{
+		bool w1c = (offset == PIOSIM_FDEBUG) || (offset == PIOSIM_IRQ);
+		if ( (alias != 0) && !w1c && (offset != PIOSIM_CTRL) )
+		{
+			uint32_t old = piosim_pio_read(ps, pio, offset, false);
+			value = (alias == PIOSIM_ALIAS_XOR) ? (old ^ value) : (alias == PIOSIM_ALIAS_SET) ? (old | value) : (old & ~value);
+		}
+		else if (offset == PIOSIM_CTRL)
+		{ // the restart bits only act on the written bits
+			uint32_t restart = value & 0xff0u;
+			value = (alias == PIOSIM_ALIAS_XOR) ? (pio->ctrl ^ value) : (alias == PIOSIM_ALIAS_SET) ? (pio->ctrl | value) :
+			        (alias == PIOSIM_ALIAS_CLR) ? (pio->ctrl & ~value) : value;
+			value = (value & 0xfu) | ((alias == PIOSIM_ALIAS_CLR) ? 0 : restart);
+		}
+		piosim_pio_write(ps, pio, offset, value);
+	}
+	else if (base == PIOSIM_IO_BANK0_BASE)
+	{
+		if (alias != 0)
+		{
+			uint32_t old = piosim_io_read(ps, offset);
+			value = (alias == PIOSIM_ALIAS_XOR) ? (old ^ value) : (alias == PIOSIM_ALIAS_SET) ? (old | value) : (old & ~value);
+		}
+		piosim_io_write(ps, offset, value);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// devices and trace
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+void piosim_attach(piosim_t *ps, piosim_device_t *pdev, piosim_device_fn update, void *ctx)
+{
+	pdev->update   = update;
+	pdev->ctx      = ctx;
+	pdev->pull_low = 0;
+	pdev->wakeup   = UINT64_MAX;
+	pdev->next     = ps->devices;
+	ps->devices    = pdev;
+}
+
+void piosim_detach(piosim_t *ps, piosim_device_t *pdev)
+{
+	for (piosim_device_t **pp = &ps->devices; *pp; pp = &(*pp)->next)
+	{
+		if (*pp == pdev)
+		{
+			*pp = pdev->next;
+			break;
+		}
+	}
+	piosim_resolve(ps);
+}
+
+void piosim_pull(piosim_t *ps, piosim_device_t *pdev, uint32_t mask, bool low)
+{
+	if (low)
+		pdev->pull_low |= mask;
+	else
+		pdev->pull_low &= ~mask;
+	(void)ps; // the levels are resolved by the caller of the device update, or in the next cycle
+}
+
+void piosim_wakeup(piosim_t *ps, piosim_device_t *pdev, uint64_t cycle)
+{
+	pdev->wakeup = cycle;
+	(void)ps;
+}
+
+void piosim_vcd_pin(piosim_t *ps, unsigned gpio, const char *name)
+{
+	if (gpio >= PIOSIM_NUM_GPIOS)
+		return;
+	ps->vcd_pins |= 1u << gpio;
+	snprintf(ps->vcd_names[gpio], sizeof(ps->vcd_names[gpio]), "%s", name);
+}
+
+void piosim_vcd_sm(piosim_t *ps, unsigned pio, unsigned sm)
+{
+	if ( (pio < PIOSIM_NUM_PIOS) && (sm < PIOSIM_NUM_SMS) )
+		ps->vcd_sms |= 1u << (pio*PIOSIM_NUM_SMS + sm);
+}
+
+bool piosim_vcd_open(piosim_t *ps, const char *path)
+{
+	char id[3];
+
+	ps->vcd = fopen(path, "w");
+	if (!ps->vcd)
+		return false;
+	fprintf(ps->vcd, "$date simulated $end\n$version piosim $end\n$timescale 1ps $end\n$scope module rp2040 $end\n");
+	for (unsigned i=0; i<PIOSIM_NUM_GPIOS; i++)
+	{
+		if ((ps->vcd_pins & (1u << i)) == 0)
+			continue;
+		fprintf(ps->vcd, "$var wire 1 %s %s $end\n", piosim_vcd_id(3*i, id), ps->vcd_names[i]);
+		fprintf(ps->vcd, "$var wire 1 %s %s_oe $end\n", piosim_vcd_id(3*i+1, id), ps->vcd_names[i]);
+		fprintf(ps->vcd, "$var wire 1 %s %s_pulled $end\n", piosim_vcd_id(3*i+2, id), ps->vcd_names[i]);
+	}
+	for (unsigned p=0; p<PIOSIM_NUM_PIOS; p++)
+		for (unsigned sm=0; sm<PIOSIM_NUM_SMS; sm++)
+			if (ps->vcd_sms & (1u << (p*PIOSIM_NUM_SMS + sm)))
+				fprintf(ps->vcd, "$var reg 5 %s pio%u_sm%u_pc $end\n", piosim_vcd_id(3*PIOSIM_NUM_GPIOS + p*PIOSIM_NUM_SMS + sm, id), p, sm);
+	fprintf(ps->vcd, "$upscope $end\n$enddefinitions $end\n");
+	piosim_vcd_dump(ps, true);
+	return true;
+}
+
+void piosim_vcd_close(piosim_t *ps)
+{
+	if (ps->vcd)
+	{
+		piosim_vcd_time(ps);
+		fclose(ps->vcd);
+		ps->vcd = NULL;
+	}
+}
@@ -0,0 +1,180 @@
+#ifndef _PIOSIM_H
+#define _PIOSIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Cycle accurate model of the two RP2040 PIO blocks and the GPIOs they drive, to run the programs of src/i3c.pio on
+ * a host.
+ *
+ * The model is accessed like the hardware through the register addresses of PIO0, PIO1 and IO_BANK0 (incl. the atomic
+ * XOR/SET/CLR aliases), see piosim_read32 / piosim_write32. Every access first advances the simulation by
+ * access_cycles system clock cycles, which models the bus access time of the CPU and lets polling loops make progress.
+ *
+ * Per system clock cycle the clock divider of every enabled state machine decides if it executes an instruction cycle.
+ * Modeled are all instructions, side-set (opt, pindirs), delays, stalls, wrap, the FIFOs (incl. joining, autopush and
+ * autopull), OUT/MOV EXEC, instructions written to SMx_INSTR, JMP PIN, the IRQ flags, FSTAT/FDEBUG/FLEVEL and the
+ * input synchronizers (2 cycles unless bypassed). An instruction written to SMx_INSTR executes at the next clock enable
+ * of the state machine, a second write before replaces it. Not modeled: OUT_STICKY/INLINE_OUT_EN, interrupts to the
+ * CPU. DMA is up to the user of the model, piosim_dreq provides the DREQs of the FIFOs.
+ *
+ * Pins: a GPIO whose FUNCSEL selects a PIO block is driven by the output and output enable of that block. Devices
+ * (target models, monitors) attached with piosim_attach can pull pins low. The level of a pin is low when any driver
+ * pulls it low, otherwise high (driven or pulled up). A PIO driving high against a device pulling low is counted as
+ * contention.
+ */
+
+#define PIOSIM_NUM_PIOS     (2)
+#define PIOSIM_NUM_SMS      (4)
+#define PIOSIM_NUM_GPIOS    (30)
+#define PIOSIM_FIFO_DEPTH   (4)
+
+// register addresses, same as on the RP2040
+#define PIOSIM_IO_BANK0_BASE    (0x40014000u)
+#define PIOSIM_PIO0_BASE        (0x50200000u)
+#define PIOSIM_PIO1_BASE        (0x50300000u)
+#define PIOSIM_ALIAS_XOR        (0x1000u)
+#define PIOSIM_ALIAS_SET        (0x2000u)
+#define PIOSIM_ALIAS_CLR        (0x3000u)
+
+#define PIOSIM_CTRL             (0x000u)
+#define PIOSIM_FSTAT            (0x004u)
+#define PIOSIM_FDEBUG           (0x008u)
+#define PIOSIM_FLEVEL           (0x00cu)
+#define PIOSIM_TXF0             (0x010u)
+#define PIOSIM_RXF0             (0x020u)
+#define PIOSIM_IRQ              (0x030u)
+#define PIOSIM_IRQ_FORCE        (0x034u)
+#define PIOSIM_INPUT_SYNC_BYPASS (0x038u)
+#define PIOSIM_DBG_PADOUT       (0x03cu)
+#define PIOSIM_DBG_PADOE        (0x040u)
+#define PIOSIM_INSTR_MEM0       (0x048u)
+#define PIOSIM_SM0_CLKDIV       (0x0c8u)
+#define PIOSIM_SM0_EXECCTRL     (0x0ccu)
+#define PIOSIM_SM0_SHIFTCTRL    (0x0d0u)
+#define PIOSIM_SM0_ADDR         (0x0d4u)
+#define PIOSIM_SM0_INSTR        (0x0d8u)
+#define PIOSIM_SM0_PINCTRL      (0x0dcu)
+#define PIOSIM_SM_STRIDE        (0x018u)
+
+#define PIOSIM_GPIO_STATUS(n)   (8u*(n))      // OUTFROMPERI 8, OUTTOPAD 9, OEFROMPERI 12, OETOPAD 13, INFROMPAD 17, INTOPERI 19
+#define PIOSIM_GPIO_CTRL(n)     (8u*(n) + 4u) // FUNCSEL 4..0
+#define PIOSIM_FUNCSEL_PIO0     (6u)
+#define PIOSIM_FUNCSEL_PIO1     (7u)
+#define PIOSIM_FUNCSEL_NULL     (0x1fu)
+
+typedef struct piosim piosim_t;
+typedef struct piosim_device piosim_device_t;
+
+// called after the pin levels changed (changed = mask of the changed pins) and at the cycle the device asked for with
+// piosim_wakeup (changed = 0). The device may change its drivers with piosim_pull from here
+typedef void (*piosim_device_fn)(piosim_t *ps, piosim_device_t *pdev, uint32_t levels, uint32_t changed);
+
+struct piosim_device
+{
+	piosim_device_fn update;
+	void            *ctx;
+	uint32_t         pull_low;   // pins pulled low by this device
+	uint64_t         wakeup;     // cycle of the next timed call, UINT64_MAX: none
+	piosim_device_t *next;
+};
+
+typedef struct
+{
+	uint32_t buf[2*PIOSIM_FIFO_DEPTH];
+	uint8_t  head;
+	uint8_t  count;
+} piosim_fifo_t;
+
+typedef struct
+{
+	uint32_t      clkdiv, execctrl, shiftctrl, pinctrl;
+	uint32_t      divacc;        // clock divider accumulator in 1/256 cycles
+	uint8_t       pc;
+	uint32_t      x, y, isr, osr;
+	uint8_t       isr_count;     // bits shifted into the ISR
+	uint8_t       osr_count;     // bits shifted out of the OSR, 32: empty
+	uint32_t      delay;         // remaining delay cycles
+	bool          exec_pending;  // instruction from OUT/MOV EXEC or SMx_INSTR to execute instead of the next one
+	uint16_t      exec_instr;
+	bool          stalled;       // current instruction stalled in the last cycle
+	bool          irq_waiting;   // IRQ wait: flag set, waiting for it to be cleared
+	piosim_fifo_t tx, rx;
+	uint64_t      instructions;  // executed instruction cycles (incl. stalls, excl. delays)
+} piosim_sm_t;
+
+typedef struct
+{
+	uint16_t    instr_mem[32];
+	uint32_t    ctrl;            // SM_ENABLE bits only, the restart bits are self clearing
+	uint32_t    fdebug;
+	uint8_t     irq;
+	uint32_t    input_sync_bypass;
+	uint32_t    pad_out, pad_oe; // outputs of all state machines of this block
+	piosim_sm_t sm[PIOSIM_NUM_SMS];
+} piosim_pio_t;
+
+struct piosim
+{
+	uint64_t         cycle;          // system clock cycles since piosim_init
+	uint32_t         sysclk_khz;
+	uint32_t         access_cycles;  // cycles of every register access, default 1
+	piosim_pio_t     pio[PIOSIM_NUM_PIOS];
+	uint8_t          funcsel[PIOSIM_NUM_GPIOS];
+	uint32_t         pullup;         // pins with pull-up, all by default. Undriven pins without pull-up keep their level
+	uint32_t         levels;         // current pin levels
+	uint32_t         sync[2];        // levels delayed by the input synchronizers
+	uint64_t         contention;     // count of cycles a PIO drove high against a device pulling low
+	piosim_device_t *devices;
+	FILE            *vcd;
+	uint32_t         vcd_pins;       // traced pins
+	char             vcd_names[PIOSIM_NUM_GPIOS][16];
+	uint8_t          vcd_sms;        // traced state machines, bit pio*4+sm
+	uint32_t         vcd_levels, vcd_oe, vcd_pulled;
+	uint8_t          vcd_pc[PIOSIM_NUM_PIOS][PIOSIM_NUM_SMS];
+	bool             vcd_header_done;
+};
+
+// reset to the state after power up. sysclk_khz is the system clock the PIO clock dividers divide, 125000 on the RP2040
+void     piosim_init(piosim_t *ps, uint32_t sysclk_khz);
+
+// register access, see above. Unknown addresses read as 0
+uint32_t piosim_read32(piosim_t *ps, uint32_t addr);
+void     piosim_write32(piosim_t *ps, uint32_t addr, uint32_t value);
+
+// advance the simulation. Phases in which all state machines wait in a PULL for data are skipped at once
+void     piosim_step(piosim_t *ps, uint64_t cycles);
+
+// advance until all enabled state machines of block pio with an empty TX FIFO stall in a PULL, at most maxcycles.
+// Returns false on timeout
+bool     piosim_run_until_stalled(piosim_t *ps, unsigned pio, uint64_t maxcycles);
+
+// DREQ of the FIFOs like on the RP2040: 0..3 TX and 4..7 RX of the state machines of PIO0, 8..15 the same of PIO1. TX is
+// requested while the FIFO is not full, RX while it is not empty. Used by DMA models, they access the FIFOs through
+// piosim_read32 / piosim_write32
+bool     piosim_dreq(const piosim_t *ps, unsigned dreq);
+
+// simulated time
+uint64_t piosim_time_ns(const piosim_t *ps);
+uint64_t piosim_cycles_to_ns(const piosim_t *ps, uint64_t cycles);
+
+// attach a device to the pins. It stays attached until piosim_detach
+void     piosim_attach(piosim_t *ps, piosim_device_t *pdev, piosim_device_fn update, void *ctx);
+void     piosim_detach(piosim_t *ps, piosim_device_t *pdev);
+
+// pull pins (mask) of a device low (true) or release them
+void     piosim_pull(piosim_t *ps, piosim_device_t *pdev, uint32_t mask, bool low);
+
+// ask for a call of the device update function at cycle (UINT64_MAX: none)
+void     piosim_wakeup(piosim_t *ps, piosim_device_t *pdev, uint64_t cycle);
+
+// VCD trace with 1 ps resolution. Select the traced pins and state machines before opening the file.
+// Per pin the level, the output enable of the PIO and the pull down of the devices are traced, per state machine its PC
+void     piosim_vcd_pin(piosim_t *ps, unsigned gpio, const char *name);
+void     piosim_vcd_sm(piosim_t *ps, unsigned pio, unsigned sm);
+bool     piosim_vcd_open(piosim_t *ps, const char *path);
+void     piosim_vcd_close(piosim_t *ps);
+
+#endif
@@ -1,6 +1,8 @@
 import serial 
 import serial.tools.list_ports 
 import time
+import struct
+import collections
 
 class i3cblaster:
     
@@ -8,8 +10,54 @@ class i3cblaster:
     USB_VID = 0x2E8A # USB vendor ID of the i3cblaster devices
     USB_PID = 0x000A # USB product ID of the i3cblaster devices
     
+    # binary frame protocol (see src/binframe.h). Transfers with payload use it when binary is True,
+    # otherwise the text commands are used. None: probed on connect, firmware without binary frames falls back to text
+    binary = None
+    BINFRAME_SOF = 0x02
+    OP_ECHO                 = 0x0A
+    OP_I3C_CLK              = 0x05
+    OP_I3C_BUS_SELECT       = 0x0B
+    OP_I3C_BUS_INIT         = 0x0C
+    OP_I3C_SDR_WRITE        = 0x10
+    OP_I3C_SDR_READ         = 0x11
+    OP_I3C_SDR_WRITEREAD    = 0x12
+    OP_I3C_CCC_BC_WRITE     = 0x13
+    OP_I3C_CCC_DIRECT_WRITE = 0x14
+    OP_I3C_CCC_DIRECT_READ  = 0x15
+    OP_I3C_IBI_CONFIG       = 0x17
+    OP_I3C_IBI_READ         = 0x18
+    OP_I3C_IBI_STREAM       = 0x19
+    OP_I3C_IBI_EVENT        = 0x1A # unsolicited frame with seq 0, sent while IBI streaming is enabled
+    OP_I3C_DDR_CONFIG       = 0x20
+    OP_I3C_DDR_WRITE        = 0x21
+    OP_I3C_DDR_READ         = 0x22
+    OP_I3C_DDR_WRITEREAD    = 0x23
+    OP_I2C_CLK              = 0x30
+    OP_I2C_TIMEOUT          = 0x31
+    OP_I2C_WRITE            = 0x33
+    OP_I2C_READ             = 0x34
+    OP_I2C_WRITEREAD        = 0x35
+    OP_I3C_SAMPLE_JOB       = 0x40
+    OP_I3C_SAMPLE_CLEAR     = 0x41
+    OP_I3C_SAMPLE_START     = 0x42
+    OP_I3C_SAMPLE_STOP      = 0x43
+    OP_I3C_SAMPLE_READ      = 0x44
+    OP_I3C_SAMPLE_STATS     = 0x45
+    # transfer types of sampler jobs (i3c_hl_batch_op_t)
+    SAMPLE_OPS = {'sdr_write': 0, 'sdr_read': 1, 'sdr_writeread': 2, 'ccc_bc_write': 3, 'ccc_direct_read': 5,
+                  'ddr_write': 6, 'ddr_read': 7}
+    # same texts as returned by the text commands, index is the status code
+    STATUSTEXT = ['OK', 'ERR_IBI_ARBITRATION', 'ERR_NAKED_DURING_ARBHDR', 'ERR_NAKED', 'ERR_INVALID_PARAMETER', 'WARN_NO_IBI',
+                  'ERR_NAKED_DDR', 'WARN_EARLY_TERMINATED', 'ERR_DDR_INVALID_PREAMBLE', 'ERR_DDR_READ_PARITY_WRONG',
+                  'ERR_DDR_READ_CRC_WRONG', 'ERR_I2C_FAILED', 'ERR_SKIPPED']
+    
     _ser = None
     _serialnumber = None
+    _port = None
+    _seq = 0
+    _ibi_streaming = False
+    _ibi_callback = None
+    _ibi_events = None
     
     def _findcomport(self, serialnumber=None): 
         foundport = None 
@@ -24,8 +72,11 @@ class i3cblaster:
                         foundport = port.name
         return foundport 
         
-    def init(self, serialnumber=None): 
+    # port selects a serial port (e.g. 'COM5', '/dev/ttyACM0' or the pty of the host/i3cb_loopback test double) instead
+    # of searching the device by its USB IDs
+    def init(self, serialnumber=None, port=None): 
         self._serialnumber = serialnumber
+        self._port = port
     
     # Magic function to close all relevant serial port instances running open in current python instance right now
     def close_serialport(self, port): 
@@ -50,9 +101,10 @@ class i3cblaster:
                 del self._ser 
                 self._ser = None 
         if self._ser is None: 
-            comport = self._findcomport(self._serialnumber) 
+            comport = self._port if self._port is not None else self._findcomport(self._serialnumber) 
             if comport is not None: 
-                self.close_serialport(comport) # close port if it is open within this python instance... just to be sure 
+                if self._port is None:
+                    self.close_serialport(comport) # close port if it is open within this python instance... just to be sure 
                 # now try to connect with a timeout
                 openedit = False 
                 timedout = False 
@@ -81,21 +133,116 @@ class i3cblaster:
                                 done = True
                             if time.time()-starttime > 2:
                                 done = True
+                        if self.binary is None:
+                            self._probe_binary()
                 
         return self._ser is not None
 
+    # check whether the firmware answers binary frames. A firmware without them takes the frame as a text line,
+    # which gets terminated and its error response discarded
+    def _probe_binary(self):
+        probe = b'\xa5\x5a'
+        status, data = self._exec_bin(self.OP_ECHO, probe)
+        self.binary = (status == self.OKTEXT) and (data == probe)
+        if not self.binary:
+            self._ser.write(b'\r')
+            time.sleep(0.1)
+            self._ser.read_all()
+
     def _exec(self, cmdstr): 
         respstr = ''
         if self._connect():
-            self._ser.read_all() # flush
-            self._ser.write(('@'+cmdstr+'\r').encode('ansi'))
-            respstr = self._ser.readline()
+            self._flush()
+            self._ser.write(('@'+cmdstr+'\r').encode('latin-1'))
+            if self._ibi_streaming:
+                respstr = self._readline()
+            else:
+                respstr = self._ser.readline()
         return respstr
     
+    # discard pending input. While IBI streaming is enabled, pending IBI event frames are dispatched instead
+    def _flush(self):
+        if not self._ibi_streaming:
+            self._ser.read_all()
+        else:
+            while self._ser.in_waiting > 0:
+                if self._ser.read(1)[0] == self.BINFRAME_SOF:
+                    self._read_frame()
+    
+    # readline which dispatches IBI event frames arriving before the text response
+    def _readline(self):
+        line = b''
+        while True:
+            ch = self._ser.read(1)
+            if len(ch) == 0:
+                return line
+            if (len(line) == 0) and (ch[0] == self.BINFRAME_SOF):
+                self._read_frame()
+            else:
+                line += ch
+                if ch == b'\n':
+                    return line
+    
+    # read the rest of a frame after the SOF. Returns (seq, opcode, status, payload) or None.
+    # IBI event frames are dispatched and returned as well
+    def _read_frame(self):
+        header = self._ser.read(2)
+        if len(header) != 2:
+            return None
+        framelen = struct.unpack('<H', header)[0]
+        resp = self._ser.read(framelen)
+        if (len(resp) != framelen) or (framelen < 3):
+            return None
+        if (resp[0] == 0) and (resp[1] == self.OP_I3C_IBI_EVENT):
+            self._dispatch_ibis(resp[3:])
+        return (resp[0], resp[1], resp[2], resp[3:])
+    
+    # parse IBI records: dropped count (32 bit), per IBI: timestamp in us (64 bit), bus, len, data
+    def _parse_ibis(self, data):
+        ibis = []
+        dropped = struct.unpack('<I', data[0:4])[0]
+        pos = 4
+        while pos + 10 <= len(data):
+            timestamp, bus, ibilen = struct.unpack('<QBB', data[pos:pos+10])
+            ibis.append((timestamp, bus, list(data[pos+10:pos+10+ibilen])))
+            pos += 10 + ibilen
+        return (dropped, ibis)
+    
+    def _dispatch_ibis(self, data):
+        dropped, ibis = self._parse_ibis(data)
+        for timestamp, bus, ibidata in ibis:
+            event = (timestamp, bus, ibidata[0] >> 1, ibidata[1:])
+            if self._ibi_callback is not None:
+                self._ibi_callback(*event)
+            else:
+                self._ibi_events.append(event)
+    
+    # execute a binary frame command. Returns the status text and the response payload as bytes
+    def _exec_bin(self, opcode, payload=b''):
+        status = 'ERR_NO_RESPONSE'
+        data = b''
+        if self._connect():
+            self._seq = (self._seq % 255) + 1 # seq 0 is used by unsolicited frames
+            body = bytes([self._seq, opcode]) + bytes(payload)
+            self._flush()
+            self._ser.write(bytes([self.BINFRAME_SOF]) + struct.pack('<H', len(body)) + body)
+            while True:
+                sof = self._ser.read(1)
+                resp = self._read_frame() if (len(sof) == 1) and (sof[0] == self.BINFRAME_SOF) else None
+                if (resp is None) or (resp[0] != 0): # everything except event frames ends the wait
+                    break
+            if (resp is not None) and (resp[0] == self._seq) and (resp[1] == opcode):
+                if resp[2] < len(self.STATUSTEXT):
+                    status = '%s(%d)' % (self.STATUSTEXT[resp[2]], resp[2])
+                else:
+                    status = 'ERR_UNKNOWN(%d)' % resp[2]
+                data = resp[3]
+        return (status, data)
+
     def _parse_response(self, resp):
         errorcode = ''
         returnvalues = []
-        resp = resp.decode('ansi').strip()
+        resp = resp.decode('latin-1').strip()
         errorend = resp.find(')')
         if errorend >= 0:            
             errorcode = resp[0:errorend+1]
@@ -150,6 +297,13 @@ class i3cblaster:
             raise Exception('I3C Blaster exception: ' + resp[0])
         return resp[1]
 
+    # same scan as i3c_scan, returns the presence bitmap as 128 bit integer: bit n set = address n responded
+    def i3c_scan_bitmap(self):
+        resp = self._parse_response(self._exec('i3c_scan 1'))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+        return resp[1][0]
+
     # execute a broadcast RST DAA
     def i3c_rstdaa(self):
         resp = self._parse_response(self._exec('i3c_rstdaa'))
@@ -166,7 +320,90 @@ class i3cblaster:
             else:
                 raise Exception('I3C Blaster exception: ' + resp[0])
         return resp[1]
+
+    # assign dynamic addresses to all targets taking part in ENTDAA with one command and one ENTDAA CCC on the bus.
+    # The addresses are taken in ascending order from firstaddr..lastaddr, reserved addresses are skipped. The pool should
+    # not contain addresses in use already, e.g. run i3c_rstdaa before.
+    # returns a list with a tuple (pid, bcr, dcr, addr) per target, pid as 48 bit integer. An empty list when no target
+    # took part, an exception when there were more targets than addresses in the pool
+    def i3c_daa(self, firstaddr=0x08, lastaddr=0x7d):
+        resp = self._exec('i3c_daa 0x%x 0x%x' % (firstaddr, lastaddr)).decode('latin-1').strip()
+        entries = resp.split(';')
+        status = self._parse_response(entries[0].encode('latin-1'))
+        if status[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + status[0])
+        return [tuple(int(v, 0) for v in e.split(',')) for e in entries[1:]]
     
+    # read the device table of the selected bus: what the firmware learned about the targets from DAA and the GET CCCs.
+    # returns a list with a dict per target with the keys addr, pid, bcr, dcr, mrl, mwl, ibi_payload, maxwr, maxrd and
+    # caps (list of bytes). Unknown fields are None
+    def i3c_devices(self):
+        resp = self._exec('i3c_devices').decode('latin-1').strip()
+        entries = resp.split(';')
+        status = self._parse_response(entries[0].encode('latin-1'))
+        if status[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + status[0])
+        keys = ('addr', 'pid', 'bcr', 'dcr', 'mrl', 'mwl', 'ibi_payload', 'maxwr', 'maxrd', 'caps')
+        devices = []
+        for e in entries[1:]:
+            values = e.split(',')
+            dev = {k: (None if v == '-' else int(v, 0)) for k, v in zip(keys[:-1], values[:-1])}
+            dev['caps'] = None if values[-1] == '-' else [int(v, 0) for v in values[-1].split()]
+            devices.append(dev)
+        return devices
+
+    # query GETBCR, GETDCR, GETMRL, GETMWL, GETMXDS and GETCAPS of targetaddr into the device table, of all targets in
+    # the table when targetaddr is None
+    def i3c_discover(self, targetaddr=None):
+        cmd = 'i3c_discover' if targetaddr is None else 'i3c_discover %d' % targetaddr
+        resp = self._parse_response(self._exec(cmd))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+
+    # save the current settings of all buses, the selected bus, i3c_ddr_config, i2c_clk and i2c_timeout to the flash
+    # together with the profiles and DAA settings, they are applied at startup. The dynamic addresses of all targets with
+    # known PID become their preferred ones. Returns the count of saves since the flash was cleared
+    def config_save(self):
+        resp = self._parse_response(self._exec('config_save'))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+        return resp[1][0]
+
+    # erase the saved configuration. The current settings stay until the next reset
+    def config_clear(self):
+        resp = self._parse_response(self._exec('config_clear'))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+
+    # returns the configuration applied at startup incl. changes not saved yet as dict. buses is a list with a dict per
+    # bus, profiles a list of tuples (pid, bus, addr)
+    def config_show(self):
+        resp = self._exec('config_show').decode('latin-1').strip()
+        entries = resp.split(';')
+        status = self._parse_response(entries[0].encode('latin-1'))
+        if status[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + status[0])
+        config = dict(zip(('saves', 'bus', 'ddr_crc_word_indicator', 'ddr_early_write_term', 'ddr_write_ack',
+                           'i2c_clk_khz', 'i2c_timeout_ms'), status[1]))
+        keys = ('initialized', 'gpiobase', 'sm', 'clk_khz', 'drivestrength_ma', 'daa', 'daa_firstaddr', 'daa_lastaddr')
+        config['buses'] = [dict(zip(keys, (int(v, 0) for v in e.split(',')))) for e in entries[1:5]]
+        config['profiles'] = [tuple(int(v, 0) for v in e.split(',')) for e in entries[5:]]
+        return config
+
+    # set the preferred dynamic address of the target with the 48 bit pid on the selected bus, addr 0 removes it.
+    # Used by i3c_daa and the DAA at startup, saved by config_save
+    def config_profile(self, pid, addr):
+        resp = self._parse_response(self._exec('config_profile 0x%012x %d' % (pid, addr)))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+
+    # enable or disable RSTDAA, DAA with the pool firstaddr..lastaddr and discovery of all targets of the selected bus at
+    # startup, saved by config_save
+    def config_daa(self, enable, firstaddr=0x08, lastaddr=0x7d):
+        resp = self._parse_response(self._exec('config_daa %d %d %d' % (1 if enable else 0, firstaddr, lastaddr)))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+
     # Create a target reset pattern condition on the I3C bus
     def i3c_targetreset(self):
         resp = self._parse_response(self._exec('i3c_targetreset'))
@@ -176,19 +413,25 @@ class i3cblaster:
     # Set the I3C clock frequency in units of kHz.
     # provide e.g. 12500 for 12.5 MHz
     def i3c_clk(self, clockrate_khz):
-        resp = self._parse_response(self._exec('i3c_clock %d' % clockrate_khz))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_CLK, struct.pack('<I', clockrate_khz))
+        else:
+            resp = self._parse_response(self._exec('i3c_clk %d' % clockrate_khz))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
 
     # execute a private write transfer to a I3C target.
     # writedata is an array, targetaddr is the 7-bit targetaddress to write to
     def i3c_sdr_write(self, targetaddr, writedata):
-        cmd = 'i3c_sdr_write %d ' % targetaddr
-        for d in writedata:
-            cmd += hex(d)+','
-        if len(writedata) > 0:
-            cmd = cmd[0:-1]
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_SDR_WRITE, bytes([targetaddr]) + bytes(writedata))
+        else:
+            cmd = 'i3c_sdr_write %d ' % targetaddr
+            for d in writedata:
+                cmd += hex(d)+','
+            if len(writedata) > 0:
+                cmd = cmd[0:-1]
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
 
@@ -199,11 +442,14 @@ class i3cblaster:
     # Note: This can be less as the requested bytecount in case the I3C target
     #       terminated the read earlier.
     def i3c_sdr_read(self, targetaddr, readbytecount):
-        cmd = 'i3c_sdr_read %d %d' % (targetaddr, readbytecount)
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_SDR_READ, struct.pack('<BH', targetaddr, readbytecount))
+        else:
+            cmd = 'i3c_sdr_read %d %d' % (targetaddr, readbytecount)
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
-        return resp[1]
+        return list(resp[1])
     
     # execute a private write transfer from a I3C target followed by a restart and read transfer.
     # targetaddr is the 7-bit targetaddress to write to.
@@ -213,26 +459,32 @@ class i3cblaster:
     # Note: This can be less as the requested bytecount in case the I3C target
     #       terminated the read earlier.
     def i3c_sdr_writeread(self, targetaddr, writedata, readbytecount):
-        cmd = 'i3c_sdr_writeread %d ' % targetaddr
-        for d in writedata:
-            cmd += hex(d)+','
-        if len(writedata) > 0:
-            cmd = cmd[0:-1]
-        cmd += ' %d' % readbytecount
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_SDR_WRITEREAD, struct.pack('<BH', targetaddr, readbytecount) + bytes(writedata))
+        else:
+            cmd = 'i3c_sdr_writeread %d ' % targetaddr
+            for d in writedata:
+                cmd += hex(d)+','
+            if len(writedata) > 0:
+                cmd = cmd[0:-1]
+            cmd += ' %d' % readbytecount
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
-        return resp[1]
+        return list(resp[1])
     
     # execute a broadcast ccc transfer to the I3C bus.
     # writedata is an array with payload data to write
     def i3c_sdr_ccc_bc_write(self, writedata):
-        cmd = 'i3c_sdr_ccc_bc_write '
-        for d in writedata:
-            cmd += hex(d)+','
-        if len(writedata) > 0:
-            cmd = cmd[0:-1]
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_CCC_BC_WRITE, bytes(writedata))
+        else:
+            cmd = 'i3c_sdr_ccc_bc_write '
+            for d in writedata:
+                cmd += hex(d)+','
+            if len(writedata) > 0:
+                cmd = cmd[0:-1]
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
         
@@ -241,18 +493,21 @@ class i3cblaster:
     # bc_phase_writedata is an array with payload data to write during the broadcast phase of the transfer
     # direct_phase_writedata is an array with payload data to write during the direct addressed phase of the transfer
     def i3c_sdr_ccc_direct_write(self, targetaddr, bc_phase_writedata, direct_phase_writedata):
-        cmd = 'i3c_sdr_ccc_bc_write %d ' % targetaddr
-        for d in bc_phase_writedata:
-            cmd += hex(d)+','
-        if len(bc_phase_writedata) > 0:
-            cmd = cmd[0:-1]
-        cmd += ' '
-        for d in direct_phase_writedata:
-            cmd += hex(d)+','
-        if len(direct_phase_writedata) > 0:
-            cmd = cmd[0:-1]
-        
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_CCC_DIRECT_WRITE, bytes([targetaddr, len(bc_phase_writedata)]) + bytes(bc_phase_writedata) + bytes(direct_phase_writedata))
+        else:
+            cmd = 'i3c_sdr_ccc_bc_write %d ' % targetaddr
+            for d in bc_phase_writedata:
+                cmd += hex(d)+','
+            if len(bc_phase_writedata) > 0:
+                cmd = cmd[0:-1]
+            cmd += ' '
+            for d in direct_phase_writedata:
+                cmd += hex(d)+','
+            if len(direct_phase_writedata) > 0:
+                cmd = cmd[0:-1]
+            
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
         
@@ -264,17 +519,20 @@ class i3cblaster:
     # Note: This can be less as the requested bytecount in case the I3C target
     #       terminated the read earlier.
     def i3c_sdr_ccc_direct_read(self, targetaddr, writedata, readbytecount):
-        cmd = 'i3c_sdr_ccc_direct_read %d ' % targetaddr
-        for d in writedata:
-            cmd += hex(d)+','
-        if len(writedata) > 0:
-            cmd = cmd[0:-1]
-        cmd += ' %d' % readbytecount
-        
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_CCC_DIRECT_READ, struct.pack('<BH', targetaddr, readbytecount) + bytes(writedata))
+        else:
+            cmd = 'i3c_sdr_ccc_direct_read %d ' % targetaddr
+            for d in writedata:
+                cmd += hex(d)+','
+            if len(writedata) > 0:
+                cmd = cmd[0:-1]
+            cmd += ' %d' % readbytecount
+            
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
-        return resp[1]
+        return list(resp[1])
     
     # check if an I3C IBI or HJ request occured.
     # All transfer functions will also return an error in case an IBI or HJ was detected.
@@ -290,6 +548,180 @@ class i3cblaster:
                 raise Exception('I3C Blaster exception: ' + resp[0])
         return resp[1]        
     
+    # Enable or disable automatic IBI handling.
+    # When enabled, the I3C Blaster reads IBIs as soon as a target raises them and queues them with a timestamp.
+    # Use i3c_ibi_read to fetch them. i3c_poll returns queued IBIs first.
+    def i3c_ibi_auto(self, enable):
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_IBI_CONFIG, bytes([1 if enable else 0]))
+        else:
+            resp = self._parse_response(self._exec('i3c_ibi_auto %d' % (1 if enable else 0)))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+
+    # Read IBIs queued by the automatic IBI handling of all buses.
+    # Returns a tuple (dropped, ibis). dropped is the count of IBIs lost since startup because the queue was full,
+    # ibis is a list of (timestamp_us, bus, [ibi address byte, MDB, payload...]) tuples.
+    def i3c_ibi_read(self, maxcount=0xffff):
+        ibis = []
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_IBI_READ, struct.pack('<H', maxcount))
+            if resp[0] != self.OKTEXT:
+                raise Exception('I3C Blaster exception: ' + resp[0])
+            dropped, ibis = self._parse_ibis(resp[1])
+        else:
+            resp = self._exec('i3c_ibi_read %d' % maxcount).decode('latin-1').strip()
+            entries = resp.split(';')
+            status = self._parse_response(entries[0].encode('latin-1'))
+            if status[0] != self.OKTEXT:
+                raise Exception('I3C Blaster exception: ' + status[0])
+            dropped = status[1][0]
+            for e in entries[1:]:
+                values = [int(v, 0) for v in e.split(',')]
+                ibis.append((values[0], values[1], values[2:]))
+        return (dropped, ibis)
+
+    # Enable or disable IBI streaming. This enables automatic IBI handling as well.
+    # While enabled, the I3C Blaster sends every IBI without being asked, there is no need to poll.
+    # IBIs of all buses are streamed, automatic IBI handling gets enabled for the selected bus.
+    # When callback is given, it is called as callback(timestamp_us, bus, targetaddr, payload) for every IBI, otherwise
+    # the IBIs are queued for i3c_ibi_events. Both happen while this class reads from the device: during any command
+    # or while iterating over i3c_ibi_events. The stream always uses binary frames, independent of the binary setting.
+    def i3c_ibi_stream(self, enable, callback=None):
+        if self._ibi_events is None:
+            self._ibi_events = collections.deque()
+        self._ibi_callback = callback
+        self._ibi_streaming = True # already set before the command, IBIs can arrive before the response
+        resp = self._exec_bin(self.OP_I3C_IBI_STREAM, bytes([1 if enable else 0]))
+        self._ibi_streaming = enable
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+
+    # Iterator over streamed IBIs, yields (timestamp_us, bus, targetaddr, payload) tuples. payload starts with the MDB.
+    # Waits up to timeout seconds for the next IBI, None waits forever
+    def i3c_ibi_events(self, timeout=None):
+        if self._ibi_events is None:
+            self._ibi_events = collections.deque()
+        lastevent = time.time()
+        while True:
+            while len(self._ibi_events) > 0:
+                yield self._ibi_events.popleft()
+                lastevent = time.time()
+            if not self._connect():
+                return
+            if (self._ser.in_waiting == 0) and (timeout is not None) and ((time.time() - lastevent) >= timeout):
+                return
+            sof = self._ser.read(1) # blocks for up to the serial timeout
+            if (len(sof) == 1) and (sof[0] == self.BINFRAME_SOF):
+                self._read_frame()
+
+    # Set job index (0..15) of the periodic sampler on the selected bus. The transfer is executed by the I3C Blaster
+    # every period_us (0 = once), the first time offset_us after i3c_sample_start.
+    # op is one of SAMPLE_OPS. writedata (up to 8 bytes) is the payload of writes, the CCC code (+ defining byte) of
+    # CCC transfers or 16-bit words for ddr_write. readcount is in bytes, for ddr_read in 16-bit words (up to 32 bytes).
+    # ddrcommand is the HDR-DDR command code. Sampler commands always use binary frames
+    def i3c_sample_job(self, index, period_us, op, targetaddr=0, writedata=[], readcount=0, ddrcommand=0, offset_us=0):
+        opcode = self.SAMPLE_OPS[op]
+        if op in ('ddr_write', 'ddr_read'):
+            payload = struct.pack('<%dH' % len(writedata), *writedata)
+            flags = 0x08 if op == 'ddr_write' else 0 # CRC on early termination, as the i3c_ddr_config default
+        else:
+            payload = bytes(writedata)
+            flags = 0
+        resp = self._exec_bin(self.OP_I3C_SAMPLE_JOB, struct.pack('<BBBBBHII', index, opcode, flags, targetaddr, ddrcommand,
+                                                                  readcount, period_us, offset_us) + payload)
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+
+    # Remove job index of the periodic sampler, all jobs when index is None
+    def i3c_sample_clear(self, index=None):
+        resp = self._exec_bin(self.OP_I3C_SAMPLE_CLEAR, bytes([0xff if index is None else index]))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+
+    # Start the periodic sampler delay_us from now. Clears queued samples and counters.
+    # Returns the start time in us (device time base of the sample timestamps) all job offsets refer to
+    def i3c_sample_start(self, delay_us=0):
+        resp = self._exec_bin(self.OP_I3C_SAMPLE_START, struct.pack('<I', delay_us))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+        return struct.unpack('<Q', resp[1])[0]
+
+    def i3c_sample_stop(self):
+        resp = self._exec_bin(self.OP_I3C_SAMPLE_STOP)
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+
+    # Read queued samples of the periodic sampler.
+    # Returns a tuple (dropped, samples). dropped is the count of samples lost since i3c_sample_start because the
+    # queue was full, samples is a list of (timestamp_us, job, status, [read bytes]) tuples, oldest first
+    def i3c_sample_read(self, maxcount=0xffff):
+        samples = []
+        resp = self._exec_bin(self.OP_I3C_SAMPLE_READ, struct.pack('<H', maxcount))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+        data = resp[1]
+        dropped = struct.unpack('<I', data[0:4])[0]
+        pos = 4
+        while pos + 11 <= len(data):
+            timestamp, job, status, samplelen = struct.unpack('<QBBB', data[pos:pos+11])
+            samples.append((timestamp, job, status, list(data[pos+11:pos+11+samplelen])))
+            pos += 11 + samplelen
+        return (dropped, samples)
+
+    # Returns a tuple (running, jobs). jobs maps the index of every set job to (executed, missed, dropped) counts:
+    # missed counts periods which started while the previous sample was still not taken
+    def i3c_sample_stats(self):
+        jobs = {}
+        resp = self._exec_bin(self.OP_I3C_SAMPLE_STATS)
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+        data = resp[1]
+        for pos in range(1, len(data) - 12, 13):
+            index, executed, missed, dropped = struct.unpack('<BIII', data[pos:pos+13])
+            jobs[index] = (executed, missed, dropped)
+        return (data[0] != 0, jobs)
+
+    # Returns a batch which queues text commands instead of executing them one by one. Use it as context manager:
+    #   with dev.batch() as b:
+    #       r = b.i3c_sdr_read(0x08, 4)
+    #   print(r.value)
+    # The queued commands are sent back to back when the with block ends, so the USB round trip is paid once per
+    # window commands instead of once per command. See i3cblaster_batch
+    def batch(self, window=32):
+        return i3cblaster_batch(self, window)
+
+    # Returns the transfer statistics of all buses as dict (bus, type) -> dict with the keys count, data, nak, ibi,
+    # parity_crc, early_term, busy_us, max_us and hist. type is e.g. 'sdr_write', data counts bytes (HDR-DDR: words),
+    # hist is the log2 histogram of the transfer durations: bin 0 < 1us, bin n 2^(n-1)..2^n-1 us.
+    # Only types with at least one transfer are returned. reset clears the statistics after reading them
+    def stats(self, reset=False):
+        result = {}
+        resp = self._exec('stats %d' % (1 if reset else 0)).decode('latin-1').strip()
+        entries = resp.split(';')
+        if entries[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + entries[0])
+        for e in entries[1:]:
+            values = e.split(',')
+            counts = [int(v, 0) for v in values[2:]]
+            result[(int(values[0]), values[1])] = {'count': counts[0], 'data': counts[1], 'nak': counts[2], 'ibi': counts[3],
+                                                   'parity_crc': counts[4], 'early_term': counts[5], 'busy_us': counts[6],
+                                                   'max_us': counts[7], 'hist': counts[8:]}
+        return result
+
+    # Select the I3C bus (0..3) used by all following commands and optionally (re)initialize it.
+    # When gpiobase is given, the bus gets SDA on gpiobase and SCL on gpiobase+1, driven by state machine sm
+    # (default: sm = bus). Buses with even and odd numbers transfer at the same time.
+    # Bus 0 is initialized at startup. Returns a tuple (gpiobase, sm) of the selected bus
+    def i3c_bus(self, bus, gpiobase=None, sm=None):
+        cmd = 'i3c_bus %d' % bus
+        if gpiobase is not None:
+            cmd += ' %d %d' % (gpiobase, bus if sm is None else sm)
+        resp = self._parse_response(self._exec(cmd))
+        if resp[0] != self.OKTEXT:
+            raise Exception('I3C Blaster exception: ' + resp[0])
+        return tuple(resp[1])
+
     # Configure drive strength of controllers SDA/SCL pads.
     # Valid values are 2, 4, 8, 12 for either 2mA, 4mA, 8mA or 12mA drive strength
     # Note that it might be necessary to set the drivestrength of the I3C target too by doing target specific writes
@@ -302,8 +734,11 @@ class i3cblaster:
     # Configure I3C DDR specific target capabilities. Look into ENDXFER CCC for complete explanation.
     # For the values of the 3 parameters use either True or False
     def i3c_ddr_config(self, crc_word_indicator, enable_early_write_term, write_ack_enable):
-        cmd = 'i3c_ddr_config %d %d %d' % (int(crc_word_indicator), int(enable_early_write_term), int(write_ack_enable))
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_DDR_CONFIG, bytes([int(crc_word_indicator), int(enable_early_write_term), int(write_ack_enable)]))
+        else:
+            cmd = 'i3c_ddr_config %d %d %d' % (int(crc_word_indicator), int(enable_early_write_term), int(write_ack_enable))
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
     
@@ -313,12 +748,15 @@ class i3cblaster:
     # Note that writedata for HDR-DDR mode are 16-bit values!
     # writecommand is the 7-bit command value which is used for the command word in the HDR-DDR write
     def i3c_ddr_write(self, targetaddr, writecommand, writedata):
-        cmd = 'i3c_ddr_write %d %d ' % (targetaddr, writecommand)
-        for d in writedata:
-            cmd += hex(d)+','
-        if len(writedata) > 0:
-            cmd = cmd[0:-1]
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_DDR_WRITE, struct.pack('<BB%dH' % len(writedata), targetaddr, writecommand, *writedata))
+        else:
+            cmd = 'i3c_ddr_write %d %d ' % (targetaddr, writecommand)
+            for d in writedata:
+                cmd += hex(d)+','
+            if len(writedata) > 0:
+                cmd = cmd[0:-1]
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
 
@@ -330,8 +768,12 @@ class i3cblaster:
     #       terminated the read earlier.
     # readcommand is the 7-bit command value which is used for the command word in the HDR-DDR read
     def i3c_ddr_read(self, targetaddr, readcommand, readbytecount):
-        cmd = 'i3c_ddr_read %d %d %d' % (targetaddr, readcommand, readbytecount)
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_DDR_READ, struct.pack('<BBH', targetaddr, readcommand, readbytecount))
+            resp = (resp[0], list(struct.unpack('<%dH' % (len(resp[1])//2), resp[1])))
+        else:
+            cmd = 'i3c_ddr_read %d %d %d' % (targetaddr, readcommand, readbytecount)
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
         return resp[1]
@@ -347,13 +789,17 @@ class i3cblaster:
     #   The first item contains the amount of words written successfully
     #   The second item is an array containing the read data values
     def i3c_ddr_writeread(self, targetaddr, writecommand, readcommand, writedata, readbytecount):
-        cmd = 'i3c_ddr_writeread %d %d %d ' % (targetaddr, writecommand, readcommand)
-        for d in writedata:
-            cmd += hex(d)+','
-        if len(writedata) > 0:
-            cmd = cmd[0:-1]
-        cmd += ' %d' % readbytecount
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I3C_DDR_WRITEREAD, struct.pack('<BBBH%dH' % len(writedata), targetaddr, writecommand, readcommand, readbytecount, *writedata))
+            resp = (resp[0], list(struct.unpack('<%dH' % (len(resp[1])//2), resp[1])))
+        else:
+            cmd = 'i3c_ddr_writeread %d %d %d ' % (targetaddr, writecommand, readcommand)
+            for d in writedata:
+                cmd += hex(d)+','
+            if len(writedata) > 0:
+                cmd = cmd[0:-1]
+            cmd += ' %d' % readbytecount
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
         if len(resp[1]) > 0:
@@ -375,7 +821,10 @@ class i3cblaster:
     # Set the I2C clock frequency in units of kHz.
     # provide e.g. 1000 for 1 MHz. Note that the actual frequency will be lower as function of bus capacitance.
     def i2c_clk(self, clockrate_khz):
-        resp = self._parse_response(self._exec('i2c_clock %d' % clockrate_khz))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I2C_CLK, struct.pack('<I', clockrate_khz))
+        else:
+            resp = self._parse_response(self._exec('i2c_clk %d' % clockrate_khz))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
 
@@ -389,12 +838,15 @@ class i3cblaster:
     # execute an i2c write transfer to a I2C target.
     # writedata is an array, targetaddr is the 7-bit targetaddress to write to
     def i2c_write(self, targetaddr, writedata):
-        cmd = 'i2c_write %d ' % targetaddr
-        for d in writedata:
-            cmd += hex(d)+','
-        if len(writedata) > 0:
-            cmd = cmd[0:-1]
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I2C_WRITE, bytes([targetaddr]) + bytes(writedata))
+        else:
+            cmd = 'i2c_write %d ' % targetaddr
+            for d in writedata:
+                cmd += hex(d)+','
+            if len(writedata) > 0:
+                cmd = cmd[0:-1]
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
 
@@ -403,11 +855,14 @@ class i3cblaster:
     # targetaddr is the 7-bit targetaddress to write to
     # The function returns the read data bytes.
     def i2c_read(self, targetaddr, readbytecount):
-        cmd = 'i2c_read %d %d' % (targetaddr, readbytecount)
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I2C_READ, struct.pack('<BH', targetaddr, readbytecount))
+        else:
+            cmd = 'i2c_read %d %d' % (targetaddr, readbytecount)
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
-        return resp[1]
+        return list(resp[1])
 
     # execute an i2c write transfer from a I3C target followed by a restart and read transfer.
     # targetaddr is the 7-bit targetaddress to write to.
@@ -415,16 +870,181 @@ class i3cblaster:
     # readbyecount is the count of bytes requested to read.
     # The function returns the read data bytes.
     def i2c_writeread(self, targetaddr, writedata, readbytecount):
-        cmd = 'i2c_writeread %d ' % targetaddr
-        for d in writedata:
-            cmd += hex(d)+','
-        if len(writedata) > 0:
-            cmd = cmd[0:-1]
-        cmd += ' %d' % readbytecount
-        resp = self._parse_response(self._exec(cmd))
+        if self.binary:
+            resp = self._exec_bin(self.OP_I2C_WRITEREAD, struct.pack('<BH', targetaddr, readbytecount) + bytes(writedata))
+        else:
+            cmd = 'i2c_writeread %d ' % targetaddr
+            for d in writedata:
+                cmd += hex(d)+','
+            if len(writedata) > 0:
+                cmd = cmd[0:-1]
+            cmd += ' %d' % readbytecount
+            resp = self._parse_response(self._exec(cmd))
         if resp[0] != self.OKTEXT:
             raise Exception('I3C Blaster exception: ' + resp[0])
-        return resp[1]
+        return list(resp[1])
+
+
+# Error of a command executed within a batch. command is the text command as sent, errorcode the returned status text
+class i3cblaster_batcherror(Exception):
+    def __init__(self, command, errorcode):
+        Exception.__init__(self, 'I3C Blaster exception: %s (%s)' % (errorcode, command))
+        self.command = command
+        self.errorcode = errorcode
+
+# Result of a command queued in a batch. value and errorcode are set once the batch was executed, error is the
+# i3cblaster_batcherror of a failed command, None otherwise
+class i3cblaster_batchresult:
+    def __init__(self, command, convert, accept):
+        self.command = command
+        self.errorcode = None
+        self.value = None
+        self.error = None
+        self._convert = convert
+        self._accept = accept   # status texts besides OK which are no error, mapped to the value
+
+# Pipelined execution of text commands.
+# The transfer functions have the same parameters as the ones of i3cblaster, but return a i3cblaster_batchresult
+# which gets its value during execute(). Commands are executed by the I3C Blaster in the queued order. Up to window
+# commands are written ahead of their responses, each one produces one response line (echo is disabled by the @ prefix).
+# Only the text command line is used, so this works with every firmware version and independent of the binary setting.
+# execute() raises the i3cblaster_batcherror of the first failed command after all responses were read; the following
+# commands are executed nevertheless, their results stay valid. Leaving a with block by an exception discards the batch.
+class i3cblaster_batch:
+    def __init__(self, dev, window=32):
+        self._dev = dev
+        self._window = max(1, window)
+        self._queue = []
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        if exc_type is None:
+            self.execute()
+        else:
+            self._queue = []
+        return False
+
+    def __len__(self):
+        return len(self._queue)
+
+    # queue any text command. convert is called with the list of returned values, accept maps status texts
+    # which are no error to the value returned for them
+    def command(self, cmdstr, convert=None, accept={}):
+        cmdstr = cmdstr.rstrip()
+        if len(cmdstr) >= 1024: # UCLI_MAXLINELEN of the firmware
+            raise ValueError('command too long for the I3C Blaster command line: ' + cmdstr[0:40] + '...')
+        result = i3cblaster_batchresult(cmdstr, convert, accept)
+        self._queue.append(result)
+        return result
+
+    # sends all queued commands and reads the responses. Returns the list of values in queued order
+    def execute(self):
+        queue = self._queue
+        self._queue = []
+        dev = self._dev
+        if (len(queue) > 0) and not dev._connect():
+            raise Exception('I3C Blaster exception: not connected')
+        if len(queue) > 0:
+            dev._flush()
+        sent = 0
+        firsterror = None
+        for received in range(len(queue)):
+            if sent - received <= self._window // 2: # refill, so the device always has commands to execute
+                count = min(len(queue), received + self._window) - sent
+                dev._ser.write(''.join(['@' + r.command + '\r' for r in queue[sent:sent+count]]).encode('latin-1'))
+                sent += count
+            result = queue[received]
+            line = dev._readline() if dev._ibi_streaming else dev._ser.readline()
+            if len(line) == 0:
+                result.errorcode = 'ERR_NO_RESPONSE'
+            else:
+                result.errorcode, values = dev._parse_response(line)
+            if result.errorcode == dev.OKTEXT:
+                result.value = values if result._convert is None else result._convert(values)
+            elif result.errorcode in result._accept:
+                result.value = result._accept[result.errorcode]
+            else:
+                result.error = i3cblaster_batcherror(result.command, result.errorcode)
+                if firsterror is None:
+                    firsterror = result.error
+            if len(line) == 0: # the device stopped answering, the remaining responses would not match anymore
+                for r in queue[received+1:]:
+                    r.errorcode = 'ERR_NO_RESPONSE'
+                    r.error = i3cblaster_batcherror(r.command, r.errorcode)
+                break
+        if firsterror is not None:
+            raise firsterror
+        return [r.value for r in queue]
+
+    def _datastr(self, data):
+        return ','.join([hex(d) for d in data])
+
+    def gpio_write(self, gpionum, state):
+        if (state == 1) or (state == True) or (state == '1'):
+            state = '1'
+        elif (state == 0) or (state == False)  or (state == '0'):
+            state = '0'
+        else:
+            state = 'Z'
+        return self.command('gpio_write %d %c' % (gpionum, state))
+
+    def gpio_read(self, gpionum=None):
+        return self.command('gpio_read' if gpionum is None else 'gpio_read %d' % gpionum)
+
+    def i3c_clk(self, clockrate_khz):
+        return self.command('i3c_clk %d' % clockrate_khz)
+
+    def i3c_bus(self, bus, gpiobase=None, sm=None):
+        cmd = 'i3c_bus %d' % bus
+        if gpiobase is not None:
+            cmd += ' %d %d' % (gpiobase, bus if sm is None else sm)
+        return self.command(cmd, tuple)
+
+    def i3c_sdr_write(self, targetaddr, writedata):
+        return self.command('i3c_sdr_write %d %s' % (targetaddr, self._datastr(writedata)))
+
+    def i3c_sdr_read(self, targetaddr, readbytecount):
+        return self.command('i3c_sdr_read %d %d' % (targetaddr, readbytecount))
+
+    def i3c_sdr_writeread(self, targetaddr, writedata, readbytecount):
+        return self.command('i3c_sdr_writeread %d %s %d' % (targetaddr, self._datastr(writedata), readbytecount))
+
+    def i3c_sdr_ccc_bc_write(self, writedata):
+        return self.command('i3c_sdr_ccc_bc_write %s' % self._datastr(writedata))
+
+    def i3c_sdr_ccc_direct_write(self, targetaddr, bc_phase_writedata, direct_phase_writedata):
+        return self.command('i3c_sdr_ccc_direct_write %d %s %s' % (targetaddr, self._datastr(bc_phase_writedata),
+                                                                   self._datastr(direct_phase_writedata)))
+
+    def i3c_sdr_ccc_direct_read(self, targetaddr, writedata, readbytecount):
+        return self.command('i3c_sdr_ccc_direct_read %d %s %d' % (targetaddr, self._datastr(writedata), readbytecount))
+
+    # value is None when no IBI was pending, as i3cblaster.i3c_poll
+    def i3c_poll(self):
+        return self.command('i3c_poll', accept={'WARN_NO_IBI(5)': None})
+
+    def i3c_ddr_write(self, targetaddr, writecommand, writedata):
+        return self.command('i3c_ddr_write %d %d %s' % (targetaddr, writecommand, self._datastr(writedata)))
+
+    def i3c_ddr_read(self, targetaddr, readcommand, readbytecount):
+        return self.command('i3c_ddr_read %d %d %d' % (targetaddr, readcommand, readbytecount))
+
+    # value is [count of written words, read data] as returned by i3cblaster.i3c_ddr_writeread
+    def i3c_ddr_writeread(self, targetaddr, writecommand, readcommand, writedata, readbytecount):
+        return self.command('i3c_ddr_writeread %d %d %d %s %d' % (targetaddr, writecommand, readcommand,
+                                                                  self._datastr(writedata), readbytecount),
+                            lambda v: [v[0], v[1:]] if len(v) > 0 else [0, []])
+
+    def i2c_write(self, targetaddr, writedata):
+        return self.command('i2c_write %d %s' % (targetaddr, self._datastr(writedata)))
+
+    def i2c_read(self, targetaddr, readbytecount):
+        return self.command('i2c_read %d %d' % (targetaddr, readbytecount))
+
+    def i2c_writeread(self, targetaddr, writedata, readbytecount):
+        return self.command('i2c_writeread %d %s %d' % (targetaddr, self._datastr(writedata), readbytecount))
 
 
 def listdevices():
@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+# End to end benchmark of the I3C Blaster through the i3cblaster module.
+#
+# Measures transactions/s and the round trip latency (min, mean, p50, p99, p999, max) of every transfer type for all
+# combinations of payload size, clock rate and mode:
+#   binary  one binary frame per call, waiting for the response (i3cblaster.binary = True, the default when the firmware supports it)
+#   text    one text command per call, waiting for the response (i3cblaster.binary = False)
+#   batch   text commands queued by i3cblaster.batch(), only transactions/s is measured
+#
+# The results are written as JSON (--json) for regression tracking, --baseline compares them with an earlier result
+# and fails when a throughput dropped by more than --tolerance percent.
+# With --sim the benchmark runs against host/i3cb_loopback (build it with: cmake -S host -B build-host && cmake --build
+# build-host), which emulates the device on a pty including the bus time at the set clock rate, so it runs without
+# hardware e.g. in CI. The target addresses given with --addr and --i2caddr are emulated then.
+# With --fwsim it runs against host/i3cb_fwsim instead: the firmware itself with the CLI on a pty and the I3C bus in the
+# cycle accurate PIO simulator with a target model at --addr. It measures the host stack incl. the firmware's command
+# processing, at the speed of the simulation rather than the bus. There are no I2C devices, so the I2C ops are left out
+# unless given with --ops.
+#
+# examples:
+#   python i3cblaster_bench.py --addr 0x08 --i2caddr 0x50 --json result.json
+#   python i3cblaster_bench.py --sim --count 1000 --json sim.json --baseline sim_baseline.json
+#   python i3cblaster_bench.py --fwsim --clocks 12500 --sizes 1,64 --count 100 --json fwsim.json
+
+import argparse
+import datetime
+import json
+import math
+import os
+import platform
+import subprocess
+import sys
+import time
+
+import i3cblaster
+
+OPS = ['sdr_write', 'sdr_read', 'sdr_writeread', 'ccc_bc_write', 'ccc_direct_read', 'ddr_write', 'ddr_read',
+       'i2c_write', 'i2c_read', 'i2c_writeread']
+MODES = ['binary', 'text', 'batch']
+DDR_COMMAND = 0x05
+CCC_ENEC = 0x00      # broadcast ENEC without events: changes nothing on the targets
+CCC_GETSTATUS = 0x90 # direct GETSTATUS, 2 bytes
+
+def intlist(s):
+    return [int(v, 0) for v in s.split(',') if len(v) > 0]
+
+def strlist(s):
+    return [v for v in s.split(',') if len(v) > 0]
+
+# returns a function executing op once on dev (or queuing it on a batch) and the effective payload size
+def transfer(op, size, addr, i2caddr):
+    data = [(i * 7) & 0xff for i in range(size)]
+    words = [(i * 0x0101) & 0xffff for i in range(max(1, size // 2))]
+    if op == 'sdr_write':
+        return (lambda d: d.i3c_sdr_write(addr, data)), size
+    if op == 'sdr_read':
+        return (lambda d: d.i3c_sdr_read(addr, size)), size
+    if op == 'sdr_writeread':
+        return (lambda d: d.i3c_sdr_writeread(addr, [0x00], size)), size
+    if op == 'ccc_bc_write':
+        return (lambda d: d.i3c_sdr_ccc_bc_write([CCC_ENEC, 0x00])), 1
+    if op == 'ccc_direct_read':
+        return (lambda d: d.i3c_sdr_ccc_direct_read(addr, [CCC_GETSTATUS], 2)), 2
+    if op == 'ddr_write':
+        return (lambda d: d.i3c_ddr_write(addr, DDR_COMMAND, words)), 2 * len(words)
+    if op == 'ddr_read':
+        return (lambda d: d.i3c_ddr_read(addr, DDR_COMMAND, len(words))), 2 * len(words)
+    if op == 'i2c_write':
+        return (lambda d: d.i2c_write(i2caddr, data)), size
+    if op == 'i2c_read':
+        return (lambda d: d.i2c_read(i2caddr, size)), size
+    if op == 'i2c_writeread':
+        return (lambda d: d.i2c_writeread(i2caddr, [0x00], size)), size
+    raise ValueError('unknown op ' + op)
+
+# nearest rank percentile of sorted values
+def percentile(values, p):
+    return values[max(0, min(len(values) - 1, int(math.ceil(p * len(values))) - 1))]
+
+def run(dev, mode, fn, count, warmup, window):
+    latencies = []
+    errors = 0
+    firsterror = None
+    dev.binary = (mode == 'binary')
+    for i in range(warmup):
+        try:
+            if mode == 'batch':
+                with dev.batch(window) as b:
+                    fn(b)
+            else:
+                fn(dev)
+        except Exception:
+            pass
+    tstart = time.perf_counter()
+    if mode == 'batch':
+        b = dev.batch(window)
+        results = [fn(b) for i in range(count)]
+        try:
+            b.execute()
+        except Exception as e:
+            firsterror = str(e)
+        errors = len([r for r in results if r.error is not None])
+    else:
+        for i in range(count):
+            t = time.perf_counter()
+            try:
+                fn(dev)
+            except Exception as e:
+                errors += 1
+                if firsterror is None:
+                    firsterror = str(e)
+            latencies.append((time.perf_counter() - t) * 1e6)
+    elapsed = time.perf_counter() - tstart
+    result = {'count': count, 'errors': errors, 'elapsed_s': round(elapsed, 6), 'tps': round(count / elapsed, 1),
+              'latency_us': None}
+    if len(latencies) > 0:
+        latencies.sort()
+        result['latency_us'] = {'min': round(latencies[0], 1), 'mean': round(sum(latencies) / len(latencies), 1),
+                                'p50': round(percentile(latencies, 0.5), 1), 'p99': round(percentile(latencies, 0.99), 1),
+                                'p999': round(percentile(latencies, 0.999), 1), 'max': round(latencies[-1], 1)}
+    if firsterror is not None:
+        result['first_error'] = firsterror
+    return result
+
+def key(r):
+    return (r['op'], r['mode'], r['clk_khz'], r['size'])
+
+# prints throughput changes against a baseline result file, returns the count of regressions
+def compare(results, baselinefile, tolerance):
+    with open(baselinefile) as f:
+        baseline = {key(r): r for r in json.load(f)['results']}
+    regressions = 0
+    for r in results:
+        b = baseline.get(key(r))
+        if (b is None) or (b['tps'] <= 0):
+            continue
+        change = 100.0 * (r['tps'] - b['tps']) / b['tps']
+        if change < -tolerance:
+            regressions += 1
+            print('REGRESSION %-16s %-6s %6d kHz %5d bytes: %9.1f -> %9.1f tps (%+.1f%%)' %
+                  (r['op'], r['mode'], r['clk_khz'], r['size'], b['tps'], r['tps'], change))
+    print('%d of %d results more than %.1f%% slower than %s' % (regressions, len(results), tolerance, baselinefile))
+    return regressions
+
+def start_sim(binary, addr, i2caddr, latency_us):
+    if binary is None:
+        binary = os.environ.get('I3CB_LOOPBACK',
+                                os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'build-host', 'i3cb_loopback'))
+    proc = subprocess.Popen([binary, '-l', str(latency_us), '-t', str(addr), '-t', str(i2caddr)],
+                            stdout=subprocess.PIPE, universal_newlines=True)
+    return proc, proc.stdout.readline().strip()
+
+def start_fwsim(binary, addr):
+    if binary is None:
+        binary = os.environ.get('I3CB_FWSIM',
+                                os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'build-host', 'i3cb_fwsim'))
+    proc = subprocess.Popen([binary, '-t', str(addr)], stdout=subprocess.PIPE, universal_newlines=True)
+    return proc, proc.stdout.readline().strip()
+
+def main():
+    parser = argparse.ArgumentParser(description='I3C Blaster end to end benchmark')
+    parser.add_argument('--port', help='serial port of the device, default: search by USB IDs')
+    parser.add_argument('--serial', help='serial number of the device to search')
+    parser.add_argument('--sim', nargs='?', const=None, default=False, metavar='LOOPBACK',
+                        help='run against the i3cb_loopback test double (default: build-host/i3cb_loopback or $I3CB_LOOPBACK)')
+    parser.add_argument('--fwsim', nargs='?', const=None, default=False, metavar='FWSIM',
+                        help='run against the firmware on the PIO simulator (default: build-host/i3cb_fwsim or $I3CB_FWSIM)')
+    parser.add_argument('--sim-latency', type=int, default=50, help='processing time of the test double per transfer in us')
+    parser.add_argument('--ops', type=strlist, default=None, help='comma separated transfer types, default: all')
+    parser.add_argument('--modes', type=strlist, default=MODES, help='comma separated modes, default: all')
+    parser.add_argument('--sizes', type=intlist, default=[1, 16, 64, 256], help='payload sizes in bytes')
+    parser.add_argument('--clocks', type=intlist, default=[1000, 4000, 12500], help='I3C clock rates in kHz')
+    parser.add_argument('--i2c-clocks', type=intlist, default=[100, 400, 1000], help='I2C clock rates in kHz')
+    parser.add_argument('--count', type=int, default=200, help='transfers per measurement')
+    parser.add_argument('--warmup', type=int, default=5, help='transfers before each measurement')
+    parser.add_argument('--window', type=int, default=32, help='commands in flight in batch mode')
+    parser.add_argument('--addr', type=lambda s: int(s, 0), default=0x08, help='I3C target address')
+    parser.add_argument('--i2caddr', type=lambda s: int(s, 0), default=0x50, help='I2C target address')
+    parser.add_argument('--json', help='write the results to this file')
+    parser.add_argument('--baseline', help='compare the results with this earlier --json file')
+    parser.add_argument('--tolerance', type=float, default=10.0, help='allowed throughput drop against the baseline in percent')
+    args = parser.parse_args()
+
+    if (args.sim is not False) and (args.fwsim is not False):
+        parser.error('--sim and --fwsim exclude each other')
+    if args.ops is None:
+        args.ops = OPS if args.fwsim is False else [op for op in OPS if not op.startswith('i2c_')]
+    for op in args.ops:
+        if op not in OPS:
+            parser.error('unknown op %s, valid: %s' % (op, ','.join(OPS)))
+    for mode in args.modes:
+        if mode not in MODES:
+            parser.error('unknown mode %s, valid: %s' % (mode, ','.join(MODES)))
+
+    sim = None
+    port = args.port
+    if args.sim is not False:
+        sim, port = start_sim(args.sim, args.addr, args.i2caddr, args.sim_latency)
+    elif args.fwsim is not False:
+        sim, port = start_fwsim(args.fwsim, args.addr)
+    dev = i3cblaster.i3cblaster()
+    dev.init(args.serial, port)
+
+    results = []
+    try:
+        if not dev._connect():
+            print('no I3C Blaster found')
+            return 1
+        print('%-16s %-6s %9s %6s %10s %9s %9s %9s %6s' % ('op', 'mode', 'clk_kHz', 'size', 'tps', 'p50_us', 'p99_us', 'p999_us', 'errors'))
+        for op in args.ops:
+            i2c = op.startswith('i2c_')
+            for clk in (args.i2c_clocks if i2c else args.clocks):
+                dev.binary = True
+                if i2c:
+                    dev.i2c_clk(clk)
+                else:
+                    dev.i3c_clk(clk)
+                sizes = args.sizes if not op.startswith('ccc_') else args.sizes[0:1] # CCC payloads are fixed
+                for size in sizes:
+                    fn, effsize = transfer(op, size, args.addr, args.i2caddr)
+                    for mode in args.modes:
+                        r = {'op': op, 'mode': mode, 'clk_khz': clk, 'size': effsize}
+                        r.update(run(dev, mode, fn, args.count, args.warmup, args.window))
+                        results.append(r)
+                        lat = r['latency_us'] if r['latency_us'] is not None else {'p50': '-', 'p99': '-', 'p999': '-'}
+                        print('%-16s %-6s %9d %6d %10.1f %9s %9s %9s %6d' % (op, mode, clk, effsize, r['tps'], lat['p50'], lat['p99'],
+                                                                      lat['p999'], r['errors']))
+        dev.binary = True
+        dev.i3c_clk(12500)
+    finally:
+        if sim is not None:
+            sim.terminate()
+            sim.wait()
+
+    if args.json is not None:
+        report = {'version': 1,
+                  'timestamp': datetime.datetime.now().isoformat(timespec='seconds'),
+                  'target': ('sim' if args.fwsim is False else 'fwsim') if sim is not None else (port if port is not None else (args.serial or 'auto')),
+                  'host': platform.node(),
+                  'python': platform.python_version(),
+                  'config': {'count': args.count, 'warmup': args.warmup, 'window': args.window, 'addr': args.addr,
+                             'i2caddr': args.i2caddr, 'sim_latency_us': args.sim_latency if args.sim is not False else None},
+                  'results': results}
+        with open(args.json, 'w') as f:
+            json.dump(report, f, indent=1)
+    failed = len([r for r in results if r['errors'] > 0])
+    if failed > 0:
+        print('%d measurements had failing transfers' % failed)
+    regressions = compare(results, args.baseline, args.tolerance) if args.baseline is not None else 0
+    return 1 if (failed > 0) or (regressions > 0) else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,147 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "binframe.h"
+#include <string.h>
+#include "pico/stdlib.h"
+
+typedef enum
+{
+	BINFRAME_STATE_IDLE = 0,
+	BINFRAME_STATE_LEN0,
+	BINFRAME_STATE_LEN1,
+	BINFRAME_STATE_BODY,
+} binframe_state_t;
+
+void binframe_init(binframe_t *pbf, binframe_handler_t handler, binframe_write_t write)
+{
+	pbf->handler = handler;
+	pbf->write   = write;
+	pbf->state   = BINFRAME_STATE_IDLE;
+	pbf->bus     = 0;
+}
+
+bool binframe_busy(binframe_t *pbf)
+{
+	return pbf->state != BINFRAME_STATE_IDLE;
+}
+
+static void binframe_complete(binframe_t *pbf)
+{
+	pbf->state = BINFRAME_STATE_IDLE;
+	if (pbf->handler)
+	{
+		pbf->handler(pbf, pbf->buf[0], pbf->buf[1], &pbf->buf[2], pbf->len - 2);
+	}
+}
+
+void binframe_process(binframe_t *pbf, char ch)
+{
+	uint8_t b = (uint8_t)ch;
+
+	pbf->lastrx_us = time_us_32();
+	switch (pbf->state)
+	{
+		case BINFRAME_STATE_IDLE:
+			if (b == BINFRAME_SOF)
+				pbf->state = BINFRAME_STATE_LEN0;
+			break;
+		case BINFRAME_STATE_LEN0:
+			pbf->len = b;
+			pbf->state = BINFRAME_STATE_LEN1;
+			break;
+		case BINFRAME_STATE_LEN1:
+			pbf->len |= (uint32_t)b << 8;
+			pbf->pos = 0;
+			if ( (pbf->len < 2) || (pbf->len > BINFRAME_MAXLEN) )
+			{ // no seq/opcode or too long -> drop, there is no way to resync inside of such a frame anyway
+				pbf->state = BINFRAME_STATE_IDLE;
+			}
+			else
+			{
+				pbf->state = BINFRAME_STATE_BODY;
+			}
+			break;
+		case BINFRAME_STATE_BODY:
+			pbf->buf[pbf->pos++] = b;
+			if (pbf->pos == pbf->len)
+			{
+				binframe_complete(pbf);
+			}
+			break;
+	}
+}
+
+void binframe_receive(binframe_t *pbf, const uint8_t *pdat, uint32_t len)
+{
+	while (len > 0)
+	{
+		if (pbf->state == BINFRAME_STATE_BODY)
+		{ // copy the frame body in one go instead of char by char
+			uint32_t n = pbf->len - pbf->pos;
+			if (n > len)
+				n = len;
+			memcpy(&pbf->buf[pbf->pos], pdat, n);
+			pbf->pos += n;
+			pdat     += n;
+			len      -= n;
+			pbf->lastrx_us = time_us_32();
+			if (pbf->pos == pbf->len)
+			{
+				binframe_complete(pbf);
+			}
+		}
+		else
+		{
+			binframe_process(pbf, (char)*pdat++);
+			len--;
+		}
+	}
+}
+
+void binframe_poll(binframe_t *pbf)
+{
+	if ( binframe_busy(pbf) && ((time_us_32() - pbf->lastrx_us) > BINFRAME_TIMEOUT_US) )
+	{
+		pbf->state = BINFRAME_STATE_IDLE;
+	}
+}
+
+void binframe_respond(binframe_t *pbf, uint8_t seq, uint8_t opcode, uint8_t status, const void *ppayload, uint32_t len)
+{
+	uint8_t  header[6];
+	uint32_t framelen = len + 3;
+
+	header[0] = BINFRAME_SOF;
+	header[1] = (uint8_t)framelen;
+	header[2] = (uint8_t)(framelen >> 8);
+	header[3] = seq;
+	header[4] = opcode;
+	header[5] = status;
+	pbf->write(header, sizeof(header));
+	if (len > 0)
+	{
+		pbf->write(ppayload, len);
+	}
+}
@@ -0,0 +1,117 @@
+#ifndef _BINFRAME_H
+#define _BINFRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Length prefixed binary command frames as an alternative to the text CLI.
+ *
+ * Every transport has its own binframe_t instance, responses are sent back through the write function of the
+ * instance which received the request.
+ * On the CDC interface a frame is started by sending BINFRAME_SOF as first character of an (empty) CLI line.
+ * ucli_process hands it over to binframe_process and all following characters have to be routed to binframe_process
+ * until binframe_busy() returns false again. So text commands and binary frames can be mixed freely.
+ * On the vendor bulk interface all data is fed through binframe_receive.
+ *
+ * Request:  SOF | len (16 bit, little endian) | seq | opcode | payload
+ * Response: SOF | len (16 bit, little endian) | seq | opcode | status | payload
+ *
+ * len counts all bytes after the len field. seq is returned unchanged and allows the host to match responses.
+ * status is a i3c_hl_status_t value. All 16/32 bit values are little endian, HDR-DDR words as well.
+ * An incomplete frame gets dropped after BINFRAME_TIMEOUT_US without further character.
+ * Every transport has its own selected I3C bus (BINFRAME_OP_I3C_BUS_SELECT, bus 0 after startup). Transfers are queued per
+ * bus, so alternating BUS_SELECT and transfer requests keeps buses with even and odd numbers busy at the same time.
+ * With IBI or sample streaming enabled, the device sends BINFRAME_OP_I3C_IBI_EVENT / BINFRAME_OP_I3C_SAMPLE_EVENT frames
+ * without a request. They are only sent between responses, so a host has to dispatch frames by opcode and not assume that
+ * every frame answers a request.
+ */
+
+#define BINFRAME_SOF         (0x02)
+#define BINFRAME_MAXLEN      (2 + 6 + 2048) // seq, opcode, parameters and 1024 HDR-DDR words
+#define BINFRAME_TIMEOUT_US  (100000ul)
+
+// opcodes, request payload -> response payload
+typedef enum
+{
+	BINFRAME_OP_GPIO_WRITE           = 0x01, // port, state (0, 1, 2 = Z)
+	BINFRAME_OP_GPIO_READ            = 0x02, //  -> gpio states (32 bit)
+	BINFRAME_OP_I3C_DRIVESTRENGTH    = 0x03, // drivestrength in mA
+	BINFRAME_OP_I3C_TARGETRESET      = 0x04, //
+	BINFRAME_OP_I3C_CLK              = 0x05, // frequency in kHz (32 bit)
+	BINFRAME_OP_I3C_SCAN             = 0x06, //  -> list of acknowledging addresses
+	BINFRAME_OP_I3C_ENTDAA           = 0x07, // addr -> 8 bytes PID, BCR, DCR
+	BINFRAME_OP_I3C_RSTDAA           = 0x08, //
+	BINFRAME_OP_I3C_RECOVER          = 0x09, //
+	BINFRAME_OP_ECHO                 = 0x0A, // data -> same data, for transport tests
+	BINFRAME_OP_I3C_BUS_SELECT       = 0x0B, // bus: all following I3C requests of this transport address this bus
+	BINFRAME_OP_I3C_BUS_INIT         = 0x0C, // bus, gpiobase, sm: (re)initialize a bus, see i3c_init
+	BINFRAME_OP_I3C_SDR_WRITE        = 0x10, // addr, data
+	BINFRAME_OP_I3C_SDR_READ         = 0x11, // addr, count (16 bit) -> data
+	BINFRAME_OP_I3C_SDR_WRITEREAD    = 0x12, // addr, count (16 bit), data -> data
+	BINFRAME_OP_I3C_CCC_BC_WRITE     = 0x13, // data
+	BINFRAME_OP_I3C_CCC_DIRECT_WRITE = 0x14, // addr, broadcast phase length, broadcast phase data, direct phase data
+	BINFRAME_OP_I3C_CCC_DIRECT_READ  = 0x15, // addr, count (16 bit), broadcast phase data -> data
+	BINFRAME_OP_I3C_POLL             = 0x16, //  -> IBI data
+	BINFRAME_OP_I3C_IBI_CONFIG       = 0x17, // enable automatic IBI handling of the selected bus
+	BINFRAME_OP_I3C_IBI_READ         = 0x18, // maxcount (16 bit) -> dropped count (32 bit), per IBI: timestamp in us (64 bit), bus, len, data
+	BINFRAME_OP_I3C_IBI_STREAM       = 0x19, // enable: queued IBIs of all buses are sent unsolicited to this transport, enables automatic IBI handling of the selected bus
+	BINFRAME_OP_I3C_IBI_EVENT        = 0x1A, // unsolicited, seq 0: same payload as BINFRAME_OP_I3C_IBI_READ. data[0] of an IBI is address << 1 | 1
+	BINFRAME_OP_I3C_DDR_CONFIG       = 0x20, // crc_word_indicator, enable_early_write_term, write_ack_enable
+	BINFRAME_OP_I3C_DDR_WRITE        = 0x21, // addr, cmd, words -> count of written words (16 bit)
+	BINFRAME_OP_I3C_DDR_READ         = 0x22, // addr, cmd, count (16 bit) -> words
+	BINFRAME_OP_I3C_DDR_WRITEREAD    = 0x23, // addr, wrcmd, rdcmd, count (16 bit), words -> count of written words (16 bit), words
+	BINFRAME_OP_I2C_CLK              = 0x30, // frequency in kHz (32 bit)
+	BINFRAME_OP_I2C_TIMEOUT          = 0x31, // timeout in ms (32 bit)
+	BINFRAME_OP_I2C_SCAN             = 0x32, //  -> list of acknowledging addresses
+	BINFRAME_OP_I2C_WRITE            = 0x33, // addr, data
+	BINFRAME_OP_I2C_READ             = 0x34, // addr, count (16 bit) -> data
+	BINFRAME_OP_I2C_WRITEREAD        = 0x35, // addr, count (16 bit), data -> data
+	BINFRAME_OP_I3C_SAMPLE_JOB       = 0x40, // index, op (i3c_hl_batch_op_t), flags, addr, cmd, readcount (16 bit), period_us (32 bit), offset_us (32 bit), write data: set a sampler job on the selected bus, see sampler_job_set
+	BINFRAME_OP_I3C_SAMPLE_CLEAR     = 0x41, // index (>= SAMPLER_MAXJOBS: all jobs)
+	BINFRAME_OP_I3C_SAMPLE_START     = 0x42, // delay_us (32 bit) -> start time in us (64 bit) the job offsets refer to
+	BINFRAME_OP_I3C_SAMPLE_STOP      = 0x43, //
+	BINFRAME_OP_I3C_SAMPLE_READ      = 0x44, // maxcount (16 bit) -> dropped count (32 bit), per sample: timestamp in us (64 bit), job, status, len, data
+	BINFRAME_OP_I3C_SAMPLE_STATS     = 0x45, //  -> running, per set job: index, executed, missed, dropped count (32 bit each)
+	BINFRAME_OP_I3C_SAMPLE_STREAM    = 0x46, // enable: sampler results are sent unsolicited to this transport
+	BINFRAME_OP_I3C_SAMPLE_EVENT     = 0x47, // unsolicited, seq 0: same payload as BINFRAME_OP_I3C_SAMPLE_READ
+} binframe_opcode_t;
+
+typedef struct binframe binframe_t;
+
+// called for every received complete frame. ppayload points behind the opcode
+typedef void (*binframe_handler_t)(binframe_t *pbf, uint8_t seq, uint8_t opcode, const uint8_t *ppayload, uint32_t len);
+
+// sends response bytes to the host
+typedef void (*binframe_write_t)(const uint8_t *pdat, uint32_t len);
+
+struct binframe
+{
+	binframe_handler_t handler;
+	binframe_write_t   write;
+	uint8_t            state;
+	uint8_t            bus;       // selected I3C bus of this transport
+	uint32_t           len;
+	uint32_t           pos;
+	uint32_t           lastrx_us;
+	uint8_t            buf[BINFRAME_MAXLEN];
+};
+
+void binframe_init(binframe_t *pbf, binframe_handler_t handler, binframe_write_t write);
+
+// true while a frame is being received
+bool binframe_busy(binframe_t *pbf);
+
+// process a received character
+void binframe_process(binframe_t *pbf, char ch);
+
+// process a block of received data, e.g. a USB packet
+void binframe_receive(binframe_t *pbf, const uint8_t *pdat, uint32_t len);
+
+// call periodically. Drops incomplete frames after a timeout
+void binframe_poll(binframe_t *pbf);
+
+// send a response frame
+void binframe_respond(binframe_t *pbf, uint8_t seq, uint8_t opcode, uint8_t status, const void *ppayload, uint32_t len);
+
+#endif
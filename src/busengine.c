@@ -0,0 +1,355 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "busengine.h"
+#include "sampler.h"
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/flash.h"
+#include "hardware/sync.h"
+#include <string.h>
+
+// per bus state. The job ring is written by core0 (wr) and read by the executor of the bus (rd), the IBI queue is
+// written by the executor (ibi_wr) and read by core0 (ibi_rd). All indexes are free running, the slot is the index
+// modulo the ring size
+typedef struct
+{
+	busengine_job_t   *ring[BUSENGINE_RINGSIZE];
+	volatile uint32_t  wr;
+	volatile uint32_t  rd;
+	busengine_ibi_t    ibi_queue[BUSENGINE_IBI_QUEUE];
+	volatile uint32_t  ibi_wr;
+	volatile uint32_t  ibi_rd;
+	volatile uint32_t  ibi_dropped;
+	volatile bool      ibi_auto;  // automatic IBI handling requested by core0
+	volatile bool      ibi_irq;   // the executor enabled the IBI wakeup interrupt
+	volatile bool      busy;      // the executor accesses the bus outside of a job (IBI or sample)
+	bool               ibi_last;  // the last action of the executor was reading a IBI
+} busengine_bus_t;
+
+static busengine_bus_t    s_busengine_bus[I3C_HL_MAXBUS];
+static void             (*s_busengine_idle)(void);
+static volatile bool      s_busengine_locked;     // core0 accesses the buses directly
+
+static inline busengine_bus_t *busengine_bus_state(i3c_hl_bus_t *pbus)
+{
+	return &s_busengine_bus[i3c_hl_bus_index(pbus)];
+}
+
+// read a pending IBI into the queue
+static void __not_in_flash_func(busengine_ibi_service)(i3c_hl_bus_t *pbus, busengine_bus_t *pb)
+{
+	uint64_t         timestamp_us = time_us_64();
+	busengine_ibi_t *pibi = &pb->ibi_queue[pb->ibi_wr % BUSENGINE_IBI_QUEUE];
+	uint8_t          data[BUSENGINE_IBI_MAXLEN];
+	uint32_t         len = sizeof(data);
+	i3c_hl_status_t  retcode;
+	uint32_t         previntstate;
+
+	// no edge interrupts for every bit while the IBI is read
+	previntstate = save_and_disable_interrupts();
+	retcode = i3c_hl_poll(pbus, data, &len);
+	restore_interrupts(previntstate);
+
+	if ( (retcode != i3c_hl_status_ok) || (len == 0) )
+		return;
+	if ((pb->ibi_wr - pb->ibi_rd) >= BUSENGINE_IBI_QUEUE)
+	{ // queue full, the IBI has been acknowledged anyway
+		pb->ibi_dropped++;
+		return;
+	}
+	pibi->timestamp_us = timestamp_us;
+	pibi->bus = i3c_hl_bus_index(pbus);
+	pibi->len = (uint8_t)len;
+	memcpy(pibi->data, data, len);
+	__dmb(); // the entry has to be visible before the write index
+	pb->ibi_wr++;
+}
+
+// one pass of an executor over its buses (even bus numbers: core1, odd ones: core0): executes due samples and reads a
+// pending IBI or executes one job per bus. Returns false when there was nothing to do
+static bool __not_in_flash_func(busengine_execute)(uint8_t executor)
+{
+	bool busy = false;
+
+	for (uint8_t i=0; i<I3C_HL_MAXBUS; i++)
+	{
+		i3c_hl_bus_t    *pbus = i3c_hl_bus(i);
+		busengine_bus_t *pb = &s_busengine_bus[i];
+		busengine_job_t *pjob;
+		bool             jobs_pending = pb->rd != pb->wr;
+
+		if ( !i3c_hl_bus_initialized(pbus) || ((i & 1u) != executor) )
+			continue;
+
+		if (pb->ibi_auto != pb->ibi_irq)
+		{
+			bool enable = pb->ibi_auto;
+			i3c_hl_ibi_irq_enable(pbus, enable); // on this core, the interrupt only wakes up its executor
+			pb->ibi_irq = enable;
+		}
+
+		// due samples first, they are time critical
+		if ( !s_busengine_locked && sampler_pending(pbus) )
+		{
+			pb->busy = true;
+			__dmb(); // pairs with busengine_lock
+			if (!s_busengine_locked)
+				sampler_execute(pbus);
+			__dmb();
+			pb->busy = false;
+			busy = true;
+		}
+
+		// IBIs next, but alternate with jobs so a target holding SDA low can not block the engine
+		if ( pb->ibi_irq && !s_busengine_locked && !(jobs_pending && pb->ibi_last) && i3c_hl_ibi_pending(pbus) )
+		{
+			pb->busy = true;
+			__dmb(); // pairs with busengine_lock
+			if (!s_busengine_locked)
+				busengine_ibi_service(pbus, pb);
+			__dmb();
+			pb->busy = false;
+			pb->ibi_last = true;
+			busy = true;
+			continue;
+		}
+		pb->ibi_last = false;
+
+		if (!jobs_pending)
+			continue;
+		__dmb(); // read the job after seeing the write index
+
+		pjob = pb->ring[pb->rd % BUSENGINE_RINGSIZE];
+		pjob->status = i3c_hl_batch_execute(pbus, pjob->pdesc, pjob->count, &pjob->executed);
+
+		__dmb(); // results have to be visible before done
+		pjob->done = true;
+		pb->rd++;
+		__sev();
+		busy = true;
+	}
+	return busy;
+}
+
+#ifndef I3C_HAL_HOST
+static void __not_in_flash_func(busengine_core1_main)(void)
+{
+	flash_safe_execute_core_init(); // core0 can stop core1 for programming the flash (see cfgstore.c)
+	while (1)
+	{
+		if (!busengine_execute(0))
+		{
+			__wfe(); // woken up by busengine_submit, busengine_ibi_enable/unlock, the SDA edge interrupt or the sampler alarm
+		}
+	}
+}
+
+#endif
+
+void busengine_init(void (*idle)(void))
+{
+	s_busengine_idle = idle;
+	memset(s_busengine_bus, 0, sizeof(s_busengine_bus));
+#ifndef I3C_HAL_HOST
+	multicore_launch_core1(busengine_core1_main);
+#endif
+}
+
+void busengine_task(void)
+{
+#ifdef I3C_HAL_HOST
+	busengine_execute(0); // the host build (src/i3c_hal.h) has a single core, the executor of core1 runs here as well
+#endif
+	busengine_execute(1);
+}
+
+// waiting for the executors: keeps the executor of core0 running
+static void busengine_wait(void)
+{
+	busengine_task();
+	if (s_busengine_idle)
+		s_busengine_idle();
+}
+
+bool busengine_submit(busengine_job_t *pjob)
+{
+	busengine_bus_t *pb = busengine_bus_state(pjob->pbus);
+
+	if (!i3c_hl_bus_initialized(pjob->pbus))
+	{ // there is no executor for this bus
+		pjob->executed = 0;
+		pjob->status   = i3c_hl_status_param_outofrange;
+		pjob->done     = true;
+		return true;
+	}
+	if ((pb->wr - pb->rd) >= BUSENGINE_RINGSIZE)
+		return false;
+
+	pjob->done = false;
+	pb->ring[pb->wr % BUSENGINE_RINGSIZE] = pjob;
+	__dmb(); // the job has to be visible before the write index
+	pb->wr++;
+	__sev();
+	return true;
+}
+
+bool busengine_idle(void)
+{
+	for (uint32_t i=0; i<I3C_HL_MAXBUS; i++)
+	{
+		if (s_busengine_bus[i].rd != s_busengine_bus[i].wr)
+			return false;
+	}
+	return true;
+}
+
+void busengine_sync(void)
+{
+	while (!busengine_idle())
+	{
+		busengine_wait();
+	}
+	__dmb();
+}
+
+i3c_hl_status_t busengine_run(i3c_hl_bus_t *pbus, i3c_hl_batch_desc_t *pdesc, uint32_t count, uint32_t *pexecuted)
+{
+	busengine_job_t job = { .pbus = pbus, .pdesc = pdesc, .count = count };
+
+	while (!busengine_submit(&job))
+	{
+		busengine_wait();
+	}
+	while (!job.done)
+	{
+		busengine_wait();
+	}
+	__dmb();
+	if (pexecuted)
+		*pexecuted = job.executed;
+	return job.status;
+}
+
+void busengine_lock(void)
+{
+	busengine_sync();
+	s_busengine_locked = true;
+	__dmb(); // pairs with the IBI handling of the executors
+	for (uint32_t i=0; i<I3C_HL_MAXBUS; i++)
+	{
+		while (s_busengine_bus[i].busy)
+		{
+			tight_loop_contents();
+		}
+	}
+	__dmb();
+}
+
+void busengine_unlock(void)
+{
+	__dmb();
+	s_busengine_locked = false;
+	__sev();
+}
+
+i3c_hl_status_t busengine_bus_init(i3c_hl_bus_t *pbus, uint8_t sm, uint8_t gpiobasepin)
+{
+	busengine_bus_t *pb = busengine_bus_state(pbus);
+	bool             ibi_auto = pb->ibi_auto;
+	i3c_hl_status_t  retcode;
+
+	// the executor of the bus has to release the IBI interrupt of the current pins first
+	pb->ibi_auto = false;
+	__sev();
+	while (pb->ibi_irq)
+	{
+		busengine_task();
+	}
+	retcode = i3c_init(pbus, sm, gpiobasepin);
+	pb->ibi_auto = ibi_auto;
+	__sev();
+	return retcode;
+}
+
+void busengine_ibi_enable(i3c_hl_bus_t *pbus, bool enable)
+{
+	busengine_bus_state(pbus)->ibi_auto = enable;
+	__sev();
+}
+
+bool busengine_ibi_enabled(i3c_hl_bus_t *pbus)
+{
+	return busengine_bus_state(pbus)->ibi_auto;
+}
+
+// the bus with the oldest queued IBI, NULL when all queues are empty
+static busengine_bus_t *busengine_ibi_oldest(void)
+{
+	busengine_bus_t *poldest = NULL;
+
+	for (uint32_t i=0; i<I3C_HL_MAXBUS; i++)
+	{
+		busengine_bus_t *pb = &s_busengine_bus[i];
+		if (pb->ibi_rd == pb->ibi_wr)
+			continue;
+		__dmb(); // read the entry after seeing the write index
+		if ( (poldest == NULL) ||
+		     (pb->ibi_queue[pb->ibi_rd % BUSENGINE_IBI_QUEUE].timestamp_us < poldest->ibi_queue[poldest->ibi_rd % BUSENGINE_IBI_QUEUE].timestamp_us) )
+		{
+			poldest = pb;
+		}
+	}
+	return poldest;
+}
+
+uint32_t busengine_ibi_read(i3c_hl_bus_t *pbus, busengine_ibi_t *pibi, uint32_t maxcount)
+{
+	uint32_t count = 0;
+
+	while (count < maxcount)
+	{
+		busengine_bus_t *pb = pbus ? busengine_bus_state(pbus) : busengine_ibi_oldest();
+		if ( (pb == NULL) || (pb->ibi_rd == pb->ibi_wr) )
+			break;
+		__dmb(); // read the entry after seeing the write index
+		pibi[count++] = pb->ibi_queue[pb->ibi_rd % BUSENGINE_IBI_QUEUE];
+		__dmb(); // the entry has to be read before it is released
+		pb->ibi_rd++;
+	}
+	return count;
+}
+
+uint32_t busengine_ibi_dropped(i3c_hl_bus_t *pbus)
+{
+	uint32_t dropped = 0;
+
+	if (pbus)
+		return busengine_bus_state(pbus)->ibi_dropped;
+	for (uint32_t i=0; i<I3C_HL_MAXBUS; i++)
+	{
+		dropped += s_busengine_bus[i].ibi_dropped;
+	}
+	return dropped;
+}
@@ -0,0 +1,88 @@
+#ifndef _BUSENGINE_H
+#define _BUSENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i3c_hl.h"
+
+/*
+ * Executes i3c_hl transfers on one or more I3C buses (see i3c_hl_bus).
+ *
+ * core0 submits jobs (a list of batch descriptors for one bus, see i3c_hl_batch_execute) into a single producer / single
+ * consumer ring of that bus. Each core has one executor which runs the jobs of its buses in order and sets done when
+ * finished: buses with even numbers are executed by core1, buses with odd numbers by core0 inside of busengine_task.
+ * So transfers on bus 0 and bus 1 run at the same time, while buses of the same executor take turns job by job.
+ * The job and its descriptors and buffers are owned by the executor from submit until done is set.
+ * As i3c_hl disables interrupts only on the executing core, USB handling, command parsing and response formatting on
+ * core0 continue while a transfer on an even bus is running.
+ *
+ * When automatic IBI handling is enabled for a bus, its executor reads IBIs by itself whenever no job is running: SDA
+ * getting low on the idle bus wakes it up by a GPIO interrupt, IBIs winning the arbitration of a transfer are read right
+ * after the job. Each IBI is queued with a timestamp and can be drained by core0 with busengine_ibi_read.
+ * Due jobs of the periodic sampler (see sampler.h) are executed before both.
+ *
+ * All functions are to be called from core0 only. Code on core0 which accesses a bus directly (e.g. configuration
+ * changes or I2C transfers on the shared pins) has to be enclosed by busengine_lock() and busengine_unlock().
+ */
+
+#define BUSENGINE_RINGSIZE    (8u)  // power of 2
+#define BUSENGINE_IBI_QUEUE   (64u) // power of 2
+#define BUSENGINE_IBI_MAXLEN  (16u) // IBI address + MDB + payload
+
+typedef struct
+{
+	i3c_hl_bus_t        *pbus;
+	i3c_hl_batch_desc_t *pdesc;
+	uint32_t             count;
+	uint32_t             executed; // out: count of executed descriptors
+	i3c_hl_status_t      status;   // out: see i3c_hl_batch_execute
+	volatile bool        done;     // set by the executor when the job is completed
+} busengine_job_t;
+
+typedef struct
+{
+	uint64_t timestamp_us;                // time the IBI request was detected
+	uint8_t  bus;                         // index of the bus which raised the IBI
+	uint8_t  len;
+	uint8_t  data[BUSENGINE_IBI_MAXLEN];  // as returned by i3c_hl_poll: IBI address byte, MDB, payload
+} busengine_ibi_t;
+
+// starts core1. idle is called while busengine_run/busengine_sync wait for the executors, e.g. to keep USB serviced
+void busengine_init(void (*idle)(void));
+
+// executes jobs and IBI handling of the buses with odd numbers. Call it from the main loop of core0
+void busengine_task(void);
+
+// queues a job on the ring of pjob->pbus. Returns false when the ring is full. A job for a bus which is not
+// initialized completes immediately with i3c_hl_status_param_outofrange
+bool busengine_submit(busengine_job_t *pjob);
+
+// true when no job is queued or running on any bus
+bool busengine_idle(void);
+
+// waits until all queued jobs are completed
+void busengine_sync(void);
+
+// executes the descriptors on bus pbus and waits for completion
+i3c_hl_status_t busengine_run(i3c_hl_bus_t *pbus, i3c_hl_batch_desc_t *pdesc, uint32_t count, uint32_t *pexecuted);
+
+// waits until all queued jobs are completed and suspends automatic IBI handling, so core0 can access the buses directly.
+// Jobs submitted while locked are still executed
+void busengine_lock(void);
+void busengine_unlock(void);
+
+// (re)initializes a bus, see i3c_init. Automatic IBI handling of the bus is kept enabled and moves along with it
+i3c_hl_status_t busengine_bus_init(i3c_hl_bus_t *pbus, uint8_t sm, uint8_t gpiobasepin);
+
+// enables automatic IBI handling of a bus
+void busengine_ibi_enable(i3c_hl_bus_t *pbus, bool enable);
+bool busengine_ibi_enabled(i3c_hl_bus_t *pbus);
+
+// removes up to maxcount IBIs from the queue of pbus, or from the queues of all buses when pbus is NULL (oldest first).
+// Returns the count of IBIs copied to pibi
+uint32_t busengine_ibi_read(i3c_hl_bus_t *pbus, busengine_ibi_t *pibi, uint32_t maxcount);
+
+// count of IBIs of pbus (NULL: of all buses) dropped since startup because the queue was full
+uint32_t busengine_ibi_dropped(i3c_hl_bus_t *pbus);
+
+#endif
@@ -0,0 +1,204 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "cfgstore.h"
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include <string.h>
+#include <stddef.h>
+
+#define CFGSTORE_MAGIC        (0x43423349ul) // "I3BC"
+#define CFGSTORE_VERSION      (1u)           // of cfgstore_config_t, records of other versions are ignored
+#define CFGSTORE_OFFSET       (PICO_FLASH_SIZE_BYTES - CFGSTORE_SECTORS * FLASH_SECTOR_SIZE)
+#define CFGSTORE_SLOTS        (CFGSTORE_SECTORS * FLASH_SECTOR_SIZE / CFGSTORE_SLOTSIZE)
+#define CFGSTORE_SECTOR_SLOTS (FLASH_SECTOR_SIZE / CFGSTORE_SLOTSIZE)
+#define CFGSTORE_LOCKOUT_MS   (100u)         // timeout of stopping the other core
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t sequence;  // incremented by every save
+	uint16_t version;
+	uint16_t len;       // of the payload following the header
+	uint32_t crc;       // CRC-32 of the header up to crc and the payload
+} cfgstore_header_t;
+
+_Static_assert(sizeof(cfgstore_header_t) + sizeof(cfgstore_config_t) <= CFGSTORE_SLOTSIZE, "cfgstore_config_t exceeds a slot");
+_Static_assert((CFGSTORE_SLOTSIZE % FLASH_PAGE_SIZE) == 0, "CFGSTORE_SLOTSIZE is no multiple of the flash page size");
+
+typedef struct
+{
+	uint32_t offset;
+	const uint8_t *pdat;
+} cfgstore_flashop_t;
+
+static int32_t  s_cfgstore_newest = -1; // slot of the newest valid record, -1: none
+static uint32_t s_cfgstore_sequence;
+
+static inline const uint8_t *cfgstore_slot(uint32_t slot)
+{
+	return (const uint8_t *)(XIP_BASE + CFGSTORE_OFFSET + slot * CFGSTORE_SLOTSIZE);
+}
+
+static uint32_t cfgstore_crc32(uint32_t crc, const uint8_t *pdat, uint32_t len)
+{
+	crc = ~crc;
+	while (len--)
+	{
+		crc ^= *pdat++;
+		for (uint32_t i=0; i<8; i++)
+			crc = (crc >> 1) ^ (0xedb88320ul & (0u - (crc & 1u)));
+	}
+	return ~crc;
+}
+
+static uint32_t cfgstore_record_crc(const cfgstore_header_t *phdr, const uint8_t *ppayload)
+{
+	uint32_t crc = cfgstore_crc32(0, (const uint8_t *)phdr, offsetof(cfgstore_header_t, crc));
+	return cfgstore_crc32(crc, ppayload, phdr->len);
+}
+
+static bool cfgstore_slot_valid(uint32_t slot)
+{
+	cfgstore_header_t hdr;
+	const uint8_t *p = cfgstore_slot(slot);
+
+	memcpy(&hdr, p, sizeof(hdr));
+	return (hdr.magic == CFGSTORE_MAGIC) && (hdr.version == CFGSTORE_VERSION) && (hdr.len == sizeof(cfgstore_config_t)) &&
+	       (hdr.crc == cfgstore_record_crc(&hdr, p + sizeof(hdr)));
+}
+
+static bool cfgstore_slot_blank(uint32_t slot)
+{
+	const uint32_t *p = (const uint32_t *)cfgstore_slot(slot);
+
+	for (uint32_t i=0; i<CFGSTORE_SLOTSIZE/4u; i++)
+	{
+		if (p[i] != 0xfffffffful)
+			return false;
+	}
+	return true;
+}
+
+// finds the newest valid record. Sequence numbers are compared by their difference, so they may wrap
+static void cfgstore_scan(void)
+{
+	s_cfgstore_newest   = -1;
+	s_cfgstore_sequence = 0;
+	for (uint32_t slot=0; slot<CFGSTORE_SLOTS; slot++)
+	{
+		if (cfgstore_slot_valid(slot))
+		{
+			uint32_t sequence = ((const cfgstore_header_t *)cfgstore_slot(slot))->sequence;
+			if ( (s_cfgstore_newest < 0) || ((int32_t)(sequence - s_cfgstore_sequence) > 0) )
+			{
+				s_cfgstore_newest   = (int32_t)slot;
+				s_cfgstore_sequence = sequence;
+			}
+		}
+	}
+}
+
+// executed with the other core stopped and interrupts disabled
+static void cfgstore_flash_erase(void *param)
+{
+	const cfgstore_flashop_t *pop = param;
+	flash_range_erase(pop->offset, FLASH_SECTOR_SIZE);
+}
+
+static void cfgstore_flash_program(void *param)
+{
+	const cfgstore_flashop_t *pop = param;
+	flash_range_program(pop->offset, pop->pdat, CFGSTORE_SLOTSIZE);
+}
+
+bool cfgstore_load(cfgstore_config_t *pcfg)
+{
+	cfgstore_scan();
+	if (s_cfgstore_newest < 0)
+		return false;
+	memcpy(pcfg, cfgstore_slot((uint32_t)s_cfgstore_newest) + sizeof(cfgstore_header_t), sizeof(*pcfg));
+	return true;
+}
+
+bool cfgstore_save(const cfgstore_config_t *pcfg)
+{
+	static uint8_t buf[CFGSTORE_SLOTSIZE];
+	cfgstore_header_t hdr;
+	cfgstore_flashop_t op;
+	uint32_t slot;
+
+	cfgstore_scan();
+	slot = (s_cfgstore_newest < 0) ? 0 : ((uint32_t)s_cfgstore_newest + 1u) % CFGSTORE_SLOTS;
+
+	// a slot which is not blank (e.g. a save interrupted by a reset) can only be reused by erasing its sector. Within the
+	// sector of the newest record the log continues in the next sector instead
+	if ( ((slot % CFGSTORE_SECTOR_SLOTS) != 0) && !cfgstore_slot_blank(slot) )
+		slot = (slot + CFGSTORE_SECTOR_SLOTS - (slot % CFGSTORE_SECTOR_SLOTS)) % CFGSTORE_SLOTS;
+	if ((slot % CFGSTORE_SECTOR_SLOTS) == 0)
+	{
+		op.offset = CFGSTORE_OFFSET + slot * CFGSTORE_SLOTSIZE;
+		if (flash_safe_execute(cfgstore_flash_erase, &op, CFGSTORE_LOCKOUT_MS) != PICO_OK)
+			return false;
+	}
+
+	hdr.magic    = CFGSTORE_MAGIC;
+	hdr.sequence = s_cfgstore_sequence + 1u;
+	hdr.version  = CFGSTORE_VERSION;
+	hdr.len      = sizeof(*pcfg);
+	hdr.crc      = cfgstore_record_crc(&hdr, (const uint8_t *)pcfg);
+	memset(buf, 0xff, sizeof(buf));
+	memcpy(buf, &hdr, sizeof(hdr));
+	memcpy(buf + sizeof(hdr), pcfg, sizeof(*pcfg));
+
+	op.offset = CFGSTORE_OFFSET + slot * CFGSTORE_SLOTSIZE;
+	op.pdat   = buf;
+	if (flash_safe_execute(cfgstore_flash_program, &op, CFGSTORE_LOCKOUT_MS) != PICO_OK)
+		return false;
+	if (memcmp(cfgstore_slot(slot), buf, sizeof(buf)) != 0)
+		return false;
+
+	s_cfgstore_newest   = (int32_t)slot;
+	s_cfgstore_sequence = hdr.sequence;
+	return true;
+}
+
+void cfgstore_erase(void)
+{
+	cfgstore_flashop_t op;
+
+	for (uint32_t sector=0; sector<CFGSTORE_SECTORS; sector++)
+	{
+		op.offset = CFGSTORE_OFFSET + sector * FLASH_SECTOR_SIZE;
+		flash_safe_execute(cfgstore_flash_erase, &op, CFGSTORE_LOCKOUT_MS);
+	}
+	s_cfgstore_newest   = -1;
+	s_cfgstore_sequence = 0;
+}
+
+uint32_t cfgstore_sequence(void)
+{
+	return s_cfgstore_sequence;
+}
@@ -0,0 +1,71 @@
+#ifndef _CFGSTORE_H
+#define _CFGSTORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i3c_hl.h"
+
+/*
+ * Configuration store in the last CFGSTORE_SECTORS sectors of the flash: the bus settings and the target profiles,
+ * applied by main at startup so the module comes up with them after a reset or USB reconnect.
+ *
+ * The sectors are used as a log of records of one slot (CFGSTORE_SLOTSIZE) each. Every save programs the slot after the
+ * newest record, a sector gets erased only when the log wraps into it, so all sectors wear evenly and every sector sees
+ * one erase per CFGSTORE_SECTORS * slots per sector saves. A record is valid when its magic, version, length and CRC
+ * match, the valid record with the highest sequence number wins. A save interrupted by a reset leaves the previous
+ * record in place, as the sector holding it never gets erased by the save following it.
+ *
+ * Programming the flash stops the other core (flash_safe_execute), so all functions are to be called from core0 only.
+ */
+
+#define CFGSTORE_SECTORS     (4u)
+#define CFGSTORE_SLOTSIZE    (512u)  // multiple of FLASH_PAGE_SIZE
+#define CFGSTORE_MAXPROFILES (32u)
+
+typedef struct
+{
+	uint8_t  initialized;     // bus gets initialized at startup with gpiobase and sm
+	uint8_t  gpiobase;
+	uint8_t  sm;
+	uint8_t  drivestrength_mA;
+	uint16_t clkrate_khz;
+	uint8_t  daa;             // RSTDAA, DAA with the pool daa_firstaddr..daa_lastaddr and discovery of all targets at startup
+	uint8_t  daa_firstaddr;
+	uint8_t  daa_lastaddr;
+	uint8_t  reserved[3];
+} cfgstore_bus_t;
+
+// preferred dynamic address of a target (see i3c_hl_daa_preferred)
+typedef struct
+{
+	uint8_t pid[6];           // provisioned ID, MSB first
+	uint8_t bus;
+	uint8_t addr;
+} cfgstore_profile_t;
+
+typedef struct
+{
+	cfgstore_bus_t     bus[I3C_HL_MAXBUS];
+	uint8_t            cli_bus;                // bus selected by i3c_bus
+	uint8_t            ddr_crc_word_indicator; // see i3c_ddr_config
+	uint8_t            ddr_early_write_term;
+	uint8_t            ddr_write_ack;
+	uint32_t           i2c_freq_khz;
+	uint32_t           i2c_timeout_ms;
+	uint32_t           profilecount;
+	cfgstore_profile_t profiles[CFGSTORE_MAXPROFILES];
+} cfgstore_config_t;
+
+// copies the newest valid record to pcfg. Returns false when the store holds none, pcfg is unchanged then
+bool cfgstore_load(cfgstore_config_t *pcfg);
+
+// writes pcfg as the newest record and reads it back. Returns false when the flash content does not match
+bool cfgstore_save(const cfgstore_config_t *pcfg);
+
+// erases all sectors of the store
+void cfgstore_erase(void);
+
+// count of saves since the store was erased (sequence number of the newest record), 0 when empty
+uint32_t cfgstore_sequence(void);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _I3C_HAL_H
+#define _I3C_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef I3C_HAL_HOST
+#include "i3c_hal_host.h"
+#else
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "hardware/dma.h"
+#endif
+
+/*
+ * Hardware access of i3c_hl: the pico-sdk functions it uses plus the register accesses below.
+ *
+ * The registers of PIO, IO_BANK0 and DMA are accessed through the structs of the pico-sdk (pio0->txf[sm],
+ * io_bank0_hw->io[n].status, ...) but always with i3c_hal_read32 / i3c_hal_write32 and the atomic hw_set_bits /
+ * hw_clear_bits, never by dereferencing them. DMA addresses are set and read with i3c_hal_dma_set_write_addr /
+ * i3c_hal_dma_get_write_addr, as they are pointers.
+ *
+ * In the firmware these are plain volatile accesses. With I3C_HAL_HOST defined, i3c_hl and ucli build natively against
+ * host/sim/i3c_hal_host.h, which implements the same functions on the PIO simulator.
+ */
+
+#ifndef I3C_HAL_HOST
+static __inline__ __attribute__((always_inline)) uint32_t i3c_hal_read32(const volatile uint32_t *preg)
+{
+	return *preg;
+}
+
+static __inline__ __attribute__((always_inline)) void i3c_hal_write32(volatile uint32_t *preg, uint32_t value)
+{
+	*preg = value;
+}
+
+static __inline__ __attribute__((always_inline)) volatile void *i3c_hal_dma_get_write_addr(uint channel)
+{
+	return (volatile void *)dma_channel_hw_addr(channel)->write_addr;
+}
+
+static __inline__ __attribute__((always_inline)) void i3c_hal_dma_set_write_addr(uint channel, volatile void *paddr)
+{
+	dma_channel_hw_addr(channel)->write_addr = (uintptr_t)paddr;
+}
+#endif
+
+#endif
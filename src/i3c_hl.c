@@ -3,12 +3,8 @@
 
 #include <stdio.h>
 #include <string.h>
-#include "pico/stdlib.h"
-#include "hardware/clocks.h"
-#include "hardware/gpio.h"
-#include "hardware/pio.h"
+#include "i3c_hal.h"
 #include "i3c.pio.h"
-#include "hardware/sync.h"
 
 /*
 MIT License
@@ -43,12 +39,399 @@ SOFTWARE.
 ///////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////
 static uint32_t i3c_wdata_table[512];
-static uint8_t i3c_hl_arbcode;
-static uint8_t i3c_hl_gpiobasepin;
-static uint32_t i3c_hl_pio_program_sdr[32];         // copy of pio memory for fast exchange of SM. It is on purpose located in ram for fast copy action
-static uint32_t i3c_hl_pio_program_ddr[32];         // copy of pio memory for fast exchange of SM. It is on purpose located in ram for fast copy action
-static uint32_t i3c_hl_pio_program_sdr_overlay[32]; // copy of pio memory for fast exchange of SM. It is on purpose located in ram for fast copy action
+static bool     i3c_hl_tables_initialized;
+static bool     i3c_hl_ibi_irq_handler_added[NUM_CORES]; // the IBI wakeup handler is installed once per core
 
+// DMA based SDR write engine. The payload gets expanded chunk wise through i3c_wdata_table into one half of a double buffer
+// while the DMA channel streams the other half into the (joined) TX FIFO of the state machine.
+#define I3C_SDR_DMA_CHUNKSIZE (128u) // payload bytes per buffer half
+
+// DMA based HDR-DDR write engine. Preamble and data instruction words are encoded ahead chunk wise into one half of a 
+// double buffer while the DMA streams the other half. The results of the state machine are drained by a second DMA channel.
+#define I3C_DDR_DMA_CHUNKSIZE (64u) // data words per buffer half
+
+// HDR-DDR reads are streamed: the TX DMA repeats the cmd_read_word instruction, the RX DMA drains the results into a ring
+// buffer which the CPU evaluates (parity, CRC) behind the DMA write pointer. The CPU is faster than the bus, so it never
+// falls a full ring behind.
+#define I3C_DDR_DMA_RXRING_BITS (8u) // ring size in bytes as power of 2 -> 64 result words
+static const uint32_t i3c_ddr_read_word_opcode = DDR_HDR_OPCODE_READ_WORD;
+
+// Both PIO programs stay loaded all the time: the SDR program (incl. SDR reads) in I3C_HL_PIO_SDR, the HDR-DDR program in
+// I3C_HL_PIO_DDR. A bus uses the same state machine number in both blocks. Entering or leaving HDR-DDR mode hands the pins
+// over from one state machine to the other (see i3c_pio_select), no instruction memory gets rewritten at runtime.
+#define I3C_HL_PIO_SDR pio0
+#define I3C_HL_PIO_DDR pio1
+
+// consecutive NAKs of an assigned dynamic address before i3c_hl_daa gives up on the target
+#define I3C_HL_DAA_RETRIES (2u)
+
+// SCL periods i3c_hl_scan waits after its STOP for SDA to settle
+#define I3C_HL_BUSFREE_CLOCKS (4u)
+
+// context of one I3C bus. All state of a controller lives here, so several buses can run on different state machines
+struct i3c_hl_bus
+{
+	uint32_t     ddr_dma_rxring[(1u<<I3C_DDR_DMA_RXRING_BITS)/4u] __attribute__((aligned(1u<<I3C_DDR_DMA_RXRING_BITS))); // first member to keep the padding small
+	PIO          pio;            // PIO block and state machine currently driving the pins (SDR or HDR-DDR)
+	pio_sm_hw_t *smhw;
+	uint32_t     fstat_txfull;   // FSTAT / FDEBUG bits of the state machine, precalculated for the FIFO access functions
+	uint32_t     fstat_txempty;
+	uint32_t     fstat_rxempty;
+	uint32_t     fdebug_txstall;
+	uint32_t     pinctrl;        // PINCTRL of both state machines
+	uint32_t     dma_tx_ctrl[2]; // CTRL of dma_channel_tx paced by the SDR (0) or HDR-DDR (1) state machine
+	uint8_t      sm;
+	uint8_t      gpiobasepin;
+	uint8_t      arbcode;
+	bool         initialized;
+	bool         sm_is_in_ddr_mode;
+	bool         sdr_dma_enabled;
+	bool         ddr_dma_enabled;
+	bool         ibi_irq_enabled;
+	int          dma_channel_tx;  // feeds the TX FIFO of the state machine
+	int          dma_channel_rx;  // drains the RX FIFO of the state machine
+	uint32_t     shiftctrl_autopointer_tab[32]; // prepare a table for quick autopush value update
+	uint32_t     sdr_dma_buffer[2][I3C_SDR_DMA_CHUNKSIZE*2u + 1u]; // 2 words per byte + SCL0 opcode at the end
+	uint32_t     ddr_dma_buffer[2][I3C_DDR_DMA_CHUNKSIZE*2u + 4u]; // 2 words per data word + command word + CRC word
+	uint32_t     ddr_dma_rxdump;                                   // results of the state machine are not needed, the SM halts on errors
+	i3c_hl_stats_t stats[I3C_HL_STATS_TYPES];                      // written by the core executing the transfers only
+	i3c_hl_device_t devices[I3C_HL_MAXDEVICES];                    // device table, addr 0: free entry
+	uint8_t      device_index[128];                                // per address: index into devices + 1, 0: unknown
+	const i3c_hl_daa_entry_t *daa_preferred;                       // see i3c_hl_daa_preferred
+	uint32_t     daa_preferred_count;
+	uint32_t     clkrate_khz;
+	uint8_t      drivestrength_mA;
+};
+
+static i3c_hl_bus_t i3c_hl_buses[I3C_HL_MAXBUS];
+
+// account a transfer which started at tstart_us (time_us_32) in the statistics of its type. datacount is only added when
+// the transfer moved data. The log2 bin is searched by shifting, the M0+ has no CLZ instruction
+static inline void __not_in_flash_func(i3c_hl_stats_record)(i3c_hl_bus_t *pbus, i3c_hl_stats_type_t type, i3c_hl_status_t status,
+                                                            uint32_t datacount, uint32_t tstart_us)
+{
+	i3c_hl_stats_t *ps = &pbus->stats[type];
+	uint32_t duration_us = time_us_32() - tstart_us;
+	uint32_t bin = 0;
+
+	for (uint32_t d = duration_us; (d != 0) && (bin < I3C_HL_STATS_HISTBINS-1); d >>= 1)
+		bin++;
+	ps->count++;
+	ps->busy_us += duration_us;
+	ps->hist[bin]++;
+	if (duration_us > ps->max_us)
+		ps->max_us = duration_us;
+	switch (status)
+	{
+		case i3c_hl_status_ok:
+			ps->data += datacount;
+			break;
+		case i3c_hl_status_ddr_early_termination:
+			ps->data += datacount;
+			ps->early_term++;
+			break;
+		case i3c_hl_status_ibi:
+			ps->ibi++;
+			break;
+		case i3c_hl_status_nak_during_arbhdr:
+		case i3c_hl_status_nak_during_sdraddr:
+		case i3c_hl_status_nak_ddr:
+			ps->nak++;
+			break;
+		case i3c_hl_status_ddr_invalid_preamble:
+		case i3c_hl_status_ddr_parity_wrong:
+		case i3c_hl_status_ddr_crc_wrong:
+			ps->parity_crc++;
+			break;
+		default:
+			break;
+	}
+}
+
+void i3c_hl_stats_get(i3c_hl_bus_t *pbus, i3c_hl_stats_type_t type, i3c_hl_stats_t *pstats)
+{
+	if (type < I3C_HL_STATS_TYPES)
+		*pstats = pbus->stats[type];
+	else
+		memset(pstats, 0, sizeof(*pstats));
+}
+
+void i3c_hl_stats_reset(i3c_hl_bus_t *pbus)
+{
+	memset(pbus->stats, 0, sizeof(pbus->stats));
+}
+
+const char *i3c_hl_stats_typename(i3c_hl_stats_type_t type)
+{
+	static const char *names[I3C_HL_STATS_TYPES] =
+	{
+		"sdr_write", "sdr_read", "sdr_writeread", "ccc_broadcast", "ccc_direct_write", "ccc_direct_read", "ddr_write", "ddr_read", "ibi"
+	};
+	return (type < I3C_HL_STATS_TYPES) ? names[type] : "unknown";
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// device table. Written by the core executing the transfers, like the statistics
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+#define CCC_RSTDAA   (0x06)
+#define CCC_SETMWL   (0x09)
+#define CCC_SETMRL   (0x0a)
+#define CCC_DIRECT   (0x80)
+#define CCC_SETNEWDA (0x88)
+#define CCC_GETMWL   (0x8b)
+#define CCC_GETMRL   (0x8c)
+#define CCC_GETBCR   (0x8e)
+#define CCC_GETDCR   (0x8f)
+#define CCC_GETMXDS  (0x94)
+#define CCC_GETCAPS  (0x95)
+
+#define BCR_IBI_PAYLOAD (1u<<2)
+#define BCR_HDR_CAPABLE (1u<<5)
+
+static inline i3c_hl_device_t *__not_in_flash_func(i3c_hl_device_find)(i3c_hl_bus_t *pbus, uint8_t addr)
+{
+	uint8_t index = pbus->device_index[addr & 0x7fu];
+	return index ? &pbus->devices[index - 1u] : NULL;
+}
+
+// entry of addr, a new one for unknown addresses. NULL when the table is full
+static i3c_hl_device_t *__not_in_flash_func(i3c_hl_device_add)(i3c_hl_bus_t *pbus, uint8_t addr)
+{
+	i3c_hl_device_t *pdev = i3c_hl_device_find(pbus, addr);
+
+	for (uint8_t i=0; (pdev == NULL) && (i<I3C_HL_MAXDEVICES); i++)
+	{
+		if (pbus->devices[i].addr == 0)
+		{
+			pdev = &pbus->devices[i];
+			memset(pdev, 0, sizeof(*pdev));
+			pdev->addr = addr & 0x7fu;
+			pbus->device_index[pdev->addr] = i + 1u;
+		}
+	}
+	return pdev;
+}
+
+static void __not_in_flash_func(i3c_hl_device_remove)(i3c_hl_bus_t *pbus, uint8_t addr)
+{
+	i3c_hl_device_t *pdev = i3c_hl_device_find(pbus, addr);
+
+	if (pdev)
+	{
+		pdev->addr = 0;
+		pbus->device_index[addr & 0x7fu] = 0;
+	}
+}
+
+// a target got a dynamic address by ENTDAA. pid points to PID, BCR and DCR as sent by the target
+static void __not_in_flash_func(i3c_hl_device_assigned)(i3c_hl_bus_t *pbus, uint8_t addr, const uint8_t *pid)
+{
+	i3c_hl_device_t *pdev;
+
+	i3c_hl_device_remove(pbus, addr); // a stale entry of a target which lost the address
+	pdev = i3c_hl_device_add(pbus, addr);
+	if (pdev)
+	{
+		memcpy(pdev->pid, pid, sizeof(pdev->pid));
+		pdev->bcr   = pid[6];
+		pdev->dcr   = pid[7];
+		pdev->flags = I3C_HL_DEVICE_PID | I3C_HL_DEVICE_BCR | I3C_HL_DEVICE_DCR;
+	}
+}
+
+// MRL / MWL of a SETMRL / SETMWL, GETMRL or GETMWL. The max IBI payload follows the MRL when the target has one
+static void __not_in_flash_func(i3c_hl_device_set_length)(i3c_hl_device_t *pdev, uint8_t ccc, const uint8_t *pdat, uint32_t len)
+{
+	if (len < 2)
+		return;
+	if ( ((ccc & ~CCC_DIRECT) == CCC_SETMWL) || (ccc == CCC_GETMWL) )
+	{
+		pdev->mwl    = (uint16_t)((pdat[0] << 8) | pdat[1]);
+		pdev->flags |= I3C_HL_DEVICE_MWL;
+	}
+	else
+	{
+		pdev->mrl    = (uint16_t)((pdat[0] << 8) | pdat[1]);
+		if (len >= 3)
+			pdev->ibi_payload = pdat[2];
+		pdev->flags |= I3C_HL_DEVICE_MRL;
+	}
+}
+
+// a direct GET CCC (pccc: CCC code and defining byte) returned len bytes
+static void __not_in_flash_func(i3c_hl_device_snoop_get)(i3c_hl_bus_t *pbus, const uint8_t *pccc, uint8_t addr, const uint8_t *pdat, uint32_t len)
+{
+	i3c_hl_device_t *pdev;
+
+	if ( (len == 0) || ((pccc[0] != CCC_GETBCR) && (pccc[0] != CCC_GETDCR) && (pccc[0] != CCC_GETMRL) && (pccc[0] != CCC_GETMWL) &&
+	                    (pccc[0] != CCC_GETMXDS) && (pccc[0] != CCC_GETCAPS)) )
+		return;
+	pdev = i3c_hl_device_add(pbus, addr);
+	if (pdev == NULL)
+		return;
+	switch (pccc[0])
+	{
+		case CCC_GETBCR:
+			pdev->bcr    = pdat[0];
+			pdev->flags |= I3C_HL_DEVICE_BCR;
+			break;
+		case CCC_GETDCR:
+			pdev->dcr    = pdat[0];
+			pdev->flags |= I3C_HL_DEVICE_DCR;
+			break;
+		case CCC_GETMRL:
+		case CCC_GETMWL:
+			i3c_hl_device_set_length(pdev, pccc[0], pdat, len);
+			break;
+		case CCC_GETMXDS:
+			if (len >= 2)
+			{
+				pdev->maxwr  = pdat[0];
+				pdev->maxrd  = pdat[1];
+				pdev->flags |= I3C_HL_DEVICE_MXDS;
+			}
+			break;
+		case CCC_GETCAPS:
+			pdev->capslen = (len < sizeof(pdev->caps)) ? (uint8_t)len : (uint8_t)sizeof(pdev->caps);
+			memcpy(pdev->caps, pdat, pdev->capslen);
+			pdev->flags |= I3C_HL_DEVICE_CAPS;
+			break;
+	}
+}
+
+// a CCC write succeeded: broadcast (addr 0xff) or direct to addr. pdat: CCC code, defining byte / payload
+static void __not_in_flash_func(i3c_hl_device_snoop_set)(i3c_hl_bus_t *pbus, const uint8_t *pdat, uint32_t len, uint8_t addr,
+                                                         const uint8_t *pdirectdat, uint32_t directlen)
+{
+	i3c_hl_device_t *pdev;
+
+	if (len == 0)
+		return;
+	switch (pdat[0])
+	{
+		case CCC_RSTDAA:
+			i3c_hl_device_clear(pbus);
+			break;
+		case CCC_SETMWL:
+		case CCC_SETMRL:
+			for (uint32_t i=0; i<I3C_HL_MAXDEVICES; i++)
+			{
+				if (pbus->devices[i].addr != 0)
+					i3c_hl_device_set_length(&pbus->devices[i], pdat[0], &pdat[1], len - 1);
+			}
+			break;
+		case CCC_DIRECT | CCC_SETMWL:
+		case CCC_DIRECT | CCC_SETMRL:
+			pdev = i3c_hl_device_find(pbus, addr);
+			if (pdev)
+				i3c_hl_device_set_length(pdev, pdat[0], pdirectdat, directlen);
+			break;
+		case CCC_SETNEWDA:
+			pdev = i3c_hl_device_find(pbus, addr);
+			if ( pdev && (directlen >= 1) )
+			{
+				i3c_hl_device_t dev = *pdev;
+
+				i3c_hl_device_remove(pbus, addr);
+				i3c_hl_device_remove(pbus, pdirectdat[0] >> 1);
+				pdev = i3c_hl_device_add(pbus, pdirectdat[0] >> 1);
+				dev.addr = pdev->addr;
+				*pdev = dev;
+			}
+			break;
+	}
+}
+
+// MRL of addr for splitting reads, 0: unknown
+static inline uint32_t __not_in_flash_func(i3c_hl_device_mrl)(i3c_hl_bus_t *pbus, uint8_t addr)
+{
+	i3c_hl_device_t *pdev = i3c_hl_device_find(pbus, addr);
+	return (pdev && (pdev->flags & I3C_HL_DEVICE_MRL)) ? pdev->mrl : 0u;
+}
+
+// IBI data bytes (MDB and payload) to read from addr at most
+static inline uint32_t __not_in_flash_func(i3c_hl_device_ibi_maxlen)(i3c_hl_bus_t *pbus, uint8_t addr, uint32_t maxlen)
+{
+	i3c_hl_device_t *pdev = i3c_hl_device_find(pbus, addr);
+
+	if ( (pdev == NULL) || !(pdev->flags & I3C_HL_DEVICE_BCR) )
+		return maxlen;
+	if ( !(pdev->bcr & BCR_IBI_PAYLOAD) )
+		return 0;
+	if ( (pdev->flags & I3C_HL_DEVICE_MRL) && (pdev->ibi_payload != 0) && (pdev->ibi_payload < maxlen) )
+		return pdev->ibi_payload;
+	return maxlen;
+}
+
+// false when addr is known to lack HDR-DDR
+static inline bool __not_in_flash_func(i3c_hl_device_ddr_capable)(i3c_hl_bus_t *pbus, uint8_t addr)
+{
+	i3c_hl_device_t *pdev = i3c_hl_device_find(pbus, addr);
+
+	if (pdev == NULL)
+		return true;
+	if ( (pdev->flags & I3C_HL_DEVICE_BCR) && !(pdev->bcr & BCR_HDR_CAPABLE) )
+		return false;
+	return !(pdev->flags & I3C_HL_DEVICE_CAPS) || (pdev->capslen == 0) || (pdev->caps[0] & 0x01u); // GETCAPS byte 1 bit 0: HDR-DDR
+}
+
+bool i3c_hl_device_get(i3c_hl_bus_t *pbus, uint8_t addr, i3c_hl_device_t *pdev)
+{
+	const i3c_hl_device_t *pentry = i3c_hl_device_find(pbus, addr);
+
+	if (pentry)
+		*pdev = *pentry;
+	return pentry != NULL;
+}
+
+uint32_t i3c_hl_device_list(i3c_hl_bus_t *pbus, i3c_hl_device_t *pdevs, uint32_t maxcount)
+{
+	uint32_t count = 0;
+
+	for (uint8_t addr=1; (addr<128) && (count<maxcount); addr++)
+	{
+		if (i3c_hl_device_get(pbus, addr, &pdevs[count]))
+			count++;
+	}
+	return count;
+}
+
+i3c_hl_status_t i3c_hl_device_discover(i3c_hl_bus_t *pbus, uint8_t addr)
+{
+	static const uint8_t cccs[] = { CCC_GETBCR, CCC_GETDCR, CCC_GETMRL, CCC_GETMWL, CCC_GETMXDS, CCC_GETCAPS };
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
+
+	if ( (addr == 0) || (addr >= 0x7e) )
+		return i3c_hl_status_param_outofrange;
+	if (i3c_hl_device_add(pbus, addr) == NULL)
+		return i3c_hl_status_param_outofrange;
+	for (uint32_t i=0; i<sizeof(cccs); i++)
+	{
+		uint8_t  dat[8];
+		uint32_t len = sizeof(dat);
+		i3c_hl_status_t status = i3c_hl_sdr_ccc_direct_read(pbus, &cccs[i], 1, addr, dat, &len); // fills the table
+
+		if ( (status == i3c_hl_status_ibi) || ((i == 0) && (status != i3c_hl_status_ok)) )
+		{ // no target at addr, or the bus is busy with an IBI
+			retcode = status;
+			break;
+		}
+	}
+	if ( (retcode != i3c_hl_status_ok) && (retcode != i3c_hl_status_ibi) )
+	{
+		i3c_hl_device_t *pdev = i3c_hl_device_find(pbus, addr);
+		if ( pdev && (pdev->flags == 0) )
+			i3c_hl_device_remove(pbus, addr); // nothing known about it
+	}
+	return retcode;
+}
+
+void i3c_hl_device_clear(i3c_hl_bus_t *pbus)
+{
+	memset(pbus->devices, 0, sizeof(pbus->devices));
+	memset(pbus->device_index, 0, sizeof(pbus->device_index));
+}
 
 // A table to help executing CRC5 CRCs using macro CRC5_CALCULATE
 // generated using pycrc:
@@ -72,7 +455,6 @@ static const uint8_t __not_in_flash("crc_table") crc5_table[256] = {
 	0xc0, 0xe8, 0x90, 0xb8, 0x60, 0x48, 0x30, 0x18, 0xa8, 0x80, 0xf8, 0xd0, 0x08, 0x20, 0x58, 0x70,
 	0x10, 0x38, 0x40, 0x68, 0xb0, 0x98, 0xe0, 0xc8, 0x78, 0x50, 0x28, 0x00, 0xd8, 0xf0, 0x88, 0xa0
 };
-static bool sm_is_in_ddr_mode;
 
 // Helper macro for fast CRC execution. For correct usage use ast initial value 0x1f<<3 and the resulting CRC is the return value >>3
 // The shift by 3 bytes helps in cycle efficiency of the CRC calculation
@@ -86,17 +468,17 @@ static bool sm_is_in_ddr_mode;
 #define DDR_PARITY(data) ( (uint8_t)( ((uint32_t)__builtin_parity(((uint16_t)(data) & 0xaaaau)) << 1) | ((uint32_t)__builtin_parity(((uint16_t)(data) & 0x5555u))  ^ 1) ))
 
 
-static inline void __not_in_flash_func(i3c_pio_wait_tx_empty)(void) 
+static inline void __not_in_flash_func(i3c_pio_wait_tx_empty)(i3c_hl_bus_t *pbus) 
 {
-    while ( (pio0->fstat & (1u << (PIO_FSTAT_TXEMPTY_LSB + 1))) == 0 )
+    while ( (i3c_hal_read32(&pbus->pio->fstat) & pbus->fstat_txempty) == 0 )
     {
 	}
 }
 
 // wait until PIO is idle - i.e. waits in first PULL instruction
-static inline void __not_in_flash_func(i3c_pio_wait_idle)(void) 
+static inline void __not_in_flash_func(i3c_pio_wait_idle)(i3c_hl_bus_t *pbus) 
 {
-    while ( pio0->sm[0].addr  != 0 )
+    while ( i3c_hal_read32(&pbus->smhw->addr) != 0 )
     {
 	}
 }
@@ -104,104 +486,93 @@ static inline void __not_in_flash_func(i3c_pio_wait_idle)(void)
 
 
 // blocking write to pio pipeline
-static inline void __not_in_flash_func(i3c_pio_put32)(uint32_t data) 
+static inline void __not_in_flash_func(i3c_pio_put32)(i3c_hl_bus_t *pbus, uint32_t data) 
 {
-    while ( (pio0->fstat & (1u << (PIO_FSTAT_TXFULL_LSB + 1))) != 0 )
+    while ( (i3c_hal_read32(&pbus->pio->fstat) & pbus->fstat_txfull) != 0 )
     {
 	}
-    pio0->txf[1] = data;
+    i3c_hal_write32(&pbus->pio->txf[pbus->sm], data);
 }
 
 // non blocking write to pio write pipe
-static inline void __not_in_flash_func(i3c_pio_put32_no_check)(uint32_t data) 
+static inline void __not_in_flash_func(i3c_pio_put32_no_check)(i3c_hl_bus_t *pbus, uint32_t data) 
 {
-    pio0->txf[1] = data;
+    i3c_hal_write32(&pbus->pio->txf[pbus->sm], data);
 }
 
 
 // blocking read from pio read pipe
-static inline uint32_t __not_in_flash_func(i3c_pio_get32)(void)
+static inline uint32_t __not_in_flash_func(i3c_pio_get32)(i3c_hl_bus_t *pbus)
 {
-    while ( (pio0->fstat & (1u << (PIO_FSTAT_RXEMPTY_LSB + 1))) != 0 )
+    while ( (i3c_hal_read32(&pbus->pio->fstat) & pbus->fstat_rxempty) != 0 )
     {
 	}
-    return pio0->rxf[1];
+    return i3c_hal_read32(&pbus->pio->rxf[pbus->sm]);
 }
 
 // mechanism to update autopush threshold quickly on the fly
-static uint32_t i3c_pio_shiftctrl_autopointer_tab[32] = { 0ul }; // prepare a table for quick autopush value update
-static inline void __not_in_flash_func(i3c_pio_set_autopush)(uint8_t bitcount)
+static inline void __not_in_flash_func(i3c_pio_set_autopush)(i3c_hl_bus_t *pbus, uint8_t bitcount)
 {
-	pio0->sm[1].shiftctrl = i3c_pio_shiftctrl_autopointer_tab[bitcount];
+	i3c_hal_write32(&pbus->smhw->shiftctrl, pbus->shiftctrl_autopointer_tab[bitcount]);
 }
 
-static inline void __not_in_flash_func(i3c_pio_set_autopush_bitrev)(uint8_t bitcount)
+static inline void __not_in_flash_func(i3c_pio_set_autopush_bitrev)(i3c_hl_bus_t *pbus, uint8_t bitcount)
 {
-	pio0->sm[1].shiftctrl = i3c_pio_shiftctrl_autopointer_tab[bitcount] & ~(1<<19);
+	i3c_hal_write32(&pbus->smhw->shiftctrl, pbus->shiftctrl_autopointer_tab[bitcount] & ~(1<<19));
 }
 
 // restart pio (resets e.g. shift counters and ISR/OSR content)
-static inline void __not_in_flash_func(i3c_pio_restart)(void)
+static inline void __not_in_flash_func(i3c_pio_restart)(i3c_hl_bus_t *pbus)
 {
-	pio0->ctrl = PIO_CTRL_CLKDIV_RESTART_BITS | (1 << (PIO_CTRL_SM_ENABLE_LSB + 1));
+	hw_set_bits(&pbus->pio->ctrl, (1u << pbus->sm) << PIO_CTRL_CLKDIV_RESTART_LSB);
 }
 
-// program pio SM for SDR mode overlay or remove overlay - this requires the current statemachine to be already the sdr statemachine as precondition
-static inline void __not_in_flash_func(s_i3c_program_sdr_overlay_sm)(bool tbit_overlay)
+// hand the pins of the bus over to its SDR (ddr = false) or HDR-DDR (ddr = true) state machine.
+// The active state machine has to finish all queued instructions first, both wait in their first PULL instruction
+// afterwards. The new one takes over the current levels and directions of SDA and SCL before the pins get switched to
+// its PIO block, so there is no glitch on the bus.
+static void __not_in_flash_func(i3c_pio_select)(i3c_hl_bus_t *pbus, bool ddr)
 {
-	void *datasrc;
-
-	i3c_pio_wait_tx_empty();
-	i3c_pio_wait_idle();
-	datasrc =  (void*)&i3c_hl_pio_program_sdr[i3c_overlay_offset_cmd_restart];
-	if (tbit_overlay)
-		datasrc = (void*)&i3c_hl_pio_program_sdr_overlay[i3c_overlay_offset_cmd_restart];
-	memcpy((void*)(&pio0->instr_mem[i3c_overlay_offset_cmd_restart]), datasrc, (i3c_overlay_program.length-i3c_overlay_offset_cmd_restart)*4);
-}
-
-
-// program pio SM for SDR mode
-static inline void __not_in_flash_func(s_i3c_program_hdr_sdr_sm)(void)
-{
-//	for (uint32_t i=0; i<i3c_program.length; i++)
-//		*((volatile uint16_t *)&(pio0->instr_mem[i])) = i3c_program_instructions[i];
-	memcpy((void*)(pio0->instr_mem), (void*)i3c_hl_pio_program_sdr, i3c_program.length*4);
-    pio0->sm[1].execctrl = (          i3c_wrap << PIO_SM0_EXECCTRL_WRAP_TOP_LSB) |
-	                       (   i3c_wrap_target << PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB) | 
-						   (                 1 << PIO_SM0_EXECCTRL_SIDE_EN_LSB) |
-						   (i3c_hl_gpiobasepin << PIO_SM0_EXECCTRL_JMP_PIN_LSB);
-	pio0->sm[1].shiftctrl = (0 << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB) | 
-		 				    (1 << PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_LSB) |
-						    (0 << PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_LSB) |
-						    (0 << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB) |
-						    (1 << PIO_SM0_SHIFTCTRL_AUTOPUSH_LSB) |
-						    (0 << PIO_SM0_SHIFTCTRL_AUTOPULL_LSB);
-	sm_is_in_ddr_mode = false;
+	PIO          pio  = ddr ? I3C_HL_PIO_DDR : I3C_HL_PIO_SDR;
+	pio_sm_hw_t *smhw = &pio->sm[pbus->sm];
+	uint32_t     pins = 0, pindirs = 0;
+
+	if (pbus->sm_is_in_ddr_mode == ddr)
+		return;
+	i3c_pio_wait_tx_empty(pbus);
+	i3c_pio_wait_idle(pbus);
+	for (uint32_t i=0; i<2; i++)
+	{
+		uint32_t status = i3c_hal_read32(&io_bank0_hw->io[pbus->gpiobasepin+i].status);
+		pins    |= ((status & IO_BANK0_GPIO0_STATUS_OUTTOPAD_BITS) ? 1u : 0u) << i;
+		pindirs |= ((status & IO_BANK0_GPIO0_STATUS_OETOPAD_BITS)  ? 1u : 0u) << i;
+	}
+	// SET addresses SDA and SCL for a moment. An instruction written to SMx_INSTR executes on the next clock enable of
+	// the state machine, at low clock rates the second write would replace the first one before. So it runs undivided
+	uint32_t clkdiv = i3c_hal_read32(&smhw->clkdiv);
+	i3c_hal_write32(&smhw->clkdiv,  1u << PIO_SM0_CLKDIV_INT_LSB);
+	i3c_hal_write32(&smhw->pinctrl, (2u << PIO_SM0_PINCTRL_SET_COUNT_LSB) | ((uint32_t)pbus->gpiobasepin << PIO_SM0_PINCTRL_SET_BASE_LSB));
+	i3c_hal_write32(&smhw->instr,   pio_encode_set(pio_pins, pins));
+	i3c_hal_write32(&smhw->instr,   pio_encode_set(pio_pindirs, pindirs));
+	i3c_hal_write32(&smhw->pinctrl, pbus->pinctrl);
+	i3c_hal_write32(&smhw->clkdiv,  clkdiv);
+	i3c_hal_write32(&io_bank0_hw->io[pbus->gpiobasepin  ].ctrl, (ddr ? GPIO_FUNC_PIO1 : GPIO_FUNC_PIO0) << IO_BANK0_GPIO0_CTRL_FUNCSEL_LSB);
+	i3c_hal_write32(&io_bank0_hw->io[pbus->gpiobasepin+1].ctrl, (ddr ? GPIO_FUNC_PIO1 : GPIO_FUNC_PIO0) << IO_BANK0_GPIO0_CTRL_FUNCSEL_LSB);
+
+	pbus->pio  = pio;
+	pbus->smhw = smhw;
+	i3c_hal_dma_set_write_addr(pbus->dma_channel_tx, &pio->txf[pbus->sm]);
+	i3c_hal_write32(&dma_channel_hw_addr(pbus->dma_channel_tx)->al1_ctrl, pbus->dma_tx_ctrl[ddr ? 1 : 0]);
+	pbus->sm_is_in_ddr_mode = ddr;
 }
 
-// program pio SM for DDR mode
-static inline void __not_in_flash_func(s_i3c_program_hdr_ddr_sm)(void)
+// an HDR-DDR transfer finalized with HDR restart leaves the pins at the HDR-DDR state machine
+static inline void __not_in_flash_func(i3c_pio_ensure_sdr)(i3c_hl_bus_t *pbus)
 {
-	//uint32_t *src=i3c_hl_pio_program_ddr, *dst=pio0->instr_mem;
-//	for (uint32_t i=0; i<i3c_ddr_program.length; i++)
-//		*((volatile uint16_t *)&(pio0->instr_mem[i])) = i3c_ddr_program_instructions[i];
-	memcpy((void*)(pio0->instr_mem), (void*)i3c_hl_pio_program_ddr, i3c_ddr_program.length*4);
-
-    pio0->sm[1].execctrl = (       i3c_ddr_wrap << PIO_SM0_EXECCTRL_WRAP_TOP_LSB) |
-	                       (i3c_ddr_wrap_target << PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB) | 
-						   (                  1 << PIO_SM0_EXECCTRL_SIDE_EN_LSB) |
-						   ( i3c_hl_gpiobasepin << PIO_SM0_EXECCTRL_JMP_PIN_LSB);
-
-	pio0->sm[1].shiftctrl = (0 << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB) | 
-		 				    (0 << PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_LSB) | // in DDR mode we shift out bits left out to avoid bitreversal which is slow on CM0 or adds artificially to PIO program memory size
-		 				    (0 << PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_LSB) | // data enters from right
-						    (0 << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB) |
-						    (1 << PIO_SM0_SHIFTCTRL_AUTOPUSH_LSB) |
-						    (0 << PIO_SM0_SHIFTCTRL_AUTOPULL_LSB);
-	sm_is_in_ddr_mode = true;
+	i3c_pio_select(pbus, false);
 }
 
-i3c_hl_status_t i3c_hl_set_drivestrength(uint8_t drivestrength_mA)
+i3c_hl_status_t i3c_hl_set_drivestrength(i3c_hl_bus_t *pbus, uint8_t drivestrength_mA)
 {
 	uint8_t ds = 0xff;
 	switch (drivestrength_mA)
@@ -218,50 +589,146 @@ i3c_hl_status_t i3c_hl_set_drivestrength(uint8_t drivestrength_mA)
 	}
 	else
 	{
-		gpio_set_drive_strength(i3c_hl_gpiobasepin, (enum gpio_drive_strength)ds);
-		gpio_set_drive_strength(i3c_hl_gpiobasepin+1, (enum gpio_drive_strength)ds);		
+		gpio_set_drive_strength(pbus->gpiobasepin, (enum gpio_drive_strength)ds);
+		gpio_set_drive_strength(pbus->gpiobasepin+1, (enum gpio_drive_strength)ds);		
+		pbus->drivestrength_mA = drivestrength_mA;
 	}
 	return i3c_hl_status_ok;
 }
 
+uint8_t i3c_hl_get_drivestrength(const i3c_hl_bus_t *pbus)
+{
+	return pbus->drivestrength_mA;
+}
+
+
+i3c_hl_bus_t *i3c_hl_bus(uint8_t index)
+{
+	if (index >= I3C_HL_MAXBUS)
+		return NULL;
+	return &i3c_hl_buses[index];
+}
+
+uint8_t i3c_hl_bus_index(const i3c_hl_bus_t *pbus)
+{
+	return (uint8_t)(pbus - i3c_hl_buses);
+}
+
+bool i3c_hl_bus_initialized(const i3c_hl_bus_t *pbus)
+{
+	return pbus->initialized;
+}
+
+uint8_t i3c_hl_bus_sm(const i3c_hl_bus_t *pbus)
+{
+	return pbus->sm;
+}
 
-i3c_hl_status_t i3c_init(uint8_t gpiobasepin)
+uint8_t i3c_hl_bus_gpiobasepin(const i3c_hl_bus_t *pbus)
 {
-    PIO pio = pio0;
+	return pbus->gpiobasepin;
+}
 
-	// create copies of PIO statemachines for very quick exchange during runtime when switching transfer modes
-	for (uint32_t i=0; i<sizeof(i3c_hl_pio_program_sdr)/sizeof(uint32_t); i++)
+// load the PIO programs, they stay resident for all buses, and precalculate the write table for fast sdr_write execution
+static void i3c_hl_tables_init(void)
+{
+	for (uint32_t i=0; i<i3c_program.length; i++)
 	{
-		if (i < (sizeof(i3c_program_instructions)/sizeof(uint16_t)) )
-		{
-			i3c_hl_pio_program_sdr[i] = i3c_program_instructions[i];
-		}
-		else
-		{
-			i3c_hl_pio_program_sdr[i] = 0x0ul;
-		}
-		if (i < (sizeof(i3c_ddr_program_instructions)/sizeof(uint16_t)) )
-		{
-			i3c_hl_pio_program_ddr[i] = i3c_ddr_program_instructions[i];
-		}
-		else
-		{
-			i3c_hl_pio_program_ddr[i] = 0x0ul;
-		}
-		if (i < (sizeof(i3c_overlay_program_instructions)/sizeof(uint16_t)) )
-		{
-			i3c_hl_pio_program_sdr_overlay[i] = i3c_overlay_program_instructions[i];
-		}
-		else
-		{
-			i3c_hl_pio_program_sdr_overlay[i] = 0x0ul;
-		}
+		i3c_hal_write32(&I3C_HL_PIO_SDR->instr_mem[i], i3c_program_instructions[i]);
 	}
-	i3c_hl_gpiobasepin = gpiobasepin;
-	s_i3c_program_hdr_sdr_sm();
+	for (uint32_t i=0; i<i3c_ddr_program.length; i++)
+	{
+		i3c_hal_write32(&I3C_HL_PIO_DDR->instr_mem[i], i3c_ddr_program_instructions[i]);
+	}
+
+	for (uint32_t value=0; value<256; value++)
+	{
+		uint8_t tbit = __builtin_parity(value)^1;
+		i3c_wdata_table[(uint32_t)value*2u+0u] = I3CPIO_OPCODE_XFER(6, SDR_WBIT((value>>7)&1), SDR_WBIT((value>>6)&1), SDR_WBIT((value>>5)&1), SDR_WBIT((value>>4)&1), SDR_WBIT((value>>3)&1), SDR_WBIT((value>>2)&1));
+		i3c_wdata_table[(uint32_t)value*2u+1u] = I3CPIO_OPCODE_XFER(3, SDR_WBIT((value>>1)&1), SDR_WBIT((value>>0)&1), SDR_WBIT(tbit), 0, 0, 0);
+	}
+	i3c_hl_tables_initialized = true;
+}
 
-    pio->sm[1].clkdiv = (uint32_t) (1.0f * (1 << 16));
-    pio->sm[1].pinctrl =
+i3c_hl_status_t i3c_init(i3c_hl_bus_t *pbus, uint8_t sm, uint8_t gpiobasepin)
+{
+	if ( (pbus == NULL) || (sm >= NUM_PIO_STATE_MACHINES) || ((uint32_t)gpiobasepin+1u >= NUM_BANK0_GPIOS) )
+		return i3c_hl_status_param_outofrange;
+
+	// the state machine and the pins must not be used by another bus
+	for (uint32_t i=0; i<I3C_HL_MAXBUS; i++)
+	{
+		i3c_hl_bus_t *pother = &i3c_hl_buses[i];
+		if ( (pother == pbus) || !pother->initialized )
+			continue;
+		if (pother->sm == sm)
+			return i3c_hl_status_param_outofrange;
+		if ( ((gpiobasepin+1) >= pother->gpiobasepin) && (gpiobasepin <= (pother->gpiobasepin+1)) )
+			return i3c_hl_status_param_outofrange;
+	}
+
+	if (!i3c_hl_tables_initialized)
+	{
+		i3c_hl_tables_init();
+	}
+
+	if (pbus->initialized)
+	{ // re-initialization, release the previous state machines
+		hw_clear_bits(&I3C_HL_PIO_SDR->ctrl, 1u << (PIO_CTRL_SM_ENABLE_LSB + pbus->sm));
+		hw_clear_bits(&I3C_HL_PIO_DDR->ctrl, 1u << (PIO_CTRL_SM_ENABLE_LSB + pbus->sm));
+		pbus->initialized = false;
+	}
+	else
+	{
+		pbus->sdr_dma_enabled = true;
+		pbus->ddr_dma_enabled = true;
+		pbus->dma_channel_tx  = -1;
+		pbus->dma_channel_rx  = -1;
+		i3c_hl_device_clear(pbus);
+	}
+
+	PIO pio = I3C_HL_PIO_SDR;
+	pbus->pio            = pio;
+	pbus->sm             = sm;
+	pbus->smhw           = &pio->sm[sm];
+	pbus->fstat_txfull   = 1u << (PIO_FSTAT_TXFULL_LSB + sm);
+	pbus->fstat_txempty  = 1u << (PIO_FSTAT_TXEMPTY_LSB + sm);
+	pbus->fstat_rxempty  = 1u << (PIO_FSTAT_RXEMPTY_LSB + sm);
+	pbus->fdebug_txstall = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+	pbus->gpiobasepin    = gpiobasepin;
+	pbus->sm_is_in_ddr_mode = false;
+	pbus->pinctrl =
+            (1 << PIO_SM0_PINCTRL_SET_COUNT_LSB) |
+            (gpiobasepin << PIO_SM0_PINCTRL_SET_BASE_LSB)  |
+            (1 << PIO_SM0_PINCTRL_OUT_COUNT_LSB) |
+            (gpiobasepin << PIO_SM0_PINCTRL_OUT_BASE_LSB)  |
+            (gpiobasepin << PIO_SM0_PINCTRL_IN_BASE_LSB)  |
+            (2 << PIO_SM0_PINCTRL_SIDESET_COUNT_LSB) |
+            ((gpiobasepin+1) << PIO_SM0_PINCTRL_SIDESET_BASE_LSB) ;
+
+	// the HDR-DDR state machine waits in its first PULL instruction until the pins are handed over to it
+	pio_sm_hw_t *ddrhw = &I3C_HL_PIO_DDR->sm[sm];
+	i3c_hal_write32(&ddrhw->clkdiv,  (uint32_t) (1.0f * (1 << 16)));
+	i3c_hal_write32(&ddrhw->pinctrl, pbus->pinctrl);
+    i3c_hal_write32(&ddrhw->execctrl,
+	                (       i3c_ddr_wrap << PIO_SM0_EXECCTRL_WRAP_TOP_LSB) |
+	                (i3c_ddr_wrap_target << PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB) | 
+	                (                  1 << PIO_SM0_EXECCTRL_SIDE_EN_LSB) |
+	                (        gpiobasepin << PIO_SM0_EXECCTRL_JMP_PIN_LSB));
+	i3c_hal_write32(&ddrhw->shiftctrl,
+	                (0 << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB) | 
+	                (0 << PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_LSB) | // in DDR mode we shift out bits left out to avoid bitreversal which is slow on CM0 or adds artificially to PIO program memory size
+	                (0 << PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_LSB) | // data enters from right
+	                (0 << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB) |
+	                (1 << PIO_SM0_SHIFTCTRL_AUTOPUSH_LSB) |
+	                (0 << PIO_SM0_SHIFTCTRL_AUTOPULL_LSB));
+	i3c_hal_write32(&ddrhw->instr, pio_encode_jmp(0));
+    hw_set_bits(&I3C_HL_PIO_DDR->ctrl, 1u << (PIO_CTRL_SM_ENABLE_LSB + sm));	
+    hw_set_bits(&I3C_HL_PIO_DDR->input_sync_bypass, (3u << (gpiobasepin)));
+
+	i3c_hal_write32(&pbus->smhw->instr, pio_encode_jmp(0)); // start in the first PULL instruction, a moved bus may have stopped anywhere
+    i3c_hal_write32(&pbus->smhw->clkdiv, (uint32_t) (1.0f * (1 << 16)));
+    i3c_hal_write32(&pbus->smhw->pinctrl,
             (1 << PIO_SM0_PINCTRL_SET_COUNT_LSB) |
             ((gpiobasepin+1) << PIO_SM0_PINCTRL_SET_BASE_LSB)  |
             (2 << PIO_SM0_PINCTRL_OUT_COUNT_LSB) |
@@ -269,56 +736,87 @@ i3c_hl_status_t i3c_init(uint8_t gpiobasepin)
             //(1 << PIO_SM0_PINCTRL_IN_COUNT_LSB) |
             (gpiobasepin << PIO_SM0_PINCTRL_IN_BASE_LSB)  |
             (2 << PIO_SM0_PINCTRL_SIDESET_COUNT_LSB) |
-            ((gpiobasepin+1) << PIO_SM0_PINCTRL_SIDESET_BASE_LSB) ;
+            ((gpiobasepin+1) << PIO_SM0_PINCTRL_SIDESET_BASE_LSB));
     gpio_set_function(gpiobasepin, GPIO_FUNC_PIO0);
     gpio_set_function(gpiobasepin+1, GPIO_FUNC_PIO0);
 	gpio_set_drive_strength(gpiobasepin, GPIO_DRIVE_STRENGTH_12MA);
 	gpio_set_drive_strength(gpiobasepin+1, GPIO_DRIVE_STRENGTH_12MA);
+	pbus->clkrate_khz      = 12500;
+	pbus->drivestrength_mA = 12;
 	gpio_set_slew_rate(gpiobasepin, GPIO_SLEW_RATE_FAST);
 	gpio_set_slew_rate(gpiobasepin+1, GPIO_SLEW_RATE_FAST);
 
 	// set wrap target
-    pio->sm[1].execctrl = (       i3c_wrap << PIO_SM0_EXECCTRL_WRAP_TOP_LSB) |
-	                      (i3c_wrap_target << PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB) | 
-						  (              1 << PIO_SM0_EXECCTRL_SIDE_EN_LSB) | 
-						  (    gpiobasepin << PIO_SM0_EXECCTRL_JMP_PIN_LSB);
-	pio->sm[1].shiftctrl = (0 << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB) | 
-						   (1 << PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_LSB) |
-						   (0 << PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_LSB) |
-						   (0 << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB) |
-						   (1 << PIO_SM0_SHIFTCTRL_AUTOPUSH_LSB) |
-						   (0 << PIO_SM0_SHIFTCTRL_AUTOPULL_LSB);
+    i3c_hal_write32(&pbus->smhw->execctrl,
+	                (       i3c_wrap << PIO_SM0_EXECCTRL_WRAP_TOP_LSB) |
+	                (i3c_wrap_target << PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB) | 
+	                (              1 << PIO_SM0_EXECCTRL_SIDE_EN_LSB) | 
+	                (    gpiobasepin << PIO_SM0_EXECCTRL_JMP_PIN_LSB));
+	i3c_hal_write32(&pbus->smhw->shiftctrl,
+	                (0 << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB) | 
+	                (1 << PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_LSB) |
+	                (0 << PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_LSB) |
+	                (0 << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB) |
+	                (1 << PIO_SM0_SHIFTCTRL_AUTOPUSH_LSB) |
+	                (0 << PIO_SM0_SHIFTCTRL_AUTOPULL_LSB));
+	uint32_t shiftctrl = i3c_hal_read32(&pbus->smhw->shiftctrl);
 	for (uint8_t bitcount=0; bitcount<32; bitcount++)
 	{
-		i3c_pio_shiftctrl_autopointer_tab[bitcount] = 
-		    pio->sm[1].shiftctrl | (((uint32_t)(bitcount&0x1f)) << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB);
+		pbus->shiftctrl_autopointer_tab[bitcount] = 
+		    shiftctrl | (((uint32_t)(bitcount&0x1f)) << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB);
 	}
-    hw_set_bits(&pio->ctrl, 1u << (PIO_CTRL_SM_ENABLE_LSB + 1));	
+    hw_set_bits(&pio->ctrl, 1u << (PIO_CTRL_SM_ENABLE_LSB + sm));	
     hw_set_bits(&pio->input_sync_bypass, (3u << (gpiobasepin)));	 // bypass input synchronizers. Very important for I3C at 12.5 MHz
-	i3c_pio_put32( I3CPIO_OPCODE_SETDIR_SCLSDA_SCLHIGH(1, 0) );
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SETDIR_SCLSDA_SCLHIGH(1, 0) );
+	// the OUT PINDIRS of SCL has to run before OUT_COUNT gets reduced to SDA, don't rely on the state machine being faster
+	i3c_pio_wait_tx_empty(pbus);
+	i3c_pio_wait_idle(pbus);
 
-    pio->sm[1].pinctrl =
-            (1 << PIO_SM0_PINCTRL_SET_COUNT_LSB) |
-            (gpiobasepin << PIO_SM0_PINCTRL_SET_BASE_LSB)  |
-            (1 << PIO_SM0_PINCTRL_OUT_COUNT_LSB) |
-            (gpiobasepin << PIO_SM0_PINCTRL_OUT_BASE_LSB)  |
-            (gpiobasepin << PIO_SM0_PINCTRL_IN_BASE_LSB)  |
-            (2 << PIO_SM0_PINCTRL_SIDESET_COUNT_LSB) |
-            ((gpiobasepin+1) << PIO_SM0_PINCTRL_SIDESET_BASE_LSB) ;
+    i3c_hal_write32(&pbus->smhw->pinctrl, pbus->pinctrl);
 
-	// precalculate write table for fast sdr_write execution
-	for (uint32_t value=0; value<256; value++)
+	pbus->arbcode = 0xfc;
+
+	// DMA channels for the SDR/DDR write engines. Destination is always the TX FIFO of the active SM, source always the
+	// RX FIFO of the HDR-DDR SM, paced by their DREQs. i3c_pio_select retargets the TX channel.
+	if (pbus->dma_channel_tx < 0)
 	{
-		uint8_t tbit = __builtin_parity(value)^1;
-		i3c_wdata_table[(uint32_t)value*2u+0u] = I3CPIO_OPCODE_XFER(6, SDR_WBIT((value>>7)&1), SDR_WBIT((value>>6)&1), SDR_WBIT((value>>5)&1), SDR_WBIT((value>>4)&1), SDR_WBIT((value>>3)&1), SDR_WBIT((value>>2)&1));
-		i3c_wdata_table[(uint32_t)value*2u+1u] = I3CPIO_OPCODE_XFER(3, SDR_WBIT((value>>1)&1), SDR_WBIT((value>>0)&1), SDR_WBIT(tbit), 0, 0, 0);
+		pbus->dma_channel_tx = dma_claim_unused_channel(true);
+		pbus->dma_channel_rx = dma_claim_unused_channel(true);
 	}
-	i3c_hl_arbcode = 0xfc;
-	
+	dma_channel_config dmacfg = dma_channel_get_default_config(pbus->dma_channel_tx);
+	channel_config_set_transfer_data_size(&dmacfg, DMA_SIZE_32);
+	channel_config_set_read_increment(&dmacfg, true);
+	channel_config_set_write_increment(&dmacfg, false);
+	channel_config_set_dreq(&dmacfg, pio_get_dreq(I3C_HL_PIO_DDR, sm, true));
+	pbus->dma_tx_ctrl[1] = channel_config_get_ctrl_value(&dmacfg);
+	channel_config_set_dreq(&dmacfg, pio_get_dreq(pio, sm, true));
+	pbus->dma_tx_ctrl[0] = channel_config_get_ctrl_value(&dmacfg);
+	dma_channel_configure(pbus->dma_channel_tx, &dmacfg, &pio->txf[sm], NULL, 0, false);
+
+	dmacfg = dma_channel_get_default_config(pbus->dma_channel_rx);
+	channel_config_set_transfer_data_size(&dmacfg, DMA_SIZE_32);
+	channel_config_set_read_increment(&dmacfg, false);
+	channel_config_set_write_increment(&dmacfg, false);
+	channel_config_set_dreq(&dmacfg, pio_get_dreq(I3C_HL_PIO_DDR, sm, false));
+	dma_channel_configure(pbus->dma_channel_rx, &dmacfg, &pbus->ddr_dma_rxdump, &I3C_HL_PIO_DDR->rxf[sm], 0, false);
+
+	pbus->initialized = true;
+	return i3c_hl_status_ok;
+}
+
+i3c_hl_status_t i3c_hl_sdr_write_dma_enable(i3c_hl_bus_t *pbus, bool enable)
+{
+	pbus->sdr_dma_enabled = enable;
 	return i3c_hl_status_ok;
 }
 
-i3c_hl_status_t i3c_hl_set_clkrate(uint32_t targetfreq_khz)
+i3c_hl_status_t i3c_hl_ddr_write_dma_enable(i3c_hl_bus_t *pbus, bool enable)
+{
+	pbus->ddr_dma_enabled = enable;
+	return i3c_hl_status_ok;
+}
+
+i3c_hl_status_t i3c_hl_set_clkrate(i3c_hl_bus_t *pbus, uint32_t targetfreq_khz)
 {
 	if (targetfreq_khz > 12500u)
 		return i3c_hl_status_param_outofrange;
@@ -326,21 +824,29 @@ i3c_hl_status_t i3c_hl_set_clkrate(uint32_t targetfreq_khz)
 		return i3c_hl_status_param_outofrange;
 
     //pio->sm[1].clkdiv = (uint32_t) (1.0f * (1 << 16));
-	pio0->sm[1].clkdiv = (12500*65536) / targetfreq_khz;
+	uint32_t clkdiv = (12500*65536) / targetfreq_khz;
+	i3c_hal_write32(&I3C_HL_PIO_SDR->sm[pbus->sm].clkdiv, clkdiv); // both state machines of the bus run at the same clock
+	i3c_hal_write32(&I3C_HL_PIO_DDR->sm[pbus->sm].clkdiv, clkdiv);
+	pbus->clkrate_khz = targetfreq_khz;
 	return i3c_hl_status_ok;
 }
 
-i3c_hl_status_t i3c_hl_i2c_pinmode(bool enable_i2c_module)
+uint32_t i3c_hl_get_clkrate(const i3c_hl_bus_t *pbus)
+{
+	return pbus->clkrate_khz;
+}
+
+i3c_hl_status_t i3c_hl_i2c_pinmode(i3c_hl_bus_t *pbus, bool enable_i2c_module)
 {
 	if (enable_i2c_module)
 	{
-		gpio_set_function(i3c_hl_gpiobasepin, GPIO_FUNC_I2C);
-		gpio_set_function(i3c_hl_gpiobasepin+1, GPIO_FUNC_I2C);
+		gpio_set_function(pbus->gpiobasepin, GPIO_FUNC_I2C);
+		gpio_set_function(pbus->gpiobasepin+1, GPIO_FUNC_I2C);
 	}
 	else
 	{
-		gpio_set_function(i3c_hl_gpiobasepin, GPIO_FUNC_PIO0);
-		gpio_set_function(i3c_hl_gpiobasepin+1, GPIO_FUNC_PIO0);
+		gpio_set_function(pbus->gpiobasepin, pbus->sm_is_in_ddr_mode ? GPIO_FUNC_PIO1 : GPIO_FUNC_PIO0);
+		gpio_set_function(pbus->gpiobasepin+1, pbus->sm_is_in_ddr_mode ? GPIO_FUNC_PIO1 : GPIO_FUNC_PIO0);
 	}
 	return i3c_hl_status_ok;
 }
@@ -356,21 +862,21 @@ i3c_hl_status_t i3c_hl_i2c_pinmode(bool enable_i2c_module)
 // read 1 bit 
 
 // returns TRUE on success (acked)
-i3c_hl_status_t __not_in_flash_func(i3c_sdr_write_addr)(uint8_t value)
+i3c_hl_status_t __not_in_flash_func(i3c_sdr_write_addr)(i3c_hl_bus_t *pbus, uint8_t value)
 {
 	uint32_t cmdword0,  cmdword1, resp;
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_set_autopush(9);
+	i3c_pio_wait_tx_empty(pbus); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
+	i3c_pio_set_autopush(pbus, 9);
 
 	cmdword0 = I3CPIO_OPCODE_XFER(6, SDR_WBIT((value>>7)&1), SDR_WBIT((value>>6)&1), SDR_WBIT((value>>5)&1), SDR_WBIT((value>>4)&1), SDR_WBIT((value>>3)&1), SDR_WBIT((value>>2)&1));
 	cmdword1 = I3CPIO_OPCODE_XFER(3, SDR_WBIT((value>>1)&1), SDR_WBIT((value>>0)&1), OD_RACKBIT, 0, 0, 0);
 
-	i3c_pio_put32_no_check(cmdword0);
-	i3c_pio_put32_no_check(cmdword1);
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
-	resp = i3c_pio_get32();
+	i3c_pio_put32_no_check(pbus, cmdword0);
+	i3c_pio_put32_no_check(pbus, cmdword1);
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
+	resp = i3c_pio_get32(pbus);
 	if (resp & 1)
 	{
 		retcode = i3c_hl_status_nak_during_sdraddr;
@@ -378,473 +884,670 @@ i3c_hl_status_t __not_in_flash_func(i3c_sdr_write_addr)(uint8_t value)
 	return retcode;
 }
 
-static inline void __not_in_flash_func(i3c_start)(void)
+static inline void __not_in_flash_func(i3c_start)(i3c_hl_bus_t *pbus)
 {
-	i3c_pio_put32( I3CPIO_OPCODE_START ); // start
+	i3c_pio_ensure_sdr(pbus);
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_START ); // start
 }
 
-static inline void __not_in_flash_func(i3c_restart)(void)
+static inline void __not_in_flash_func(i3c_restart)(i3c_hl_bus_t *pbus)
 {
-	
-	i3c_pio_put32( I3CPIO_OPCODE_RESTART ); // start
-	i3c_pio_put32( I3CPIO_OPCODE_SCL0 ); 
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SCL0_SDA1 );
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDADRIVE_WAIT4 );
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SCL1_WAIT4 );
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDA0_WAIT4 ); // start
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SCL0 ); 
 }
 
-static inline void __not_in_flash_func(i3c_stop)(void)
+static inline void __not_in_flash_func(i3c_stop)(i3c_hl_bus_t *pbus)
 {
-	i3c_pio_put32( I3CPIO_OPCODE_STOP ); // stop
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SCL0_SDA0 );
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDADRIVE_WAIT4 );
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SCL1_WAIT2 );
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDARELEASE ); // stop
 }
 
-void __not_in_flash_func(i3c_sdr_write)(uint8_t value)
+void __not_in_flash_func(i3c_sdr_write)(i3c_hl_bus_t *pbus, uint8_t value)
 {
 	uint32_t cmdword0,  cmdword1, tbit;
 
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_set_autopush(9);
-	i3c_pio_put32_no_check( i3c_wdata_table[(uint32_t)value*2+0] );
-	i3c_pio_put32_no_check( i3c_wdata_table[(uint32_t)value*2+1] );	
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
-	i3c_pio_get32(); // dump read data;
+	i3c_pio_wait_tx_empty(pbus); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
+	i3c_pio_set_autopush(pbus, 9);
+	i3c_pio_put32_no_check(pbus, i3c_wdata_table[(uint32_t)value*2+0] );
+	i3c_pio_put32_no_check(pbus, i3c_wdata_table[(uint32_t)value*2+1] );	
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
+	i3c_pio_get32(pbus); // dump read data;
 }
 
-// returns the read data byte in bits 8..1 and the slave ACK phase state in Bit 0 (0 = slave did not ask to finish transfer)
-// The slave will signal in in pre-Bit9 low phase if read can continue or not
-//   0 => The transfer should end
-//   1 => The transfer can continue
-// The Master can signal back its intention in Bit 9 high state:
-//   1 => Continue transfer
-//   0 => STOP transfer (creates an implcit repeated start)
-#if 0
-static uint32_t __not_in_flash_func(i3c_sdr_read)(uint8_t continuetransfer)
+// Write a block of SDR data bytes (incl. T-bit) without any CPU handshake between the bytes.
+// During the transfer the TX FIFO is joined (8 entries deep) and autopush is disabled, so the sampled bits are simply
+// discarded in the ISR instead of filling up the RX FIFO and stalling the state machine.
+static void __not_in_flash_func(i3c_sdr_write_dma)(i3c_hl_bus_t *pbus, const uint8_t *pdat, uint32_t bytecount)
 {
-	uint32_t data;
+	uint32_t bufidx = 0;
+
+	if (bytecount == 0)
+		return;
+
+	i3c_pio_wait_tx_empty(pbus);
+	i3c_pio_wait_idle(pbus);
+	// note: changing FJOIN_TX flushes the FIFOs. This is fine as the SM is idle and all read data was collected already
+	i3c_hal_write32(&pbus->smhw->shiftctrl, (pbus->shiftctrl_autopointer_tab[0] & ~PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS) | PIO_SM0_SHIFTCTRL_FJOIN_TX_BITS);
+
+	while (bytecount)
+	{
+		uint32_t chunk = (bytecount > I3C_SDR_DMA_CHUNKSIZE) ? I3C_SDR_DMA_CHUNKSIZE : bytecount;
+		uint32_t *pbuf = pbus->sdr_dma_buffer[bufidx];
+		uint32_t wordcount = chunk*2u;
+
+		bytecount -= chunk;
+		// expand the next chunk while the DMA is still streaming the previous one
+		while (chunk--)
+		{
+			const uint32_t *pentry = &i3c_wdata_table[(uint32_t)(*pdat++)*2u];
+			*pbuf++ = pentry[0];
+			*pbuf++ = pentry[1];
+		}
+		if (bytecount == 0)
+		{
+			*pbuf = I3CPIO_OPCODE_SCL0; // avoid high phase beeing too long after the last byte
+			wordcount++;
+		}
+		while (dma_channel_is_busy(pbus->dma_channel_tx))
+		{
+		}
+		dma_channel_transfer_from_buffer_now(pbus->dma_channel_tx, pbus->sdr_dma_buffer[bufidx], wordcount);
+		bufidx ^= 1;
+	}
 
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_set_autopush(9);
-	i3c_pio_put32_no_check( I3CPIO_OPCODE_XFER(6, SDR_RBIT(0), SDR_RBIT(0), SDR_RBIT(0), SDR_RBIT(0), SDR_RBIT(0), SDR_RBIT(0)) );
-	i3c_pio_put32_no_check( I3CPIO_OPCODE_XFER(3, SDR_RBIT(0), SDR_RBIT(0), SDR_RBIT(continuetransfer), 0, 0, 0) );	
-	i3c_pio_put32_no_check( I3CPIO_OPCODE_SCL0 ); // avoid high phase beeing too long
-	data = i3c_pio_get32(); // dump read data;
-	return data;
+	while (dma_channel_is_busy(pbus->dma_channel_tx))
+	{
+	}
+	i3c_pio_wait_tx_empty(pbus);
+	i3c_pio_wait_idle(pbus);
+	// split FIFOs again, restore autopush and clear the ISR incl. its shift counter
+	i3c_pio_set_autopush(pbus, 9);
+	i3c_hal_write32(&pbus->smhw->instr, pio_encode_mov(pio_isr, pio_null));
+}
+
+// write a block of data bytes in SDR mode using the DMA engine or the classic per byte loop
+static inline void __not_in_flash_func(i3c_sdr_write_block)(i3c_hl_bus_t *pbus, const uint8_t *pdat, uint32_t bytecount)
+{
+	if (pbus->sdr_dma_enabled)
+	{
+		i3c_sdr_write_dma(pbus, pdat, bytecount);
+	}
+	else
+	{
+		while (bytecount--)
+			i3c_sdr_write(pbus, *pdat++);
+	}
 }
-#else
-static uint32_t __not_in_flash_func(i3c_sdr_read)(uint8_t continuetransfer)
+
+// Read up to maxlen bytes in SDR mode. The statemachine clocks all bytes autonomously and evaluates the T-Bit:
+//   T-Bit = 0 => The target ends the transfer, the statemachine stops
+//   T-Bit = 1 => The target can continue. After maxlen bytes the statemachine aborts the transfer
+// The CPU only drains the RX fifo. Each word contains the data byte in bits 8..1 and the T-Bit in Bit 0.
+// returns the count of read bytes
+static uint32_t __not_in_flash_func(i3c_sdr_read_bytes)(i3c_hl_bus_t *pbus, uint8_t *pdat, uint32_t maxlen)
 {
-	uint32_t data;
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_set_autopush(9);
-	i3c_pio_put32_no_check( I3CPIO_OPCODE_XFER(6, SDR_RBIT(0), SDR_RBIT(0), SDR_RBIT(0), SDR_RBIT(0), SDR_RBIT(0), SDR_RBIT(0)) );
-	i3c_pio_put32_no_check( I3CPIO_OPCODE_XFER(2, SDR_RBIT(0), SDR_RBIT(0), 0, 0, 0, 0) );	
-	i3c_pio_put32_no_check( I3CPIO_OPCODE_T_BIT(continuetransfer) ); // handle T-Bit
-	//i3c_pio_put32_no_check( I3CPIO_OPCODE_SCL0 ); // avoid high phase beeing too long
-	data = i3c_pio_get32(); // dump read data;
-	return data;
+	uint32_t readcount = 0;
+	bool done = false;
+
+	if (maxlen == 0)
+		return 0;
+	if (maxlen > 65536u)
+		maxlen = 65536u;
+
+	i3c_pio_wait_tx_empty(pbus);
+	i3c_pio_set_autopush(pbus, 9);
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_READ_BYTES(maxlen) );
+	while (!done)
+	{
+		uint32_t value = i3c_pio_get32(pbus);
+		*pdat++ = (uint8_t)(value >> 1);
+		readcount++;
+		done = ((value & 1) == 0) || (readcount == maxlen);
+	}
+	return readcount;
 }
-#endif
 
 
 
-static void __not_in_flash_func(i3c_od_write)(uint8_t value)
+static void __not_in_flash_func(i3c_od_write)(i3c_hl_bus_t *pbus, uint8_t value)
 {
 	uint32_t cmdword0,  cmdword1;
 
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_set_autopush(9);
+	i3c_pio_wait_tx_empty(pbus); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
+	i3c_pio_set_autopush(pbus, 9);
 	cmdword0 = I3CPIO_OPCODE_XFER(6, OD_WBIT((value>>7)&1), OD_WBIT((value>>6)&1), OD_WBIT((value>>5)&1), OD_WBIT((value>>4)&1), OD_WBIT((value>>3)&1), OD_WBIT((value>>2)&1));
 	cmdword1 = I3CPIO_OPCODE_XFER(3, OD_WBIT((value>>1)&1), OD_WBIT((value>>0)&1), OD_RACKBIT, 0, 0, 0);
 	
-	i3c_pio_put32_no_check(cmdword0);
-	i3c_pio_put32_no_check(cmdword1);	
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
-	uint32_t data = i3c_pio_get32();	
+	i3c_pio_put32_no_check(pbus, cmdword0);
+	i3c_pio_put32_no_check(pbus, cmdword1);	
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
+	uint32_t data = i3c_pio_get32(pbus);	
 }
 
-static inline uint8_t __not_in_flash_func(i3c_od_read)(uint8_t ack)
+static inline uint8_t __not_in_flash_func(i3c_od_read)(i3c_hl_bus_t *pbus, uint8_t ack)
 {
 	uint32_t cmdword0,  cmdword1, data;
 
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_set_autopush(9);
+	i3c_pio_wait_tx_empty(pbus); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
+	i3c_pio_set_autopush(pbus, 9);
 	cmdword0 = I3CPIO_OPCODE_XFER(6, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT);
 	cmdword1 = I3CPIO_OPCODE_XFER(3, OD_RBIT, OD_RBIT, OD_WBIT((ack^1)&1), 0, 0, 0);
-	i3c_pio_put32_no_check(cmdword0);
-	i3c_pio_put32_no_check(cmdword1);	
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
-	data = i3c_pio_get32();
+	i3c_pio_put32_no_check(pbus, cmdword0);
+	i3c_pio_put32_no_check(pbus, cmdword1);	
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
+	data = i3c_pio_get32(pbus);
 	return ((uint8_t)(data>>1));
 }
 
-static inline uint8_t __not_in_flash_func(i3c_od_read8)(void)
+static inline uint8_t __not_in_flash_func(i3c_od_read8)(i3c_hl_bus_t *pbus)
 {
 	uint32_t cmdword0,  cmdword1;
 	uint8_t readdata;
 
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_set_autopush(8);
+	i3c_pio_wait_tx_empty(pbus); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
+	i3c_pio_set_autopush(pbus, 8);
 	cmdword0 = I3CPIO_OPCODE_XFER(6, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT, OD_RBIT);
 	cmdword1 = I3CPIO_OPCODE_XFER(2, OD_RBIT, OD_RBIT, 0, 0, 0, 0);
-	i3c_pio_put32_no_check(cmdword0);
-	i3c_pio_put32_no_check(cmdword1);
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
-	readdata =  (uint8_t)i3c_pio_get32();
+	i3c_pio_put32_no_check(pbus, cmdword0);
+	i3c_pio_put32_no_check(pbus, cmdword1);
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
+	readdata =  (uint8_t)i3c_pio_get32(pbus);
 	return readdata;
 }
 
-// returns true of SDA is low (IBI/HJ type 1)
-bool __not_in_flash_func(i3c_ibi_type1_check)(void)
+// returns true of SDA is low (IBI/HJ type 1). The STOP of a previous transfer may still be queued, so the state machine
+// has to finish first
+bool __not_in_flash_func(i3c_ibi_type1_check)(i3c_hl_bus_t *pbus)
+{
+	i3c_pio_wait_tx_empty(pbus);
+	i3c_pio_wait_idle(pbus);
+	return ((i3c_hal_read32(&io_bank0_hw->io[pbus->gpiobasepin].status) & IO_BANK0_GPIO0_STATUS_INFROMPAD_BITS) >> IO_BANK0_GPIO0_STATUS_INFROMPAD_LSB) == 0;
+}
+
+// IBI detection while the bus is idle. A falling SDA edge raises IO_IRQ_BANK0 on the core which enabled it. The
+// handler only wakes up the core from __wfe, the IBI itself is read by i3c_hl_poll from thread context.
+// One handler per core serves all buses, the event mask of a GPIO only shows the events enabled on the current core.
+static void __not_in_flash_func(i3c_hl_ibi_irq_handler)(void)
+{
+	for (uint32_t i=0; i<I3C_HL_MAXBUS; i++)
+	{
+		i3c_hl_bus_t *pbus = &i3c_hl_buses[i];
+		if ( pbus->ibi_irq_enabled && (gpio_get_irq_event_mask(pbus->gpiobasepin) & GPIO_IRQ_EDGE_FALL) )
+		{
+			gpio_acknowledge_irq(pbus->gpiobasepin, GPIO_IRQ_EDGE_FALL);
+			__sev();
+		}
+	}
+}
+
+i3c_hl_status_t i3c_hl_ibi_irq_enable(i3c_hl_bus_t *pbus, bool enable)
+{
+	if (!pbus->initialized)
+		return i3c_hl_status_param_outofrange;
+	if (enable)
+	{
+		gpio_acknowledge_irq(pbus->gpiobasepin, GPIO_IRQ_EDGE_FALL);
+		pbus->ibi_irq_enabled = true;
+		if (!i3c_hl_ibi_irq_handler_added[get_core_num()])
+		{
+			gpio_add_raw_irq_handler_masked(1u << pbus->gpiobasepin, i3c_hl_ibi_irq_handler);
+			i3c_hl_ibi_irq_handler_added[get_core_num()] = true;
+		}
+		gpio_set_irq_enabled(pbus->gpiobasepin, GPIO_IRQ_EDGE_FALL, true);
+		irq_set_enabled(IO_IRQ_BANK0, true);
+	}
+	else
+	{
+		gpio_set_irq_enabled(pbus->gpiobasepin, GPIO_IRQ_EDGE_FALL, false);
+		pbus->ibi_irq_enabled = false;
+	}
+	return i3c_hl_status_ok;
+}
+
+// true when a target requests service: an IBI won the arbitration of the last transfer or SDA is held low on the idle bus
+bool __not_in_flash_func(i3c_hl_ibi_pending)(i3c_hl_bus_t *pbus)
 {
-	return ((io_bank0_hw->io[i3c_hl_gpiobasepin].status & IO_BANK0_GPIO0_STATUS_INFROMPAD_BITS) >> IO_BANK0_GPIO0_STATUS_INFROMPAD_LSB) == 0;
+	return (pbus->arbcode != 0xfc) || i3c_ibi_type1_check(pbus);
 }
 
 // returns true when acked and no arbitration issue occured.
 // *parbdata will contain the sensed data during transmit, enabling to detect e.g. IBI source
-static i3c_hl_status_t __not_in_flash_func(i3c_arbhdr)(uint8_t *parbdata)
+static i3c_hl_status_t __not_in_flash_func(i3c_arbhdr)(i3c_hl_bus_t *pbus, uint8_t *parbdata)
 {
 	uint32_t cmdword0, cmdword1, cmdword2;
 	uint32_t data0, data1;
 	uint8_t  arbdata;
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_set_autopush(6);
+	i3c_pio_wait_tx_empty(pbus); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
+	i3c_pio_set_autopush(pbus, 6);
 	cmdword0 = I3CPIO_OPCODE_XFER(6, OD_WBIT(1), OD_WBIT(1), OD_WBIT(1), OD_WBIT(1), OD_WBIT(1), OD_WBIT(1));
 	cmdword1 = I3CPIO_OPCODE_XFER(3, OD_WBIT(0), OD_WBIT(0), OD_RACKBIT, 0, 0, 0); // normal case: no arbitration happened
 	cmdword2 = I3CPIO_OPCODE_XFER(3, OD_WBIT(1), OD_WBIT(1), OD_WBIT(0), 0, 0, 0); // used when arbitration won by target, this will get a read  which we need to ACK
 
-	i3c_pio_put32_no_check(cmdword0);
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0); // in debug build the high period would be too long and pass through i2c glitch filters, so make it low to prevent this
-	data0 = i3c_pio_get32();
-	i3c_pio_set_autopush(3);
+	i3c_pio_put32_no_check(pbus, cmdword0);
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0); // in debug build the high period would be too long and pass through i2c glitch filters, so make it low to prevent this
+	data0 = i3c_pio_get32(pbus);
+	i3c_pio_set_autopush(pbus, 3);
 	if (data0 == 0x3ful)
 	{ // no arbitration occured (transmitted 6 high bits and received 6 high bits)
-		i3c_pio_put32_no_check(cmdword1);	
-		i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
-		data1 = i3c_pio_get32();
+		i3c_pio_put32_no_check(pbus, cmdword1);	
+		i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
+		data1 = i3c_pio_get32(pbus);
 		if (data1 & 1)
 		{
 			retcode = i3c_hl_status_nak_during_arbhdr;
 		}
 	}
-	else
-	{ // arbitration occured (IBI raised - collect data)
-		i3c_pio_put32_no_check(cmdword2);	
-		i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
-		data1 = i3c_pio_get32();
-		retcode = i3c_hl_status_ibi;
-	}
-	arbdata = (data0<<2) | (data1>>1); // strip away ACK bit
-	if (parbdata)
-		*parbdata = arbdata;
+	else
+	{ // arbitration occured (IBI raised - collect data)
+		i3c_pio_put32_no_check(pbus, cmdword2);	
+		i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0); // avoid high phase beeing too long
+		data1 = i3c_pio_get32(pbus);
+		retcode = i3c_hl_status_ibi;
+	}
+	arbdata = (data0<<2) | (data1>>1); // strip away ACK bit
+	if (parbdata)
+		*parbdata = arbdata;
+
+	pbus->arbcode = arbdata;
+	return retcode; // Bit 0 of data 1 is the last bit sampled, thus the ACK bit
+}
+
+// execute entdaa process. Return TRUE on success. FALSE when no target responded
+// pid points to an 8 byte memory which receives the UID returned by the device during execution
+i3c_hl_status_t __not_in_flash_func(i3c_hl_entdaa)(i3c_hl_bus_t *pbus, uint8_t addr, uint8_t *pid)
+{
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
+	uint8_t arbhdr;
+	uint32_t previntstate = save_and_disable_interrupts();
+
+	if (i3c_ibi_type1_check(pbus))
+	{
+		retcode = i3c_hl_status_ibi;
+	}
+	if (retcode == i3c_hl_status_ok)
+	{
+		i3c_start(pbus);
+		retcode = i3c_arbhdr(pbus, &arbhdr);
+		if ( retcode == i3c_hl_status_ok )
+		{		
+			i3c_sdr_write(pbus, 0x07);
+			i3c_restart(pbus);
+			retcode = i3c_sdr_write_addr(pbus, (0x7eu<<1) | 1);
+			if ( retcode == i3c_hl_status_ok )
+			{
+				uint8_t id[8];
+
+				for (uint8_t i=0; i<8; i++)
+				{
+					id[i] = i3c_od_read8(pbus);
+				}
+				if ( pid )
+				{
+					memcpy(pid, id, sizeof(id));
+				}
+
+				retcode = i3c_sdr_write_addr(pbus, (uint8_t)((addr << 1) | (__builtin_parity(addr) ^ 1)));
+				if ( retcode == i3c_hl_status_ok )
+				{
+					i3c_hl_device_assigned(pbus, addr, id);
+				}
+			}
+		}
+		else
+		{
+			if (arbhdr != 0x7e)
+			{
+				//asdf
+			}
+		}
+		if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
+			i3c_stop(pbus);
+	}
+	restore_interrupts(previntstate);
 
-	i3c_hl_arbcode = arbdata;
-	return retcode; // Bit 0 of data 1 is the last bit sampled, thus the ACK bit
+	return retcode;
 }
 
-// execute entdaa process. Return TRUE on success. FALSE when no target responded
-// pid points to an 8 byte memory which receives the UID returned by the device during execution
-i3c_hl_status_t __not_in_flash_func(i3c_hl_entdaa)(uint8_t addr, uint8_t *pid)
+// address usable for dynamic address assignment: not reserved (0x00..0x07, 0x7E and the addresses differing from 0x7E in a
+// single bit, which could be mistaken for the broadcast address) and not marked as used in pskip
+static inline bool __not_in_flash_func(i3c_hl_daa_addr_free)(uint8_t addr, const uint32_t *pskip)
+{
+	uint8_t diff = addr ^ 0x7eu;
+
+	if ( (addr < 0x08u) || (addr > 0x7fu) || (diff == 0) || ((diff & (diff - 1u)) == 0) )
+		return false;
+	return (pskip == NULL) || ((pskip[addr >> 5] & (1ul << (addr & 31u))) == 0);
+}
+
+void i3c_hl_daa_preferred(i3c_hl_bus_t *pbus, const i3c_hl_daa_entry_t *pprefs, uint32_t count)
+{
+	pbus->daa_preferred       = pprefs;
+	pbus->daa_preferred_count = pprefs ? count : 0;
+}
+
+// preferred address of the target with PID pid, 0 when it has none
+static uint8_t __not_in_flash_func(i3c_hl_daa_preferred_addr)(const i3c_hl_bus_t *pbus, const uint8_t *pid)
+{
+	for (uint32_t i=0; i<pbus->daa_preferred_count; i++)
+	{
+		if (memcmp(pbus->daa_preferred[i].pid, pid, sizeof(pbus->daa_preferred[i].pid)) == 0)
+			return pbus->daa_preferred[i].addr;
+	}
+	return 0;
+}
+
+// ENTDAA of all targets in one CCC: START, 0x7E/W, ENTDAA, then per target a repeated START with 0x7E/R, its PID, BCR and
+// DCR and its preferred address or the next one of the pool, until 0x7E/R is NAKed.
+i3c_hl_status_t __not_in_flash_func(i3c_hl_daa)(i3c_hl_bus_t *pbus, uint8_t firstaddr, uint8_t lastaddr, const uint32_t *pskip,
+                                                i3c_hl_daa_entry_t *pentries, uint32_t maxcount, uint32_t *pcount)
 {
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
-	uint8_t arbhdr;
-	uint32_t previntstate = save_and_disable_interrupts();
+	uint32_t count = 0, naks = 0;
+	uint8_t addr = firstaddr, assign;
+	uint32_t used[4] = { 0 }, pool[4];  // addresses in use (pskip and assigned) / not to be taken from the pool
+	uint32_t previntstate;
+
+	*pcount = 0;
+	if ( (firstaddr > lastaddr) || (lastaddr > 0x7fu) || ((pentries == NULL) && (maxcount > 0)) )
+		return i3c_hl_status_param_outofrange;
+
+	if (pskip)
+		memcpy(used, pskip, sizeof(used));
+	memcpy(pool, used, sizeof(pool));
+	for (uint32_t i=0; i<pbus->daa_preferred_count; i++)
+	{
+		uint8_t prefaddr = pbus->daa_preferred[i].addr & 0x7fu;
+		pool[prefaddr >> 5] |= 1ul << (prefaddr & 31u);
+	}
 
-	if (i3c_ibi_type1_check())
+	previntstate = save_and_disable_interrupts();
+	if (i3c_ibi_type1_check(pbus))
 	{
 		retcode = i3c_hl_status_ibi;
 	}
 	if (retcode == i3c_hl_status_ok)
 	{
-		i3c_start();
-		retcode = i3c_arbhdr(&arbhdr);
+		i3c_start(pbus);
+		retcode = i3c_arbhdr(pbus, NULL);
 		if ( retcode == i3c_hl_status_ok )
-		{		
-			i3c_sdr_write(0x07);
-			i3c_restart();
-			retcode = i3c_sdr_write_addr((0x7eu<<1) | 1);
-			if ( retcode == i3c_hl_status_ok )
+		{
+			i3c_sdr_write(pbus, 0x07); // ENTDAA
+			while (retcode == i3c_hl_status_ok)
 			{
+				uint8_t id[8];
+
+				i3c_restart(pbus);
+				if (i3c_sdr_write_addr(pbus, (0x7eu<<1) | 1) != i3c_hl_status_ok)
+					break; // NAK: no target left without dynamic address
 				for (uint8_t i=0; i<8; i++)
-				{
-					uint8_t id = i3c_od_read8();
-					if ( pid )
-					{
-						*pid++ = id;
-					}
+					id[i] = i3c_od_read8(pbus);
+
+				assign = i3c_hl_daa_preferred_addr(pbus, id);
+				if ( (assign == 0) || !i3c_hl_daa_addr_free(assign, used) )
+				{ // no preferred address or not available: the next one of the pool
+					while ( (addr <= lastaddr) && !i3c_hl_daa_addr_free(addr, pool) )
+						addr++;
+					assign = (addr <= lastaddr) ? addr : 0;
+				}
+				if ( (assign == 0) || (count >= maxcount) )
+				{ // more targets than addresses or entries. The STOP ends ENTDAA, the target stays without address
+					retcode = i3c_hl_status_param_outofrange;
+					break;
 				}
 
-				addr <<= 1;
-				addr |= __builtin_parity(addr)^1;
-
-				retcode = i3c_sdr_write_addr(addr);
-			}
-		}
-		else
-		{
-			if (arbhdr != 0x7e)
-			{
-				//asdf
+				if (i3c_sdr_write_addr(pbus, (uint8_t)((assign << 1) | (__builtin_parity(assign) ^ 1))) == i3c_hl_status_ok)
+				{
+					i3c_hl_daa_entry_t *pentry = &pentries[count++];
+
+					memcpy(pentry->pid, id, sizeof(pentry->pid));
+					pentry->bcr  = id[6];
+					pentry->dcr  = id[7];
+					pentry->addr = assign;
+					used[assign >> 5] |= 1ul << (assign & 31u);
+					pool[assign >> 5] |= 1ul << (assign & 31u);
+					naks = 0;
+					i3c_hl_device_assigned(pbus, assign, id);
+				}
+				else if (++naks > I3C_HL_DAA_RETRIES)
+				{ // the target takes part again after the next repeated START, unless it keeps refusing the address
+					retcode = i3c_hl_status_nak_during_sdraddr;
+				}
 			}
 		}
 		if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
-			i3c_stop();
+			i3c_stop(pbus);
 	}
 	restore_interrupts(previntstate);
 
+	*pcount = count;
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_rstdaa)(void)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_rstdaa)(i3c_hl_bus_t *pbus)
 {
 	uint32_t previntstate = save_and_disable_interrupts();
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	if (i3c_ibi_type1_check())
+	if (i3c_ibi_type1_check(pbus))
 	{
 		retcode = i3c_hl_status_ibi;
 	}
 
 	if (retcode == i3c_hl_status_ok)
 	{
-		i3c_start();
-		retcode = i3c_arbhdr(NULL);
+		i3c_start(pbus);
+		retcode = i3c_arbhdr(pbus, NULL);
 		if ( retcode == i3c_hl_status_ok )
-			i3c_sdr_write(0x06); // RSTDAA
+		{
+			i3c_sdr_write(pbus, 0x06); // RSTDAA
+			i3c_hl_device_clear(pbus);
+		}
 		if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
-			i3c_stop();
+			i3c_stop(pbus);
 	}
 	restore_interrupts(previntstate);
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_privwrite)(uint8_t addr, const uint8_t *pdat, uint32_t bytecount)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_privwrite)(i3c_hl_bus_t *pbus, uint8_t addr, const uint8_t *pdat, uint32_t bytecount)
 {
+	uint32_t tstart_us = time_us_32();
 	uint32_t previntstate = save_and_disable_interrupts();
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 	uint8_t arbdata;
 
-	if (i3c_ibi_type1_check())
+	if (i3c_ibi_type1_check(pbus))
 	{
 		retcode = i3c_hl_status_ibi;
 	}
 	if (retcode == i3c_hl_status_ok)
 	{
-		i3c_start();
-		retcode = i3c_arbhdr(&arbdata);
+		i3c_start(pbus);
+		retcode = i3c_arbhdr(pbus, &arbdata);
 
 		if ( retcode == i3c_hl_status_ok )
 		{
-			i3c_restart();
-			retcode = i3c_sdr_write_addr(addr<<1);
+			i3c_restart(pbus);
+			retcode = i3c_sdr_write_addr(pbus, addr<<1);
 			if (retcode == i3c_hl_status_ok)
 			{
-				while (bytecount--)
-					i3c_sdr_write(*pdat++);
+				i3c_sdr_write_block(pbus, pdat, bytecount);
 			}
 		}
 		if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
-			i3c_stop();
+			i3c_stop(pbus);
 	}
+	i3c_hl_stats_record(pbus, i3c_hl_stats_sdr_write, retcode, bytecount, tstart_us);
 	restore_interrupts(previntstate);
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_privwriteread)(uint8_t addr, const uint8_t *pwritedat, uint32_t writebytecount,
+i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_privwriteread)(i3c_hl_bus_t *pbus, uint8_t addr, const uint8_t *pwritedat, uint32_t writebytecount,
                                                                                   uint8_t *preaddat, uint32_t *preadbytecount)
 {
+	uint32_t tstart_us = time_us_32();
 	uint32_t previntstate = save_and_disable_interrupts();
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
-	uint32_t readbytecount;
-	bool done;
 
-	if (i3c_ibi_type1_check())
+	if (i3c_ibi_type1_check(pbus))
 	{
 		retcode = i3c_hl_status_ibi;
 	}
 	if (retcode == i3c_hl_status_ok)
 	{
-		i3c_start();
-		retcode = i3c_arbhdr(NULL);
+		i3c_start(pbus);
+		retcode = i3c_arbhdr(pbus, NULL);
 		if ( retcode == i3c_hl_status_ok )
 		{
-			i3c_restart();
-			retcode = i3c_sdr_write_addr(addr<<1);
+			i3c_restart(pbus);
+			retcode = i3c_sdr_write_addr(pbus, addr<<1);
 			if (retcode == i3c_hl_status_ok)
 			{
-				while (writebytecount--)
-					i3c_sdr_write(*pwritedat++);
+				i3c_sdr_write_block(pbus, pwritedat, writebytecount);
 				// step over to read phase
-				i3c_restart();
+				i3c_restart(pbus);
 
 
-				retcode = i3c_sdr_write_addr((addr<<1) | 1);
-s_i3c_program_sdr_overlay_sm(true);
+				retcode = i3c_sdr_write_addr(pbus, (addr<<1) | 1);
 				if (retcode == i3c_hl_status_ok)
 				{
-					uint32_t readlen = *preadbytecount;
-					done = false;
-					readbytecount = 0;
-					while ( (readlen) && (!done) )
-					{
-						uint32_t value;
-						readlen--;
-						value = i3c_sdr_read(readlen==0);
-						done = !(value & 1);
-						*preaddat++ = value >>1;
-						readbytecount++;
-					}
-					*preadbytecount = readbytecount;
+					*preadbytecount = i3c_sdr_read_bytes(pbus, preaddat, *preadbytecount);
 				}
-s_i3c_program_sdr_overlay_sm(false);
 
 			}
 		}
 		if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
-			i3c_stop();
+			i3c_stop(pbus);
 	}
+	i3c_hl_stats_record(pbus, i3c_hl_stats_sdr_writeread, retcode, writebytecount + *preadbytecount, tstart_us);
 	restore_interrupts(previntstate);
 	return retcode;
 }
 
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_ccc_broadcast_write)(const uint8_t *pdat, uint32_t bytecount)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_ccc_broadcast_write)(i3c_hl_bus_t *pbus, const uint8_t *pdat, uint32_t bytecount)
 {
+	uint32_t tstart_us = time_us_32();
 	uint32_t previntstate = save_and_disable_interrupts();
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	if (i3c_ibi_type1_check())
+	if (i3c_ibi_type1_check(pbus))
 	{
 		retcode = i3c_hl_status_ibi;
 	}
 	if (retcode == i3c_hl_status_ok)
 	{
-		i3c_start();
-		retcode = i3c_arbhdr(NULL);
+		i3c_start(pbus);
+		retcode = i3c_arbhdr(pbus, NULL);
 		if ( retcode == i3c_hl_status_ok )
 		{
-			while (bytecount--)
-				i3c_sdr_write(*pdat++);
+			i3c_sdr_write_block(pbus, pdat, bytecount);
+			i3c_hl_device_snoop_set(pbus, pdat, bytecount, 0xff, NULL, 0);
 		}
 		if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
-			i3c_stop();
+			i3c_stop(pbus);
 	}
+	i3c_hl_stats_record(pbus, i3c_hl_stats_ccc_broadcast, retcode, bytecount, tstart_us);
 	restore_interrupts(previntstate);
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_ccc_direct_write)(const uint8_t *pdat, uint32_t bytecount,
+i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_ccc_direct_write)(i3c_hl_bus_t *pbus, const uint8_t *pdat, uint32_t bytecount,
 																uint8_t addr, const uint8_t *pdirectdat, uint32_t directbytecount)
 {
+	uint32_t tstart_us = time_us_32();
 	uint32_t previntstate = save_and_disable_interrupts();
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	if (i3c_ibi_type1_check())
+	if (i3c_ibi_type1_check(pbus))
 	{
 		retcode = i3c_hl_status_ibi;
 	}
 	if (retcode == i3c_hl_status_ok)
 	{
-		i3c_start();
-		retcode = i3c_arbhdr(NULL);
+		i3c_start(pbus);
+		retcode = i3c_arbhdr(pbus, NULL);
 		if ( retcode == i3c_hl_status_ok )
 		{
-			while (bytecount--)
-				i3c_sdr_write(*pdat++);
-			i3c_restart();
-			retcode = i3c_sdr_write_addr(addr<<1);
+			i3c_sdr_write_block(pbus, pdat, bytecount);
+			i3c_restart(pbus);
+			retcode = i3c_sdr_write_addr(pbus, addr<<1);
 			if (retcode == i3c_hl_status_ok)
 			{
-				while (directbytecount--)
-					i3c_sdr_write(*pdirectdat++);
+				i3c_sdr_write_block(pbus, pdirectdat, directbytecount);
+				i3c_hl_device_snoop_set(pbus, pdat, bytecount, addr, pdirectdat, directbytecount);
 			}
 		}
 		if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
-			i3c_stop();
+			i3c_stop(pbus);
 	}
+	i3c_hl_stats_record(pbus, i3c_hl_stats_ccc_direct_write, retcode, bytecount + directbytecount, tstart_us);
 	restore_interrupts(previntstate);
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_ccc_direct_read)(const uint8_t *pdat, uint32_t bytecount,
+i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_ccc_direct_read)(i3c_hl_bus_t *pbus, const uint8_t *pdat, uint32_t bytecount,
 																uint8_t addr, uint8_t *pdirectdat, uint32_t *pdirectbytecount)
 {
+	uint32_t tstart_us = time_us_32();
 	uint32_t previntstate = save_and_disable_interrupts();
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
-	uint32_t readbytecount = 0;
-	bool done;
 
-	if (i3c_ibi_type1_check())
+	if (i3c_ibi_type1_check(pbus))
 	{
 		retcode = i3c_hl_status_ibi;
 	}
 	if (retcode == i3c_hl_status_ok)
 	{
-		i3c_start();
-		retcode = i3c_arbhdr(NULL);
+		i3c_start(pbus);
+		retcode = i3c_arbhdr(pbus, NULL);
 		if ( retcode == i3c_hl_status_ok )
 		{
-			while (bytecount--)
-				i3c_sdr_write(*pdat++);
-			i3c_restart();
-s_i3c_program_sdr_overlay_sm(true);
-			retcode = i3c_sdr_write_addr((addr<<1) | 1);
+			i3c_sdr_write_block(pbus, pdat, bytecount);
+			i3c_restart(pbus);
+			retcode = i3c_sdr_write_addr(pbus, (addr<<1) | 1);
 			if (retcode == i3c_hl_status_ok)
 			{
-				uint32_t readlen = *pdirectbytecount;
-				done = false;
-				while ( (readlen--) && (!done) )
-				{
-					uint32_t value;
-					value = i3c_sdr_read(readlen==0);
-					done = !(value & 1);
-					*pdirectdat++ = value >>1;
-					readbytecount++;
-				}
-				*pdirectbytecount = readbytecount;
+				*pdirectbytecount = i3c_sdr_read_bytes(pbus, pdirectdat, *pdirectbytecount);
+				if (bytecount > 0)
+					i3c_hl_device_snoop_get(pbus, pdat, addr, pdirectdat, *pdirectbytecount);
 			}
-s_i3c_program_sdr_overlay_sm(false);
 		}
 		if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
-			i3c_stop();
+			i3c_stop(pbus);
 	}
+	i3c_hl_stats_record(pbus, i3c_hl_stats_ccc_direct_read, retcode, bytecount + *pdirectbytecount, tstart_us);
 	restore_interrupts(previntstate);
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_ccc_read)(const uint8_t *pwritedata, uint32_t writelen,
+i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_ccc_read)(i3c_hl_bus_t *pbus, const uint8_t *pwritedata, uint32_t writelen,
                                                               uint8_t *preaddat,  uint32_t *preadlen)
 {
 	uint32_t previntstate = save_and_disable_interrupts();
 	i3c_hl_status_t retcode;
-	uint32_t readbytecount;
-	uint32_t readlen = *preadlen;
-	bool done;
 
-	i3c_start();
-	retcode = i3c_arbhdr(NULL);
+	i3c_start(pbus);
+	retcode = i3c_arbhdr(pbus, NULL);
 	if ( retcode == i3c_hl_status_ok )
 	{
-		while (writelen--)
-			i3c_sdr_write(*pwritedata++);
-		i3c_restart();
-		retcode = i3c_sdr_write_addr((0x7e<<1) | 1);
-s_i3c_program_sdr_overlay_sm(true);
+		i3c_sdr_write_block(pbus, pwritedata, writelen);
+		i3c_restart(pbus);
+		retcode = i3c_sdr_write_addr(pbus, (0x7e<<1) | 1);
 		if ( retcode == i3c_hl_status_ok )
 		{
-			done = false;
-			while ( (readlen--) && (!done) )
-			{
-				uint32_t value;
-				value = i3c_sdr_read(readlen==0);
-				done = !(value & 1);
-				*preaddat++ = value >>1;
-				readbytecount++;
-			}
-			*preadlen = readbytecount;
+			*preadlen = i3c_sdr_read_bytes(pbus, preaddat, *preadlen);
 		}
-s_i3c_program_sdr_overlay_sm(false);
 	}
 	if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
-		i3c_stop();
+		i3c_stop(pbus);
 	restore_interrupts(previntstate);
 	return retcode;
 }
@@ -854,157 +1557,207 @@ s_i3c_program_sdr_overlay_sm(false);
 // execute a private read.
 // returns the count of read data bytes.
 // a slave might indicate that it ran "out of data".
-i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_privread)(uint8_t addr, uint8_t *pdat, uint32_t *pbytecount)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_sdr_privread)(i3c_hl_bus_t *pbus, uint8_t addr, uint8_t *pdat, uint32_t *pbytecount)
 {
+	uint32_t tstart_us = time_us_32();
 	uint32_t previntstate = save_and_disable_interrupts();
 	uint32_t readbytecount;
-	bool done;
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 	uint32_t bytecount = *pbytecount;
 
-	if (i3c_ibi_type1_check())
+	if (i3c_ibi_type1_check(pbus))
 	{
 		retcode = i3c_hl_status_ibi;
 	}
 	if (retcode == i3c_hl_status_ok)
 	{
+		uint32_t mrl = i3c_hl_device_mrl(pbus, addr);
+		uint32_t chunk, chunkcount;
+
 		readbytecount = 0;
-		i3c_start();
-		retcode = i3c_arbhdr(NULL);
+		i3c_start(pbus);
+		retcode = i3c_arbhdr(pbus, NULL);
 		if ( retcode ==  i3c_hl_status_ok )
 		{
-			i3c_restart();
-			retcode = i3c_sdr_write_addr((addr<<1) | 1);
-s_i3c_program_sdr_overlay_sm(true);
-			if ( retcode == i3c_hl_status_ok )
+			// reads longer than the MRL of the target are split into reads of up to MRL bytes, until the target ends one early
+			do
 			{
-				
-				done = false;
-				while ( (bytecount--) && (!done) )
+				chunk = bytecount - readbytecount;
+				if ( (mrl != 0) && (chunk > mrl) )
+					chunk = mrl;
+				i3c_hl_status_t addrstatus;
+
+				i3c_restart(pbus);
+				addrstatus = i3c_sdr_write_addr(pbus, (addr<<1) | 1);
+				if (addrstatus != i3c_hl_status_ok)
 				{
-					uint32_t value;
-					value = i3c_sdr_read(bytecount==0);
-					done = !(value & 1);
-					*pdat++ = value >>1;
-					readbytecount++;
+					if (readbytecount == 0)
+						retcode = addrstatus;
+					break; // a NAK after the first chunk: no more data
 				}
-			}
-s_i3c_program_sdr_overlay_sm(false);
+				chunkcount = i3c_sdr_read_bytes(pbus, pdat + readbytecount, chunk);
+				readbytecount += chunkcount;
+			} while ( (chunkcount == chunk) && (readbytecount < bytecount) );
 		}
 		if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
-			i3c_stop();
+			i3c_stop(pbus);
 		*pbytecount = readbytecount;
 	}
+	i3c_hl_stats_record(pbus, i3c_hl_stats_sdr_read, retcode, *pbytecount, tstart_us);
 	restore_interrupts(previntstate);
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_checkack)(uint8_t addr)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_checkack)(i3c_hl_bus_t *pbus, uint8_t addr)
 {
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	if (i3c_ibi_type1_check())
-	{
-		printf("IBI CHECK\n");
+	if (i3c_ibi_type1_check(pbus))
 		return i3c_hl_status_ibi;
-	}
 
-	i3c_start();
-	retcode = i3c_arbhdr(NULL);
+	i3c_start(pbus);
+	retcode = i3c_arbhdr(pbus, NULL);
 	if ( retcode ==  i3c_hl_status_ok)
 	{
-		i3c_restart( );
-		retcode = i3c_sdr_write_addr(addr<<1);
+		i3c_restart(pbus);
+		retcode = i3c_sdr_write_addr(pbus, addr<<1);
 	}
 	if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
-		i3c_stop();
+		i3c_stop(pbus);
 	
 	// ensure SDA is settled to avoid unintended IBI detection in next step
 	sleep_us(100);
-	i3c_ibi_type1_check();
+	i3c_ibi_type1_check(pbus);
+
+	return retcode;
+}
+
+i3c_hl_status_t __not_in_flash_func(i3c_hl_scan)(i3c_hl_bus_t *pbus, uint32_t *ppresent)
+{
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
+	uint32_t previntstate;
+	uint32_t busfree_us;
+
+	memset(ppresent, 0, 4 * sizeof(uint32_t));
+	previntstate = save_and_disable_interrupts();
+	if (i3c_ibi_type1_check(pbus))
+	{
+		retcode = i3c_hl_status_ibi;
+	}
+	if (retcode == i3c_hl_status_ok)
+	{
+		i3c_start(pbus);
+		retcode = i3c_arbhdr(pbus, NULL);
+		if ( retcode == i3c_hl_status_ok )
+		{ // targets can't raise IBIs after a repeated START, so all addresses are probed within this frame
+			for (uint8_t addr=0; addr<0x80; addr++)
+			{
+				uint8_t diff = addr ^ 0x7eu;
+
+				if ( (diff & (diff - 1u)) == 0 ) // 0x7E or a single bit away from it
+					continue;
+				i3c_restart(pbus);
+				if (i3c_sdr_write_addr(pbus, addr << 1) == i3c_hl_status_ok)
+					ppresent[addr >> 5] |= 1ul << (addr & 31u);
+			}
+		}
+		else if (retcode == i3c_hl_status_nak_during_arbhdr)
+		{ // no I3C target on the bus
+			retcode = i3c_hl_status_ok;
+		}
+		if (retcode != i3c_hl_status_ibi) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
+			i3c_stop(pbus);
+	}
+	restore_interrupts(previntstate);
 
+	// bus free time: I3C_HL_BUSFREE_CLOCKS periods of the clock rate, at least 1 us
+	busfree_us = (I3C_HL_BUSFREE_CLOCKS * 1000u + pbus->clkrate_khz - 1u) / pbus->clkrate_khz;
+	sleep_us(busfree_us ? busfree_us : 1u);
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_arbhdronly)(void)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_arbhdronly)(i3c_hl_bus_t *pbus)
 {
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	if (i3c_ibi_type1_check())
+	if (i3c_ibi_type1_check(pbus))
 	{
 		return i3c_hl_status_ibi;
 	}
-	i3c_start();
-	retcode = i3c_arbhdr(NULL);
-	i3c_stop();
+	i3c_start(pbus);
+	retcode = i3c_arbhdr(pbus, NULL);
+	i3c_stop(pbus);
 	return retcode;
 }
 
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_targetreset)(void)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_targetreset)(i3c_hl_bus_t *pbus)
 {
 	uint32_t cmdword0,  cmdword1, resp;
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0);
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SDASTATE(1));
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SDADIR(1));  // SDA = active high
+	i3c_pio_ensure_sdr(pbus);
+	i3c_pio_wait_tx_empty(pbus); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0);
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SDASTATE(1));
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SDADIR(1));  // SDA = active high
 
 #pragma GCC unroll 8
 	for (int i=0; i<7;i++)
 	{
-		i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(0));
-		i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(1));
+		i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(0));
+		i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(1));
 	}
-	i3c_pio_put32(I3CPIO_OPCODE_SCL1); // avoid high phase beeing too long
-	i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(0)); 
-	i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(1)); 
-	i3c_pio_put32(I3CPIO_OPCODE_SDADIR(0)); 
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SCL1); // avoid high phase beeing too long
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(0)); 
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(1)); 
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDADIR(0)); 
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_hdrexit)(void)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_hdrexit)(i3c_hl_bus_t *pbus)
 {
 	uint32_t cmdword0,  cmdword1, resp;
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0);
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SDASTATE(1));
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SDADIR(1));  // SDA = active high
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SDASTATE(0));  // SDA = low
+	i3c_pio_ensure_sdr(pbus);
+	i3c_pio_wait_tx_empty(pbus); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0);
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SDASTATE(1));
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SDADIR(1));  // SDA = active high
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SDASTATE(0));  // SDA = low
 
 #pragma GCC unroll 4
 	for (int i=0; i<4;i++)
 	{
-		i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(1));
-		i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(0));
+		i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(1));
+		i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(0));
 	}
-	i3c_pio_put32(I3CPIO_OPCODE_SCL1); // avoid high phase beeing too long
-	i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(1)); 
-	i3c_pio_put32(I3CPIO_OPCODE_SDADIR(0)); 
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SCL1); // avoid high phase beeing too long
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(1)); 
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDADIR(0)); 
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_hdrrestart)(void)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_hdrrestart)(i3c_hl_bus_t *pbus)
 {
 	uint32_t cmdword0,  cmdword1, resp;
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	i3c_pio_wait_tx_empty(); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SCL0);
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SDASTATE(1));
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SDADIR(1));  // SDA = active high
-	i3c_pio_put32_no_check(I3CPIO_OPCODE_SDASTATE(0));  // SDA = low
+	i3c_pio_ensure_sdr(pbus);
+	i3c_pio_wait_tx_empty(pbus); // wait until tx pipe is empty. Afterwards 4 words can be written without full check
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SCL0);
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SDASTATE(1));
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SDADIR(1));  // SDA = active high
+	i3c_pio_put32_no_check(pbus, I3CPIO_OPCODE_SDASTATE(0));  // SDA = low
 
-	i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(0));
-	i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(1));
-	i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(0));
-	i3c_pio_put32(I3CPIO_OPCODE_SDASTATE(1));
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(0));
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(1));
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(0));
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDASTATE(1));
 
-	i3c_pio_put32(I3CPIO_OPCODE_SCL1); // avoid high phase beeing too long
-	i3c_pio_put32(I3CPIO_OPCODE_SDADIR(0)); // release SCL
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SCL1); // avoid high phase beeing too long
+	i3c_pio_put32(pbus, I3CPIO_OPCODE_SDADIR(0)); // release SCL
 	return retcode;
 }
 
@@ -1029,6 +1782,7 @@ const char     *i3c_hl_get_errorstring(i3c_hl_status_t errcode)
 		case i3c_hl_status_ddr_parity_wrong      : sprintf(errstring, "ERR_DDR_READ_PARITY_WRONG(%d)", (uint32_t)errcode); break;
 		case i3c_hl_status_ddr_crc_wrong         : sprintf(errstring, "ERR_DDR_READ_CRC_WRONG(%d)", (uint32_t)errcode); break;
 		case i3c_hl_status_i2c_xfererror         : sprintf(errstring, "ERR_I2C_FAILED(%d)", (uint32_t)errcode); break;
+		case i3c_hl_status_batch_skipped         : sprintf(errstring, "ERR_SKIPPED(%d)", (uint32_t)errcode); break;
 		default:
 			sprintf(errstring, "ERR_UNDEFINED(%d)", (uint32_t)errcode); 
 			break;
@@ -1041,105 +1795,230 @@ const char     *i3c_hl_get_errorstring(i3c_hl_status_t errcode)
 // at first it checks if there was an unhandled Arbitration time interrupt raised.
 //    If so, it handles it by reading IBI/HJ code
 // If not, it checks if START assertion type IBI/HJ was raised and handles it by reading IBI/HJ code
-i3c_hl_status_t __not_in_flash_func(i3c_hl_poll)(uint8_t *pdat, uint32_t *plen)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_poll)(i3c_hl_bus_t *pbus, uint8_t *pdat, uint32_t *plen)
 {
+	uint32_t tstart_us = time_us_32();
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 	uint32_t maxlen = *plen;
 	*plen = 0;
-	if (i3c_hl_arbcode != 0xfc) // last i3c transfer created an arbitration case => IBI type 2 occured
+	i3c_pio_ensure_sdr(pbus);
+	if (pbus->arbcode != 0xfc) // last i3c transfer created an arbitration case => IBI type 2 occured
 	{ // IBI - read bytes in SDR mode until end is signalled
-		bool done = false;
-		if (plen > 0)
-		{
-			*pdat++ = i3c_hl_arbcode;
-			*plen = *plen + 1;
-		}
-s_i3c_program_sdr_overlay_sm(true);
-
-		while ( (maxlen--) && (!done) )
+		if (maxlen > 0)
 		{
-			uint32_t value;
-			value = i3c_sdr_read(maxlen==0);
-			done = !(value & 1);
-			*pdat++ = value >>1;
+			*pdat++ = pbus->arbcode;
 			*plen = *plen + 1;
+			maxlen--;
 		}
-s_i3c_program_sdr_overlay_sm(false);
-		i3c_stop();
-		i3c_hl_arbcode = 0xfc;
+		*plen = *plen + i3c_sdr_read_bytes(pbus, pdat, i3c_hl_device_ibi_maxlen(pbus, pbus->arbcode >> 1, maxlen));
+		i3c_stop(pbus);
+		pbus->arbcode = 0xfc;
 	}
-	else if (i3c_ibi_type1_check())   // check if interrupt is asserted by target (SDA=0)
+	else if (i3c_ibi_type1_check(pbus))   // check if interrupt is asserted by target (SDA=0)
 	{ // read IBI in OD mode
-		uint8_t ibiword = i3c_od_read(1); // read and ACK
-s_i3c_program_sdr_overlay_sm(true);
-		if (plen > 0)
+		uint8_t ibiword = i3c_od_read(pbus, 1); // read and ACK
+		if (maxlen > 0)
 		{
 			*pdat++ = ibiword;
 			*plen = *plen + 1;
+			maxlen--;
 		}
 		if (ibiword == 0x04) // hotjoin request (0x02 with R/W 0), no further words to read afterwards
 		{
 		}
 		else
 		{ // IBI - read bytes in SDR mode until end is signalled
-			bool done = false;
-			while ( (maxlen--) && (!done) )
-			{
-				uint32_t value;
-				value = i3c_sdr_read(maxlen==0);
-				done = !(value & 1);
-				*pdat++ = value >>1;
-				*plen = *plen + 1;
-			}
+			*plen = *plen + i3c_sdr_read_bytes(pbus, pdat, i3c_hl_device_ibi_maxlen(pbus, ibiword >> 1, maxlen));
 		}
-s_i3c_program_sdr_overlay_sm(false);
-		i3c_stop();
+		i3c_stop(pbus);
 	}
 	else
 	{
 		retcode = i3c_hl_status_no_ibi;
 	}
+	if (retcode == i3c_hl_status_ok)
+		i3c_hl_stats_record(pbus, i3c_hl_stats_ibi, retcode, *plen, tstart_us);
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_enthdr0)(void)
+i3c_hl_status_t __not_in_flash_func(i3c_hl_enthdr0)(i3c_hl_bus_t *pbus)
 {
 	uint8_t dat;
 	dat = 0x7e;
-	return i3c_hl_sdr_ccc_broadcast_write(&dat, 1);
+	return i3c_hl_sdr_ccc_broadcast_write(pbus, &dat, 1);
+}
+
+// returns true when the DDR state machine halted in target_nacked_halt (NACK or early termination request in DMA streaming mode)
+static inline bool __not_in_flash_func(i3c_ddr_is_halted)(i3c_hl_bus_t *pbus)
+{
+	return i3c_hal_read32(&pbus->smhw->addr) == i3c_ddr_offset_target_nacked_halt;
+}
+
+// Stream the command word, all data words and the CRC word of a DDR write by DMA. Precondition: DDR statemachine is 
+// active with autopush 19. cmddat and cmdparity contain the already prepared command word.
+// The preamble instructions which evaluate target ACK/NACK or early termination requests branch to target_nacked_halt.
+// On a halt the queued instruction words are flushed and the transfer continues like in the word by word mode.
+static i3c_hl_status_t __not_in_flash_func(i3c_ddr_write_dma)(i3c_hl_bus_t *pbus, uint32_t cmddat, uint32_t cmdparity, const uint16_t *pdat, uint32_t *pwordcount,
+                                                              bool ack_nack_enable, bool early_write_termination_enabled, bool send_crc_on_early_termination)
+{
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
+	uint32_t wordcount = *pwordcount;
+	const uint16_t *pdati = pdat;
+	uint32_t encoded = 0; // count of data words encoded so far
+	uint32_t bufidx = 0;
+	uint32_t pre_first, pre_next;
+	uint8_t  crc5_value = 0x1f<<3;
+	bool     halted = false;
+
+	// The first data word preamble phase can have an ACK/NACK phase, the following ones an early termination request phase
+	if (ack_nack_enable)
+		pre_first = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 0, 0, 18, i3c_ddr_offset_target_nacked_halt, i3c_ddr_offset_cmd_write_bits);
+	else
+		pre_first = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 1, 1, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
+	if (early_write_termination_enabled)
+		pre_next = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 0, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_target_nacked_halt);
+	else
+		pre_next = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 1, 1, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
+
+	// drain the results of command word and data words. The CRC word result (11 bits) stays below the autopush threshold
+	dma_channel_transfer_to_buffer_now(pbus->dma_channel_rx, &pbus->ddr_dma_rxdump, wordcount + 1);
+
+	do
+	{
+		uint32_t *pbuf = pbus->ddr_dma_buffer[bufidx];
+		uint32_t chunk = wordcount - encoded;
+
+		if (chunk > I3C_DDR_DMA_CHUNKSIZE)
+			chunk = I3C_DDR_DMA_CHUNKSIZE;
+		if (encoded == 0)
+		{ // command word
+			*pbuf++ = DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
+			*pbuf++ = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, (cmddat<<2) | cmdparity);
+			crc5_value = CRC5_CALCULATE(crc5_value, cmddat);
+		}
+		while (chunk--)
+		{
+			uint32_t dat = *pdati++;
+			*pbuf++ = (encoded == 0) ? pre_first : pre_next;
+			*pbuf++ = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, (dat<<2) | DDR_PARITY(dat));
+			crc5_value = CRC5_CALCULATE(crc5_value, dat);
+			encoded++;
+		}
+		if (encoded == wordcount)
+		{ // CRC word
+			*pbuf++ = DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 10, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
+			*pbuf++ = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 10, (((0xcul<<5) | (crc5_value>>3))<<1) | 1);
+		}
+		while ( dma_channel_is_busy(pbus->dma_channel_tx) && !halted )
+		{
+			halted = i3c_ddr_is_halted(pbus);
+		}
+		if (!halted)
+		{
+			dma_channel_transfer_from_buffer_now(pbus->dma_channel_tx, pbus->ddr_dma_buffer[bufidx], pbuf - pbus->ddr_dma_buffer[bufidx]);
+		}
+		bufidx ^= 1;
+	}
+	while ( (encoded < wordcount) && !halted );
+
+	// wait until all instruction words are streamed
+	while ( dma_channel_is_busy(pbus->dma_channel_tx) && !halted )
+	{
+		halted = i3c_ddr_is_halted(pbus);
+	}
+	// wait until the last instruction finished and the SM stalls at the instruction parser again
+	i3c_hal_write32(&pbus->pio->fdebug, pbus->fdebug_txstall);
+	while ( ((i3c_hal_read32(&pbus->pio->fdebug) & pbus->fdebug_txstall) == 0) && !halted )
+	{
+		halted = i3c_ddr_is_halted(pbus);
+	}
+
+	if (halted)
+	{
+		uint32_t written;
+
+		dma_channel_abort(pbus->dma_channel_tx);
+		// all results up to the halt are pushed already. Let the RX DMA collect them before evaluating its progress
+		while ( (i3c_hal_read32(&pbus->pio->fstat) & pbus->fstat_rxempty) == 0 )
+		{
+		}
+		dma_channel_abort(pbus->dma_channel_rx);
+		written = (wordcount + 1) - i3c_hal_read32(&dma_channel_hw_addr(pbus->dma_channel_rx)->transfer_count) - 1; // the command word result is not counted
+		// flush the queued instruction words by toggling FJOIN_RX and release the SM. target_nacked consumes the sync word 
+		// and returns a 1 in bit 0 like in word by word mode
+		i3c_hal_write32(&pbus->smhw->shiftctrl, i3c_hal_read32(&pbus->smhw->shiftctrl) ^ PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS);
+		i3c_hal_write32(&pbus->smhw->shiftctrl, i3c_hal_read32(&pbus->smhw->shiftctrl) ^ PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS);
+		i3c_hal_write32(&pbus->pio->irq_force, 1u << pbus->sm); // irq 0 relative to the state machine
+		i3c_pio_put32_no_check(pbus, DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, 0));
+		i3c_pio_get32(pbus);
+
+		*pwordcount = written;
+		if ( (written == 0) && ack_nack_enable )
+		{ // target did not ack
+			retcode = i3c_hl_status_nak_ddr;
+		}
+		else
+		{ // target did request early termination. The CRC was calculated over all words, so recalculate it for the words really sent
+			retcode = i3c_hl_status_ddr_early_termination;
+			if (send_crc_on_early_termination)
+			{
+				crc5_value = CRC5_CALCULATE(0x1f<<3, cmddat);
+				for (uint32_t i=0; i<written; i++)
+					crc5_value = CRC5_CALCULATE(crc5_value, pdat[i]);
+				i3c_pio_set_autopush_bitrev(pbus, 11);
+				i3c_pio_put32_no_check(pbus, DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 10, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits));
+				i3c_pio_put32_no_check(pbus, DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 10, (((0xcul<<5) | (crc5_value>>3))<<1) | 1));
+				i3c_pio_get32(pbus); // dump read data. This is just used as synchronization point
+			}
+		}
+	}
+	else
+	{
+		while (dma_channel_is_busy(pbus->dma_channel_rx))
+		{
+		}
+		i3c_hal_write32(&pbus->smhw->instr, pio_encode_mov(pio_isr, pio_null)); // discard the CRC word result
+	}
+	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_ddr_write)(uint8_t addr, uint8_t command, uint16_t *pdat, uint32_t *pwordcount, bool finalize_with_restart,
+i3c_hl_status_t __not_in_flash_func(i3c_hl_ddr_write)(i3c_hl_bus_t *pbus, uint8_t addr, uint8_t command, uint16_t *pdat, uint32_t *pwordcount, bool finalize_with_restart,
                                                       bool ack_nack_enable, bool early_write_termination_enabled, bool send_crc_on_early_termination)
 {
+	if (!i3c_hl_device_ddr_capable(pbus, addr)) // known to lack HDR-DDR, see device table
+	{
+		*pwordcount = 0;
+		return i3c_hl_status_param_outofrange;
+	}
+	uint32_t tstart_us = time_us_32();
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
 	uint32_t previntstate = save_and_disable_interrupts();
 
-	if ( !sm_is_in_ddr_mode )
+	if ( !pbus->sm_is_in_ddr_mode )
 	{
-		if (i3c_ibi_type1_check())
+		if (i3c_ibi_type1_check(pbus))
 		{
 			retcode = i3c_hl_status_ibi;
 		}
 		if (retcode == i3c_hl_status_ok)
 		{
-			i3c_start();
-			retcode = i3c_arbhdr(NULL);
+			i3c_start(pbus);
+			retcode = i3c_arbhdr(pbus, NULL);
 			if ( retcode == i3c_hl_status_ok )
 			{
-				i3c_sdr_write( 0x20 );
+				i3c_sdr_write(pbus, 0x20 );
 			}
 			if ( (retcode != i3c_hl_status_ibi) && (retcode != i3c_hl_status_ok) ) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
 			{
-				i3c_stop();
+				i3c_stop(pbus);
 			}
 		}
 	}
 
 	if (retcode == i3c_hl_status_ok) // no IBI arbitration happend and arbitration header was acknowledge, so lets transfer....
 	{
-		s_i3c_program_hdr_ddr_sm(); // switch to DDR PIO SM. No need to restart it, as the start sequence of PIO code where the PC is at that point of time  is identical
-		i3c_pio_set_autopush_bitrev(19);
+		i3c_pio_select(pbus, true); // hand the pins over to the DDR state machine, it waits in its first PULL instruction
+		i3c_pio_set_autopush_bitrev(pbus, 19);
 		uint8_t crc5_value = 0x1f<<3; // 0x1f is the initial value for CRC5 calculation
 		uint32_t cmd1, cmd2, parity, dat;
 		uint32_t retval; // PIO return values end up here
@@ -1155,143 +2034,293 @@ i3c_hl_status_t __not_in_flash_func(i3c_hl_ddr_write)(uint8_t addr, uint8_t comm
 			parity |= 1u;
 			dat ^= 1u;
 		}
-		// send write command
-		cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
-		cmd2 = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, dat<<2 | parity);
-		i3c_pio_put32_no_check( cmd1 );
-		i3c_pio_put32_no_check( cmd2 );
-		crc5_value = CRC5_CALCULATE(crc5_value, dat); // calculate crc5 during data transfer execution to make use of parallelism
-		i3c_pio_get32(); // dump read data. During command sending phase there is no ACK/NACK mechanism present in HDR-DDR mode. This is done during the NEXT preamble phase.
-
-		// send a data word(s)
-		uint16_t *pdati = pdat;
-		uint32_t wordcount, prev_crc5_value;
-		bool     early_termination = false;
-		for (wordcount=0; wordcount < *pwordcount; wordcount++)
+		if (pbus->ddr_dma_enabled)
 		{
-			dat = *pdati++; // get next data word
-			parity = ((uint32_t)__builtin_parity((dat & 0xaaaa)) << 1) |      // PA1 = D[15] ^ D[13] ^ D[11] ^ D[9] ^ D[7] ^ D[5] ^ D[3] ^ D[1]
-					 ((uint32_t)__builtin_parity((dat & 0x5555))  ^ 1);       // PA0 = D[14] ^ D[12] ^ D[10] ^ D[8] ^ D[6] ^ D[4] ^ D[2] ^ D[0] ^ 1 
-			if (wordcount == 0)
-			{ // The first data word preamble phase is handled conditional cause there is an optional ACK/NACK phase
-				if (ack_nack_enable)
-				{ // when DDR Write ack&nack is enabled, the target signals by PRE0 state if it acks or not (introduced as optional in V1.1 spec, likely to be enforced in V1.2 spec)
-					cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 0, 0, 18, i3c_ddr_offset_target_nacked, i3c_ddr_offset_cmd_write_bits);
-				}
-				else
-				{ // when ack&nack by target is not enabled, the CONTROLLER has to write PRE0 as 0. This was standard behavior in V1.0 spec
-					cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 1, 1, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
-				}
-			}
-			else
-			{ // for following data words the preamble phase can optionally signal target early request
-				if (early_write_termination_enabled)
-				{ // when DDR Write early termination is enabled, the target signals by PRE0 state if it wants to abort (introduced as optional in V1.1 spec, likely to be enforced in V1.2 spec)
-					cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 0, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_target_nacked);
-				}
-				else
-				{ // when DDR Write early write termination is disabled, the target cannot signal early abort (default V1.0 behavior)
-					cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 1, 1, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
-				}
-			}
-			cmd2 = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, (dat<<2) | parity);
-			i3c_pio_put32_no_check(cmd1);
-			i3c_pio_put32_no_check(cmd2);
-			prev_crc5_value = crc5_value; //  store previous crc value to be able to use the correct crc value in case of early termination
+			retcode = i3c_ddr_write_dma(pbus, dat, parity, pdat, pwordcount, ack_nack_enable, early_write_termination_enabled, send_crc_on_early_termination);
+		}
+		else
+		{
+			// send write command
+			cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
+			cmd2 = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, dat<<2 | parity);
+			i3c_pio_put32_no_check(pbus, cmd1 );
+			i3c_pio_put32_no_check(pbus, cmd2 );
 			crc5_value = CRC5_CALCULATE(crc5_value, dat); // calculate crc5 during data transfer execution to make use of parallelism
-			retval = i3c_pio_get32(); // dump read data. This is used as synchronization point to enable SM replacement in next step
-			if (retval & 1) // on a successful transfer bit 0 is 0. If bit 1 is 0 then the target_nacked path was taken, which means the transfer stopped after preamble phase
+			i3c_pio_get32(pbus); // dump read data. During command sending phase there is no ACK/NACK mechanism present in HDR-DDR mode. This is done during the NEXT preamble phase.
+
+			// send a data word(s)
+			uint16_t *pdati = pdat;
+			uint32_t wordcount, prev_crc5_value;
+			bool     early_termination = false;
+			for (wordcount=0; wordcount < *pwordcount; wordcount++)
 			{
+				dat = *pdati++; // get next data word
+				parity = ((uint32_t)__builtin_parity((dat & 0xaaaa)) << 1) |      // PA1 = D[15] ^ D[13] ^ D[11] ^ D[9] ^ D[7] ^ D[5] ^ D[3] ^ D[1]
+						 ((uint32_t)__builtin_parity((dat & 0x5555))  ^ 1);       // PA0 = D[14] ^ D[12] ^ D[10] ^ D[8] ^ D[6] ^ D[4] ^ D[2] ^ D[0] ^ 1 
 				if (wordcount == 0)
-				{ // target did not ack
-					retcode == i3c_hl_status_nak_ddr;
-					break; // I'm not fan of break statements, but sometimes they are nice and this is no automotive qualified code at the end...
+				{ // The first data word preamble phase is handled conditional cause there is an optional ACK/NACK phase
+					if (ack_nack_enable)
+					{ // when DDR Write ack&nack is enabled, the target signals by PRE0 state if it acks or not (introduced as optional in V1.1 spec, likely to be enforced in V1.2 spec)
+						cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 0, 0, 18, i3c_ddr_offset_target_nacked, i3c_ddr_offset_cmd_write_bits);
+					}
+					else
+					{ // when ack&nack by target is not enabled, the CONTROLLER has to write PRE0 as 0. This was standard behavior in V1.0 spec
+						cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 1, 1, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
+					}
 				}
 				else
-				{ // target did request early termination
-					retcode == i3c_hl_status_ddr_early_termination;
-					crc5_value = prev_crc5_value; // The last datavalue was not really sent on the bus, so restore the previous CRC value
-					early_termination = true; // on early termination we might want to suppress the CRC phase as passed to this function
-					break;
+				{ // for following data words the preamble phase can optionally signal target early request
+					if (early_write_termination_enabled)
+					{ // when DDR Write early termination is enabled, the target signals by PRE0 state if it wants to abort (introduced as optional in V1.1 spec, likely to be enforced in V1.2 spec)
+						cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 0, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_target_nacked);
+					}
+					else
+					{ // when DDR Write early write termination is disabled, the target cannot signal early abort (default V1.0 behavior)
+						cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 1, 1, 0, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
+					}
+				}
+				cmd2 = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, (dat<<2) | parity);
+				i3c_pio_put32_no_check(pbus, cmd1);
+				i3c_pio_put32_no_check(pbus, cmd2);
+				prev_crc5_value = crc5_value; //  store previous crc value to be able to use the correct crc value in case of early termination
+				crc5_value = CRC5_CALCULATE(crc5_value, dat); // calculate crc5 during data transfer execution to make use of parallelism
+				retval = i3c_pio_get32(pbus); // dump read data. This is used as synchronization point to enable SM replacement in next step
+				if (retval & 1) // on a successful transfer bit 0 is 0. If bit 1 is 0 then the target_nacked path was taken, which means the transfer stopped after preamble phase
+				{
+					if (wordcount == 0)
+					{ // target did not ack
+						retcode = i3c_hl_status_nak_ddr;
+						break; // I'm not fan of break statements, but sometimes they are nice and this is no automotive qualified code at the end...
+					}
+					else
+					{ // target did request early termination
+						retcode = i3c_hl_status_ddr_early_termination;
+						crc5_value = prev_crc5_value; // The last datavalue was not really sent on the bus, so restore the previous CRC value
+						early_termination = true; // on early termination we might want to suppress the CRC phase as passed to this function
+						break;
+					}
 				}
 			}
-		}
-		*pwordcount = wordcount; // update to callee the count of actual written words
+			*pwordcount = wordcount; // update to callee the count of actual written words
 
-		if (retcode != i3c_hl_status_nak_ddr)
-		{ // don't send CRC word in case the target did not ACK
-			// don't send CRC word in case early termination is enabled and sending CRC on early termination is disabled.
-			if ( !(early_termination && !send_crc_on_early_termination) )
-			{
-				i3c_pio_set_autopush_bitrev(11);
-				cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 10, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
-				cmd2 = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 10, (((0xcul<<5) | (crc5_value>>3))<<1) | 1);
-				i3c_pio_put32_no_check(cmd1);
-				i3c_pio_put32_no_check(cmd2);
-				i3c_pio_get32(); // dump read data. This is just used as synchronization point
+			if (retcode != i3c_hl_status_nak_ddr)
+			{ // don't send CRC word in case the target did not ACK
+				// don't send CRC word in case early termination is enabled and sending CRC on early termination is disabled.
+				if ( !(early_termination && !send_crc_on_early_termination) )
+				{
+					i3c_pio_set_autopush_bitrev(pbus, 11);
+					cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 10, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
+					cmd2 = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 10, (((0xcul<<5) | (crc5_value>>3))<<1) | 1);
+					i3c_pio_put32_no_check(pbus, cmd1);
+					i3c_pio_put32_no_check(pbus, cmd2);
+					i3c_pio_get32(pbus); // dump read data. This is just used as synchronization point
+				}
 			}
 		}
 
-
 		// In case no transfer error occured and a request came to finalize with a HDR-restart condition, we'll do so. This allows concatenation of 
 		// transfers without SDR phase in between.
 		if ( (retcode == i3c_hl_status_ok) && finalize_with_restart )
 		{
 			// generate HDR Exit pattern
-			i3c_pio_put32_no_check(DDR_OPCODE_SDA_DIR(1)); // set SDA to output
-			i3c_pio_put32_no_check(DDR_OPCODE_SDA_PATTERN(5, 0x15)); // create 1 0 1 0 1 pattern on SDA
-			i3c_pio_put32_no_check(DDR_OPCODE_SCL1);
-			i3c_pio_put32_no_check(DDR_OPCODE_SCL0);
-			i3c_pio_put32(DDR_OPCODE_SDA_DIR(0)); // release SDA (open drain). Note: SDA state is still 0 which is important for any following I3C start condition
-			i3c_pio_wait_tx_empty();
-			while (pio0->sm[1].addr != 0); // wait until last instruction is finished processing and stay then in ddr mode
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SDA_DIR(1)); // set SDA to output
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SDA_PATTERN(5, 0x15)); // create 1 0 1 0 1 pattern on SDA
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SCL1);
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SCL0);
+			i3c_pio_put32(pbus, DDR_OPCODE_SDA_DIR(0)); // release SDA (open drain). Note: SDA state is still 0 which is important for any following I3C start condition
+			i3c_pio_wait_tx_empty(pbus);
+			while (i3c_hal_read32(&pbus->smhw->addr) != 0); // wait until last instruction is finished processing and stay then in ddr mode
 		}
 		else
 		{
 			// generate HDR Exit pattern
-			i3c_pio_put32_no_check(DDR_OPCODE_SDA_DIR(1)); // set SDA to output
-			i3c_pio_put32_no_check(DDR_OPCODE_SDA_PATTERN(8, 0xaa)); // create 1 0 1 0 1 0 1 0 pattern on SDA
-			i3c_pio_put32_no_check(DDR_OPCODE_SCL0_WAIT7); // ensure that SDA is detected low at i2c targets spike filter outputs for proper STOP condition detection
-			i3c_pio_put32_no_check(DDR_OPCODE_SCL1_WAIT7); // wait a bit until SDA is released
-			i3c_pio_put32(DDR_OPCODE_SDA_DIR(0)); // release SDA (open drain). Note: SDA state is still 0 which is important for any following I3C start condition
-			i3c_pio_wait_tx_empty();
-			while (pio0->sm[1].addr != 0); // wait until last instruction is finished processing
-			s_i3c_program_hdr_sdr_sm(); // back to SDR statemachine
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SDA_DIR(1)); // set SDA to output
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SDA_PATTERN(8, 0xaa)); // create 1 0 1 0 1 0 1 0 pattern on SDA
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SCL0_WAIT7); // ensure that SDA is detected low at i2c targets spike filter outputs for proper STOP condition detection
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SCL1_WAIT7); // wait a bit until SDA is released
+			i3c_pio_put32(pbus, DDR_OPCODE_SDA_DIR(0)); // release SDA (open drain). Note: SDA state is still 0 which is important for any following I3C start condition
+			i3c_pio_wait_tx_empty(pbus);
+			while (i3c_hal_read32(&pbus->smhw->addr) != 0); // wait until last instruction is finished processing
+			i3c_pio_select(pbus, false); // back to SDR statemachine
 		}
 
 	}
 
+	i3c_hl_stats_record(pbus, i3c_hl_stats_ddr_write, retcode, *pwordcount, tstart_us);
 	restore_interrupts(previntstate);
 	return retcode;
 }
 
-i3c_hl_status_t __not_in_flash_func(i3c_hl_ddr_read)(uint8_t addr, uint8_t command, uint16_t *pdat, uint32_t *pwordcount, bool finalize_with_restart, bool read_crc_on_early_termination)
+// checks the parity bits of a cmd_read_word result: Bit 18..3 data, bit 2 PA1, bit 1 PA0. Folding the bits down keeps
+// odd and even bit positions apart, PA1 has to give an even parity over the odd data bits, PA0 an odd one over the even bits.
+static inline bool __not_in_flash_func(i3c_ddr_read_word_parity_ok)(uint32_t pioretval)
+{
+	uint32_t v = (pioretval >> 1) & 0x3fffful;
+	v ^= v >> 16;
+	v ^= v >> 8;
+	v ^= v >> 4;
+	v ^= v >> 2;
+	return (v & 3u) == 1u;
+}
+
+// Clock 12 bits in from the target starting with a new preamble. Used for CRC words. The result is 13 bits with
+// the preamble in bit 12..11 and the CRC in bit 6..2
+static inline uint32_t __not_in_flash_func(i3c_ddr_read_crc_word)(i3c_hl_bus_t *pbus)
+{
+	i3c_pio_set_autopush_bitrev(pbus, 13);
+	i3c_pio_put32_no_check(pbus, DDR_OPCODE_SET_X(5));
+	i3c_pio_put32_no_check(pbus, DDR_HDR_OPCODE_READ_NEXTBIT);
+	return i3c_pio_get32(pbus);
+}
+
+// Stream the data words 2..n of a DDR read. The state machine decides on the preamble itself if a data word (PRE1 = 1) follows 
+// or halts in target_nacked_halt when the target sends its CRC word (PRE1 = 0). Data words are streamed back to back without 
+// any CPU interaction on the bus. Precondition: DDR statemachine active and idle, SDA in input state.
+// On return *pwordcount contains the number of data words received, *pcrc_received signals that the target ended the transfer by a CRC word.
+static i3c_hl_status_t __not_in_flash_func(i3c_ddr_read_dma)(i3c_hl_bus_t *pbus, uint16_t *pdat, uint32_t *pwordcount, uint8_t *pcrc5_value, bool *pcrc_received)
+{
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
+	uint32_t wordcount = *pwordcount;
+	uint32_t received = 0;
+	uint8_t  crc5_value = *pcrc5_value;
+	bool     halted = false;
+	bool     done = false;
+	dma_channel_config txcfg = dma_get_channel_config(pbus->dma_channel_tx);
+	dma_channel_config rxcfg = dma_get_channel_config(pbus->dma_channel_rx);
+	dma_channel_config cfg;
+
+	// TX repeats the same instruction word, RX writes into the ring
+	cfg = txcfg;
+	channel_config_set_read_increment(&cfg, false);
+	dma_channel_set_config(pbus->dma_channel_tx, &cfg, false);
+	cfg = rxcfg;
+	channel_config_set_write_increment(&cfg, true);
+	channel_config_set_ring(&cfg, true, I3C_DDR_DMA_RXRING_BITS);
+	dma_channel_set_config(pbus->dma_channel_rx, &cfg, false);
+
+	i3c_pio_set_autopush_bitrev(pbus, 21);
+	dma_channel_transfer_to_buffer_now(pbus->dma_channel_rx, pbus->ddr_dma_rxring, wordcount);
+	dma_channel_transfer_from_buffer_now(pbus->dma_channel_tx, &i3c_ddr_read_word_opcode, wordcount);
+
+	while (!done)
+	{
+		// the write address points to the next ring entry the DMA will write
+		uint32_t widx = (uint32_t)((volatile uint32_t *)i3c_hal_dma_get_write_addr(pbus->dma_channel_rx) - pbus->ddr_dma_rxring);
+
+		done = halted;
+		while ( ((received % count_of(pbus->ddr_dma_rxring)) != widx) && (received < wordcount) )
+		{
+			uint32_t pioretval = pbus->ddr_dma_rxring[received % count_of(pbus->ddr_dma_rxring)];
+			uint16_t dat = (uint16_t)(pioretval >> 3);
+
+			if ( (pioretval >> 19) != 3 )
+			{ // PRE1 is 1, so PRE0 was sensed 0 -> invalid preamble
+				retcode = i3c_hl_status_ddr_invalid_preamble;
+				break;
+			}
+			*pdat++ = dat;
+			received++;
+			crc5_value = CRC5_CALCULATE(crc5_value, dat); // Update crc5 with latest dataword
+			if (!i3c_ddr_read_word_parity_ok(pioretval))
+			{
+				retcode = i3c_hl_status_ddr_parity_wrong;
+				break;
+			}
+		}
+		if ( (received == wordcount) || (retcode != i3c_hl_status_ok) )
+		{
+			break;
+		}
+		if (!halted && i3c_ddr_is_halted(pbus))
+		{ // all results up to the halt are pushed already. Let the RX DMA collect them and evaluate them in one more pass
+			halted = true;
+			dma_channel_abort(pbus->dma_channel_tx);
+			while ( (i3c_hal_read32(&pbus->pio->fstat) & pbus->fstat_rxempty) == 0 )
+			{
+			}
+			dma_channel_abort(pbus->dma_channel_rx);
+		}
+	}
+
+	if (retcode != i3c_hl_status_ok)
+	{ // stop streaming. The SM finishes the already queued instruction words (their data gets dropped) or halts on a CRC word
+		dma_channel_abort(pbus->dma_channel_tx);
+		i3c_hal_write32(&pbus->pio->fdebug, pbus->fdebug_txstall);
+		while ( ((i3c_hal_read32(&pbus->pio->fdebug) & pbus->fdebug_txstall) == 0) && !halted )
+		{
+			halted = i3c_ddr_is_halted(pbus);
+		}
+		dma_channel_abort(pbus->dma_channel_rx);
+	}
+	dma_channel_set_config(pbus->dma_channel_tx, &txcfg, false);
+	dma_channel_set_config(pbus->dma_channel_rx, &rxcfg, false);
+
+	// flush queued instruction words and unused results
+	i3c_hal_write32(&pbus->smhw->shiftctrl, i3c_hal_read32(&pbus->smhw->shiftctrl) ^ PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS);
+	i3c_hal_write32(&pbus->smhw->shiftctrl, i3c_hal_read32(&pbus->smhw->shiftctrl) ^ PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS);
+	i3c_pio_set_autopush_bitrev(pbus, 19);
+	if (halted)
+	{ // release the SM. target_nacked consumes the sync word, afterwards the CRC word is clocked in
+		i3c_hal_write32(&pbus->pio->irq_force, 1u << pbus->sm); // irq 0 relative to the state machine
+		i3c_pio_put32_no_check(pbus, DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(0, 18, 0));
+		i3c_pio_get32(pbus);
+		if (retcode == i3c_hl_status_ok)
+		{
+			uint32_t pioretval = i3c_ddr_read_crc_word(pbus);
+			if ( (pioretval >> (1+10)) != 1 )
+			{ // preamble 00
+				retcode = i3c_hl_status_ddr_invalid_preamble;
+			}
+			else
+			{ // check if CRC is correct. If not -> raise an error. Note that the data is still written to the receive buffer.
+				*pcrc_received = true;
+				if ( (crc5_value>>3) != ((pioretval>>2) & 0x1f) )
+				{
+					retcode = i3c_hl_status_ddr_crc_wrong;
+				}
+			}
+			i3c_pio_set_autopush_bitrev(pbus, 19);
+		}
+	}
+
+	*pwordcount = received;
+	*pcrc5_value = crc5_value;
+	return retcode;
+}
+
+i3c_hl_status_t __not_in_flash_func(i3c_hl_ddr_read)(i3c_hl_bus_t *pbus, uint8_t addr, uint8_t command, uint16_t *pdat, uint32_t *pwordcount, bool finalize_with_restart, bool read_crc_on_early_termination)
 {
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
-	uint32_t previntstate = save_and_disable_interrupts();
 
 	if (0 == *pwordcount) // defensive programming, I am proud of myself...
 	{
 		return i3c_hl_status_param_outofrange; // ...and my proudness fades away cause I return before the end of the function body :-)
 	}
+	if (!i3c_hl_device_ddr_capable(pbus, addr)) // known to lack HDR-DDR, see device table
+	{
+		*pwordcount = 0;
+		return i3c_hl_status_param_outofrange;
+	}
+	uint32_t tstart_us = time_us_32();
+	uint32_t previntstate = save_and_disable_interrupts();
 
-	if ( !sm_is_in_ddr_mode )
+	if ( !pbus->sm_is_in_ddr_mode )
 	{
-		if (i3c_ibi_type1_check())
+		if (i3c_ibi_type1_check(pbus))
 		{
 			retcode = i3c_hl_status_ibi;
 		}
 		if (retcode == i3c_hl_status_ok)
 		{
-			i3c_start();
-			retcode = i3c_arbhdr(NULL);
+			i3c_start(pbus);
+			retcode = i3c_arbhdr(pbus, NULL);
 			if ( retcode == i3c_hl_status_ok )
 			{
-				i3c_sdr_write( 0x20 );
+				i3c_sdr_write(pbus, 0x20 );
 			}
 			if ( (retcode != i3c_hl_status_ibi) && (retcode != i3c_hl_status_ok) ) // on a IBI getting received, don't terminate the transfer -> it has to be handled by i3c_poll function
 			{
-				i3c_stop();
+				i3c_stop(pbus);
 			}
 		}
 	}
@@ -1299,8 +2328,8 @@ i3c_hl_status_t __not_in_flash_func(i3c_hl_ddr_read)(uint8_t addr, uint8_t comma
 	if (retcode == i3c_hl_status_ok)
 	{ // let's talk HDR-DDR
 		uint32_t wordcount = *pwordcount;
-		s_i3c_program_hdr_ddr_sm(); // switch to DDR PIO SM. No need to restart it, as the start sequence of PIO code where the PC is at that point of time  is identical
-		i3c_pio_set_autopush_bitrev(19);
+		i3c_pio_select(pbus, true); // hand the pins over to the DDR state machine, it waits in its first PULL instruction
+		i3c_pio_set_autopush_bitrev(pbus, 19);
 
 		uint32_t cmd1, cmd2, cmd3, cmd4, parity;
 		uint16_t dat;
@@ -1320,19 +2349,19 @@ i3c_hl_status_t __not_in_flash_func(i3c_hl_ddr_read)(uint8_t addr, uint8_t comma
 		}
 		cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(1, 0, 1, 1, 18, i3c_ddr_offset_cmd_write_bits, i3c_ddr_offset_cmd_write_bits);
 		cmd2 = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(1, 18, ((uint32_t)dat<<2) | parity);
-		i3c_pio_put32_no_check(cmd1);
-		i3c_pio_put32_no_check(cmd2);
+		i3c_pio_put32_no_check(pbus, cmd1);
+		i3c_pio_put32_no_check(pbus, cmd2);
 		crc5_value = CRC5_CALCULATE(crc5_value, dat); // calculate crc5 during data transfer execution to make use of parallelism
 		//printf("%x %x\r\n", dat, crc5_value);
-		i3c_pio_get32(); // dump read data. This is used as synchronization point only
+		i3c_pio_get32(pbus); // dump read data. This is used as synchronization point only
 
 		// read first word This one is special, because the target acknowledges during its preamble phase
 		uint32_t pioretval;
 		cmd1 = DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 0, 0, 18, i3c_ddr_offset_target_nacked, i3c_ddr_offset_cmd_write_bits);
 		cmd2 = DDR_HDR_OPCODE_WRITE_BITS_NOOPCODE(0, 18, 0x00000);
-		i3c_pio_put32_no_check(cmd1);
-		i3c_pio_put32_no_check(cmd2);
-		pioretval = i3c_pio_get32(); // dump read data. This is used as synchronization point to enable SM replacement in next step
+		i3c_pio_put32_no_check(pbus, cmd1);
+		i3c_pio_put32_no_check(pbus, cmd2);
+		pioretval = i3c_pio_get32(pbus); // dump read data. This is used as synchronization point to enable SM replacement in next step
 		dat = (uint16_t)(pioretval >> 3);
 		wordcount = 0;
 		if (pioretval & 1)
@@ -1346,87 +2375,43 @@ i3c_hl_status_t __not_in_flash_func(i3c_hl_ddr_read)(uint8_t addr, uint8_t comma
 			crc5_value = CRC5_CALCULATE(crc5_value, dat); // update crc5 with latest dataword
 			// check Parity bits
 			if ( ((pioretval>>1) & 3) != DDR_PARITY(dat) )
-			{
 				retcode = i3c_hl_status_ddr_parity_wrong;
-				printf("dat: %d pioretval: %d calculated_parity: %d\r\n", dat, pioretval, DDR_PARITY(dat));
-			}
 		}
 
 		if (retcode == i3c_hl_status_ok)
-		{ // read the (potential) rest of the data words word by word...
+		{ // read the (potential) rest of the data words
 			bool crc_received = false;     // Set to true in case the target returned a crc value during read. This happens when more words are read as the target can return
 			bool early_terminated = false; // Set to true in case the controller executed an early termination action.
-			uint8_t preamble_value;        // This will receive the preamble value
-			
-			cmd1 = DDR_HDR_OPCODE_READ_BITS(12); // Prepare for reading 12 Bits. This is the first part of a transfer where we don't know if its a CRC or data word.
-			cmd2 = DDR_HDR_OPCODE_READ_BITS(8);  // Read another 8 bits in case we know a data word is to be received.
-
-			for (wordcount=1; wordcount < *pwordcount; wordcount++)
-			{ // During this inner look no early termination has to be signalled by controller. There are only 2 cases the target will signal: Either CRC is received or Data.
-				// as we don't know if the target sends a CRC or data, we first make the worst case assumption in terms 
-				// of data length, which is CRC with its 10 bits.
-				// After those 12 bits are received, we check the preamble. 
-				//	 If it is 01 a CRC word was sent and we stop.
-				//   If it is 11 a Data word is being send and we transfer 8 more bits. Unfortunately this scheme creates a timing gap 
-				//   during data word reading, but we live for it for now until I am more motivated to improve it.
-				i3c_pio_set_autopush_bitrev(13);
-				i3c_pio_put32_no_check(cmd1);
-				pioretval = i3c_pio_get32();      // dump read data. This is used as synchronization point to enable SM replacement in next step
-				preamble_value = (pioretval >> (1+10)); // 01 in case of CRC, 11 in case of data word, other values: report error
-				if (preamble_value == 3)
-				{ // we need to transfer 8 more bits
-					i3c_pio_set_autopush_bitrev(9);
-					i3c_pio_put32_no_check(cmd2);
-					dat = ((uint16_t)pioretval<<5) & 0xffc0;   // The 10 lower bits of pioretval contain the 10 MSBs of the read data word
-					pioretval = i3c_pio_get32();               // Dump read data. This is used as synchronization point to enable SM replacement in next step
-					dat |= (uint16_t)pioretval>>3;             // Complement the last 6 missing bits. The 2 skipped bits are the parity
-					*pdat++ = dat;
-					crc5_value = CRC5_CALCULATE(crc5_value, dat); // Update crc5 with latest dataword
-					// check Parity bits
-					if ( ((pioretval>>1) & 3) != DDR_PARITY(dat) )
-					{
-						retcode = i3c_hl_status_ddr_parity_wrong;
-						break;
-					}
-				}
-				else if (preamble_value == 1)
-				{ // CRC received, no further transfer requred
-					crc_received = true;
-					// check if CRC is correct. If not -> raise an error. Note that the data is still written to the receive buffer.
-					if ( (crc5_value>>3) != ((pioretval>>2) & 0x1f) )
-					{
-						retcode == i3c_hl_status_ddr_crc_wrong;
-					}
-					break;
-				}
-				else
-				{ // we received an invalid preamble, e.g. 00 or 10 -> raise an error and go to HDR EXIT phase...
-					retcode = i3c_hl_status_ddr_invalid_preamble;
-					break;
-				}
+			if (*pwordcount > 1)
+			{ // stream the remaining data words. The state machine evaluates each preamble itself: it either receives a full data
+			  // word or stops on a CRC word sent by the target.
+				uint32_t streamed = *pwordcount - 1;
+				retcode = i3c_ddr_read_dma(pbus, pdat, &streamed, &crc5_value, &crc_received);
+				wordcount += streamed;
 			}
 
 			// TODO: Check if early abortion is required and if so ... do it by transmitting the 2 magic bits...
 			// Early termination is required when no CRC was received in previous phase OR
 			// a Parity or CRC error occured
 			if ( ((retcode == i3c_hl_status_ok) && (!crc_received)) ||
-			     (retcode == i3c_hl_status_ddr_invalid_preamble) || (retcode == i3c_hl_status_ddr_crc_wrong) )
+			     (retcode == i3c_hl_status_ddr_invalid_preamble) || (retcode == i3c_hl_status_ddr_parity_wrong) ||
+			     (retcode == i3c_hl_status_ddr_crc_wrong) )
 			 
 			{ // let's terminate "early" -> This means transmitting 2 preamble bits with state 10 as binary value. Only the 0 is actively driven by controller
-				i3c_pio_put32_no_check( DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 1, 0, 18, i3c_ddr_offset_target_nacked, i3c_ddr_offset_target_nacked) );
-				i3c_pio_put32_no_check(0x00000000ul);
-				pioretval = i3c_pio_get32(); // dump read data. This is used as synchronization point to enable SM replacement in next step
+				i3c_pio_put32_no_check(pbus, DDR_HDR_OPCODE_WRITE_PREAMBLE(0, 0, 1, 0, 18, i3c_ddr_offset_target_nacked, i3c_ddr_offset_target_nacked) );
+				i3c_pio_put32_no_check(pbus, 0x00000000ul);
+				pioretval = i3c_pio_get32(pbus); // dump read data. This is used as synchronization point to enable SM replacement in next step
 
 				// If the target supports CRC transmission after early termination AND the reason of the early termination was no error...
 				// ...let's read the CRC and check it
 				if  ( (retcode == i3c_hl_status_ok) && (read_crc_on_early_termination) )
-				{
-					i3c_pio_set_autopush_bitrev(13);
-					i3c_pio_put32_no_check(cmd1);
-					pioretval = i3c_pio_get32();      // dump read data. This is used as synchronization point to enable SM replacement in next step
+				{ // the termination preamble leaves SDA driven low, release it for the CRC word of the target
+					i3c_pio_put32_no_check(pbus, DDR_OPCODE_SDA_DIR(0));
+					pioretval = i3c_ddr_read_crc_word(pbus);
+					i3c_pio_set_autopush_bitrev(pbus, 19);
 					if ( (crc5_value>>3) != ((pioretval>>2) & 0x1f) )
 					{
-						retcode == i3c_hl_status_ddr_crc_wrong; // When we get here, it can also mean that the target does NOT support sending a CRC on early termination. For the V1.0 target I test this is the case. I suspect this feature got only introduced in >= V1.1 spec version
+						retcode = i3c_hl_status_ddr_crc_wrong; // When we get here, it can also mean that the target does NOT support sending a CRC on early termination. For the V1.0 target I test this is the case. I suspect this feature got only introduced in >= V1.1 spec version
 					}
 				}
 			}
@@ -1439,29 +2424,102 @@ i3c_hl_status_t __not_in_flash_func(i3c_hl_ddr_read)(uint8_t addr, uint8_t comma
 		if ( (retcode == i3c_hl_status_ok) && finalize_with_restart )
 		{
 			// generate HDR Exit pattern
-			i3c_pio_put32_no_check(DDR_OPCODE_SDA_DIR(1)); // set SDA to output
-			i3c_pio_put32_no_check(DDR_OPCODE_SDA_PATTERN(5, 0x15)); // create 1 0 1 0 pattern on SDA
-			i3c_pio_put32_no_check(DDR_OPCODE_SCL0);
-			i3c_pio_put32(DDR_OPCODE_SDA_DIR(0)); // release SDA (open drain). Note: SDA state is still 0 which is important for any following I3C start condition
-			i3c_pio_wait_tx_empty();
-			while (pio0->sm[1].addr != 0); // wait until last instruction is finished processing
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SDA_DIR(1)); // set SDA to output
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SDA_PATTERN(5, 0x15)); // create 1 0 1 0 pattern on SDA
+			i3c_pio_put32(pbus, DDR_OPCODE_SCL1); // the rising SCL edge completes the restart pattern
+			i3c_pio_put32(pbus, DDR_OPCODE_SCL0);
+			i3c_pio_put32(pbus, DDR_OPCODE_SDA_DIR(0)); // release SDA (open drain). Note: SDA state is still 0 which is important for any following I3C start condition
+			i3c_pio_wait_tx_empty(pbus);
+			while (i3c_hal_read32(&pbus->smhw->addr) != 0); // wait until last instruction is finished processing
 		}
 		else
 		{
 			// generate HDR Exit pattern
-			i3c_pio_put32_no_check(DDR_OPCODE_SDA_DIR(1)); // set SDA to output
-			i3c_pio_put32_no_check(DDR_OPCODE_SDA_PATTERN(8, 0xaa)); // create 1 0 1 0 1 0 1 0 pattern on SDA
-			i3c_pio_put32_no_check(DDR_OPCODE_SCL0_WAIT7); // ensure that SDA is detected low at i2c targets spike filter outputs for proper STOP condition detection
-			i3c_pio_put32_no_check(DDR_OPCODE_SCL1_WAIT7); // wait a bit until SDA is released
-			i3c_pio_put32(DDR_OPCODE_SDA_DIR(0)); // release SDA (open drain). Note: SDA state is still 0 which is important for any following I3C start condition
-			i3c_pio_wait_tx_empty();
-			while (pio0->sm[1].addr != 0); // wait until last instruction is finished processing
-			s_i3c_program_hdr_sdr_sm();
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SDA_DIR(1)); // set SDA to output
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SDA_PATTERN(8, 0xaa)); // create 1 0 1 0 1 0 1 0 pattern on SDA
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SCL0_WAIT7); // ensure that SDA is detected low at i2c targets spike filter outputs for proper STOP condition detection
+			i3c_pio_put32_no_check(pbus, DDR_OPCODE_SCL1_WAIT7); // wait a bit until SDA is released
+			i3c_pio_put32(pbus, DDR_OPCODE_SDA_DIR(0)); // release SDA (open drain). Note: SDA state is still 0 which is important for any following I3C start condition
+			i3c_pio_wait_tx_empty(pbus);
+			while (i3c_hal_read32(&pbus->smhw->addr) != 0); // wait until last instruction is finished processing
+			i3c_pio_select(pbus, false);
 		}
 
 
 	}
 
+	i3c_hl_stats_record(pbus, i3c_hl_stats_ddr_read, retcode, *pwordcount, tstart_us);
 	restore_interrupts(previntstate);
 	return retcode;
 }
+
+i3c_hl_status_t __not_in_flash_func(i3c_hl_batch_execute)(i3c_hl_bus_t *pbus, i3c_hl_batch_desc_t *pdesc, uint32_t count, uint32_t *pexecuted)
+{
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
+	uint32_t executed = 0;
+	bool stop = false;
+
+	for (uint32_t i=0; i<count; i++, pdesc++)
+	{
+		if (stop)
+		{
+			pdesc->status = i3c_hl_status_batch_skipped;
+			continue;
+		}
+		switch (pdesc->op)
+		{
+			case i3c_hl_batch_op_sdr_write:
+				pdesc->status = i3c_hl_sdr_privwrite(pbus, pdesc->addr, pdesc->pwritedat, pdesc->writecount);
+				break;
+			case i3c_hl_batch_op_sdr_read:
+				pdesc->status = i3c_hl_sdr_privread(pbus, pdesc->addr, pdesc->preaddat, &pdesc->readcount);
+				break;
+			case i3c_hl_batch_op_sdr_writeread:
+				pdesc->status = i3c_hl_sdr_privwriteread(pbus, pdesc->addr, pdesc->pwritedat, pdesc->writecount, pdesc->preaddat, &pdesc->readcount);
+				break;
+			case i3c_hl_batch_op_ccc_broadcast:
+				pdesc->status = i3c_hl_sdr_ccc_broadcast_write(pbus, pdesc->pwritedat, pdesc->writecount);
+				break;
+			case i3c_hl_batch_op_ccc_direct_write:
+				pdesc->status = i3c_hl_sdr_ccc_direct_write(pbus, pdesc->pwritedat, pdesc->writecount, pdesc->addr, pdesc->pdirectdat, pdesc->directcount);
+				break;
+			case i3c_hl_batch_op_ccc_direct_read:
+				pdesc->status = i3c_hl_sdr_ccc_direct_read(pbus, pdesc->pwritedat, pdesc->writecount, pdesc->addr, pdesc->preaddat, &pdesc->readcount);
+				break;
+			case i3c_hl_batch_op_ddr_write:
+				pdesc->status = i3c_hl_ddr_write(pbus, pdesc->addr, pdesc->cmd, (uint16_t *)pdesc->pwritedat, &pdesc->writecount,
+				                                 (pdesc->flags & I3C_HL_BATCH_FLAG_DDR_RESTART) != 0,
+				                                 (pdesc->flags & I3C_HL_BATCH_FLAG_DDR_ACK_NACK) != 0,
+				                                 (pdesc->flags & I3C_HL_BATCH_FLAG_DDR_EARLY_WRITE_TERM) != 0,
+				                                 (pdesc->flags & I3C_HL_BATCH_FLAG_DDR_CRC_ON_EARLY_TERM) != 0);
+				break;
+			case i3c_hl_batch_op_ddr_read:
+				pdesc->status = i3c_hl_ddr_read(pbus, pdesc->addr, pdesc->cmd, pdesc->preaddat, &pdesc->readcount,
+				                                (pdesc->flags & I3C_HL_BATCH_FLAG_DDR_RESTART) != 0,
+				                                (pdesc->flags & I3C_HL_BATCH_FLAG_DDR_CRC_ON_EARLY_TERM) != 0);
+				break;
+			case i3c_hl_batch_op_delay:
+				busy_wait_us_32(pdesc->delay_us);
+				pdesc->status = i3c_hl_status_ok;
+				break;
+			default:
+				pdesc->status = i3c_hl_status_param_outofrange;
+				break;
+		}
+		executed++;
+		if (pdesc->status != i3c_hl_status_ok)
+		{
+			if (retcode == i3c_hl_status_ok)
+			{
+				retcode = pdesc->status;
+			}
+			stop = (pdesc->flags & I3C_HL_BATCH_FLAG_STOP_ON_ERROR) != 0;
+		}
+	}
+
+	if (pexecuted)
+	{
+		*pexecuted = executed;
+	}
+	return retcode;
+}
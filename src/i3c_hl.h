@@ -42,35 +42,97 @@ typedef enum
     i3c_hl_status_ddr_parity_wrong,      // Incorrect HDR-CCC value received during HDR-DDR read transfer
     i3c_hl_status_ddr_crc_wrong,         // Incorrect CCC received during HDR-DDR read transfer
     i3c_hl_status_i2c_xfererror,         // Generic i2c transfer error (e.g. no Acknowledge or timeout)
+    i3c_hl_status_batch_skipped,         // batch descriptor was not executed because a previous descriptor failed with stop on error set
 } i3c_hl_status_t;
 
-i3c_hl_status_t i3c_init(uint8_t gpiobasepin);
+// Every I3C bus is an independent controller instance. Its SDR state machine runs in pio0, its HDR-DDR state machine
+// with the same number in pio1. Both programs stay loaded, entering and leaving HDR-DDR mode just hands the pins over.
+// Each bus uses 2 adjacent GPIOs: SDA = gpiobasepin, SCL = gpiobasepin + 1.
+// Buses don't share any state, so different buses can be used at the same time from different cores.
+#define I3C_HL_MAXBUS (4)
+
+typedef struct i3c_hl_bus i3c_hl_bus_t;
+
+// returns the context of bus index 0..I3C_HL_MAXBUS-1, NULL for an invalid index
+i3c_hl_bus_t   *i3c_hl_bus(uint8_t index);
+uint8_t         i3c_hl_bus_index(const i3c_hl_bus_t *pbus);
+bool            i3c_hl_bus_initialized(const i3c_hl_bus_t *pbus);
+uint8_t         i3c_hl_bus_sm(const i3c_hl_bus_t *pbus);
+uint8_t         i3c_hl_bus_gpiobasepin(const i3c_hl_bus_t *pbus);
+
+// bind a bus to state machine sm (0..3) of pio0 and pio1 and initialize it.
+// Can be called again on the same bus to re-initialize or to move it. Fails with i3c_hl_status_param_outofrange
+// when the state machine or the pins are used by another initialized bus.
+i3c_hl_status_t i3c_init(i3c_hl_bus_t *pbus, uint8_t sm, uint8_t gpiobasepin);
 const char     *i3c_hl_get_errorstring(i3c_hl_status_t errcode);
-i3c_hl_status_t i3c_hl_set_clkrate(uint32_t targetfreq_khz);
-i3c_hl_status_t i3c_hl_targetreset(void);
+i3c_hl_status_t i3c_hl_set_clkrate(i3c_hl_bus_t *pbus, uint32_t targetfreq_khz);
+uint32_t        i3c_hl_get_clkrate(const i3c_hl_bus_t *pbus); // as last set, 12500 after i3c_init
+i3c_hl_status_t i3c_hl_targetreset(i3c_hl_bus_t *pbus);
+
+i3c_hl_status_t i3c_hl_entdaa(i3c_hl_bus_t *pbus, uint8_t addr, uint8_t *pid);
+i3c_hl_status_t i3c_hl_rstdaa(i3c_hl_bus_t *pbus);
 
-i3c_hl_status_t i3c_hl_entdaa(uint8_t addr, uint8_t *pid);
-i3c_hl_status_t i3c_hl_rstdaa(void);
-i3c_hl_status_t i3c_hl_checkack(uint8_t addr);
-i3c_hl_status_t i3c_hl_arbhdronly(void); // send START, arbhdr, STOP only
+// Dynamic address assignment of all targets taking part in ENTDAA, within one ENTDAA CCC: after every assigned target a
+// repeated START with 0x7E/R lets the next one take part, until 0x7E/R is NAKed.
+// The addresses are taken in ascending order from the pool firstaddr..lastaddr, skipping the reserved addresses (0x00..0x07,
+// 0x7E and the ones differing from it in a single bit) and the ones set in pskip (optional 128 bit bitmap, bit n of
+// pskip[n/32] = address n is in use already). A target NAKing its address gets the same address again.
+// A target with a preferred address (see i3c_hl_daa_preferred) gets it instead, unless it is reserved, set in pskip or
+// assigned already. The pool skips the preferred addresses of all targets, so they stay free for their targets.
+// Returns i3c_hl_status_ok when all targets got an address, i3c_hl_status_param_outofrange when there were more targets
+// than addresses in the pool or than maxcount. *pcount returns the count of entries in pentries in any case.
+typedef struct
+{
+    uint8_t pid[6];  // provisioned ID, MSB first
+    uint8_t bcr;
+    uint8_t dcr;
+    uint8_t addr;    // assigned dynamic address
+} i3c_hl_daa_entry_t;
+
+i3c_hl_status_t i3c_hl_daa(i3c_hl_bus_t *pbus, uint8_t firstaddr, uint8_t lastaddr, const uint32_t *pskip,
+                           i3c_hl_daa_entry_t *pentries, uint32_t maxcount, uint32_t *pcount);
+// sets the preferred dynamic addresses of targets for i3c_hl_daa: pid and addr of count entries, bcr and dcr are not used.
+// The table is referenced, not copied. NULL or a count of 0 removes it
+void            i3c_hl_daa_preferred(i3c_hl_bus_t *pbus, const i3c_hl_daa_entry_t *pprefs, uint32_t count);
+i3c_hl_status_t i3c_hl_checkack(i3c_hl_bus_t *pbus, uint8_t addr);
+// address scan in one frame: START, 0x7E/W, then a repeated START with A/W for every address A except 0x7E and the
+// addresses differing from it in a single bit, STOP. Sets bit A of ppresent[A/32] (128 bit bitmap) for every
+// address which was ACKed. Ends with a wait for the bus free time derived from the clock rate, so SDA has settled
+// before the next transfer checks for IBIs. Fails with i3c_hl_status_ibi when a target raises an IBI first, an empty
+// bitmap with i3c_hl_status_ok when no target ACKs 0x7E
+i3c_hl_status_t i3c_hl_scan(i3c_hl_bus_t *pbus, uint32_t *ppresent);
+i3c_hl_status_t i3c_hl_arbhdronly(i3c_hl_bus_t *pbus); // send START, arbhdr, STOP only
 
 // check if interrupt or HJ request is raised
-i3c_hl_status_t i3c_hl_poll(uint8_t *pdat, uint32_t *plen);
+i3c_hl_status_t i3c_hl_poll(i3c_hl_bus_t *pbus, uint8_t *pdat, uint32_t *plen);
+
+// true when a IBI or HJ request is waiting to be read by i3c_hl_poll
+bool i3c_hl_ibi_pending(i3c_hl_bus_t *pbus);
+
+// enable a falling SDA edge interrupt on the calling core, waking it up from __wfe when a target raises an IBI
+i3c_hl_status_t i3c_hl_ibi_irq_enable(i3c_hl_bus_t *pbus, bool enable);
 
-i3c_hl_status_t i3c_hl_sdr_privwrite(uint8_t addr, const uint8_t *pdat, uint32_t bytecount);
-i3c_hl_status_t i3c_hl_sdr_privread(uint8_t addr, uint8_t *pdat, uint32_t *pbytecount);
-i3c_hl_status_t i3c_hl_sdr_privwriteread(uint8_t addr, const uint8_t *pwritedat, uint32_t writebytecount,
+// select if SDR write payloads are streamed by DMA (default) or written byte by byte by the CPU.
+// The DMA engine avoids idle SCL gaps between the bytes. The byte wise mode is kept for comparison and debugging.
+i3c_hl_status_t i3c_hl_sdr_write_dma_enable(i3c_hl_bus_t *pbus, bool enable);
+
+i3c_hl_status_t i3c_hl_sdr_privwrite(i3c_hl_bus_t *pbus, uint8_t addr, const uint8_t *pdat, uint32_t bytecount);
+i3c_hl_status_t i3c_hl_sdr_privread(i3c_hl_bus_t *pbus, uint8_t addr, uint8_t *pdat, uint32_t *pbytecount);
+i3c_hl_status_t i3c_hl_sdr_privwriteread(i3c_hl_bus_t *pbus, uint8_t addr, const uint8_t *pwritedat, uint32_t writebytecount,
                                                              uint8_t *preaddat, uint32_t *preadbytecount);
 
-i3c_hl_status_t i3c_hl_sdr_ccc_broadcast_write(const uint8_t *pdat, uint32_t bytecount);
-i3c_hl_status_t i3c_hl_sdr_ccc_direct_write(const uint8_t *pdat, uint32_t bytecount,
+i3c_hl_status_t i3c_hl_sdr_ccc_broadcast_write(i3c_hl_bus_t *pbus, const uint8_t *pdat, uint32_t bytecount);
+i3c_hl_status_t i3c_hl_sdr_ccc_direct_write(i3c_hl_bus_t *pbus, const uint8_t *pdat, uint32_t bytecount,
 							       				  uint8_t addr, const uint8_t *pdirectdat, uint32_t directbytecount);
-i3c_hl_status_t i3c_hl_sdr_ccc_direct_read(const uint8_t *pdat, uint32_t bytecount,
+i3c_hl_status_t i3c_hl_sdr_ccc_direct_read(i3c_hl_bus_t *pbus, const uint8_t *pdat, uint32_t bytecount,
 										         uint8_t addr, uint8_t *pdirectdat, uint32_t *pdirectbytecount);
 
 
-i3c_hl_status_t i3c_hl_hdrexit(void);
-i3c_hl_status_t i3c_hl_hdrrestart(void);
+i3c_hl_status_t i3c_hl_hdrexit(i3c_hl_bus_t *pbus);
+i3c_hl_status_t i3c_hl_hdrrestart(i3c_hl_bus_t *pbus);
+
+// select if HDR-DDR write transfers are pre-encoded and streamed by DMA (default) or written word by word by the CPU.
+i3c_hl_status_t i3c_hl_ddr_write_dma_enable(i3c_hl_bus_t *pbus, bool enable);
 
 // Execute a DDR write transfer. 
 // The parameter finalize_with_restart allows contatenation of transfers by finalizing with a HDR-restart condition instead of an HDR-exit in case no transfer errors occured
@@ -83,7 +145,7 @@ i3c_hl_status_t i3c_hl_hdrrestart(void);
 // send_crc_on_early_termination   selects if the target supports sending early termination requests. This is the case for targets that 
 //                                 comply with V1.1 spec, have flow control implemented and ENDXFER subcommand 0xf7 bit 7..6 set to bitvalue 01.
 // For V1.0 targets you can set all those 3 parameters to false.
-i3c_hl_status_t i3c_hl_ddr_write(uint8_t addr, uint8_t command, uint16_t *pdat, uint32_t *pwordcount, bool finalize_with_restart,  
+i3c_hl_status_t i3c_hl_ddr_write(i3c_hl_bus_t *pbus, uint8_t addr, uint8_t command, uint16_t *pdat, uint32_t *pwordcount, bool finalize_with_restart,  
                                  bool ack_nack_enable, bool early_write_termination_enabled, bool send_crc_on_early_termination); // These 3 configuration parameters are coming partly due to legacy nightmare to V1.0 spec. See ENDXFER CCC / "Target Ends or continues the write transfer" section of spec
 
 // Execute a DDR read transfer.
@@ -94,16 +156,135 @@ i3c_hl_status_t i3c_hl_ddr_write(uint8_t addr, uint8_t command, uint16_t *pdat,
 //                                 This has to match the ENDXFER sucommand 0xf7 bit 7..6 setting. In case this is binary 01, this parameter
 //                                 must be set to true.
 // For V1.0 targets, set this parameter to false.
-i3c_hl_status_t i3c_hl_ddr_read(uint8_t addr, uint8_t command, uint16_t *pdat, uint32_t *preadcount, bool finalize_with_restart,
+i3c_hl_status_t i3c_hl_ddr_read(i3c_hl_bus_t *pbus, uint8_t addr, uint8_t command, uint16_t *pdat, uint32_t *preadcount, bool finalize_with_restart,
                                 bool read_crc_on_early_termination);
 
+// Batch execution of transfers. A list of descriptors is executed back to back on the device, each descriptor receives its own status.
+typedef enum
+{
+    i3c_hl_batch_op_sdr_write = 0,      // private write: addr, pwritedat/writecount
+    i3c_hl_batch_op_sdr_read,           // private read: addr, preaddat/readcount
+    i3c_hl_batch_op_sdr_writeread,      // private write followed by read: addr, pwritedat/writecount, preaddat/readcount
+    i3c_hl_batch_op_ccc_broadcast,      // CCC broadcast write: pwritedat/writecount (CCC code + payload)
+    i3c_hl_batch_op_ccc_direct_write,   // CCC direct write: pwritedat/writecount (CCC code + defining byte), addr, pdirectdat/directcount
+    i3c_hl_batch_op_ccc_direct_read,    // CCC direct read: pwritedat/writecount (CCC code + defining byte), addr, preaddat/readcount
+    i3c_hl_batch_op_ddr_write,          // HDR-DDR write: addr, cmd, pwritedat/writecount as 16-bit words
+    i3c_hl_batch_op_ddr_read,           // HDR-DDR read: addr, cmd, preaddat/readcount as 16-bit words
+    i3c_hl_batch_op_delay,              // busy wait for delay_us microseconds
+} i3c_hl_batch_op_t;
+
+#define I3C_HL_BATCH_FLAG_STOP_ON_ERROR        (1u<<0) // skip all following descriptors when this one fails
+#define I3C_HL_BATCH_FLAG_DDR_ACK_NACK         (1u<<1) // see ack_nack_enable of i3c_hl_ddr_write
+#define I3C_HL_BATCH_FLAG_DDR_EARLY_WRITE_TERM (1u<<2) // see early_write_termination_enabled of i3c_hl_ddr_write
+#define I3C_HL_BATCH_FLAG_DDR_CRC_ON_EARLY_TERM (1u<<3) // see send_crc_on_early_termination of i3c_hl_ddr_write / read_crc_on_early_termination of i3c_hl_ddr_read
+#define I3C_HL_BATCH_FLAG_DDR_RESTART          (1u<<4) // see finalize_with_restart of i3c_hl_ddr_write / i3c_hl_ddr_read
+
+typedef struct
+{
+    i3c_hl_batch_op_t op;
+    uint8_t           flags;       // I3C_HL_BATCH_FLAG_xxx
+    uint8_t           addr;        // 7-bit target address
+    uint8_t           cmd;         // HDR-DDR command code
+    const void       *pwritedat;   // bytes for SDR/CCC, 16-bit words for HDR-DDR
+    uint32_t          writecount;  // for HDR-DDR writes this returns the count of words actually written
+    const uint8_t    *pdirectdat;  // direct phase payload of CCC direct writes
+    uint32_t          directcount;
+    void             *preaddat;    // bytes for SDR/CCC, 16-bit words for HDR-DDR
+    uint32_t          readcount;   // in: count to read, out: count actually read
+    uint32_t          delay_us;
+    i3c_hl_status_t   status;      // out: result of this descriptor
+} i3c_hl_batch_desc_t;
+
+// Execute count descriptors. Returns i3c_hl_status_ok if all descriptors succeeded, otherwise the status of the first failing one.
+// *pexecuted (optional) returns the count of descriptors which got executed.
+i3c_hl_status_t i3c_hl_batch_execute(i3c_hl_bus_t *pbus, i3c_hl_batch_desc_t *pdesc, uint32_t count, uint32_t *pexecuted);
+
+// Transfer statistics, collected per bus by the transfer functions. Each transfer costs a timer read and a few increments.
+typedef enum
+{
+    i3c_hl_stats_sdr_write = 0,         // i3c_hl_sdr_privwrite
+    i3c_hl_stats_sdr_read,              // i3c_hl_sdr_privread
+    i3c_hl_stats_sdr_writeread,         // i3c_hl_sdr_privwriteread
+    i3c_hl_stats_ccc_broadcast,         // i3c_hl_sdr_ccc_broadcast_write
+    i3c_hl_stats_ccc_direct_write,      // i3c_hl_sdr_ccc_direct_write
+    i3c_hl_stats_ccc_direct_read,       // i3c_hl_sdr_ccc_direct_read
+    i3c_hl_stats_ddr_write,             // i3c_hl_ddr_write
+    i3c_hl_stats_ddr_read,              // i3c_hl_ddr_read
+    i3c_hl_stats_ibi,                   // i3c_hl_poll reading a IBI or HJ request
+    I3C_HL_STATS_TYPES
+} i3c_hl_stats_type_t;
+
+#define I3C_HL_STATS_HISTBINS (16) // bin 0: < 1 us, bin n: 2^(n-1) .. 2^n-1 us, the last bin counts all longer transfers
+
+typedef struct
+{
+    uint32_t count;                        // executed transfers
+    uint32_t data;                         // bytes (HDR-DDR: words) moved by transfers which succeeded or were terminated early
+    uint32_t nak;                          // NAKed arbitration header, address or HDR-DDR transfer
+    uint32_t ibi;                          // transfers which lost the arbitration against a IBI and were not executed
+    uint32_t parity_crc;                   // HDR-DDR reads with invalid preamble, parity or CRC
+    uint32_t early_term;                   // HDR-DDR transfers terminated early by the target
+    uint32_t max_us;                       // longest transfer
+    uint64_t busy_us;                      // sum of the durations of all transfers
+    uint32_t hist[I3C_HL_STATS_HISTBINS];  // log2 histogram of the durations
+} i3c_hl_stats_t;
+
+// copies the statistics of one transfer type. Transfers of pbus must not run at the same time for a consistent snapshot
+void            i3c_hl_stats_get(i3c_hl_bus_t *pbus, i3c_hl_stats_type_t type, i3c_hl_stats_t *pstats);
+void            i3c_hl_stats_reset(i3c_hl_bus_t *pbus);
+const char     *i3c_hl_stats_typename(i3c_hl_stats_type_t type);
+
+// Device table: what is known about the targets of a bus, keyed by their dynamic address. It is filled by the DAA
+// functions (PID, BCR, DCR) and by the direct CCCs GETBCR, GETDCR, GETMRL, GETMWL, GETMXDS and GETCAPS, no matter who sends
+// them (see i3c_hl_device_discover). It follows SETNEWDA, SETMRL and SETMWL and is cleared by RSTDAA. The transfer
+// functions consult it:
+//  - i3c_hl_sdr_privread splits reads longer than the MRL into reads of up to MRL bytes joined by repeated STARTs
+//  - i3c_hl_poll reads no more IBI data than the target announced (BCR bit 2, max IBI payload of GETMRL)
+//  - HDR-DDR transfers to targets known to lack HDR-DDR (BCR bit 5, GETCAPS) fail with i3c_hl_status_param_outofrange
+//    without bus access
+#define I3C_HL_MAXDEVICES (16) // per bus
+
+#define I3C_HL_DEVICE_PID  (1u<<0) // flags of the known fields
+#define I3C_HL_DEVICE_BCR  (1u<<1)
+#define I3C_HL_DEVICE_DCR  (1u<<2)
+#define I3C_HL_DEVICE_MRL  (1u<<3) // mrl and ibi_payload
+#define I3C_HL_DEVICE_MWL  (1u<<4)
+#define I3C_HL_DEVICE_MXDS (1u<<5)
+#define I3C_HL_DEVICE_CAPS (1u<<6)
+
+typedef struct
+{
+    uint8_t  addr;         // dynamic address
+    uint8_t  flags;        // I3C_HL_DEVICE_xxx
+    uint8_t  pid[6];       // provisioned ID, MSB first
+    uint8_t  bcr;
+    uint8_t  dcr;
+    uint16_t mrl;          // max read length in bytes
+    uint16_t mwl;          // max write length in bytes
+    uint8_t  ibi_payload;  // max IBI payload in bytes incl. the MDB, 0: unlimited
+    uint8_t  maxwr;        // GETMXDS
+    uint8_t  maxrd;
+    uint8_t  capslen;      // bytes returned by GETCAPS
+    uint8_t  caps[4];
+} i3c_hl_device_t;
+
+// copies the entry of addr, false when the address is unknown
+bool            i3c_hl_device_get(i3c_hl_bus_t *pbus, uint8_t addr, i3c_hl_device_t *pdev);
+// copies up to maxcount entries in ascending address order, returns their count
+uint32_t        i3c_hl_device_list(i3c_hl_bus_t *pbus, i3c_hl_device_t *pdevs, uint32_t maxcount);
+// queries GETBCR, GETDCR, GETMRL, GETMWL, GETMXDS and GETCAPS of addr into the table. CCCs the target does not support
+// (NAK) stay unknown. Fails with the status of GETBCR, or i3c_hl_status_param_outofrange when the table is full
+i3c_hl_status_t i3c_hl_device_discover(i3c_hl_bus_t *pbus, uint8_t addr);
+void            i3c_hl_device_clear(i3c_hl_bus_t *pbus);
+
 // set drive strength for SDA and SCL outputs. Valid inputs are 2, 4, 8, 12. The units is in mA
-i3c_hl_status_t i3c_hl_set_drivestrength(uint8_t drivestrength_mA);
+i3c_hl_status_t i3c_hl_set_drivestrength(i3c_hl_bus_t *pbus, uint8_t drivestrength_mA);
+uint8_t         i3c_hl_get_drivestrength(const i3c_hl_bus_t *pbus); // as last set, 12 after i3c_init
 
 // switch gpio pinmux to either i2c mode or i3c mode. Use this function to execute i2c transfers using normal i2c API.
 // default wise the pinout is switched ti i3c mode after calling i3c_init().
 // enable_i2c_module            True to select i2c and give access to i2c IP behind it
 //                              False to select i3c (PIO) 
-i3c_hl_status_t i3c_hl_i2c_pinmode(bool enable_i2c_module);
+i3c_hl_status_t i3c_hl_i2c_pinmode(i3c_hl_bus_t *pbus, bool enable_i2c_module);
 
 #endif //_I3C_HL_H
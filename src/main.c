@@ -7,16 +7,23 @@
 #include "hardware/structs/adc.h"
 #include "hardware/adc.h"
 #include "i3c_hl.h"
+#include "i3c_hal.h"
 #include "ucli.h"
+#include "ucli_config.h"
 #include "tusb.h"
 #include "hardware/timer.h"
 #include <stdlib.h>
+#include <string.h>
 #include "hardware/regs/io_bank0.h"
 #include "hardware/structs/io_bank0.h"
 #include "hardware/pll.h"
 #include "hardware/structs/pll.h"
 #include "hardware/structs/clocks.h"
 #include "XiaoNeoPixel.h"
+#include "binframe.h"
+#include "busengine.h"
+#include "sampler.h"
+#include "cfgstore.h"
 
 #include "hardware/i2c.h"
 
@@ -56,6 +63,28 @@ static i2c_inst_t *i2c_instance = i2c0;
 static uint32_t i2c_timeout_ms = 100;
 static uint32_t i2c_freq_khz = 100;
 
+static binframe_t binframe_cdc;    // frames embedded in the CDC/stdio character stream
+static binframe_t binframe_vendor; // frames on the vendor bulk interface (data plane)
+
+// I3C bus used by the text commands. Text commands and binary frames on the CDC interface share the bus selection
+static inline i3c_hl_bus_t *i3c_cli_pbus(void)
+{
+	return i3c_hl_bus(binframe_cdc.bus);
+}
+
+// batch descriptor flags for HDR-DDR transfers according to the settings above
+static uint8_t i3c_ddr_write_flags(void)
+{
+	return (i3c_ddr_config_write_ack_enable        ? I3C_HL_BATCH_FLAG_DDR_ACK_NACK         : 0) |
+	       (i3c_ddr_config_enable_early_write_term ? I3C_HL_BATCH_FLAG_DDR_EARLY_WRITE_TERM : 0) |
+	       (i3c_ddr_config_crc_word_indicator      ? I3C_HL_BATCH_FLAG_DDR_CRC_ON_EARLY_TERM : 0);
+}
+
+static uint8_t i3c_ddr_read_flags(void)
+{
+	return i3c_ddr_config_enable_early_write_term ? I3C_HL_BATCH_FLAG_DDR_CRC_ON_EARLY_TERM : 0;
+}
+
 
 
 static void parse_array_string(const char *str, uint8_t *ppayload, uint32_t *ppayloadlen)
@@ -173,10 +202,52 @@ UCLI_COMMAND_DEF(i3c_sdr_write, "Execute a private write transfer to a target",
 
 	parse_array_string(args->payload, payload, &payloadlen);
 	
-	retcode = i3c_hl_sdr_privwrite(args->addr, payload, payloadlen);
+	i3c_hl_batch_desc_t desc = { .op = i3c_hl_batch_op_sdr_write, .addr = args->addr, .pwritedat = payload, .writecount = payloadlen };
+	retcode = busengine_run(i3c_cli_pbus(), &desc, 1, NULL);
 	printf("%s\r\n", i3c_hl_get_errorstring(retcode));
 }
 
+UCLI_COMMAND_DEF(i3c_sdr_write_bench, "Measure private write throughput of byte wise CPU writes vs. DMA streamed writes. Returns bytes/s for both modes",
+    UCLI_INT_ARG_DEF(addr, "The 7-Bit address of the target"),
+    UCLI_INT_ARG_DEF(len, "The count of bytes per transfer (1..1024)"),
+    UCLI_INT_ARG_DEF(iterations, "The count of transfers per mode")
+)
+{
+	uint8_t payload[1024];
+	uint64_t duration_us[2];
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
+
+	if ( (args->len < 1) || (args->len > (intptr_t)sizeof(payload)) || (args->iterations < 1) )
+	{
+		printf("%s\r\n", i3c_hl_get_errorstring(i3c_hl_status_param_outofrange));
+		return;
+	}
+	for (uint32_t i=0; i<args->len; i++)
+		payload[i] = (uint8_t)i;
+
+	for (uint32_t mode=0; mode<2; mode++)
+	{
+		uint64_t tstart;
+
+		i3c_hl_sdr_write_dma_enable(i3c_cli_pbus(), mode == 1);
+		tstart = time_us_64();
+		for (uint32_t i=0; (i<args->iterations) && (retcode == i3c_hl_status_ok); i++)
+			retcode = i3c_hl_sdr_privwrite(i3c_cli_pbus(), args->addr, payload, args->len);
+		duration_us[mode] = time_us_64() - tstart;
+		if (duration_us[mode] == 0)
+			duration_us[mode] = 1;
+	}
+	i3c_hl_sdr_write_dma_enable(i3c_cli_pbus(), true);
+
+	printf("%s", i3c_hl_get_errorstring(retcode));
+	if (retcode == i3c_hl_status_ok)
+	{
+		uint64_t totalbytes = (uint64_t)args->len * args->iterations;
+		printf(",%llu,%llu", (totalbytes * 1000000ull) / duration_us[0], (totalbytes * 1000000ull) / duration_us[1]);
+	}
+	printf("\r\n");
+}
+
 UCLI_COMMAND_DEF(i3c_sdr_ccc_bc_write, "Execute a ccc broadcast write transfer",
     UCLI_STR_ARG_DEF(payload, "The data payload to write in the broadcast transfer - byte values seperated with comma without whitespaces (e.g. 0x12,0x43,0x56)")
 )
@@ -187,7 +258,8 @@ UCLI_COMMAND_DEF(i3c_sdr_ccc_bc_write, "Execute a ccc broadcast write transfer",
 
 	parse_array_string(args->payload, payload, &payloadlen);
 
-	retcode = i3c_hl_sdr_ccc_broadcast_write(payload, payloadlen);
+	i3c_hl_batch_desc_t desc = { .op = i3c_hl_batch_op_ccc_broadcast, .pwritedat = payload, .writecount = payloadlen };
+	retcode = busengine_run(i3c_cli_pbus(), &desc, 1, NULL);
 	printf("%s\r\n", i3c_hl_get_errorstring(retcode));
 }
 
@@ -205,8 +277,9 @@ UCLI_COMMAND_DEF(i3c_sdr_ccc_direct_write, "Execute a ccc direct write transfer"
 
 	parse_array_string(args->bc_payload, bc_payload, &bc_payloadlen);
 	parse_array_string(args->dir_payload, direct_payload, &direct_payloadlen);
-	retcode =  i3c_hl_sdr_ccc_direct_write(bc_payload, bc_payloadlen,
-												args->addr, direct_payload, direct_payloadlen);
+	i3c_hl_batch_desc_t desc = { .op = i3c_hl_batch_op_ccc_direct_write, .addr = args->addr, .pwritedat = bc_payload, .writecount = bc_payloadlen,
+	                             .pdirectdat = direct_payload, .directcount = direct_payloadlen };
+	retcode = busengine_run(i3c_cli_pbus(), &desc, 1, NULL);
 	printf("%s\r\n", i3c_hl_get_errorstring(retcode));
 }
 
@@ -224,7 +297,10 @@ UCLI_COMMAND_DEF(i3c_sdr_ccc_direct_read, "Execute a ccc direct read transfer",
 
 	rxlen = args->len;
 	parse_array_string(args->payload, payload, &payloadlen);
-	retcode = i3c_hl_sdr_ccc_direct_read(payload, payloadlen, args->addr, rxdata, &rxlen);
+	i3c_hl_batch_desc_t desc = { .op = i3c_hl_batch_op_ccc_direct_read, .addr = args->addr, .pwritedat = payload, .writecount = payloadlen,
+	                             .preaddat = rxdata, .readcount = rxlen };
+	retcode = busengine_run(i3c_cli_pbus(), &desc, 1, NULL);
+	rxlen = desc.readcount;
 	printf("%s", i3c_hl_get_errorstring(retcode));
 	if (retcode == i3c_hl_status_ok)
 	{
@@ -248,7 +324,10 @@ UCLI_COMMAND_DEF(i3c_sdr_writeread, "Execute a private combined write read trans
 
 	rxlen = args->len;
 	parse_array_string(args->payload, payload, &payloadlen);
-	retcode = i3c_hl_sdr_privwriteread(args->addr, payload, payloadlen, rxdata, &rxlen);
+	i3c_hl_batch_desc_t desc = { .op = i3c_hl_batch_op_sdr_writeread, .addr = args->addr, .pwritedat = payload, .writecount = payloadlen,
+	                             .preaddat = rxdata, .readcount = rxlen };
+	retcode = busengine_run(i3c_cli_pbus(), &desc, 1, NULL);
+	rxlen = desc.readcount;
 	printf("%s", i3c_hl_get_errorstring(retcode));
 	if (retcode == i3c_hl_status_ok)
 	{
@@ -269,8 +348,9 @@ UCLI_COMMAND_DEF(i3c_sdr_read, "Execute a private read transfer from a target",
 	uint32_t payloadlen=0;
 	i3c_hl_status_t retcode;
 
-	payloadlen = args->len;
-	retcode = i3c_hl_sdr_privread(args->addr, payload, &payloadlen);
+	i3c_hl_batch_desc_t desc = { .op = i3c_hl_batch_op_sdr_read, .addr = args->addr, .preaddat = payload, .readcount = args->len };
+	retcode = busengine_run(i3c_cli_pbus(), &desc, 1, NULL);
+	payloadlen = desc.readcount;
 	printf("%s", i3c_hl_get_errorstring(retcode));
 	if (retcode == i3c_hl_status_ok)
 	{
@@ -284,31 +364,61 @@ UCLI_COMMAND_DEF(i3c_sdr_read, "Execute a private read transfer from a target",
 UCLI_COMMAND_DEF(i3c_rstdaa, "Execute i3crstdaa broadcast transfer. This will unassign all targets dynamic addresses"
 )
 {
-	i3c_hl_rstdaa();
+	i3c_hl_rstdaa(i3c_cli_pbus());
 	printf("%s\r\n", i3c_hl_get_errorstring(i3c_hl_status_ok));
 }
 
-UCLI_COMMAND_DEF(i3c_scan, "Scan for available i3c addreses"
-)
+// collect all addresses which acknowledge on the i3c bus, the count is 0 when the scan fails
+static i3c_hl_status_t i3c_scan_addresses(i3c_hl_bus_t *pbus, uint8_t *paddr, uint32_t *pcount)
 {
-	bool notfirst = false, gotibi = false;
-	printf("%s,", i3c_hl_get_errorstring(i3c_hl_status_ok));
+	uint32_t present[4];
+	uint32_t count = 0;
+	i3c_hl_status_t retcode;
+
+	*pcount = 0;
+	retcode = i3c_hl_scan(pbus, present);
+	if (retcode != i3c_hl_status_ok)
+		return retcode;
 	for (uint8_t addr=0; addr<0x80; addr++)
 	{
-		if ( (addr != 0x7F) && (addr != 0x7C) && (addr != 0x7A) && (addr != 0x76) && (addr != 0x6E) && (addr != 0x5E) && (addr != 0x3E) )
+		if (present[addr >> 5] & (1ul << (addr & 31u)))
 		{
-			i3c_hl_status_t status = i3c_hl_checkack(addr);
-			if ( status == i3c_hl_status_ok )
-			{
-				if (notfirst)
-					printf(",");
-				printf("0x%02x", addr);
-				notfirst = true;
-			}
-			sleep_us(10);
+			paddr[count++] = addr;
 		}
 	}
-	i3c_hl_arbhdronly(); // free the bus
+	*pcount = count;
+	return i3c_hl_status_ok;
+}
+
+UCLI_COMMAND_DEF(i3c_scan, "Scan for available i3c addreses. All addresses are probed within one frame",
+    UCLI_OPTIONAL_INT_ARG_DEF(bitmap, "1: return the 128 bit presence bitmap as one hex number (bit n: address n) instead of the list of addresses")
+)
+{
+	uint8_t  addr[0x80];
+	uint32_t present[4];
+	uint32_t count;
+	i3c_hl_status_t retcode;
+
+	if ( (args->bitmap != UCLI_INT_ARG_DEFAULT) && (args->bitmap != 0) )
+	{
+		retcode = i3c_hl_scan(i3c_cli_pbus(), present);
+		printf("%s", i3c_hl_get_errorstring(retcode));
+		if (retcode == i3c_hl_status_ok)
+			printf(",0x%08x%08x%08x%08x", (unsigned)present[3], (unsigned)present[2], (unsigned)present[1], (unsigned)present[0]);
+		printf("\r\n");
+		return;
+	}
+
+	retcode = i3c_scan_addresses(i3c_cli_pbus(), addr, &count);
+	printf("%s", i3c_hl_get_errorstring(retcode));
+	if (retcode == i3c_hl_status_ok)
+		printf(",");
+	for (uint32_t i=0; i<count; i++)
+	{
+		if (i > 0)
+			printf(",");
+		printf("0x%02x", addr[i]);
+	}
 	printf("\r\n");
 }
 
@@ -325,7 +435,7 @@ UCLI_COMMAND_DEF(i3c_entdaa, "Execute i3c entdaa procedure",
 		ucli_error("address has to be in range  0..0x7f");
 		return;
 	}
-	retcode = i3c_hl_entdaa((uint8_t)args->addr, id);
+	retcode = i3c_hl_entdaa(i3c_cli_pbus(), (uint8_t)args->addr, id);
 	printf("%s", i3c_hl_get_errorstring(retcode));
 	if ( retcode == i3c_hl_status_ok )
 	{
@@ -337,12 +447,125 @@ UCLI_COMMAND_DEF(i3c_entdaa, "Execute i3c entdaa procedure",
 	printf("\r\n");
 }
 
+UCLI_COMMAND_DEF(i3c_daa, "Assign dynamic addresses to all targets taking part in ENTDAA within one ENTDAA CCC. Returns the count of assigned targets followed by ';' PID, BCR, DCR and address of every target",
+    UCLI_INT_ARG_DEF(firstaddr, "First address of the pool, e.g. 0x08"),
+    UCLI_OPTIONAL_INT_ARG_DEF(lastaddr, "Last address of the pool (default: 0x7d). Reserved addresses are skipped")
+)
+{
+	static i3c_hl_daa_entry_t entries[128];
+	uint32_t count;
+	int32_t firstaddr = args->firstaddr;
+	int32_t lastaddr = (args->lastaddr == UCLI_INT_ARG_DEFAULT) ? 0x7d : args->lastaddr;
+	i3c_hl_status_t retcode;
+
+	if ( (firstaddr < 0) || (lastaddr >= 0x80) || (firstaddr > lastaddr) )
+	{
+		ucli_error("addresses have to be in range 0..0x7f, firstaddr <= lastaddr");
+		return;
+	}
+	retcode = i3c_hl_daa(i3c_cli_pbus(), (uint8_t)firstaddr, (uint8_t)lastaddr, NULL, entries, sizeof(entries)/sizeof(entries[0]), &count);
+	printf("%s,%u", i3c_hl_get_errorstring(retcode), (unsigned)count);
+	for (uint32_t i=0; i<count; i++)
+	{
+		printf(";0x");
+		for (int j=0; j<6; j++)
+			printf("%02x", entries[i].pid[j]);
+		printf(",0x%02x,0x%02x,0x%02x", entries[i].bcr, entries[i].dcr, entries[i].addr);
+	}
+	printf("\r\n");
+}
+
+UCLI_COMMAND_DEF(i3c_devices, "Show the device table of the selected bus. Returns the count of known targets followed by ';' address, PID, BCR, DCR, MRL, MWL, max IBI payload, GETMXDS maxwr and maxrd and GETCAPS bytes of every target. Unknown fields are shown as '-'"
+)
+{
+	static i3c_hl_device_t devs[I3C_HL_MAXDEVICES];
+	uint32_t count = i3c_hl_device_list(i3c_cli_pbus(), devs, I3C_HL_MAXDEVICES);
+
+	printf("%s,%u", i3c_hl_get_errorstring(i3c_hl_status_ok), (unsigned)count);
+	for (uint32_t i=0; i<count; i++)
+	{
+		i3c_hl_device_t *pdev = &devs[i];
+
+		printf(";0x%02x,", pdev->addr);
+		if (pdev->flags & I3C_HL_DEVICE_PID)
+		{
+			printf("0x");
+			for (int j=0; j<6; j++)
+				printf("%02x", pdev->pid[j]);
+		}
+		else
+			printf("-");
+		if (pdev->flags & I3C_HL_DEVICE_BCR)
+			printf(",0x%02x", pdev->bcr);
+		else
+			printf(",-");
+		if (pdev->flags & I3C_HL_DEVICE_DCR)
+			printf(",0x%02x", pdev->dcr);
+		else
+			printf(",-");
+		if (pdev->flags & I3C_HL_DEVICE_MRL)
+			printf(",%u", pdev->mrl);
+		else
+			printf(",-");
+		if (pdev->flags & I3C_HL_DEVICE_MWL)
+			printf(",%u", pdev->mwl);
+		else
+			printf(",-");
+		if (pdev->flags & I3C_HL_DEVICE_MRL)
+			printf(",%u", pdev->ibi_payload);
+		else
+			printf(",-");
+		if (pdev->flags & I3C_HL_DEVICE_MXDS)
+			printf(",0x%02x,0x%02x", pdev->maxwr, pdev->maxrd);
+		else
+			printf(",-,-");
+		if (pdev->flags & I3C_HL_DEVICE_CAPS)
+		{
+			printf(",");
+			for (uint32_t j=0; j<pdev->capslen; j++)
+				printf("%s0x%02x", j ? " " : "", pdev->caps[j]);
+		}
+		else
+			printf(",-");
+	}
+	printf("\r\n");
+}
+
+UCLI_COMMAND_DEF(i3c_discover, "Query GETBCR, GETDCR, GETMRL, GETMWL, GETMXDS and GETCAPS of a target into the device table of the selected bus. Without address all targets of the table are queried",
+    UCLI_OPTIONAL_INT_ARG_DEF(addr, "Dynamic address of the target")
+)
+{
+	i3c_hl_bus_t *pbus = i3c_cli_pbus();
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
+
+	if (args->addr != UCLI_INT_ARG_DEFAULT)
+	{
+		if ( (args->addr < 0) || (args->addr >= 0x80) )
+		{
+			ucli_error("addr has to be in range 0..0x7f");
+			return;
+		}
+		retcode = i3c_hl_device_discover(pbus, (uint8_t)args->addr);
+	}
+	else
+	{
+		static i3c_hl_device_t devs[I3C_HL_MAXDEVICES];
+		uint32_t count = i3c_hl_device_list(pbus, devs, I3C_HL_MAXDEVICES);
+
+		for (uint32_t i=0; (i<count) && (retcode == i3c_hl_status_ok); i++)
+		{
+			retcode = i3c_hl_device_discover(pbus, devs[i].addr);
+		}
+	}
+	printf("%s\r\n", i3c_hl_get_errorstring(retcode));
+}
+
 UCLI_COMMAND_DEF(i3c_clk, "Set I3C clock frequency",
     UCLI_INT_ARG_DEF(freq_khz, "The Clock frequency as integer number in units of kHz. Valid range: 49..12500")
 )
 {
 	i3c_hl_status_t retcode;
-	retcode = i3c_hl_set_clkrate(args->freq_khz);
+	retcode = i3c_hl_set_clkrate(i3c_cli_pbus(), args->freq_khz);
 	printf("%s\r\n", i3c_hl_get_errorstring(retcode));
 }
 
@@ -350,7 +573,7 @@ UCLI_COMMAND_DEF(i3c_targetreset, "Execute a Targetreset sequence on I3C Bus."
 )
 {
 	i3c_hl_status_t retcode;
-	retcode = i3c_hl_targetreset();
+	retcode = i3c_hl_targetreset(i3c_cli_pbus());
 	printf("%s\r\n", i3c_hl_get_errorstring(retcode));
 }
 
@@ -362,8 +585,19 @@ UCLI_COMMAND_DEF(i3c_poll, "Poll / handle interrupt"
 	uint8_t ibidata[16];
 	uint32_t ibidatalen;
 
-	ibidatalen = sizeof(ibidata);
-    retcode = i3c_hl_poll(ibidata, &ibidatalen);
+	busengine_ibi_t ibi;
+
+	if (busengine_ibi_read(i3c_cli_pbus(), &ibi, 1) > 0)
+	{ // already read by the automatic IBI handling
+		retcode = i3c_hl_status_ok;
+		ibidatalen = ibi.len;
+		memcpy(ibidata, ibi.data, ibi.len);
+	}
+	else
+	{
+		ibidatalen = sizeof(ibidata);
+		retcode = i3c_hl_poll(i3c_cli_pbus(), ibidata, &ibidatalen);
+	}
 	printf("%s", i3c_hl_get_errorstring(retcode));
 	if (retcode == i3c_hl_status_ok)
 	{
@@ -377,6 +611,31 @@ UCLI_COMMAND_DEF(i3c_poll, "Poll / handle interrupt"
 }
 
 
+UCLI_COMMAND_DEF(i3c_ibi_auto, "Enable or disable automatic IBI handling of the selected bus. IBIs are then read as soon as they are raised and queued with a timestamp",
+    UCLI_INT_ARG_DEF(enable, "1 = read IBIs automatically, 0 = IBIs are only read by i3c_poll")
+)
+{
+	busengine_ibi_enable(i3c_cli_pbus(), args->enable != 0);
+	printf("%s\r\n", i3c_hl_get_errorstring(i3c_hl_status_ok));
+}
+
+UCLI_COMMAND_DEF(i3c_ibi_read, "Read IBIs queued by the automatic IBI handling of all buses. Returns the count of dropped IBIs followed by ';' timestamp in us, bus and data of every IBI",
+    UCLI_OPTIONAL_INT_ARG_DEF(maxcount, "Maximum count of IBIs to read (default: all)")
+)
+{
+	busengine_ibi_t ibi;
+	uint32_t maxcount = (args->maxcount == UCLI_INT_ARG_DEFAULT) ? BUSENGINE_IBI_QUEUE : (uint32_t)args->maxcount;
+
+	printf("%s,%u", i3c_hl_get_errorstring(i3c_hl_status_ok), busengine_ibi_dropped(NULL));
+	while ( (maxcount-- > 0) && (busengine_ibi_read(NULL, &ibi, 1) > 0) )
+	{
+		printf(";%llu,%u", (unsigned long long)ibi.timestamp_us, ibi.bus);
+		for (uint32_t i=0; i<ibi.len; i++)
+			printf(",0x%02x", ibi.data[i]);
+	}
+	printf("\r\n");
+}
+
 UCLI_COMMAND_DEF(info, "Show information about this version")
 {
 	printf("Version: " VERSION "\r\n");
@@ -385,12 +644,10 @@ UCLI_COMMAND_DEF(info, "Show information about this version")
 	printf("-----------------------\r\n");
 	printf("By sending @ as first character for each command, there is \r\nno character echoed back for easier automation fromout PC\r\n" );
 
-	uint32_t addr = PIO0_BASE;
-
-	for (addr = PIO0_BASE; addr <= (PIO0_BASE+0x128); addr+=4)
+	for (uint32_t offset = 0; offset <= 0x128; offset+=4)
 	{
-		uint32_t data = *((volatile uint32_t *)addr);
-		printf("[%04x] = %08x\n", addr-PIO0_BASE, data);
+		uint32_t data = i3c_hal_read32((const volatile uint32_t *)((uintptr_t)pio0 + offset));
+		printf("[%04x] = %08x\n", offset, data);
 
 	}
 }
@@ -416,6 +673,33 @@ UCLI_COMMAND_DEF(clkinfo, "Show information of the MCUs clock setup")
     printf("clk_rtc  = %dkHz\n", f_clk_rtc);
 }
 
+UCLI_COMMAND_DEF(stats, "Show the transfer statistics of all buses: per bus and transfer type ';' bus, type, count, data (bytes or HDR-DDR words), NAKs, IBI aborts, parity/CRC errors, early terminations, busy time in us, longest transfer in us and the log2 histogram of the durations (bin 0: < 1us, bin n: 2^(n-1)..2^n-1 us)",
+    UCLI_OPTIONAL_INT_ARG_DEF(reset, "1 to reset all statistics after showing them (default: 0)")
+)
+{
+	i3c_hl_stats_t stats;
+
+	printf("%s", i3c_hl_get_errorstring(i3c_hl_status_ok));
+	for (uint8_t bus=0; bus<I3C_HL_MAXBUS; bus++)
+	{
+		i3c_hl_bus_t *pbus = i3c_hl_bus(bus);
+
+		for (uint32_t type=0; type<I3C_HL_STATS_TYPES; type++)
+		{
+			i3c_hl_stats_get(pbus, (i3c_hl_stats_type_t)type, &stats);
+			if (stats.count == 0)
+				continue;
+			printf(";%u,%s,%u,%u,%u,%u,%u,%u,%llu,%u", bus, i3c_hl_stats_typename((i3c_hl_stats_type_t)type), stats.count, stats.data,
+			       stats.nak, stats.ibi, stats.parity_crc, stats.early_term, (unsigned long long)stats.busy_us, stats.max_us);
+			for (uint32_t i=0; i<I3C_HL_STATS_HISTBINS; i++)
+				printf(",%u", stats.hist[i]);
+		}
+		if (args->reset == 1)
+			i3c_hl_stats_reset(pbus);
+	}
+	printf("\r\n");
+}
+
 UCLI_COMMAND_DEF(gpio_write, "Sets a GPIO pin state and direction",
     UCLI_INT_ARG_DEF(port, "The GPIO pin number (0..29)"),
 	UCLI_STR_ARG_DEF(state, "0 to set pin to OUTPUT LOW, 1 to set pin to OUTPUT HIGH, Z to set pin to tristate (input)")
@@ -461,7 +745,7 @@ UCLI_COMMAND_DEF(gpio_read, "Get gpio state. If no parameter is given a 32 Bit n
 	gpiostate = 0;
 	for (i=0; i<30; i++)
 	{
-		if ((io_bank0_hw->io[i].status & IO_BANK0_GPIO0_STATUS_INFROMPAD_BITS) >> IO_BANK0_GPIO0_STATUS_INFROMPAD_LSB > 0)
+		if ((i3c_hal_read32(&io_bank0_hw->io[i].status) & IO_BANK0_GPIO0_STATUS_INFROMPAD_BITS) >> IO_BANK0_GPIO0_STATUS_INFROMPAD_LSB > 0)
 		{
 			gpiostate |= (1<<i);
 		}
@@ -502,8 +786,11 @@ UCLI_COMMAND_DEF(i3c_ddr_write, "Execute a HDR-DDR mode write transfer to a targ
 
 	parse_array_string_uint16(args->payload, payload, &payloadlen);
 	
-	retcode =  i3c_hl_ddr_write((uint8_t)args->addr, (uint8_t)args->cmd, payload, &payloadlen, false,
-                                 i3c_ddr_config_write_ack_enable, i3c_ddr_config_enable_early_write_term, i3c_ddr_config_crc_word_indicator); // those settings can be adjusted by the user calling the i3c_ddr_config function and have to match the targets spec version / ENDXFER CCC setting
+	// the flags can be adjusted by the user calling the i3c_ddr_config function and have to match the targets spec version / ENDXFER CCC setting
+	i3c_hl_batch_desc_t desc = { .op = i3c_hl_batch_op_ddr_write, .flags = i3c_ddr_write_flags(), .addr = (uint8_t)args->addr, .cmd = (uint8_t)args->cmd,
+	                             .pwritedat = payload, .writecount = payloadlen };
+	retcode = busengine_run(i3c_cli_pbus(), &desc, 1, NULL);
+	payloadlen = desc.writecount;
 
 	printf("%s,%d\r\n", i3c_hl_get_errorstring(retcode), payloadlen);
 }
@@ -518,8 +805,10 @@ UCLI_COMMAND_DEF(i3c_ddr_read, "Execute a HDR-DDR mode read transfer from a targ
 	uint32_t payloadlen=sizeof(payload);
 	i3c_hl_status_t retcode;
 
-	payloadlen = args->wordcount;
-	retcode = i3c_hl_ddr_read(args->addr , args->cmd, payload, &payloadlen, false, i3c_ddr_config_enable_early_write_term);
+	i3c_hl_batch_desc_t desc = { .op = i3c_hl_batch_op_ddr_read, .flags = i3c_ddr_read_flags(), .addr = (uint8_t)args->addr, .cmd = (uint8_t)args->cmd,
+	                             .preaddat = payload, .readcount = args->wordcount };
+	retcode = busengine_run(i3c_cli_pbus(), &desc, 1, NULL);
+	payloadlen = desc.readcount;
 
 	printf("%s", i3c_hl_get_errorstring(retcode));
 	if (retcode == i3c_hl_status_ok)
@@ -544,35 +833,329 @@ UCLI_COMMAND_DEF(i3c_ddr_writeread, "Execute a HDR-DDR mode write transfer follo
 
 	parse_array_string_uint16(args->payload, payload, &payloadlen);
 	
-	retcode =  i3c_hl_ddr_write((uint8_t)args->addr, (uint8_t)args->wrcmd, payload, &payloadlen, true,
-                                 i3c_ddr_config_write_ack_enable, i3c_ddr_config_enable_early_write_term, i3c_ddr_config_crc_word_indicator); // those settings can be adjusted by the user calling the i3c_ddr_config function and have to match the targets spec version / ENDXFER CCC setting
+	// the flags can be adjusted by the user calling the i3c_ddr_config function and have to match the targets spec version / ENDXFER CCC setting
+	// The read is only executed when the write succeeded
+	i3c_hl_batch_desc_t desc[2] =
+	{
+		{ .op = i3c_hl_batch_op_ddr_write, .flags = i3c_ddr_write_flags() | I3C_HL_BATCH_FLAG_DDR_RESTART | I3C_HL_BATCH_FLAG_STOP_ON_ERROR,
+		  .addr = (uint8_t)args->addr, .cmd = (uint8_t)args->wrcmd, .pwritedat = payload, .writecount = payloadlen },
+		{ .op = i3c_hl_batch_op_ddr_read, .flags = i3c_ddr_read_flags(),
+		  .addr = (uint8_t)args->addr, .cmd = (uint8_t)args->rdcmd, .preaddat = payload, .readcount = args->wordcount },
+	};
+	retcode = busengine_run(i3c_cli_pbus(), desc, 2, NULL);
+	payloadlen = desc[0].writecount;
+	readpayloadlen = (retcode == i3c_hl_status_ok) ? desc[1].readcount : 0;
+
+	printf("%s,%d", i3c_hl_get_errorstring(retcode), payloadlen);
+
 	if (retcode == i3c_hl_status_ok)
 	{
-		readpayloadlen = args->wordcount;
-		retcode = i3c_hl_ddr_read(args->addr , args->rdcmd, payload, &readpayloadlen, false, i3c_ddr_config_enable_early_write_term);
-		if (retcode != i3c_hl_status_ok)
+		for (uint32_t i=0; i<readpayloadlen; i++)
+			printf(",0x%04x", payload[i]);
+	}
+	printf("\r\n");
+}
+
+// storage for i3c_batch: descriptors plus one pool for all write payloads and read buffers
+#define BATCH_MAX_DESCRIPTORS (32)
+static i3c_hl_batch_desc_t batch_desc[BATCH_MAX_DESCRIPTORS];
+static uint16_t batch_pool[4096];
+static uint32_t batch_pool_used; // in 16-bit words
+
+static void *batch_alloc(uint32_t bytecount)
+{
+	void *p = NULL;
+	uint32_t wordcount = (bytecount + 1) / 2;
+
+	if (batch_pool_used + wordcount <= count_of(batch_pool))
+	{
+		p = &batch_pool[batch_pool_used];
+		batch_pool_used += wordcount;
+	}
+	return p;
+}
+
+// parse a byte list into the pool. Returns false if the pool is exhausted
+static bool batch_parse_bytes(const char *str, const void **pp, uint32_t *pcount)
+{
+	uint8_t *p = batch_alloc(0);
+	uint32_t len = (count_of(batch_pool) - batch_pool_used) * 2;
+
+	parse_array_string(str, p, &len);
+	batch_alloc(len);
+	*pp = p;
+	*pcount = len;
+	return len > 0;
+}
+
+// parse one descriptor "op:field:field...". A trailing ! at the op name sets stop on error for this descriptor.
+static bool batch_parse_descriptor(char *str, i3c_hl_batch_desc_t *pdesc)
+{
+	char *field[5] = { NULL };
+	uint32_t fieldcount = 0;
+	char *psep;
+	bool ok = true;
+
+	memset(pdesc, 0, sizeof(*pdesc));
+	while (str && (fieldcount < count_of(field)))
+	{
+		field[fieldcount++] = str;
+		psep = strchr(str, ':');
+		if (psep)
 		{
-			readpayloadlen = 0;
+			*psep++ = 0;
 		}
+		str = psep;
+	}
+	psep = strchr(field[0], '!');
+	if (psep)
+	{
+		*psep = 0;
+		pdesc->flags |= I3C_HL_BATCH_FLAG_STOP_ON_ERROR;
 	}
 
-	printf("%s,%d", i3c_hl_get_errorstring(retcode), payloadlen);
+	if ( (strcmp(field[0], "w") == 0) && (fieldcount == 3) )
+	{
+		pdesc->op = i3c_hl_batch_op_sdr_write;
+		pdesc->addr = strtol(field[1], NULL, 0);
+		ok = batch_parse_bytes(field[2], &pdesc->pwritedat, &pdesc->writecount);
+	}
+	else if ( (strcmp(field[0], "r") == 0) && (fieldcount == 3) )
+	{
+		pdesc->op = i3c_hl_batch_op_sdr_read;
+		pdesc->addr = strtol(field[1], NULL, 0);
+		pdesc->readcount = strtol(field[2], NULL, 0);
+		pdesc->preaddat = batch_alloc(pdesc->readcount);
+	}
+	else if ( (strcmp(field[0], "wr") == 0) && (fieldcount == 4) )
+	{
+		pdesc->op = i3c_hl_batch_op_sdr_writeread;
+		pdesc->addr = strtol(field[1], NULL, 0);
+		ok = batch_parse_bytes(field[2], &pdesc->pwritedat, &pdesc->writecount);
+		pdesc->readcount = strtol(field[3], NULL, 0);
+		pdesc->preaddat = batch_alloc(pdesc->readcount);
+	}
+	else if ( (strcmp(field[0], "bc") == 0) && (fieldcount == 2) )
+	{
+		pdesc->op = i3c_hl_batch_op_ccc_broadcast;
+		ok = batch_parse_bytes(field[1], &pdesc->pwritedat, &pdesc->writecount);
+	}
+	else if ( (strcmp(field[0], "dw") == 0) && (fieldcount == 4) )
+	{
+		const void *p;
+		pdesc->op = i3c_hl_batch_op_ccc_direct_write;
+		pdesc->addr = strtol(field[1], NULL, 0);
+		ok = batch_parse_bytes(field[2], &pdesc->pwritedat, &pdesc->writecount) &&
+		     batch_parse_bytes(field[3], &p, &pdesc->directcount);
+		pdesc->pdirectdat = p;
+	}
+	else if ( (strcmp(field[0], "dr") == 0) && (fieldcount == 4) )
+	{
+		pdesc->op = i3c_hl_batch_op_ccc_direct_read;
+		pdesc->addr = strtol(field[1], NULL, 0);
+		ok = batch_parse_bytes(field[2], &pdesc->pwritedat, &pdesc->writecount);
+		pdesc->readcount = strtol(field[3], NULL, 0);
+		pdesc->preaddat = batch_alloc(pdesc->readcount);
+	}
+	else if ( (strcmp(field[0], "ddrw") == 0) && (fieldcount == 4) )
+	{
+		uint16_t *p = batch_alloc(0);
+		uint32_t len = count_of(batch_pool) - batch_pool_used;
+		pdesc->op = i3c_hl_batch_op_ddr_write;
+		pdesc->addr = strtol(field[1], NULL, 0);
+		pdesc->cmd = strtol(field[2], NULL, 0);
+		parse_array_string_uint16(field[3], p, &len);
+		batch_alloc(len * 2);
+		pdesc->pwritedat = p;
+		pdesc->writecount = len;
+		ok = len > 0;
+		// those settings can be adjusted by the user calling the i3c_ddr_config function
+		if (i3c_ddr_config_write_ack_enable)
+			pdesc->flags |= I3C_HL_BATCH_FLAG_DDR_ACK_NACK;
+		if (i3c_ddr_config_enable_early_write_term)
+			pdesc->flags |= I3C_HL_BATCH_FLAG_DDR_EARLY_WRITE_TERM;
+		if (i3c_ddr_config_crc_word_indicator)
+			pdesc->flags |= I3C_HL_BATCH_FLAG_DDR_CRC_ON_EARLY_TERM;
+	}
+	else if ( (strcmp(field[0], "ddrr") == 0) && (fieldcount == 4) )
+	{
+		pdesc->op = i3c_hl_batch_op_ddr_read;
+		pdesc->addr = strtol(field[1], NULL, 0);
+		pdesc->cmd = strtol(field[2], NULL, 0);
+		pdesc->readcount = strtol(field[3], NULL, 0);
+		pdesc->preaddat = batch_alloc(pdesc->readcount * 2);
+		if (i3c_ddr_config_enable_early_write_term) // same setting as used by i3c_ddr_read
+			pdesc->flags |= I3C_HL_BATCH_FLAG_DDR_CRC_ON_EARLY_TERM;
+	}
+	else if ( (strcmp(field[0], "delay") == 0) && (fieldcount == 2) )
+	{
+		pdesc->op = i3c_hl_batch_op_delay;
+		pdesc->delay_us = strtol(field[1], NULL, 0);
+	}
+	else
+	{
+		ok = false;
+	}
 
-	if (retcode == i3c_hl_status_ok)
+	if ( (pdesc->readcount > 0) && (pdesc->preaddat == NULL) )
 	{
-		for (uint32_t i=0; i<payloadlen; i++)
-			printf(",0x%04x", payload[i]);
+		ok = false;
+	}
+	return ok;
+}
+
+UCLI_COMMAND_DEF(i3c_batch, "Execute a list of transfers back to back. Returns the overall status followed by ';' and status + data of every transfer",
+    UCLI_STR_ARG_DEF(descriptors, "Transfers seperated with ; without whitespaces: w:addr:payload r:addr:len wr:addr:payload:len bc:payload "
+                                  "dw:addr:bc_payload:dir_payload dr:addr:bc_payload:len ddrw:addr:cmd:words ddrr:addr:cmd:wordcount delay:us. "
+                                  "Append ! to the transfer name to stop the batch when it fails (e.g. w!:0x30:0x12,0x34;r:0x30:2)")
+)
+{
+	char line[UCLI_MAXLINELEN+1];
+	char *pdesc, *pnext;
+	uint32_t count = 0;
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
+
+	strncpy(line, args->descriptors, UCLI_MAXLINELEN);
+	line[UCLI_MAXLINELEN] = 0;
+	batch_pool_used = 0;
+	pdesc = line;
+	while (pdesc && *pdesc && (retcode == i3c_hl_status_ok))
+	{
+		pnext = strchr(pdesc, ';');
+		if (pnext)
+		{
+			*pnext++ = 0;
+		}
+		if ( (count >= BATCH_MAX_DESCRIPTORS) || !batch_parse_descriptor(pdesc, &batch_desc[count]) )
+		{
+			ucli_error("invalid transfer descriptor");
+			retcode = i3c_hl_status_param_outofrange;
+		}
+		count++;
+		pdesc = pnext;
+	}
+
+	if (retcode != i3c_hl_status_ok)
+	{ // nothing executed
+		printf("%s\r\n", i3c_hl_get_errorstring(retcode));
+		return;
+	}
+
+	retcode = busengine_run(i3c_cli_pbus(), batch_desc, count, NULL);
+	printf("%s", i3c_hl_get_errorstring(retcode));
+	for (uint32_t i=0; i<count; i++)
+	{
+		i3c_hl_batch_desc_t *pd = &batch_desc[i];
+
+		printf(";%s", i3c_hl_get_errorstring(pd->status));
+		if (pd->op == i3c_hl_batch_op_ddr_write)
+		{
+			printf(",%d", pd->writecount);
+		}
+		else if ( (pd->status == i3c_hl_status_ok) && (pd->op == i3c_hl_batch_op_ddr_read) )
+		{
+			for (uint32_t j=0; j<pd->readcount; j++)
+				printf(",0x%04x", ((uint16_t *)pd->preaddat)[j]);
+		}
+		else if ( (pd->status == i3c_hl_status_ok) && (pd->readcount > 0) )
+		{
+			for (uint32_t j=0; j<pd->readcount; j++)
+				printf(",0x%02x", ((uint8_t *)pd->preaddat)[j]);
+		}
+	}
+	printf("\r\n");
+}
+
+UCLI_COMMAND_DEF(i3c_sample_job, "Set a job of the periodic sampler on the selected bus. It is executed every period_us once the sampler is started",
+    UCLI_INT_ARG_DEF(index, "Index in the job table (0..15)"),
+    UCLI_INT_ARG_DEF(period_us, "Period in us, 0 = execute once"),
+    UCLI_STR_ARG_DEF(descriptor, "Transfer as in i3c_batch: w:addr:payload r:addr:len wr:addr:payload:len bc:payload dr:addr:bc_payload:len "
+                                 "ddrw:addr:cmd:words ddrr:addr:cmd:wordcount. Up to 8 write and 32 read bytes"),
+    UCLI_OPTIONAL_INT_ARG_DEF(offset_us, "First execution in us after i3c_sample_start (default: 0)")
+)
+{
+	char line[UCLI_MAXLINELEN+1];
+	i3c_hl_batch_desc_t desc;
+	i3c_hl_status_t retcode = i3c_hl_status_param_outofrange;
+	uint32_t offset_us = (args->offset_us == UCLI_INT_ARG_DEFAULT) ? 0 : (uint32_t)args->offset_us;
+
+	strncpy(line, args->descriptor, UCLI_MAXLINELEN);
+	line[UCLI_MAXLINELEN] = 0;
+	batch_pool_used = 0;
+	if ( (args->index >= 0) && (args->period_us >= 0) && batch_parse_descriptor(line, &desc) )
+	{
+		retcode = sampler_job_set((uint8_t)args->index, i3c_cli_pbus(), &desc, (uint32_t)args->period_us, offset_us);
+	}
+	printf("%s\r\n", i3c_hl_get_errorstring(retcode));
+}
+
+UCLI_COMMAND_DEF(i3c_sample_clear, "Remove a job of the periodic sampler",
+    UCLI_OPTIONAL_INT_ARG_DEF(index, "Index in the job table (default: all jobs)")
+)
+{
+	sampler_job_clear((args->index == UCLI_INT_ARG_DEFAULT) ? SAMPLER_MAXJOBS : (uint8_t)args->index);
+	printf("%s\r\n", i3c_hl_get_errorstring(i3c_hl_status_ok));
+}
+
+UCLI_COMMAND_DEF(i3c_sample_start, "Start the periodic sampler. Clears all queued samples and counters. Returns the start time in us all job offsets refer to",
+    UCLI_OPTIONAL_INT_ARG_DEF(delay_us, "Delay of the start in us (default: 0)")
+)
+{
+	uint64_t start_us = time_us_64() + ((args->delay_us == UCLI_INT_ARG_DEFAULT) ? 0 : (uint32_t)args->delay_us);
+
+	printf("%s,%llu\r\n", i3c_hl_get_errorstring(i3c_hl_status_ok), (unsigned long long)sampler_start(start_us));
+}
+
+UCLI_COMMAND_DEF(i3c_sample_stop, "Stop the periodic sampler. Queued samples can still be read")
+{
+	sampler_stop();
+	printf("%s\r\n", i3c_hl_get_errorstring(i3c_hl_status_ok));
+}
+
+UCLI_COMMAND_DEF(i3c_sample_read, "Read samples of the periodic sampler. Returns the count of dropped samples followed by ';' timestamp in us, job, status and read data of every sample",
+    UCLI_OPTIONAL_INT_ARG_DEF(maxcount, "Maximum count of samples to read (default: all)")
+)
+{
+	sampler_sample_t sample;
+	uint32_t maxcount = (args->maxcount == UCLI_INT_ARG_DEFAULT) ? SAMPLER_QUEUE : (uint32_t)args->maxcount;
+
+	printf("%s,%u", i3c_hl_get_errorstring(i3c_hl_status_ok), sampler_dropped());
+	while ( (maxcount-- > 0) && (sampler_read(&sample, 1) > 0) )
+	{
+		printf(";%llu,%u,%s", (unsigned long long)sample.timestamp_us, sample.job, i3c_hl_get_errorstring(sample.status));
+		if (sample.op == i3c_hl_batch_op_ddr_read)
+		{
+			for (uint32_t i=0; i<sample.len; i+=2)
+				printf(",0x%04x", sample.data[i] | (sample.data[i+1] << 8));
+		}
+		else
+		{
+			for (uint32_t i=0; i<sample.len; i++)
+				printf(",0x%02x", sample.data[i]);
+		}
 	}
 	printf("\r\n");
 }
 
+UCLI_COMMAND_DEF(i3c_sample_stats, "Show the state of the periodic sampler: running flag followed by ';' index, executed, missed and dropped count of every job")
+{
+	sampler_stats_t stats;
+
+	printf("%s,%u", i3c_hl_get_errorstring(i3c_hl_status_ok), sampler_running());
+	for (uint8_t i=0; i<SAMPLER_MAXJOBS; i++)
+	{
+		if (sampler_job_stats(i, &stats))
+			printf(";%u,%u,%u,%u", i, stats.executed, stats.missed, stats.dropped);
+	}
+	printf("\r\n");
+}
 
 UCLI_COMMAND_DEF(i3c_drivestrength, "Set the drive strength of SDA and SCL outputs of the controller. This helps in addressing signal integrity issues e.g. minimize crosstalk",
     UCLI_INT_ARG_DEF(strength, "2 for 2mA, 4 for 4mA, 8 for 8mA, 12 for 12mA (default)")
 	)
 {
 	i3c_hl_status_t retcode;
-	retcode = i3c_hl_set_drivestrength(args->strength);
+	retcode = i3c_hl_set_drivestrength(i3c_cli_pbus(), args->strength);
 	printf("%s\r\n", i3c_hl_get_errorstring(retcode));
 }
 
@@ -587,7 +1170,7 @@ UCLI_COMMAND_DEF(i3c_gpiobase, "set gpio base pin for i3c. The specified GPIO pi
 		ucli_error("gpiobase has to be in range 0..27");
 		return;
 	}
-	i3c_init(args->gpiobase);
+	retcode = busengine_bus_init(i3c_cli_pbus(), i3c_hl_bus_sm(i3c_cli_pbus()), args->gpiobase);
 	printf("%s", i3c_hl_get_errorstring(retcode));
 	printf("\r\n");
 }
@@ -691,12 +1274,11 @@ UCLI_COMMAND_DEF(i2c_timeout, "Set I2C timeout value. The timeout applies to rea
 	printf("%s\r\n", i3c_hl_get_errorstring(retcode));
 }
 
-UCLI_COMMAND_DEF(i2c_scan, "Scan for available i2c addreses. Reserved I2C addresses (like 0x00) are not scanned"
-)
+// collect all addresses which acknowledge on the i2c bus. Reserved I2C addresses are skipped
+static void i2c_scan_addresses(uint8_t *paddr, uint32_t *pcount)
 {
-	bool notfirst = false;
-	printf("%s,", i3c_hl_get_errorstring(i3c_hl_status_ok));
-	i3c_hl_i2c_pinmode(true);
+	uint32_t count = 0;
+	i3c_hl_i2c_pinmode(i3c_hl_bus(0), true);
 	i2c_init(i2c_instance, i2c_freq_khz*1000ul);	
 	for (uint8_t addr=0; addr<0x80; addr++)
 	{
@@ -707,35 +1289,64 @@ UCLI_COMMAND_DEF(i2c_scan, "Scan for available i2c addreses. Reserved I2C addres
 			ret = i2c_read_timeout_us (i2c_instance, addr, &rxdata, 1, false, i2c_timeout_ms*1000ul);
 			if ( ret >= 0 )
 			{
-				if (notfirst)
-					printf(",");
-				printf("0x%02x", addr);
-				notfirst = true;
+				paddr[count++] = addr;
 			}
 		}
 	}
-	i3c_hl_i2c_pinmode(false);
-	printf("\r\n");
+	i3c_hl_i2c_pinmode(i3c_hl_bus(0), false);
+	*pcount = count;
 }
 
-UCLI_COMMAND_DEF(i2c_write, "Execute an i2c write transfer to a target",
-    UCLI_INT_ARG_DEF(addr, "The 7-Bit address of the target"),
-    UCLI_OPTIONAL_STR_ARG_DEF(payload, "Optional payload data - byte values seperated with comma without whitespaces (e.g. 0x12,0x43,0x56)")
-)
+// i2c write (pwritedat != NULL), read (preaddat != NULL) or combined write read transfer
+static i3c_hl_status_t i2c_transfer(uint8_t addr, const uint8_t *pwritedat, uint32_t writelen, uint8_t *preaddat, uint32_t readlen)
 {
-	uint8_t payload[1024];
-	uint32_t payloadlen=sizeof(payload);
-	i3c_hl_status_t retcode;
-	retcode = i3c_hl_status_ok;
-	int ret;
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
 
-	i3c_hl_i2c_pinmode(true);
+	i3c_hl_i2c_pinmode(i3c_hl_bus(0), true);
 	i2c_init(i2c_instance, i2c_freq_khz*1000ul);	
+	if (pwritedat)
+	{
+		if (i2c_write_timeout_us(i2c_instance, addr, pwritedat, writelen, preaddat != NULL, i2c_timeout_ms*1000ul) < 0)
+			retcode = i3c_hl_status_i2c_xfererror;
+	}
+	if ( preaddat && (retcode == i3c_hl_status_ok) )
+	{
+		if (i2c_read_timeout_us (i2c_instance, addr, preaddat, readlen, false, i2c_timeout_ms*1000ul) < 0)
+			retcode = i3c_hl_status_i2c_xfererror;
+	}
+	i3c_hl_i2c_pinmode(i3c_hl_bus(0), false);
+	return retcode;
+}
+
+UCLI_COMMAND_DEF(i2c_scan, "Scan for available i2c addreses. Reserved I2C addresses (like 0x00) are not scanned"
+)
+{
+	uint8_t  addr[0x80];
+	uint32_t count;
+
+	i2c_scan_addresses(addr, &count);
+	printf("%s,", i3c_hl_get_errorstring(i3c_hl_status_ok));
+	for (uint32_t i=0; i<count; i++)
+	{
+		if (i > 0)
+			printf(",");
+		printf("0x%02x", addr[i]);
+	}
+	printf("\r\n");
+}
+
+UCLI_COMMAND_DEF(i2c_write, "Execute an i2c write transfer to a target",
+    UCLI_INT_ARG_DEF(addr, "The 7-Bit address of the target"),
+    UCLI_OPTIONAL_STR_ARG_DEF(payload, "Optional payload data - byte values seperated with comma without whitespaces (e.g. 0x12,0x43,0x56)")
+)
+{
+	uint8_t payload[1024];
+	uint32_t payloadlen=sizeof(payload);
+	i3c_hl_status_t retcode;
+
 	parse_array_string(args->payload, payload, &payloadlen);
-	if (i2c_write_timeout_us(i2c_instance, args->addr, payload, payloadlen, false, i2c_timeout_ms*1000ul) < 0)
-		retcode = i3c_hl_status_i2c_xfererror;
+	retcode = i2c_transfer(args->addr, payload, payloadlen, NULL, 0);
 	printf("%s\r\n", i3c_hl_get_errorstring(retcode));
-	i3c_hl_i2c_pinmode(false);
 }
 
 UCLI_COMMAND_DEF(i2c_read, "Execute an i2c read from a target",
@@ -749,13 +1360,8 @@ UCLI_COMMAND_DEF(i2c_read, "Execute an i2c read from a target",
 	uint32_t payloadlen=args->len;
 	
 	i3c_hl_status_t retcode;
-	retcode = i3c_hl_status_ok;
 
-	i3c_hl_i2c_pinmode(true);
-	i2c_init(i2c_instance, i2c_freq_khz*1000ul);	
-	if (i2c_read_timeout_us (i2c_instance, args->addr, payload, payloadlen, false, i2c_timeout_ms*1000ul) < 0)
-		retcode = i3c_hl_status_i2c_xfererror;
-	i3c_hl_i2c_pinmode(false);
+	retcode = i2c_transfer(args->addr, NULL, 0, payload, payloadlen);
 
 	printf("%s", i3c_hl_get_errorstring(retcode));
 	if (retcode == i3c_hl_status_ok)
@@ -781,20 +1387,7 @@ UCLI_COMMAND_DEF(i2c_writeread, "Execute an i2c combined write read transfer fro
 	rxlen = args->len;
 	parse_array_string(args->payload, payload, &payloadlen);
 
-	i3c_hl_i2c_pinmode(true);
-	i2c_init(i2c_instance, i2c_freq_khz*1000ul);	
-	if (i2c_write_timeout_us (i2c_instance, args->addr, payload, payloadlen, true, i2c_timeout_ms*1000ul) < 0)
-	{
-		retcode = i3c_hl_status_i2c_xfererror;
-	}
-	else
-	{
-		rxlen = args->len;
-		if (i2c_read_timeout_us (i2c_instance, args->addr, rxdata, rxlen, false, i2c_timeout_ms*1000ul) < 0)
- 			retcode = i3c_hl_status_i2c_xfererror;
-
-	}
-	i3c_hl_i2c_pinmode(false);
+	retcode = i2c_transfer(args->addr, payload, payloadlen, rxdata, rxlen);
 
 	printf("%s", i3c_hl_get_errorstring(retcode));
 	if (retcode == i3c_hl_status_ok)
@@ -805,18 +1398,873 @@ UCLI_COMMAND_DEF(i2c_writeread, "Execute an i2c combined write read transfer fro
 	printf("\r\n");
 }
 
-UCLI_COMMAND_DEF(i3c_recover, "reinitialize i3c driver")
+UCLI_COMMAND_DEF(i3c_recover, "reinitialize i3c driver of the selected bus")
 {
-	uint8_t id[8];
+	i3c_hl_bus_t   *pbus = i3c_cli_pbus();
+	i3c_hl_status_t retcode;
+
+	retcode = busengine_bus_init(pbus, i3c_hl_bus_sm(pbus), i3c_hl_bus_gpiobasepin(pbus));
+	printf("%s", i3c_hl_get_errorstring(retcode));
+	printf("\r\n");
+}
+
+UCLI_COMMAND_DEF(i3c_bus, "Select the I3C bus used by the following commands and optionally (re)initialize it. Returns gpiobase and state machine of the bus",
+    UCLI_INT_ARG_DEF(bus, "The bus number. Valid range: 0..3. Bus 0 is initialized at startup"),
+    UCLI_OPTIONAL_INT_ARG_DEF(gpiobase, "Initialize the bus with SDA on this gpio and SCL on gpio+1. Valid range: 0..28"),
+    UCLI_OPTIONAL_INT_ARG_DEF(sm, "The state machine (0..3) used in pio0 (SDR) and pio1 (HDR-DDR). Default: the bus number")
+)
+{
+	i3c_hl_bus_t   *pbus = i3c_hl_bus((args->bus < 0) ? I3C_HL_MAXBUS : (uint8_t)args->bus);
 	i3c_hl_status_t retcode = i3c_hl_status_ok;
-	if (is_xiao)
-		i3c_init(6);
-	else
-		i3c_init(16);
+
+	if (pbus == NULL)
+	{
+		retcode = i3c_hl_status_param_outofrange;
+	}
+	else if (args->gpiobase != UCLI_INT_ARG_DEFAULT)
+	{
+		intptr_t sm = (args->sm == UCLI_INT_ARG_DEFAULT) ? args->bus : args->sm;
+		if ( (args->gpiobase < 0) || (args->gpiobase > 28) || (sm < 0) || (sm > 3) )
+			retcode = i3c_hl_status_param_outofrange;
+		else
+			retcode = busengine_bus_init(pbus, (uint8_t)sm, (uint8_t)args->gpiobase);
+	}
+	else if (!i3c_hl_bus_initialized(pbus))
+	{
+		retcode = i3c_hl_status_param_outofrange;
+	}
+	if (retcode == i3c_hl_status_ok)
+	{
+		binframe_cdc.bus = (uint8_t)args->bus;
+	}
 	printf("%s", i3c_hl_get_errorstring(retcode));
+	if (retcode == i3c_hl_status_ok)
+	{
+		printf(",%u,%u", i3c_hl_bus_gpiobasepin(pbus), i3c_hl_bus_sm(pbus));
+	}
+	printf("\r\n");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// configuration store (see cfgstore.h). config holds the configuration applied at startup incl. the changes of
+// config_profile and config_daa, config_save takes over the current bus settings and writes it to the flash
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static cfgstore_config_t  config;
+static i3c_hl_daa_entry_t config_preferred[I3C_HL_MAXBUS][CFGSTORE_MAXPROFILES]; // profiles per bus for i3c_hl_daa
+
+static void config_defaults(cfgstore_config_t *pcfg)
+{
+	memset(pcfg, 0, sizeof(*pcfg));
+	for (uint32_t bus=0; bus<I3C_HL_MAXBUS; bus++)
+	{
+		pcfg->bus[bus].sm               = (uint8_t)bus;
+		pcfg->bus[bus].drivestrength_mA = 12;
+		pcfg->bus[bus].clkrate_khz      = 12500;
+		pcfg->bus[bus].daa_firstaddr    = 0x08;
+		pcfg->bus[bus].daa_lastaddr     = 0x7d;
+	}
+	pcfg->bus[0].initialized       = 1;
+	pcfg->bus[0].gpiobase          = is_xiao ? 6 : 16;
+	pcfg->ddr_crc_word_indicator   = 1;
+	pcfg->i2c_freq_khz             = 100;
+	pcfg->i2c_timeout_ms           = 100;
+}
+
+// hands the profiles to i3c_hl_daa of their buses
+static void config_preferred_update(void)
+{
+	uint32_t count[I3C_HL_MAXBUS] = { 0 };
+
+	for (uint32_t i=0; i<config.profilecount; i++)
+	{
+		const cfgstore_profile_t *pprofile = &config.profiles[i];
+		if (pprofile->bus < I3C_HL_MAXBUS)
+		{
+			i3c_hl_daa_entry_t *pentry = &config_preferred[pprofile->bus][count[pprofile->bus]++];
+			memcpy(pentry->pid, pprofile->pid, sizeof(pentry->pid));
+			pentry->addr = pprofile->addr;
+		}
+	}
+	for (uint32_t bus=0; bus<I3C_HL_MAXBUS; bus++)
+	{
+		i3c_hl_daa_preferred(i3c_hl_bus((uint8_t)bus), config_preferred[bus], count[bus]);
+	}
+}
+
+static cfgstore_profile_t *config_profile_find(const uint8_t *pid, uint8_t bus)
+{
+	for (uint32_t i=0; i<config.profilecount; i++)
+	{
+		if ( (config.profiles[i].bus == bus) && (memcmp(config.profiles[i].pid, pid, sizeof(config.profiles[i].pid)) == 0) )
+			return &config.profiles[i];
+	}
+	return NULL;
+}
+
+// sets the preferred address of a target, addr 0 removes its profile. Returns false when the table is full
+static bool config_profile_set(const uint8_t *pid, uint8_t bus, uint8_t addr)
+{
+	cfgstore_profile_t *pprofile = config_profile_find(pid, bus);
+
+	if (addr == 0)
+	{
+		if (pprofile)
+			*pprofile = config.profiles[--config.profilecount];
+		return true;
+	}
+	if (pprofile == NULL)
+	{
+		if (config.profilecount >= CFGSTORE_MAXPROFILES)
+			return false;
+		pprofile = &config.profiles[config.profilecount++];
+		memcpy(pprofile->pid, pid, sizeof(pprofile->pid));
+		pprofile->bus = bus;
+	}
+	pprofile->addr = addr;
+	return true;
+}
+
+// takes over the current settings of the buses, the CLI and I2C, and the addresses of all targets with known PID
+static void config_capture(void)
+{
+	static i3c_hl_device_t devs[I3C_HL_MAXDEVICES];
+
+	for (uint32_t bus=0; bus<I3C_HL_MAXBUS; bus++)
+	{
+		i3c_hl_bus_t   *pbus = i3c_hl_bus((uint8_t)bus);
+		cfgstore_bus_t *pb   = &config.bus[bus];
+
+		pb->initialized = i3c_hl_bus_initialized(pbus);
+		if (!pb->initialized)
+			continue;
+		pb->gpiobase         = i3c_hl_bus_gpiobasepin(pbus);
+		pb->sm               = i3c_hl_bus_sm(pbus);
+		pb->drivestrength_mA = i3c_hl_get_drivestrength(pbus);
+		pb->clkrate_khz      = (uint16_t)i3c_hl_get_clkrate(pbus);
+
+		uint32_t count = i3c_hl_device_list(pbus, devs, I3C_HL_MAXDEVICES);
+		for (uint32_t i=0; i<count; i++)
+		{
+			if (devs[i].flags & I3C_HL_DEVICE_PID)
+				config_profile_set(devs[i].pid, (uint8_t)bus, devs[i].addr);
+		}
+	}
+	config.cli_bus                = binframe_cdc.bus;
+	config.ddr_crc_word_indicator = i3c_ddr_config_crc_word_indicator;
+	config.ddr_early_write_term   = i3c_ddr_config_enable_early_write_term;
+	config.ddr_write_ack          = i3c_ddr_config_write_ack_enable;
+	config.i2c_freq_khz           = i2c_freq_khz;
+	config.i2c_timeout_ms         = i2c_timeout_ms;
+	config_preferred_update();
+}
+
+// called by main before the bus engine starts, so the buses are accessed directly. Settings which fail (e.g. pins of a
+// different board) keep the defaults
+static void config_apply(void)
+{
+	static i3c_hl_daa_entry_t entries[I3C_HL_MAXDEVICES];
+
+	config_defaults(&config);
+	cfgstore_load(&config);
+
+	i3c_ddr_config_crc_word_indicator      = config.ddr_crc_word_indicator != 0;
+	i3c_ddr_config_enable_early_write_term = config.ddr_early_write_term != 0;
+	i3c_ddr_config_write_ack_enable        = config.ddr_write_ack != 0;
+	if ( (config.i2c_freq_khz >= 1) && (config.i2c_freq_khz <= 2000) )
+	{
+		i2c_freq_khz = config.i2c_freq_khz;
+		i2c_set_baudrate(i2c_instance, i2c_freq_khz * 1000);
+	}
+	if (config.i2c_timeout_ms <= 10000)
+		i2c_timeout_ms = config.i2c_timeout_ms;
+	config_preferred_update();
+
+	for (uint32_t bus=0; bus<I3C_HL_MAXBUS; bus++)
+	{
+		i3c_hl_bus_t   *pbus = i3c_hl_bus((uint8_t)bus);
+		cfgstore_bus_t *pb   = &config.bus[bus];
+		uint32_t        count;
+
+		if (!pb->initialized)
+			continue;
+		if ( ((i3c_hl_bus_initialized(pbus)) && (i3c_hl_bus_gpiobasepin(pbus) == pb->gpiobase) && (i3c_hl_bus_sm(pbus) == pb->sm)) ||
+		     (i3c_init(pbus, pb->sm, pb->gpiobase) == i3c_hl_status_ok) )
+		{
+			i3c_hl_set_clkrate(pbus, pb->clkrate_khz);
+			i3c_hl_set_drivestrength(pbus, pb->drivestrength_mA);
+			if (pb->daa)
+			{ // targets keep their dynamic address over a reset of the module, RSTDAA gives them all to DAA
+				i3c_hl_rstdaa(pbus);
+				i3c_hl_daa(pbus, pb->daa_firstaddr, pb->daa_lastaddr, NULL, entries, I3C_HL_MAXDEVICES, &count);
+				for (uint32_t i=0; i<count; i++)
+					i3c_hl_device_discover(pbus, entries[i].addr);
+			}
+		}
+	}
+	if ( (config.cli_bus < I3C_HL_MAXBUS) && i3c_hl_bus_initialized(i3c_hl_bus(config.cli_bus)) )
+		binframe_cdc.bus = config.cli_bus;
+}
+
+UCLI_COMMAND_DEF(config_save, "Save the current settings of all buses (pins, clock, drive strength), the selected bus, i3c_ddr_config, i2c_clk and i2c_timeout to the flash, together with the profiles and DAA settings. The dynamic addresses of all targets with known PID become their preferred ones. Returns the count of saves since the flash was cleared and the count of profiles"
+)
+{
+	config_capture();
+	if (!cfgstore_save(&config))
+	{
+		ucli_error("writing the flash failed");
+		return;
+	}
+	printf("%s,%u,%u\r\n", i3c_hl_get_errorstring(i3c_hl_status_ok), (unsigned)cfgstore_sequence(), (unsigned)config.profilecount);
+}
+
+UCLI_COMMAND_DEF(config_clear, "Erase the configuration in the flash. The current settings stay until the next reset, the profiles and DAA settings are removed"
+)
+{
+	cfgstore_erase();
+	config_defaults(&config);
+	config_preferred_update();
+	printf("%s\r\n", i3c_hl_get_errorstring(i3c_hl_status_ok));
+}
+
+UCLI_COMMAND_DEF(config_show, "Show the configuration applied at startup incl. changes not saved yet. Returns the count of saves, selected bus, i3c_ddr_config flags, I2C clock in kHz and timeout in ms, followed by ';' initialized flag, gpiobase, state machine, clock in kHz, drive strength in mA, DAA flag, first and last DAA address of every bus and ';' PID, bus and preferred address of every profile"
+)
+{
+	printf("%s,%u,%u,%u,%u,%u,%u,%u", i3c_hl_get_errorstring(i3c_hl_status_ok), (unsigned)cfgstore_sequence(), config.cli_bus,
+	       config.ddr_crc_word_indicator, config.ddr_early_write_term, config.ddr_write_ack,
+	       (unsigned)config.i2c_freq_khz, (unsigned)config.i2c_timeout_ms);
+	for (uint32_t bus=0; bus<I3C_HL_MAXBUS; bus++)
+	{
+		const cfgstore_bus_t *pb = &config.bus[bus];
+		printf(";%u,%u,%u,%u,%u,%u,0x%02x,0x%02x", pb->initialized, pb->gpiobase, pb->sm, pb->clkrate_khz, pb->drivestrength_mA,
+		       pb->daa, pb->daa_firstaddr, pb->daa_lastaddr);
+	}
+	for (uint32_t i=0; i<config.profilecount; i++)
+	{
+		const cfgstore_profile_t *pprofile = &config.profiles[i];
+		printf(";0x");
+		for (int j=0; j<6; j++)
+			printf("%02x", pprofile->pid[j]);
+		printf(",%u,0x%02x", pprofile->bus, pprofile->addr);
+	}
 	printf("\r\n");
 }
 
+UCLI_COMMAND_DEF(config_profile, "Set the preferred dynamic address of a target on the selected bus, used by i3c_daa and the DAA at startup. Save it with config_save",
+    UCLI_STR_ARG_DEF(pid, "The 48 bit provisioned ID of the target, e.g. 0x0123456789ab"),
+    UCLI_INT_ARG_DEF(addr, "The preferred dynamic address, 0 removes the profile")
+)
+{
+	uint8_t pid[6];
+	char *pend;
+	unsigned long long value = strtoull(args->pid, &pend, 0);
+
+	if ( (*pend != '\0') || (value >> 48) )
+	{
+		ucli_error("pid has to be a 48 bit number");
+		return;
+	}
+	if ( (args->addr < 0) || (args->addr >= 0x7f) )
+	{
+		ucli_error("addr has to be in range 0..0x7e");
+		return;
+	}
+	for (int i=5; i>=0; i--, value >>= 8)
+		pid[i] = (uint8_t)value;
+	if (!config_profile_set(pid, binframe_cdc.bus, (uint8_t)args->addr))
+	{
+		printf("%s\r\n", i3c_hl_get_errorstring(i3c_hl_status_param_outofrange));
+		return;
+	}
+	config_preferred_update();
+	printf("%s\r\n", i3c_hl_get_errorstring(i3c_hl_status_ok));
+}
+
+UCLI_COMMAND_DEF(config_daa, "Enable or disable RSTDAA, DAA and discovery of all targets of the selected bus at startup. Save it with config_save",
+    UCLI_INT_ARG_DEF(enable, "1: enable, 0: disable"),
+    UCLI_OPTIONAL_INT_ARG_DEF(firstaddr, "First address of the DAA pool (default: 0x08)"),
+    UCLI_OPTIONAL_INT_ARG_DEF(lastaddr, "Last address of the DAA pool (default: 0x7d)")
+)
+{
+	cfgstore_bus_t *pb = &config.bus[binframe_cdc.bus];
+	int32_t firstaddr = (args->firstaddr == UCLI_INT_ARG_DEFAULT) ? 0x08 : args->firstaddr;
+	int32_t lastaddr = (args->lastaddr == UCLI_INT_ARG_DEFAULT) ? 0x7d : args->lastaddr;
+
+	if ( (firstaddr < 0) || (lastaddr >= 0x80) || (firstaddr > lastaddr) )
+	{
+		ucli_error("addresses have to be in range 0..0x7f, firstaddr <= lastaddr");
+		return;
+	}
+	pb->daa           = args->enable != 0;
+	pb->daa_firstaddr = (uint8_t)firstaddr;
+	pb->daa_lastaddr  = (uint8_t)lastaddr;
+	printf("%s\r\n", i3c_hl_get_errorstring(i3c_hl_status_ok));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// binary frame protocol. Carries the same transfers as the text commands above with raw payloads
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t   binframe_vendor_lastrx_us;
+
+static void binframe_cdc_write(const uint8_t *pdat, uint32_t len)
+{
+	stdio_put_string((const char *)pdat, len, false, false); // raw output without CR/LF translation
+}
+
+static void binframe_cdc_process(char ch)
+{
+	binframe_process(&binframe_cdc, ch);
+}
+
+static void binframe_vendor_write(const uint8_t *pdat, uint32_t len)
+{
+	// fill the TX fifo, TinyUSB starts a transfer for every complete packet. The last partial packet is flushed
+	// by the main loop after all received frames were processed
+	while ( (len > 0) && tud_vendor_mounted() )
+	{
+		uint32_t n = tud_vendor_write(pdat, len);
+		pdat += n;
+		len  -= n;
+		if (n == 0)
+		{ // fifo full, wait for packets to go out
+			tud_vendor_write_flush();
+			tud_task();
+		}
+	}
+}
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+	return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Transfers requested by binary frames are executed by the bus engine (see busengine.h) while core0 continues receiving
+// and parsing the following frames. Every queued transfer owns a job slot until its response was sent, responses are
+// sent in request order. Bus selections take a slot as well, so they keep their place in the response order.
+#define BINFRAME_JOBS (8u)
+
+typedef struct
+{
+	binframe_t          *pbf;
+	uint8_t              seq;
+	uint8_t              opcode;
+	busengine_job_t      job;
+	i3c_hl_batch_desc_t  desc[2];
+	uint16_t             wdat[BINFRAME_MAXLEN / 2]; // copy of the write payload, bytes or HDR-DDR words
+	uint16_t             rdat[1 + 1024];            // written HDR-DDR word count followed by the read data
+} binframe_job_t;
+
+static binframe_job_t binframe_jobs[BINFRAME_JOBS];
+static uint32_t       binframe_jobs_wr; // free running, written when a job is queued
+static uint32_t       binframe_jobs_rd; // free running, written when a response was sent
+
+static void usb_service(void)
+{
+	tud_task();
+}
+
+// send the responses of all completed jobs
+static void binframe_jobs_poll(void)
+{
+	while (binframe_jobs_rd != binframe_jobs_wr)
+	{
+		binframe_job_t *pj = &binframe_jobs[binframe_jobs_rd % BINFRAME_JOBS];
+		const uint8_t  *presp = (const uint8_t *)&pj->rdat[1];
+		uint32_t        resplen = 0;
+
+		if (!pj->job.done)
+			break;
+
+		switch (pj->opcode)
+		{
+			case BINFRAME_OP_I3C_SDR_READ:
+			case BINFRAME_OP_I3C_SDR_WRITEREAD:
+			case BINFRAME_OP_I3C_CCC_DIRECT_READ:
+				resplen = pj->desc[0].readcount;
+				break;
+			case BINFRAME_OP_I3C_DDR_READ:
+				resplen = pj->desc[0].readcount * 2;
+				break;
+			case BINFRAME_OP_I3C_DDR_WRITE:
+			case BINFRAME_OP_I3C_DDR_WRITEREAD:
+				// the written word count is meaningful also on errors
+				pj->rdat[0] = (uint16_t)pj->desc[0].writecount;
+				presp = (const uint8_t *)&pj->rdat[0];
+				resplen = 2;
+				if ( (pj->opcode == BINFRAME_OP_I3C_DDR_WRITEREAD) && (pj->job.status == i3c_hl_status_ok) )
+					resplen += pj->desc[1].readcount * 2;
+				break;
+		}
+		// read data is dropped on errors like in the text commands
+		if ( (pj->job.status != i3c_hl_status_ok) && (presp != (const uint8_t *)&pj->rdat[0]) )
+			resplen = 0;
+
+		binframe_respond(pj->pbf, pj->seq, pj->opcode, (uint8_t)pj->job.status, presp, resplen);
+		binframe_jobs_rd++;
+	}
+}
+
+// wait for all queued jobs and send their responses
+static void binframe_jobs_flush(void)
+{
+	while (binframe_jobs_rd != binframe_jobs_wr)
+	{
+		usb_service();
+		busengine_task();
+		binframe_jobs_poll();
+	}
+}
+
+// queue a transfer for core1. Returns false if opcode is no transfer
+static bool binframe_job_submit(binframe_t *pbf, uint8_t seq, uint8_t opcode, const uint8_t *p, uint32_t len)
+{
+	binframe_job_t      *pj;
+	i3c_hl_batch_desc_t *pd;
+	uint32_t             readcount = 0;
+	uint32_t             desccount = 1;
+	bool                 valid = true;
+
+	switch (opcode)
+	{
+		case BINFRAME_OP_I3C_SDR_WRITE:
+		case BINFRAME_OP_I3C_SDR_READ:
+		case BINFRAME_OP_I3C_SDR_WRITEREAD:
+		case BINFRAME_OP_I3C_CCC_BC_WRITE:
+		case BINFRAME_OP_I3C_CCC_DIRECT_WRITE:
+		case BINFRAME_OP_I3C_CCC_DIRECT_READ:
+		case BINFRAME_OP_I3C_DDR_WRITE:
+		case BINFRAME_OP_I3C_DDR_READ:
+		case BINFRAME_OP_I3C_DDR_WRITEREAD:
+		case BINFRAME_OP_I3C_BUS_SELECT:
+			break;
+		default:
+			return false;
+	}
+
+	// wait for a free slot
+	while ((binframe_jobs_wr - binframe_jobs_rd) >= BINFRAME_JOBS)
+	{
+		usb_service();
+		busengine_task();
+		binframe_jobs_poll();
+	}
+	pj = &binframe_jobs[binframe_jobs_wr % BINFRAME_JOBS];
+	pd = pj->desc;
+	memset(pd, 0, sizeof(pj->desc));
+	pj->pbf    = pbf;
+	pj->seq    = seq;
+	pj->opcode = opcode;
+	pd[0].addr     = p[0];
+	pd[0].preaddat = &pj->rdat[1];
+
+	switch (opcode)
+	{
+		case BINFRAME_OP_I3C_BUS_SELECT:
+		{ // jobs already queued keep their bus, so the selection needs no flush
+			i3c_hl_bus_t *pbus = i3c_hl_bus(p[0]);
+			valid = (pbus != NULL) && i3c_hl_bus_initialized(pbus);
+			if (valid)
+			{
+				pbf->bus = p[0];
+				pj->job.status = i3c_hl_status_ok;
+				pj->job.done = true;
+				binframe_jobs_wr++;
+				return true;
+			}
+			break;
+		}
+		case BINFRAME_OP_I3C_SDR_WRITE:
+			pd[0].op = i3c_hl_batch_op_sdr_write;
+			pd[0].writecount = len - 1;
+			memcpy(pj->wdat, &p[1], len - 1);
+			break;
+		case BINFRAME_OP_I3C_SDR_READ:
+		case BINFRAME_OP_I3C_SDR_WRITEREAD:
+		case BINFRAME_OP_I3C_CCC_DIRECT_READ:
+			readcount = get_le16(&p[1]);
+			valid = readcount <= 1024;
+			pd[0].op = (opcode == BINFRAME_OP_I3C_SDR_READ)      ? i3c_hl_batch_op_sdr_read :
+			           (opcode == BINFRAME_OP_I3C_SDR_WRITEREAD) ? i3c_hl_batch_op_sdr_writeread : i3c_hl_batch_op_ccc_direct_read;
+			pd[0].readcount = readcount;
+			pd[0].writecount = len - 3;
+			memcpy(pj->wdat, &p[3], len - 3);
+			break;
+		case BINFRAME_OP_I3C_CCC_BC_WRITE:
+			pd[0].op = i3c_hl_batch_op_ccc_broadcast;
+			pd[0].writecount = len;
+			memcpy(pj->wdat, p, len);
+			break;
+		case BINFRAME_OP_I3C_CCC_DIRECT_WRITE:
+			valid = len >= 2u + p[1];
+			if (valid)
+			{
+				pd[0].op = i3c_hl_batch_op_ccc_direct_write;
+				pd[0].writecount = p[1];
+				pd[0].pdirectdat = (const uint8_t *)pj->wdat + p[1];
+				pd[0].directcount = len - 2 - p[1];
+				memcpy(pj->wdat, &p[2], len - 2);
+			}
+			break;
+		case BINFRAME_OP_I3C_DDR_WRITE:
+		case BINFRAME_OP_I3C_DDR_WRITEREAD:
+		{
+			uint32_t hdrlen = (opcode == BINFRAME_OP_I3C_DDR_WRITE) ? 2 : 5;
+
+			pd[0].op = i3c_hl_batch_op_ddr_write;
+			pd[0].flags = i3c_ddr_write_flags();
+			pd[0].cmd = p[1];
+			pd[0].writecount = (len - hdrlen) / 2;
+			memcpy(pj->wdat, &p[hdrlen], pd[0].writecount * 2);
+			if (opcode == BINFRAME_OP_I3C_DDR_WRITEREAD)
+			{ // read only after a successful write
+				readcount = get_le16(&p[3]);
+				valid = (readcount > 0) && (readcount <= 1024);
+				pd[0].flags |= I3C_HL_BATCH_FLAG_DDR_RESTART | I3C_HL_BATCH_FLAG_STOP_ON_ERROR;
+				pd[1].op = i3c_hl_batch_op_ddr_read;
+				pd[1].flags = i3c_ddr_read_flags();
+				pd[1].addr = p[0];
+				pd[1].cmd = p[2];
+				pd[1].preaddat = &pj->rdat[1];
+				pd[1].readcount = readcount;
+				desccount = 2;
+			}
+			break;
+		}
+		case BINFRAME_OP_I3C_DDR_READ:
+			readcount = get_le16(&p[2]);
+			valid = (readcount > 0) && (readcount <= 1024);
+			pd[0].op = i3c_hl_batch_op_ddr_read;
+			pd[0].flags = i3c_ddr_read_flags();
+			pd[0].cmd = p[1];
+			pd[0].readcount = readcount;
+			break;
+	}
+	pd[0].pwritedat = pj->wdat;
+
+	if (!valid)
+	{
+		binframe_jobs_flush();
+		binframe_respond(pbf, seq, opcode, i3c_hl_status_param_outofrange, NULL, 0);
+		return true;
+	}
+
+	pj->job.pbus  = i3c_hl_bus(pbf->bus);
+	pj->job.pdesc = pd;
+	pj->job.count = desccount;
+	busengine_submit(&pj->job); // can not fail, there are not more job slots than ring entries of a bus
+	binframe_jobs_wr++;
+	return true;
+}
+
+// IBI records of all buses: dropped count (32 bit), per IBI: timestamp in us (64 bit), bus, len, data. Returns the length
+static uint32_t binframe_ibi_records(uint8_t *pbuf, uint32_t maxlen, uint32_t maxcount)
+{
+	uint32_t        dropped = busengine_ibi_dropped(NULL);
+	uint32_t        len = 4;
+	busengine_ibi_t ibi;
+
+	memcpy(pbuf, &dropped, 4);
+	while ( (maxcount-- > 0) && ((len + 10 + BUSENGINE_IBI_MAXLEN) <= maxlen) && (busengine_ibi_read(NULL, &ibi, 1) > 0) )
+	{
+		memcpy(&pbuf[len], &ibi.timestamp_us, 8);
+		pbuf[len + 8] = ibi.bus;
+		pbuf[len + 9] = ibi.len;
+		memcpy(&pbuf[len + 10], ibi.data, ibi.len);
+		len += 10 + ibi.len;
+	}
+	return len;
+}
+
+// transport which receives queued IBIs unsolicited as BINFRAME_OP_I3C_IBI_EVENT frames, NULL when streaming is off
+static binframe_t *binframe_ibi_stream;
+
+// send all queued IBIs to the streaming transport. Called from the main loop, so event frames never interrupt a response
+static void binframe_ibi_stream_poll(void)
+{
+	static uint8_t records[4 + 16 * (10 + BUSENGINE_IBI_MAXLEN)];
+	uint32_t       len;
+
+	if (binframe_ibi_stream == NULL)
+		return;
+	while ( (len = binframe_ibi_records(records, sizeof(records), 16)) > 4 )
+	{
+		binframe_respond(binframe_ibi_stream, 0, BINFRAME_OP_I3C_IBI_EVENT, i3c_hl_status_ok, records, len);
+	}
+}
+
+// sampler results: dropped count (32 bit), per sample: timestamp in us (64 bit), job, status, len, data. Returns the length
+static uint32_t binframe_sample_records(uint8_t *pbuf, uint32_t maxlen, uint32_t maxcount)
+{
+	uint32_t         dropped = sampler_dropped();
+	uint32_t         len = 4;
+	sampler_sample_t sample;
+
+	memcpy(pbuf, &dropped, 4);
+	while ( (maxcount-- > 0) && ((len + 11 + SAMPLER_MAXREAD) <= maxlen) && (sampler_read(&sample, 1) > 0) )
+	{
+		memcpy(&pbuf[len], &sample.timestamp_us, 8);
+		pbuf[len + 8]  = sample.job;
+		pbuf[len + 9]  = sample.status;
+		pbuf[len + 10] = sample.len;
+		memcpy(&pbuf[len + 11], sample.data, sample.len);
+		len += 11 + sample.len;
+	}
+	return len;
+}
+
+// transport which receives sampler results unsolicited as BINFRAME_OP_I3C_SAMPLE_EVENT frames, NULL when streaming is off
+static binframe_t *binframe_sample_stream;
+
+// send all queued sampler results to the streaming transport. Called from the main loop like binframe_ibi_stream_poll
+static void binframe_sample_stream_poll(void)
+{
+	static uint8_t records[4 + 32 * (11 + SAMPLER_MAXREAD)];
+	uint32_t       len;
+
+	if (binframe_sample_stream == NULL)
+		return;
+	while ( (len = binframe_sample_records(records, sizeof(records), 32)) > 4 )
+	{
+		binframe_respond(binframe_sample_stream, 0, BINFRAME_OP_I3C_SAMPLE_EVENT, i3c_hl_status_ok, records, len);
+	}
+}
+
+static void binframe_command(binframe_t *pbf, uint8_t seq, uint8_t opcode, const uint8_t *p, uint32_t len)
+{
+	static uint8_t  resp[2 + 2048];             // response payload
+	uint32_t        resplen = 0;
+	i3c_hl_status_t retcode = i3c_hl_status_ok;
+	i3c_hl_bus_t   *pbus = i3c_hl_bus(pbf->bus);
+
+	// minimum parameter length of each opcode
+	static const uint8_t minlen[0x48] = {
+		[BINFRAME_OP_GPIO_WRITE]           = 2, [BINFRAME_OP_I3C_DRIVESTRENGTH] = 1, [BINFRAME_OP_I3C_CLK]        = 4,
+		[BINFRAME_OP_I3C_ENTDAA]           = 1, [BINFRAME_OP_I3C_SDR_WRITE]     = 1, [BINFRAME_OP_I3C_SDR_READ]   = 3,
+		[BINFRAME_OP_I3C_SDR_WRITEREAD]    = 3, [BINFRAME_OP_I3C_CCC_BC_WRITE]  = 1, [BINFRAME_OP_I3C_CCC_DIRECT_WRITE] = 2,
+		[BINFRAME_OP_I3C_CCC_DIRECT_READ]  = 3, [BINFRAME_OP_I3C_DDR_CONFIG]    = 3, [BINFRAME_OP_I3C_DDR_WRITE]  = 2,
+		[BINFRAME_OP_I3C_DDR_READ]         = 4, [BINFRAME_OP_I3C_DDR_WRITEREAD] = 5, [BINFRAME_OP_I2C_CLK]        = 4,
+		[BINFRAME_OP_I2C_TIMEOUT]          = 4, [BINFRAME_OP_I2C_WRITE]         = 1, [BINFRAME_OP_I2C_READ]       = 3,
+		[BINFRAME_OP_I2C_WRITEREAD]        = 3, [BINFRAME_OP_I3C_IBI_CONFIG]    = 1, [BINFRAME_OP_I3C_IBI_READ]   = 2,
+		[BINFRAME_OP_I3C_IBI_STREAM]       = 1, [BINFRAME_OP_I3C_BUS_SELECT]    = 1, [BINFRAME_OP_I3C_BUS_INIT]   = 3,
+		[BINFRAME_OP_I3C_SAMPLE_JOB]       = 15, [BINFRAME_OP_I3C_SAMPLE_CLEAR] = 1, [BINFRAME_OP_I3C_SAMPLE_START] = 4,
+		[BINFRAME_OP_I3C_SAMPLE_READ]      = 2, [BINFRAME_OP_I3C_SAMPLE_STREAM] = 1,
+	};
+
+	if ( (opcode >= count_of(minlen)) || (len < minlen[opcode]) )
+	{
+		binframe_jobs_flush();
+		binframe_respond(pbf, seq, opcode, i3c_hl_status_param_outofrange, NULL, 0);
+		return;
+	}
+
+	if (binframe_job_submit(pbf, seq, opcode, p, len))
+	{ // transfer queued for the bus engine, the response is sent by binframe_jobs_poll
+		return;
+	}
+
+	// everything else runs on core0 and needs the bus for itself. Responses keep the request order
+	binframe_jobs_flush();
+	busengine_lock();
+	switch (opcode)
+	{
+		case BINFRAME_OP_GPIO_WRITE:
+			if ( (p[0] < 30) && (p[1] <= 2) )
+			{
+				if (p[1] < 2)
+					gpio_put(p[0], p[1]);
+				gpio_set_dir(p[0], p[1] < 2);
+			}
+			else
+			{
+				retcode = i3c_hl_status_param_outofrange;
+			}
+			break;
+		case BINFRAME_OP_GPIO_READ:
+		{
+			uint32_t gpiostate = 0;
+			for (uint32_t i=0; i<30; i++)
+			{
+				if ((io_bank0_hw->io[i].status & IO_BANK0_GPIO0_STATUS_INFROMPAD_BITS) >> IO_BANK0_GPIO0_STATUS_INFROMPAD_LSB > 0)
+				{
+					gpiostate |= (1<<i);
+				}
+			}
+			memcpy(resp, &gpiostate, 4);
+			resplen = 4;
+			break;
+		}
+		case BINFRAME_OP_I3C_DRIVESTRENGTH:
+			retcode = i3c_hl_set_drivestrength(pbus, p[0]);
+			break;
+		case BINFRAME_OP_I3C_TARGETRESET:
+			retcode = i3c_hl_targetreset(pbus);
+			break;
+		case BINFRAME_OP_I3C_CLK:
+			retcode = i3c_hl_set_clkrate(pbus, get_le32(p));
+			break;
+		case BINFRAME_OP_I3C_SCAN:
+			retcode = i3c_scan_addresses(pbus, resp, &resplen);
+			break;
+		case BINFRAME_OP_I3C_ENTDAA:
+			retcode = i3c_hl_entdaa(pbus, p[0] & 0x7f, resp);
+			resplen = (retcode == i3c_hl_status_ok) ? 8 : 0;
+			break;
+		case BINFRAME_OP_I3C_RSTDAA:
+			retcode = i3c_hl_rstdaa(pbus);
+			break;
+		case BINFRAME_OP_I3C_RECOVER:
+			retcode = busengine_bus_init(pbus, i3c_hl_bus_sm(pbus), i3c_hl_bus_gpiobasepin(pbus));
+			break;
+		case BINFRAME_OP_I3C_BUS_INIT:
+			if (i3c_hl_bus(p[0]) == NULL)
+				retcode = i3c_hl_status_param_outofrange;
+			else
+				retcode = busengine_bus_init(i3c_hl_bus(p[0]), p[2], p[1]);
+			break;
+		case BINFRAME_OP_I3C_POLL:
+		{
+			busengine_ibi_t ibi;
+
+			if (busengine_ibi_read(pbus, &ibi, 1) > 0)
+			{ // already read by the automatic IBI handling
+				memcpy(resp, ibi.data, ibi.len);
+				resplen = ibi.len;
+			}
+			else
+			{
+				resplen = 16;
+				retcode = i3c_hl_poll(pbus, resp, &resplen);
+			}
+			break;
+		}
+		case BINFRAME_OP_I3C_IBI_CONFIG:
+			busengine_ibi_enable(pbus, p[0] != 0);
+			break;
+		case BINFRAME_OP_I3C_IBI_READ:
+			resplen = binframe_ibi_records(resp, sizeof(resp), get_le16(p));
+			break;
+		case BINFRAME_OP_I3C_IBI_STREAM:
+			binframe_ibi_stream = (p[0] != 0) ? pbf : NULL;
+			if (p[0] != 0)
+				busengine_ibi_enable(pbus, true);
+			break;
+		case BINFRAME_OP_I3C_SAMPLE_JOB:
+		{
+			i3c_hl_batch_desc_t desc = {
+				.op = p[1], .flags = p[2], .addr = p[3], .cmd = p[4], .readcount = get_le16(&p[5]),
+				.pwritedat = &p[15], .writecount = len - 15,
+			};
+			if ( (desc.op == i3c_hl_batch_op_ddr_write) || (desc.op == i3c_hl_batch_op_ddr_read) )
+				desc.writecount /= 2;
+			retcode = sampler_job_set(p[0], pbus, &desc, get_le32(&p[7]), get_le32(&p[11]));
+			break;
+		}
+		case BINFRAME_OP_I3C_SAMPLE_CLEAR:
+			sampler_job_clear(p[0]);
+			break;
+		case BINFRAME_OP_I3C_SAMPLE_START:
+		{
+			uint64_t start_us = sampler_start(time_us_64() + get_le32(p));
+			memcpy(resp, &start_us, 8);
+			resplen = 8;
+			break;
+		}
+		case BINFRAME_OP_I3C_SAMPLE_STOP:
+			sampler_stop();
+			break;
+		case BINFRAME_OP_I3C_SAMPLE_READ:
+			resplen = binframe_sample_records(resp, sizeof(resp), get_le16(p));
+			break;
+		case BINFRAME_OP_I3C_SAMPLE_STATS:
+		{
+			sampler_stats_t stats;
+			resp[resplen++] = sampler_running();
+			for (uint8_t i=0; i<SAMPLER_MAXJOBS; i++)
+			{
+				if (!sampler_job_stats(i, &stats))
+					continue;
+				resp[resplen++] = i;
+				memcpy(&resp[resplen], &stats, 12);
+				resplen += 12;
+			}
+			break;
+		}
+		case BINFRAME_OP_I3C_SAMPLE_STREAM:
+			binframe_sample_stream = (p[0] != 0) ? pbf : NULL;
+			break;
+		case BINFRAME_OP_I3C_DDR_CONFIG:
+			i3c_ddr_config_crc_word_indicator = p[0] != 0;
+			i3c_ddr_config_enable_early_write_term = p[1] != 0;
+			i3c_ddr_config_write_ack_enable = p[2] != 0;
+			break;
+		case BINFRAME_OP_I2C_CLK:
+		{
+			uint32_t freq_khz = get_le32(p);
+			if ( (freq_khz >= 1) && (freq_khz <= 2000) )
+			{
+				i2c_freq_khz = freq_khz;
+				i2c_set_baudrate (i2c_instance, freq_khz * 1000);
+			}
+			else
+			{
+				retcode = i3c_hl_status_param_outofrange;
+			}
+			break;
+		}
+		case BINFRAME_OP_I2C_TIMEOUT:
+			if (get_le32(p) > 10000)
+				retcode = i3c_hl_status_param_outofrange;
+			else
+				i2c_timeout_ms = get_le32(p);
+			break;
+		case BINFRAME_OP_I2C_SCAN:
+			i2c_scan_addresses(resp, &resplen);
+			break;
+		case BINFRAME_OP_I2C_WRITE:
+			retcode = i2c_transfer(p[0], &p[1], len - 1, NULL, 0);
+			break;
+		case BINFRAME_OP_I2C_READ:
+		case BINFRAME_OP_I2C_WRITEREAD:
+			resplen = get_le16(&p[1]);
+			if (resplen > 1024)
+				retcode = i3c_hl_status_param_outofrange;
+			else if (opcode == BINFRAME_OP_I2C_READ)
+				retcode = i2c_transfer(p[0], NULL, 0, resp, resplen);
+			else
+				retcode = i2c_transfer(p[0], &p[3], len - 3, resp, resplen);
+			break;
+		case BINFRAME_OP_ECHO:
+			if (len > sizeof(resp))
+				retcode = i3c_hl_status_param_outofrange;
+			else
+			{
+				memcpy(resp, p, len);
+				resplen = len;
+			}
+			break;
+		default:
+			retcode = i3c_hl_status_param_outofrange;
+			break;
+	}
+
+	busengine_unlock();
+
+	// read data is dropped on errors like in the text commands
+	if (retcode != i3c_hl_status_ok)
+	{
+		resplen = 0;
+	}
+	binframe_respond(pbf, seq, opcode, (uint8_t)retcode, resp, resplen);
+}
+
 
 bool usb_newly_connected(void)
 {
@@ -834,6 +2282,7 @@ uint64_t last_timer;
 
 int main()
 {
+	tusb_init(); // the application uses TinyUSB directly (vendor interface), so stdio_usb does not init it
 	stdio_init_all();
 
 	is_xiao = xnp_is_xiao_module();
@@ -845,6 +2294,9 @@ int main()
 	}
 
     ucli_init();
+	binframe_init(&binframe_cdc, binframe_command, binframe_cdc_write);
+	binframe_init(&binframe_vendor, binframe_command, binframe_vendor_write);
+	ucli_escape_register(BINFRAME_SOF, binframe_cdc_process);
     ucli_cmd_register(gpio_write);
 	ucli_cmd_register(gpio_read);
     ucli_cmd_register(info);	
@@ -853,18 +2305,32 @@ int main()
 	ucli_cmd_register(i3c_clk);
 	ucli_cmd_register(i3c_scan);
 	ucli_cmd_register(i3c_entdaa);
+	ucli_cmd_register(i3c_daa);
+	ucli_cmd_register(i3c_devices);
+	ucli_cmd_register(i3c_discover);
 	ucli_cmd_register(i3c_rstdaa);
 	ucli_cmd_register(i3c_sdr_write);
+	ucli_cmd_register(i3c_sdr_write_bench);
 	ucli_cmd_register(i3c_sdr_read);
 	ucli_cmd_register(i3c_sdr_writeread);
 	ucli_cmd_register(i3c_sdr_ccc_bc_write);
 	ucli_cmd_register(i3c_sdr_ccc_direct_write);
 	ucli_cmd_register(i3c_sdr_ccc_direct_read);
 	ucli_cmd_register(i3c_poll);
+	ucli_cmd_register(i3c_ibi_auto);
+	ucli_cmd_register(i3c_ibi_read);
 	ucli_cmd_register(i3c_ddr_config);
 	ucli_cmd_register(i3c_ddr_write);
 	ucli_cmd_register(i3c_ddr_read);
 	ucli_cmd_register(i3c_ddr_writeread);
+	ucli_cmd_register(i3c_batch);
+	ucli_cmd_register(i3c_sample_job);
+	ucli_cmd_register(i3c_sample_clear);
+	ucli_cmd_register(i3c_sample_start);
+	ucli_cmd_register(i3c_sample_stop);
+	ucli_cmd_register(i3c_sample_read);
+	ucli_cmd_register(i3c_sample_stats);
+	ucli_cmd_register(stats);
 	ucli_cmd_register(i2c_clk);
 	ucli_cmd_register(i2c_scan);
 	ucli_cmd_register(i2c_timeout);
@@ -873,6 +2339,12 @@ int main()
 	ucli_cmd_register(i2c_writeread);
 
 	ucli_cmd_register(i3c_recover);
+	ucli_cmd_register(i3c_bus);
+	ucli_cmd_register(config_save);
+	ucli_cmd_register(config_clear);
+	ucli_cmd_register(config_show);
+	ucli_cmd_register(config_profile);
+	ucli_cmd_register(config_daa);
 	
 	
 	//ucli_cmd_register(i3c_gpiobase); // With xiao module autodetection this function is not required anymore.
@@ -907,33 +2379,79 @@ int main()
 
 	// initialize i3c to use GPIO16=SDA and GPIO17=SCL (raspberry pico board)
 	// xiao rp2040 base i2c pin is gpio6
+	// bus 0 runs on state machine 0, the other buses can be set up by the i3c_bus command
 	if (is_xiao)
-		i3c_init(6);
+		i3c_init(i3c_hl_bus(0), 0, 6);
 	else
-		i3c_init(16);
+		i3c_init(i3c_hl_bus(0), 0, 16);
 
 	// initialize i2c IP to default 100kHz - Note that i2c is not select in pinmux at this state
 	i2c_init(i2c_instance, 100000);
 
+	// the saved configuration: bus settings, profiles and DAA. Before the bus engine takes over the buses
+	config_apply();
+
+	// from now on transfers are executed by the bus engine: core1 for even bus numbers, busengine_task for odd ones
+	sampler_init();
+	busengine_init(usb_service);
+
 	while (1) 
 	{
+		tud_task();
+
 		if (usb_newly_connected())
 		{
 			sleep_ms(500);
 			ucli_init(); // this reprints the welcome message
 		}
-		else if (!tud_cdc_connected())
-		{ // not connected
+		else if ( !tud_cdc_connected() && ((time_us_32() - binframe_vendor_lastrx_us) > 1000000ul) )
+		{ // not connected and no recent bulk traffic
 			sleep_ms(10);
 		}
 
+		// binary frames from the vendor bulk interface, read in blocks instead of char by char
+		if (tud_vendor_available())
+		{
+			static uint8_t buf[CFG_TUD_VENDOR_RX_BUFSIZE];
+			uint32_t       n;
+
+			while ( (n = tud_vendor_read(buf, sizeof(buf))) > 0 )
+			{
+				binframe_receive(&binframe_vendor, buf, n);
+			}
+			binframe_vendor_lastrx_us = time_us_32();
+			comm_active = 3;
+		}
+		binframe_poll(&binframe_vendor);
+		busengine_task();
+		binframe_jobs_poll();
+		binframe_ibi_stream_poll();
+		binframe_sample_stream_poll();
+		tud_vendor_write_flush();
+
 		// put received char from stdin to ucli lib
 		int ch = getchar_timeout_us(0);
 		if (ch >= 0)
 		{
-        	ucli_process((char)ch);
+			if (binframe_busy(&binframe_cdc))
+				binframe_process(&binframe_cdc, (char)ch); // binary frame reception in progress
+			else
+			{
+				if ( (ch == '\r') || (ch == '\n') )
+				{ // a command may get executed, it needs the bus for itself and its output has to follow pending responses
+					binframe_jobs_flush();
+					busengine_lock();
+					ucli_process((char)ch);
+					busengine_unlock();
+				}
+				else
+				{
+					ucli_process((char)ch);
+				}
+			}
 			comm_active = 3; // keep Neolight >=300ms in ON state every time a character was received
 		}
+		binframe_poll(&binframe_cdc);
 
 		if (is_xiao)
 		{
@@ -0,0 +1,312 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "sampler.h"
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include <string.h>
+
+// job table entry. Changed by core0 only while the bus engine is locked and with interrupts disabled against the alarm.
+// pending is set by the alarm and cleared by the executor of the bus after the transfer, missed is counted by the alarm,
+// the other counters by the executor
+typedef struct
+{
+	i3c_hl_batch_desc_t desc;      // pwritedat points to writedat
+	uint16_t            writedat[SAMPLER_MAXWRITE / 2];
+	uint8_t             bus;
+	bool                configured;
+	bool                active;    // scheduled by the alarm
+	volatile bool       pending;   // due for execution
+	uint32_t            period_us;
+	uint32_t            offset_us;
+	uint64_t            next_us;   // time of the next execution
+	sampler_stats_t     stats;
+} sampler_job_state_t;
+
+static sampler_job_state_t s_sampler_job[SAMPLER_MAXJOBS];
+static bool                s_sampler_running;
+static uint                s_sampler_alarm;
+
+// result ring, written by both executors (serialized by the spin lock) and read by core0. Indexes are free running
+static sampler_sample_t    s_sampler_queue[SAMPLER_QUEUE];
+static volatile uint32_t   s_sampler_wr;
+static volatile uint32_t   s_sampler_rd;
+static volatile uint32_t   s_sampler_dropped;
+static spin_lock_t        *s_sampler_lock;
+
+static inline bool sampler_is_ddr(uint8_t op)
+{
+	return (op == i3c_hl_batch_op_ddr_write) || (op == i3c_hl_batch_op_ddr_read);
+}
+
+// marks the jobs which are due and programs the alarm for the next one
+static void __not_in_flash_func(sampler_alarm_callback)(uint alarm_num)
+{
+	uint64_t next;
+
+	do
+	{
+		uint64_t now = time_us_64();
+		bool     due = false;
+
+		next = UINT64_MAX;
+		for (uint32_t i=0; i<SAMPLER_MAXJOBS; i++)
+		{
+			sampler_job_state_t *pj = &s_sampler_job[i];
+
+			if (!pj->active)
+				continue;
+			if (pj->next_us <= now)
+			{
+				if (pj->pending)
+					pj->stats.missed++;
+				else
+					pj->pending = true;
+				due = true;
+				if (pj->period_us == 0)
+				{ // single shot
+					pj->active = false;
+					continue;
+				}
+				pj->next_us += pj->period_us;
+				if (pj->next_us <= now)
+				{ // more than a period late, e.g. while the bus engine was locked. Keep the phase
+					uint64_t late = (now - pj->next_us) / pj->period_us + 1;
+					pj->stats.missed += (uint32_t)late;
+					pj->next_us += late * pj->period_us;
+				}
+			}
+			if (pj->next_us < next)
+				next = pj->next_us;
+		}
+		if (due)
+			__sev(); // wakes up core1
+	} while ( s_sampler_running && (next != UINT64_MAX) && hardware_alarm_set_target(alarm_num, from_us_since_boot(next)) );
+}
+
+// let the alarm reevaluate the table, e.g. after a job got added
+static void sampler_reschedule(void)
+{
+	if (s_sampler_running)
+		hardware_alarm_force_irq(s_sampler_alarm);
+}
+
+void sampler_init(void)
+{
+	memset(s_sampler_job, 0, sizeof(s_sampler_job));
+	s_sampler_lock = spin_lock_instance(spin_lock_claim_unused(true));
+	s_sampler_alarm = hardware_alarm_claim_unused(true);
+	hardware_alarm_set_callback(s_sampler_alarm, sampler_alarm_callback); // the interrupt is handled by this core
+}
+
+i3c_hl_status_t sampler_job_set(uint8_t index, i3c_hl_bus_t *pbus, const i3c_hl_batch_desc_t *pdesc, uint32_t period_us, uint32_t offset_us)
+{
+	sampler_job_state_t *pj;
+	uint32_t             unit = sampler_is_ddr(pdesc->op) ? 2 : 1;
+	uint32_t             previntstate;
+
+	if ( (index >= SAMPLER_MAXJOBS) || (pbus == NULL) )
+		return i3c_hl_status_param_outofrange;
+	if ( (pdesc->op == i3c_hl_batch_op_ccc_direct_write) || (pdesc->op == i3c_hl_batch_op_delay) ||
+	     ((uint32_t)pdesc->op > i3c_hl_batch_op_delay) )
+		return i3c_hl_status_param_outofrange;
+	if ( ((pdesc->writecount * unit) > SAMPLER_MAXWRITE) || ((pdesc->readcount * unit) > SAMPLER_MAXREAD) )
+		return i3c_hl_status_param_outofrange;
+	if ( (period_us != 0) && (period_us < SAMPLER_MIN_PERIOD_US) )
+		return i3c_hl_status_param_outofrange;
+
+	pj = &s_sampler_job[index];
+	previntstate = save_and_disable_interrupts();
+	memset(pj, 0, sizeof(*pj));
+	pj->desc = *pdesc;
+	if (pdesc->writecount > 0)
+		memcpy(pj->writedat, pdesc->pwritedat, pdesc->writecount * unit);
+	pj->desc.pwritedat = pj->writedat;
+	pj->desc.preaddat = NULL;
+	pj->desc.flags &= ~I3C_HL_BATCH_FLAG_STOP_ON_ERROR;
+	pj->bus        = i3c_hl_bus_index(pbus);
+	pj->period_us  = period_us;
+	pj->offset_us  = offset_us;
+	pj->configured = true;
+	if (s_sampler_running)
+	{
+		pj->next_us = time_us_64() + offset_us;
+		pj->active  = true;
+	}
+	restore_interrupts(previntstate);
+	sampler_reschedule();
+	return i3c_hl_status_ok;
+}
+
+void sampler_job_clear(uint8_t index)
+{
+	uint32_t previntstate = save_and_disable_interrupts();
+
+	for (uint32_t i=0; i<SAMPLER_MAXJOBS; i++)
+	{
+		if ( (index >= SAMPLER_MAXJOBS) || (i == index) )
+			memset(&s_sampler_job[i], 0, sizeof(s_sampler_job[i]));
+	}
+	restore_interrupts(previntstate);
+}
+
+bool sampler_job_stats(uint8_t index, sampler_stats_t *pstats)
+{
+	if ( (index >= SAMPLER_MAXJOBS) || !s_sampler_job[index].configured )
+		return false;
+	if (pstats)
+		*pstats = s_sampler_job[index].stats;
+	return true;
+}
+
+uint64_t sampler_start(uint64_t start_us)
+{
+	uint32_t previntstate;
+	uint32_t lockstate;
+
+	sampler_stop();
+	if (start_us == 0)
+		start_us = time_us_64();
+
+	lockstate = spin_lock_blocking(s_sampler_lock);
+	s_sampler_rd = s_sampler_wr;
+	s_sampler_dropped = 0;
+	spin_unlock(s_sampler_lock, lockstate);
+
+	previntstate = save_and_disable_interrupts();
+	for (uint32_t i=0; i<SAMPLER_MAXJOBS; i++)
+	{
+		sampler_job_state_t *pj = &s_sampler_job[i];
+
+		memset(&pj->stats, 0, sizeof(pj->stats));
+		pj->next_us = start_us + pj->offset_us;
+		pj->active  = pj->configured;
+	}
+	s_sampler_running = true;
+	restore_interrupts(previntstate);
+	sampler_reschedule();
+	return start_us;
+}
+
+void sampler_stop(void)
+{
+	uint32_t previntstate = save_and_disable_interrupts();
+
+	s_sampler_running = false;
+	hardware_alarm_cancel(s_sampler_alarm);
+	for (uint32_t i=0; i<SAMPLER_MAXJOBS; i++)
+	{
+		s_sampler_job[i].active  = false;
+		s_sampler_job[i].pending = false;
+	}
+	restore_interrupts(previntstate);
+}
+
+bool sampler_running(void)
+{
+	return s_sampler_running;
+}
+
+uint32_t sampler_read(sampler_sample_t *psample, uint32_t maxcount)
+{
+	uint32_t count = 0;
+
+	while ( (count < maxcount) && (s_sampler_rd != s_sampler_wr) )
+	{
+		__dmb(); // read the entry after seeing the write index
+		psample[count++] = s_sampler_queue[s_sampler_rd % SAMPLER_QUEUE];
+		__dmb(); // the entry has to be read before it is released
+		s_sampler_rd++;
+	}
+	return count;
+}
+
+uint32_t sampler_dropped(void)
+{
+	return s_sampler_dropped;
+}
+
+bool __not_in_flash_func(sampler_pending)(i3c_hl_bus_t *pbus)
+{
+	uint8_t bus = i3c_hl_bus_index(pbus);
+
+	for (uint32_t i=0; i<SAMPLER_MAXJOBS; i++)
+	{
+		if ( s_sampler_job[i].pending && (s_sampler_job[i].bus == bus) )
+			return true;
+	}
+	return false;
+}
+
+// stores a result, the ring is shared by the executors of both cores
+static void __not_in_flash_func(sampler_store)(sampler_job_state_t *pj, const sampler_sample_t *psample)
+{
+	uint32_t lockstate = spin_lock_blocking(s_sampler_lock);
+
+	if ((s_sampler_wr - s_sampler_rd) >= SAMPLER_QUEUE)
+	{
+		pj->stats.dropped++;
+		s_sampler_dropped++;
+	}
+	else
+	{
+		s_sampler_queue[s_sampler_wr % SAMPLER_QUEUE] = *psample;
+		__dmb(); // the entry has to be visible before the write index
+		s_sampler_wr++;
+	}
+	spin_unlock(s_sampler_lock, lockstate);
+}
+
+void __not_in_flash_func(sampler_execute)(i3c_hl_bus_t *pbus)
+{
+	uint8_t bus = i3c_hl_bus_index(pbus);
+
+	for (uint32_t i=0; i<SAMPLER_MAXJOBS; i++)
+	{
+		sampler_job_state_t *pj = &s_sampler_job[i];
+		i3c_hl_batch_desc_t  desc;
+		sampler_sample_t     sample;
+
+		if ( !pj->pending || (pj->bus != bus) )
+			continue;
+		__dmb(); // read the job after seeing pending
+
+		desc = pj->desc;
+		desc.preaddat = sample.data;
+		sample.timestamp_us = time_us_64();
+		sample.job    = (uint8_t)i;
+		sample.bus    = bus;
+		sample.op     = (uint8_t)desc.op;
+		sample.status = (uint8_t)i3c_hl_batch_execute(pbus, &desc, 1, NULL);
+		sample.len    = 0;
+		if (sample.status == i3c_hl_status_ok)
+			sample.len = (uint8_t)(desc.readcount * (sampler_is_ddr(desc.op) ? 2 : 1));
+		pj->stats.executed++;
+		sampler_store(pj, &sample);
+
+		__dmb(); // results and counters before releasing the job
+		pj->pending = false;
+	}
+}
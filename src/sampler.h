@@ -0,0 +1,80 @@
+#ifndef _SAMPLER_H
+#define _SAMPLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i3c_hl.h"
+
+/*
+ * Periodic sampling: a table of jobs, each one a single transfer (see i3c_hl_batch_desc_t) on one bus which is repeated
+ * with a fixed period.
+ *
+ * A hardware timer alarm on core0 marks jobs as due at their scheduled time and wakes up the executors of the bus engine.
+ * The executor of the bus runs due jobs before queued jobs and IBIs, so the jitter of a sample is the remaining time of
+ * the transfer in progress and not the latency of the host. Each result is stored with the time the transfer was started
+ * into one RAM ring shared by all buses, which the host drains in blocks with sampler_read.
+ * A job which is still due when its next period starts counts as missed, a result which does not fit into the ring
+ * anymore counts as dropped. In both cases the sampling of the job continues with the next period.
+ *
+ * All functions are to be called from core0 only. Functions changing the job table or the sampler state have to be
+ * called with busengine_lock held, so no job gets executed while it is changed.
+ */
+
+#define SAMPLER_MAXJOBS       (16u)
+#define SAMPLER_MAXWRITE      (8u)    // write payload bytes of a job
+#define SAMPLER_MAXREAD       (32u)   // read bytes of a job
+#define SAMPLER_QUEUE         (256u)  // power of 2
+#define SAMPLER_MIN_PERIOD_US (20u)
+
+typedef struct
+{
+	uint64_t timestamp_us;            // time the transfer was started
+	uint8_t  job;                     // index in the job table
+	uint8_t  bus;
+	uint8_t  op;                      // i3c_hl_batch_op_t of the job
+	uint8_t  status;                  // i3c_hl_status_t of the transfer
+	uint8_t  len;                     // read bytes, 0 if the transfer failed. HDR-DDR words are little endian
+	uint8_t  data[SAMPLER_MAXREAD];
+} sampler_sample_t;
+
+typedef struct
+{
+	uint32_t executed;  // count of executed transfers
+	uint32_t missed;    // count of periods which started while the job was still due
+	uint32_t dropped;   // count of results which did not fit into the ring
+} sampler_stats_t;
+
+// claims the timer alarm. Call it on core0 before busengine_init
+void sampler_init(void);
+
+// sets job index of the table. pdesc is a SDR write/read/writeread, CCC broadcast, CCC direct read or HDR-DDR write/read
+// descriptor. The write payload is copied, preaddat is not used. The job is first executed offset_us after
+// sampler_start (when the sampler is already running: after this call), then every period_us. A period of 0 executes
+// the job only once.
+i3c_hl_status_t sampler_job_set(uint8_t index, i3c_hl_bus_t *pbus, const i3c_hl_batch_desc_t *pdesc, uint32_t period_us, uint32_t offset_us);
+
+// removes job index from the table, all jobs when index is SAMPLER_MAXJOBS or higher
+void sampler_job_clear(uint8_t index);
+
+// true when job index is set. pstats (optional) returns its counters since sampler_start
+bool sampler_job_stats(uint8_t index, sampler_stats_t *pstats);
+
+// starts all jobs with a common time base: start_us is the absolute time (time_us_64) offset 0 refers to, 0 = now.
+// Empties the ring and resets all counters. Returns start_us
+uint64_t sampler_start(uint64_t start_us);
+void     sampler_stop(void);
+bool     sampler_running(void);
+
+// removes up to maxcount results from the ring (oldest first). Returns the count of results copied to psample
+uint32_t sampler_read(sampler_sample_t *psample, uint32_t maxcount);
+
+// count of results of all jobs dropped since sampler_start because the ring was full
+uint32_t sampler_dropped(void);
+
+// called by the executor of pbus: true when a job of pbus is due
+bool sampler_pending(i3c_hl_bus_t *pbus);
+
+// called by the executor of pbus: executes all due jobs of pbus
+void sampler_execute(i3c_hl_bus_t *pbus);
+
+#endif
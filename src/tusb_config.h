@@ -0,0 +1,32 @@
+#ifndef _TUSB_CONFIG_H
+#define _TUSB_CONFIG_H
+
+/*
+ * TinyUSB configuration. The device has two functions:
+ *  - CDC: stdio, used for the interactive text CLI
+ *  - Vendor: one bulk IN/OUT endpoint pair carrying binary frames (see binframe.h) for the data plane
+ */
+
+#define CFG_TUSB_RHPORT0_MODE      (OPT_MODE_DEVICE)
+
+#ifndef CFG_TUSB_OS
+#define CFG_TUSB_OS                (OPT_OS_PICO)
+#endif
+
+#define CFG_TUD_ENDPOINT0_SIZE     (64)
+
+#define CFG_TUD_CDC                (1)
+#define CFG_TUD_MSC                (0)
+#define CFG_TUD_HID                (0)
+#define CFG_TUD_MIDI               (0)
+#define CFG_TUD_VENDOR             (1)
+
+#define CFG_TUD_CDC_RX_BUFSIZE     (256)
+#define CFG_TUD_CDC_TX_BUFSIZE     (256)
+
+// large enough to take a complete maximum size frame, so the host can send a request without waiting
+#define CFG_TUD_VENDOR_EPSIZE      (64)
+#define CFG_TUD_VENDOR_RX_BUFSIZE  (4096)
+#define CFG_TUD_VENDOR_TX_BUFSIZE  (4096)
+
+#endif
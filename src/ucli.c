@@ -35,6 +35,8 @@ static char s_historybuf[UCLI_MAXLINELEN+1];
 static uint32_t s_historybuflen=0;
 static uint32_t s_ucli_cpos=0; // cursor position
 static bool ucli_echooff = false;
+static char s_ucli_escape_char;
+static ucli_escape_handler_t s_ucli_escape_handler = NULL;
 
 static void s_ucli_printchar(char ch)
 {
@@ -524,11 +526,22 @@ int32_t s_ucli_tab_extension(void)
 }
 
 static bool terminalemulationmode_putty = true;
+void ucli_escape_register(char ch, ucli_escape_handler_t handler)
+{
+    s_ucli_escape_char = ch;
+    s_ucli_escape_handler = handler;
+}
+
 void ucli_process(char ch)
 {
     //printf(" %c  0x%02x \r\n", ch, (uint32_t)ch);
     if (ch == 0xff)
         return;
+    if ((s_ucli_escape_handler != NULL) && (ch == s_ucli_escape_char) && (s_ucli_linebuflen == 0))
+    {
+        s_ucli_escape_handler(ch); // the handler takes over the following characters
+        return;
+    }
     if ((ch == '@') && (s_ucli_linebuflen == 0))
     {
         ucli_echooff = true;
@@ -16,6 +16,7 @@ Extended it by in-line editing, supporting 2 terminal emulations
 #define UCLI_STR_ARG_DEFAULT ((const char*)0)
 
 typedef void(*ucli_cmd_handler_t)(const void*);
+typedef void(*ucli_escape_handler_t)(char ch);
 
 typedef enum
 {
@@ -101,6 +102,10 @@ bool ucli_cmd_register(const ucli_command_def_t* cmd);
 // print an error message to console
 void ucli_error(const char *errmsg);
 
+// register a handler which is called instead of the line editor when ch is received as first character of a line.
+// Used to escape into the binary frame protocol
+void ucli_escape_register(char ch, ucli_escape_handler_t handler);
+
 // process a received character
 void ucli_process(char ch);
 
@@ -2,8 +2,8 @@
 #define UCLI_CONFIG_H_INCLUDED
 
 
-#define UCLI_MAXLINELEN     (256)
-#define UCLI_MAX_COMMANDS   (32)
+#define UCLI_MAXLINELEN     (1024)
+#define UCLI_MAX_COMMANDS   (64)
 #define UCLI_PROMPT_STR     ("> ")
 
 #define UCLI_WELCOMEMSG "+------------------------------------------+\r\n"\
@@ -0,0 +1,140 @@
+/*
+MIT License
+
+Copyright (c) 2024 xyphro, Kai Gossner, xyphro@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// USB descriptors: CDC for stdio (text CLI) + vendor bulk interface for binary frames.
+// VID/PID and strings are the same as the pico_stdio_usb ones, so existing host tools still find the device.
+
+#include "tusb.h"
+#include "pico/unique_id.h"
+
+#define USBD_VID               (0x2E8A) // Raspberry Pi
+#define USBD_PID               (0x000A) // Raspberry Pi Pico SDK CDC
+#define USBD_BCD_DEVICE        (0x0200)
+
+enum
+{
+	ITF_NUM_CDC = 0,
+	ITF_NUM_CDC_DATA,
+	ITF_NUM_VENDOR,
+	ITF_NUM_TOTAL
+};
+
+#define EPNUM_CDC_NOTIF        (0x81)
+#define EPNUM_CDC_OUT          (0x02)
+#define EPNUM_CDC_IN           (0x82)
+#define EPNUM_VENDOR_OUT       (0x03)
+#define EPNUM_VENDOR_IN        (0x83)
+
+#define USBD_DESC_LEN          (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_VENDOR_DESC_LEN)
+
+enum
+{
+	STRID_LANGID = 0,
+	STRID_MANUFACTURER,
+	STRID_PRODUCT,
+	STRID_SERIAL,
+	STRID_CDC,
+	STRID_VENDOR,
+};
+
+static const tusb_desc_device_t usbd_desc_device =
+{
+	.bLength            = sizeof(tusb_desc_device_t),
+	.bDescriptorType    = TUSB_DESC_DEVICE,
+	.bcdUSB             = 0x0200,
+	.bDeviceClass       = TUSB_CLASS_MISC,
+	.bDeviceSubClass    = MISC_SUBCLASS_COMMON,
+	.bDeviceProtocol    = MISC_PROTOCOL_IAD,
+	.bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
+	.idVendor           = USBD_VID,
+	.idProduct          = USBD_PID,
+	.bcdDevice          = USBD_BCD_DEVICE,
+	.iManufacturer      = STRID_MANUFACTURER,
+	.iProduct           = STRID_PRODUCT,
+	.iSerialNumber      = STRID_SERIAL,
+	.bNumConfigurations = 1,
+};
+
+static const uint8_t usbd_desc_cfg[USBD_DESC_LEN] =
+{
+	TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, USBD_DESC_LEN, 0, 250),
+	TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, STRID_CDC, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
+	TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, STRID_VENDOR, EPNUM_VENDOR_OUT, EPNUM_VENDOR_IN, CFG_TUD_VENDOR_EPSIZE),
+};
+
+static char usbd_serial_str[PICO_UNIQUE_BOARD_ID_SIZE_BYTES * 2 + 1];
+
+static const char *const usbd_desc_str[] =
+{
+	[STRID_MANUFACTURER] = "Raspberry Pi",
+	[STRID_PRODUCT]      = "Pico",
+	[STRID_SERIAL]       = usbd_serial_str,
+	[STRID_CDC]          = "Board CDC",
+	[STRID_VENDOR]       = "I3C Blaster bulk",
+};
+
+const uint8_t *tud_descriptor_device_cb(void)
+{
+	return (const uint8_t *)&usbd_desc_device;
+}
+
+const uint8_t *tud_descriptor_configuration_cb(uint8_t index)
+{
+	(void)index;
+	return usbd_desc_cfg;
+}
+
+const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid)
+{
+	static uint16_t desc_str[32 + 1];
+	uint32_t        len;
+
+	(void)langid;
+	if (!usbd_serial_str[0])
+	{
+		pico_get_unique_board_id_string(usbd_serial_str, sizeof(usbd_serial_str));
+	}
+
+	if (index == STRID_LANGID)
+	{
+		desc_str[1] = 0x0409; // English
+		len = 1;
+	}
+	else
+	{
+		const char *str;
+
+		if (index >= count_of(usbd_desc_str))
+			return NULL;
+		str = usbd_desc_str[index];
+		for (len = 0; (len < 32) && str[len]; len++)
+		{
+			desc_str[1 + len] = str[len];
+		}
+	}
+
+	// first element is length (in bytes incl. header) and type
+	desc_str[0] = (uint16_t)((TUSB_DESC_STRING << 8) | (2 * len + 2));
+	return desc_str;
+}